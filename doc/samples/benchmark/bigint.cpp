@@ -0,0 +1,96 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  This program is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <cstdio>
+
+#include <lol/engine.h>
+
+using namespace lol;
+
+static size_t const BIGINT_RUNS = 20;
+
+/* Prevent the compiler from optimising the computations away */
+static uint32_t sink = 0;
+
+template<unsigned int N, typename T>
+static bigint<N,T> random_bigint(int bits)
+{
+    bigint<N,T> ret(0);
+    for (int n = 0; n < bits; n += 16)
+        ret = (ret << 16) | bigint<N,T>((int32_t)rand(0x10000));
+    return ret >> ((bits + 15) / 16 * 16 - bits);
+}
+
+/* Time a division by a number of half the size, and modular
+ * exponentiations with an odd and an even modulus of half the size,
+ * in microseconds. */
+template<unsigned int N, typename T>
+static void bench(int bits, float *result)
+{
+    lol::timer timer;
+
+    for (size_t run = 0; run < BIGINT_RUNS; run++)
+    {
+        bigint<N,T> a = random_bigint<N,T>(bits);
+        bigint<N,T> b = random_bigint<N,T>(bits / 2) | bigint<N,T>(1);
+        bigint<N,T> m = random_bigint<N,T>(bits / 2) | bigint<N,T>(1);
+        bigint<N,T> e = random_bigint<N,T>(bits / 2);
+
+        bigint<N,T> q(0);
+        timer.get();
+        for (int i = 0; i < 100; ++i)
+        {
+            q ^= a / b;
+            b = b + bigint<N,T>(2);
+        }
+        result[0] += timer.get() / 100;
+
+        timer.get();
+        q ^= pow_mod(a, e, m);
+        result[1] += timer.get();
+
+        timer.get();
+        q ^= pow_mod(a, e, m << 1);
+        result[2] += timer.get();
+
+        sink ^= (uint32_t)q;
+    }
+
+    for (int i = 0; i < 3; i++)
+        result[i] *= 1e6f / BIGINT_RUNS;
+}
+
+void bench_bigint(int mode)
+{
+    float result[6] = { 0.0f };
+
+    switch (mode)
+    {
+    case 1:
+        bench<32, uint32_t>(960, result);
+#if defined __SIZEOF_INT128__
+        bench<16, uint64_t>(960, result + 3);
+#endif
+        break;
+    }
+
+    msg::info("                              31-bit    63-bit\n");
+    msg::info("                               µs/op     µs/op\n");
+    msg::info("bigint / bigint             %9.3f %9.3f\n", result[0], result[3]);
+    msg::info("pow_mod (Montgomery)        %9.3f %9.3f\n", result[1], result[4]);
+    msg::info("pow_mod (Barrett)           %9.3f %9.3f\n", result[2], result[5]);
+}
+
@@ -0,0 +1,303 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  This program is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <cstdio>
+
+#include <lol/engine.h>
+
+using namespace lol;
+
+static int const IMAGE_SIZE = 1024;
+static int const IMAGE_RUNS = 5;
+
+static image random_image(ivec2 size, PixelFormat format)
+{
+    image ret(size);
+    u8vec4 *pixels = ret.lock<PixelFormat::RGBA_8>();
+    for (int n = 0; n < size.x * size.y; ++n)
+        pixels[n] = u8vec4(rand<uint8_t>(), rand<uint8_t>(),
+                           rand<uint8_t>(), 255);
+    ret.unlock(pixels);
+    ret.set_format(format);
+    return ret;
+}
+
+static void bench_resample(PixelFormat format)
+{
+    static struct { ResampleAlgorithm algorithm; char const *name; } const
+    resamplers[] =
+    {
+        { ResampleAlgorithm::Bresenham, "Bresenham" },
+        { ResampleAlgorithm::Box,       "Box      " },
+        { ResampleAlgorithm::Bilinear,  "Bilinear " },
+        { ResampleAlgorithm::Bicubic,   "Bicubic  " },
+        { ResampleAlgorithm::Mitchell,  "Mitchell " },
+        { ResampleAlgorithm::Lanczos3,  "Lanczos3 " },
+    };
+
+    image src = random_image(ivec2(IMAGE_SIZE), format);
+    lol::timer timer;
+
+    msg::info("                          ms/image\n");
+    for (auto const &r : resamplers)
+    {
+        float down = 0.f, up = 0.f;
+
+        for (int run = 0; run < IMAGE_RUNS; ++run)
+        {
+            /* The source bitplane may have been converted by a previous
+             * run, so make sure we always start from the same format. */
+            src.set_format(format);
+            timer.get();
+            image dst = src.Resize(ivec2(IMAGE_SIZE / 4), r.algorithm);
+            down += timer.get();
+
+            src.set_format(format);
+            timer.get();
+            dst = src.Resize(ivec2(IMAGE_SIZE * 3 / 2), r.algorithm);
+            up += timer.get();
+        }
+
+        msg::info("%s ÷4           %8.3f\n", r.name,
+                  down * 1e3f / IMAGE_RUNS);
+        msg::info("%s ×1.5         %8.3f\n", r.name,
+                  up * 1e3f / IMAGE_RUNS);
+    }
+}
+
+static void bench_quantize()
+{
+    /* A smooth image is more representative than random noise */
+    image src(ivec2(IMAGE_SIZE, IMAGE_SIZE));
+    vec4 *pixels = src.lock<PixelFormat::RGBA_F32>();
+    for (int y = 0; y < IMAGE_SIZE; ++y)
+        for (int x = 0; x < IMAGE_SIZE; ++x)
+            pixels[y * IMAGE_SIZE + x] = vec4(
+                0.5f + 0.5f * lol::sin(x * 0.011f + y * 0.003f),
+                0.5f + 0.5f * lol::sin(y * 0.007f),
+                (float)(x ^ y) / IMAGE_SIZE, 1.f);
+    src.unlock(pixels);
+
+    lol::timer timer;
+
+    msg::info("                          ms/image\n");
+    for (int colors : { 16, 64, 256 })
+    {
+        float t[4] = { 0.f };
+
+        for (int run = 0; run < IMAGE_RUNS; ++run)
+        {
+            timer.get();
+            array<vec4> palette = src.quantize(colors,
+                                               QuantizeAlgorithm::MedianCut);
+            t[0] += timer.get();
+            palette = src.quantize(colors, QuantizeAlgorithm::KMeans);
+            t[1] += timer.get();
+            palette = src.quantize(colors, QuantizeAlgorithm::KMeans,
+                                   ColorSpace::CIELab);
+            t[2] += timer.get();
+            image dst = src.remap(palette);
+            t[3] += timer.get();
+        }
+
+        msg::info("median cut  %3d colours %8.3f\n", colors,
+                  t[0] * 1e3f / IMAGE_RUNS);
+        msg::info("k-means     %3d colours %8.3f\n", colors,
+                  t[1] * 1e3f / IMAGE_RUNS);
+        msg::info("k-means Lab %3d colours %8.3f\n", colors,
+                  t[2] * 1e3f / IMAGE_RUNS);
+        msg::info("remap       %3d colours %8.3f\n", colors,
+                  t[3] * 1e3f / IMAGE_RUNS);
+    }
+}
+
+static void bench_morphology()
+{
+    /* A noisy grey image, and a sparse binary mask */
+    image grey(ivec2(IMAGE_SIZE, IMAGE_SIZE));
+    image mask(ivec2(IMAGE_SIZE, IMAGE_SIZE));
+    float *pixels = grey.lock<PixelFormat::Y_F32>();
+    float *bits = mask.lock<PixelFormat::Y_F32>();
+    for (int n = 0; n < IMAGE_SIZE * IMAGE_SIZE; ++n)
+    {
+        pixels[n] = rand(1.f);
+        bits[n] = rand(1000) == 0 ? 1.f : 0.f;
+    }
+    grey.unlock(pixels);
+    mask.unlock(bits);
+
+    lol::timer timer;
+
+    msg::info("                          ms/image\n");
+    for (int radius : { 1, 4, 16, 64 })
+    {
+        float t[3] = { 0.f };
+
+        for (int run = 0; run < IMAGE_RUNS; ++run)
+        {
+            timer.get();
+            image dst = grey.Dilate(ivec2(radius));
+            t[0] += timer.get();
+            dst = grey.Dilate(ivec2(radius), MorphologyShape::Disc);
+            t[1] += timer.get();
+            dst = mask.Dilate(ivec2(radius), MorphologyShape::Disc);
+            t[2] += timer.get();
+        }
+
+        msg::info("rectangle   radius %3d   %8.3f\n", radius,
+                  t[0] * 1e3f / IMAGE_RUNS);
+        msg::info("disc        radius %3d   %8.3f\n", radius,
+                  t[1] * 1e3f / IMAGE_RUNS);
+        msg::info("binary disc radius %3d   %8.3f\n", radius,
+                  t[2] * 1e3f / IMAGE_RUNS);
+    }
+}
+
+static void bench_statistics()
+{
+    /* An 8K UHD grey image */
+    ivec2 const size(7680, 4320);
+    image src(size);
+    float *pixels = src.lock<PixelFormat::Y_F32>();
+    for (int y = 0; y < size.y; ++y)
+        for (int x = 0; x < size.x; ++x)
+            pixels[y * size.x + x] = 0.25f + 0.5f * lol::sin(x * 0.001f)
+                                            * lol::sin(y * 0.002f);
+    src.unlock(pixels);
+
+    lol::timer timer;
+    float t[5] = { 0.f };
+
+    for (int run = 0; run < IMAGE_RUNS; ++run)
+    {
+        timer.get();
+        image::pixel_stats st = src.statistics();
+        t[0] += timer.get();
+        array<ivec4> hist = src.histogram();
+        t[1] += timer.get();
+        vec4 median = src.percentile(0.5f);
+        t[2] += timer.get();
+        image dst = src.AutoContrast();
+        t[3] += timer.get();
+        dst = src.AutoThreshold();
+        t[4] += timer.get();
+        UNUSED(st, hist, median);
+    }
+
+    msg::info("                          ms/image\n");
+    msg::info("statistics               %8.3f\n", t[0] * 1e3f / IMAGE_RUNS);
+    msg::info("histogram                %8.3f\n", t[1] * 1e3f / IMAGE_RUNS);
+    msg::info("median                   %8.3f\n", t[2] * 1e3f / IMAGE_RUNS);
+    msg::info("AutoContrast             %8.3f\n", t[3] * 1e3f / IMAGE_RUNS);
+    msg::info("AutoThreshold            %8.3f\n", t[4] * 1e3f / IMAGE_RUNS);
+}
+
+static void bench_frames()
+{
+    /* A 1080p frame as read back from OpenGL */
+    ivec2 const size(1920, 1080), half(size / 2);
+    array<u8vec4> src;
+    for (int n = 0; n < size.x * size.y; ++n)
+        src << u8vec4(rand(256), rand(256), rand(256), 255);
+    u8vec4 const *top = &src[(size.y - 1) * size.x];
+
+    array<uint8_t> planes[3];
+    planes[0].resize(size.x * size.y);
+    planes[1].resize(half.x * half.y);
+    planes[2].resize(half.x * half.y);
+    uint8_t *const data[3] = { &planes[0][0], &planes[1][0], &planes[2][0] };
+    int const pitches[3] = { size.x, half.x, half.x };
+
+    lol::timer timer;
+    float t[2] = { 0.f };
+
+    for (int run = 0; run < IMAGE_RUNS; ++run)
+    {
+        timer.get();
+        convert_to_rgb332(top, -size.x, size, data[0], size.x);
+        t[0] += timer.get();
+        convert_to_yuv420(top, -size.x, size, data, pitches);
+        t[1] += timer.get();
+    }
+
+    msg::info("                          ms/frame\n");
+    msg::info("RGB 3:3:2                %8.3f\n", t[0] * 1e3f / IMAGE_RUNS);
+    msg::info("YUV 4:2:0                %8.3f\n", t[1] * 1e3f / IMAGE_RUNS);
+}
+
+static void bench_atlas()
+{
+    /* 100 tilesets of 20 sprites each, taken from the same image */
+    image src = random_image(ivec2(256), PixelFormat::RGBA_8);
+    array<array<ibox2>> groups;
+    for (int g = 0; g < 100; ++g)
+    {
+        groups.push(array<ibox2>());
+        for (int n = 0; n < 20; ++n)
+        {
+            ivec2 size(rand(8, 64), rand(8, 64));
+            ivec2 pos(rand(256 - size.x), rand(256 - size.y));
+            groups.last() << ibox2(pos, pos + size);
+        }
+    }
+
+    lol::timer timer;
+    float t = 0.f, efficiency = 0.f;
+    int pages = 0;
+
+    for (int run = 0; run < IMAGE_RUNS; ++run)
+    {
+        image_atlas atlas(ivec2(1024), 2);
+        timer.get();
+        for (int g = 0; g < groups.count(); ++g)
+            atlas.add(format("group%d", g), src, groups[g]);
+        t += timer.get();
+        efficiency = atlas.efficiency();
+        pages = atlas.page_count();
+    }
+
+    msg::info("                          ms/atlas  pages  efficiency\n");
+    msg::info("MaxRects, padding 2      %8.3f  %5d  %9.1f%%\n",
+              t * 1e3f / IMAGE_RUNS, pages, efficiency * 100.f);
+}
+
+void bench_image(int mode)
+{
+    switch (mode)
+    {
+    case 1:
+        bench_resample(PixelFormat::RGBA_8);
+        break;
+    case 2:
+        bench_resample(PixelFormat::RGBA_F32);
+        break;
+    case 3:
+        bench_quantize();
+        break;
+    case 4:
+        bench_morphology();
+        break;
+    case 5:
+        bench_statistics();
+        break;
+    case 6:
+        bench_frames();
+        break;
+    case 7:
+        bench_atlas();
+        break;
+    }
+}
@@ -0,0 +1,108 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  This program is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <lol/engine.h>
+
+using namespace lol;
+
+static int const MESSAGE_COUNT = 20000;
+static char const *LOG_FILE = "benchsuite-log.txt";
+
+/* Log from several threads at once and return the per-call latencies,
+ * in nanoseconds, of all threads together */
+static array<float> bench_one(int threads)
+{
+    std::vector<array<float>> results(threads);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([t, &results]()
+        {
+            array<float> &times = results[t];
+            times.reserve(MESSAGE_COUNT);
+            for (int n = 0; n < MESSAGE_COUNT; ++n)
+            {
+                auto start = std::chrono::steady_clock::now();
+                msg::info("thread %d message %d value %f\n", t, n, n * 0.5f);
+                auto end = std::chrono::steady_clock::now();
+                times << (float)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            }
+        });
+    }
+
+    for (auto &worker : workers)
+        worker.join();
+
+    array<float> ret;
+    for (auto const &times : results)
+        ret += times;
+    std::sort(ret.data(), ret.data() + ret.count());
+    return ret;
+}
+
+void bench_log(int mode)
+{
+    UNUSED(mode);
+
+    msg::info("               median     p99     max    total (ns/call)\n");
+
+    /* Messages go to a rotated file instead of the console */
+    msg::flush();
+    msg::set_console(false);
+    msg::set_log_file(LOG_FILE, 1 << 20, 2);
+
+    float result[2][3][4];
+    for (int async = 0; async < 2; ++async)
+    {
+        msg::set_async(async != 0);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            lol::timer timer;
+            array<float> times = bench_one(1 << i);
+            msg::flush();
+            float total = timer.get();
+
+            result[async][i][0] = times[times.count() / 2];
+            result[async][i][1] = times[times.count() * 99 / 100];
+            result[async][i][2] = times.last();
+            result[async][i][3] = 1e9f * total / times.count();
+        }
+    }
+
+    msg::set_log_file("");
+    msg::set_console(true);
+    msg::set_async(true);
+
+    remove(LOG_FILE);
+    remove((std::string(LOG_FILE) + ".1").c_str());
+    remove((std::string(LOG_FILE) + ".2").c_str());
+
+    for (int async = 0; async < 2; ++async)
+        for (int i = 0; i < 3; ++i)
+            msg::info("%-5s %d thread%s %7.0f %7.0f %7.0f %8.0f\n",
+                      async ? "async" : "sync", 1 << i, i ? "s" : " ",
+                      result[async][i][0], result[async][i][1],
+                      result[async][i][2], result[async][i][3]);
+}
+
@@ -0,0 +1,107 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  This program is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <string>
+
+#include <lol/engine.h>
+
+using namespace lol;
+
+static size_t const KEY_COUNT = 1000;
+static size_t const LOOKUP_COUNT = 1000000;
+
+/* Prevent the compiler from optimising the lookups away */
+static size_t sink = 0;
+
+/* Time insertions, lookups and a full iteration, in ns per element */
+template<typename M, typename K, typename Q>
+static void bench_one(char const *name, array<K> const &keys,
+                      array<Q> const &queries)
+{
+    float result[3] = { 0.0f };
+    lol::timer timer;
+
+    for (int run = 0; run < 10; ++run)
+    {
+        M m;
+
+        timer.get();
+        for (auto const &key : keys)
+            m[key] = 1;
+        result[0] += 1e9f * timer.get() / keys.count();
+
+        timer.get();
+        for (size_t n = 0; n < LOOKUP_COUNT; ++n)
+            sink += m.find(queries[n % queries.count()])->second;
+        result[1] += 1e9f * timer.get() / LOOKUP_COUNT;
+
+        timer.get();
+        for (int i = 0; i < 100; ++i)
+            for (auto const &kv : m)
+                sink += kv.second;
+        result[2] += 1e9f * timer.get() / (100 * keys.count());
+    }
+
+    msg::info("%-20s %7.2f %7.2f %7.2f\n", name,
+              result[0] / 10, result[1] / 10, result[2] / 10);
+}
+
+void bench_map(int mode)
+{
+    /* Random 64-bit keys, or random strings queried with C strings */
+    if (mode == 1)
+    {
+        array<uint64_t> keys, queries;
+        for (size_t n = 0; n < KEY_COUNT; ++n)
+            keys << ((uint64_t)rand<uint32_t>() << 32 | rand<uint32_t>());
+        for (size_t n = 0; n < KEY_COUNT * 4; ++n)
+            queries << keys[rand((int)keys.count())];
+
+        msg::info("                      insert    find iterate (ns/elem)\n");
+        bench_one<std::map<uint64_t, size_t>>("std::map", keys, queries);
+        bench_one<std::unordered_map<uint64_t, size_t>>("std::unordered_map", keys, queries);
+        bench_one<hash_map<uint64_t, size_t>>("lol::hash_map", keys, queries);
+        bench_one<flat_map<uint64_t, size_t>>("lol::flat_map", keys, queries);
+    }
+    else
+    {
+        array<std::string> keys;
+        array<char const *> queries;
+        for (size_t n = 0; n < KEY_COUNT; ++n)
+        {
+            std::string s = "data/textures/";
+            for (int i = rand(4, 16); i--; )
+                s += (char)rand<int>('a', 'z' + 1);
+            keys << s + ".png";
+        }
+        for (size_t n = 0; n < KEY_COUNT * 4; ++n)
+            queries << keys[rand((int)keys.count())].c_str();
+
+        /* The std:: maps build a temporary std::string for each query */
+        msg::info("                      insert    find iterate (ns/elem)\n");
+        bench_one<std::map<std::string, size_t>>("std::map", keys, queries);
+        bench_one<std::unordered_map<std::string, size_t>>("std::unordered_map", keys, queries);
+        bench_one<hash_map<std::string, size_t>>("lol::hash_map", keys, queries);
+        bench_one<flat_map<std::string, size_t>>("lol::flat_map", keys, queries);
+    }
+
+    if (sink == 42)
+        msg::info(" \n");
+}
+
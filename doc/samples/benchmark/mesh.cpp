@@ -0,0 +1,59 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  This program is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <cstdio>
+
+#include <lol/engine.h>
+
+using namespace lol;
+
+static int const MESH_PASSES = 6;
+static int const MESH_RUNS = 5;
+
+void bench_mesh(int mode)
+{
+    UNUSED(mode);
+
+    float result[MESH_PASSES] = { 0.0f };
+    int triangles[MESH_PASSES] = { 0 }, vertices[MESH_PASSES] = { 0 };
+
+    for (int run = 0; run < MESH_RUNS; run++)
+    {
+        /* A box with a centre vertex on each face is 24 welded triangles,
+         * so six passes end with 98304 triangles. */
+        EasyMesh em;
+        em.ToggleQuadWeighting();
+        em.AppendBox(vec3(1.f));
+        em.VerticesMerge();
+
+        lol::timer timer;
+        for (int pass = 0; pass < MESH_PASSES; pass++)
+        {
+            timer.get();
+            em.SmoothMesh(1, 1, 1);
+            result[pass] += timer.get();
+            triangles[pass] = em.m_indices.count() / 3;
+            vertices[pass] = em.m_vert.count();
+        }
+    }
+
+    msg::info("                          triangles  vertices  (ms/pass)\n");
+    for (int pass = 0; pass < MESH_PASSES; pass++)
+        msg::info("Loop subdivision pass %d  %9d  %8d  %9.3f\n", pass + 1,
+                  triangles[pass], vertices[pass],
+                  1e3f * result[pass] / MESH_RUNS);
+}
+
@@ -0,0 +1,93 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  This program is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <lol/engine.h>
+
+using namespace lol;
+
+static int const MESSAGE_COUNT = 200000;
+
+void bench_messages(int mode)
+{
+    UNUSED(mode);
+
+    MessageService::Setup();
+
+    msg::info("                   send   fetch  (ns/message)\n");
+
+    /* Queue everything, then fetch it: measures each side separately */
+    {
+        lol::timer timer;
+        for (int n = 0; n < MESSAGE_COUNT; ++n)
+            MessageService::Send(MessageBucket::Bckt0, "position 12.5 7.25");
+        float send = 1e9f * timer.get() / MESSAGE_COUNT;
+
+        std::string message;
+        while (MessageService::FetchFirst(MessageBucket::Bckt0, message))
+            ;
+        float fetch = 1e9f * timer.get() / MESSAGE_COUNT;
+
+        msg::info("%-16s %7.2f %7.2f\n", "FetchFirst", send, fetch);
+    }
+
+    /* Same with batches */
+    {
+        lol::timer timer;
+        for (int n = 0; n < MESSAGE_COUNT; ++n)
+            MessageService::Send(MessageBucket::Bckt0, "position 12.5 7.25");
+        float send = 1e9f * timer.get() / MESSAGE_COUNT;
+
+        std::string messages[64];
+        while (MessageService::FetchBatch(MessageBucket::Bckt0, messages, 64))
+            ;
+        float fetch = 1e9f * timer.get() / MESSAGE_COUNT;
+
+        msg::info("%-16s %7.2f %7.2f\n", "FetchBatch", send, fetch);
+    }
+
+    /* Several producers and one consumer running concurrently */
+    msg::info("                   total  (ns/message)\n");
+    for (int threads = 1; threads <= 4; threads *= 2)
+    {
+        lol::timer timer;
+
+        std::vector<std::thread> producers;
+        for (int t = 0; t < threads; ++t)
+            producers.emplace_back([threads]()
+            {
+                for (int n = 0; n < MESSAGE_COUNT / threads; ++n)
+                    MessageService::Send(MessageBucket::Bckt1, "position 12.5 7.25");
+            });
+
+        std::string messages[64];
+        int total = 0, expected = MESSAGE_COUNT / threads * threads;
+        while (total < expected)
+            total += MessageService::FetchBatch(MessageBucket::Bckt1, messages, 64);
+
+        for (auto &producer : producers)
+            producer.join();
+
+        float result = 1e9f * timer.get() / total;
+        msg::info("%d producer%s      %7.2f\n", threads, threads > 1 ? "s" : " ", result);
+    }
+
+    MessageService::Destroy();
+}
+
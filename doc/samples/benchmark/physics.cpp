@@ -0,0 +1,136 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  This program is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <cstdio>
+
+#include <lol/engine.h>
+
+#if LOL_USE_BULLET
+
+#include "physics/lolphysics.h"
+#include "physics/easyphysics.h"
+
+using namespace lol;
+using namespace lol::phys;
+
+static int const PHYSICS_BODIES = 1000;
+static int const PHYSICS_STEPS = 300;
+static int const PHYSICS_RAYS = 10000;
+
+/* A static floor with a stack of boxes falling on it */
+static void build_scene(Simulation *sim, array<EasyPhysic *> &bodies)
+{
+    vec3 floor_size(200.f, 1.f, 200.f);
+    EasyPhysic *floor = new EasyPhysic(nullptr);
+    floor->SetShapeToBox(floor_size);
+    floor->SetMass(.0f);
+    floor->SetTransform(vec3(0.f, -1.f, 0.f));
+    floor->InitBodyToRigid();
+    floor->AddToSimulation(sim);
+    bodies << floor;
+
+    vec3 box_size(1.f);
+    for (int i = 0; i < PHYSICS_BODIES; ++i)
+    {
+        EasyPhysic *box = new EasyPhysic(nullptr);
+        box->SetShapeToBox(box_size);
+        box->SetMass(1.f);
+        box->SetTransform(vec3((float)(i % 10) * 1.5f - 7.f,
+                               (float)(i / 100) * 1.5f + 1.f,
+                               (float)(i / 10 % 10) * 1.5f - 7.f));
+        box->InitBodyToRigid();
+        box->AddToSimulation(sim);
+        bodies << box;
+    }
+}
+
+void bench_physics(int mode)
+{
+    UNUSED(mode);
+
+    /* Entities belong to the ticker, so this one is never deleted */
+    Simulation *sim = new Simulation();
+    sim->SetWorldLimit(vec3(-1000.f), vec3(1000.f));
+
+    array<RayCastQuery> queries;
+    for (int i = 0; i < PHYSICS_RAYS; ++i)
+    {
+        vec3 from(rand(-20.f, 20.f), 30.f, rand(-20.f, 20.f));
+        queries << RayCastQuery(from, from + vec3(rand(-10.f, 10.f), -60.f, rand(-10.f, 10.f)));
+    }
+
+    msg::info("           step (ms)   rays (µs/ray)   batched (µs/ray)\n");
+
+    int const max_threads = lol::max(1, (int)std::thread::hardware_concurrency());
+    for (int threads = 1; ; threads = lol::min(threads * 2, max_threads))
+    {
+        sim->Init(threads);
+        vec3 gravity(0.f, -9.81f, 0.f);
+        sim->SetGravity(gravity);
+        sim->SetTimestep(1.f / 60.f);
+
+        array<EasyPhysic *> bodies;
+        build_scene(sim, bodies);
+
+        lol::timer timer;
+        float result[3];
+
+        timer.get();
+        for (int i = 0; i < PHYSICS_STEPS; ++i)
+            sim->Step(1.f / 60.f);
+        result[0] = timer.get() / PHYSICS_STEPS;
+
+        RayCastResult hit_result;
+        int hits = 0;
+        timer.get();
+        for (int i = 0; i < PHYSICS_RAYS; ++i)
+        {
+            hit_result.Reset();
+            hits += sim->RayHits(hit_result, ERT_Closest, queries[i].m_ray_from, queries[i].m_ray_to);
+        }
+        result[1] = timer.get() / PHYSICS_RAYS;
+
+        array<RayCastHit> batch_hits;
+        timer.get();
+        sim->RayHits(batch_hits, ERT_Closest, queries);
+        result[2] = timer.get() / PHYSICS_RAYS;
+
+        for (auto const &hit : batch_hits)
+            hits -= hit.m_collider != nullptr;
+        ASSERT(hits == 0, "batched and single raycasts disagree");
+
+        msg::info("%2d thread%s  %9.3f   %13.3f   %16.3f\n", threads,
+                  threads > 1 ? "s" : " ", 1e3f * result[0],
+                  1e6f * result[1], 1e6f * result[2]);
+
+        for (auto body : bodies)
+        {
+            body->RemoveFromSimulation(sim);
+            delete body;
+        }
+        sim->Exit();
+
+#if BT_THREADSAFE
+        if (threads == max_threads)
+            break;
+#else
+        break;
+#endif
+    }
+}
+
+#endif
+
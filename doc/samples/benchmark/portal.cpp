@@ -0,0 +1,149 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  This program is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <cstdio>
+
+#include <lol/engine.h>
+
+using namespace lol;
+
+static int const MAZE_SIZE = 64;
+static int const CAMERA_COUNT = 64;
+
+/* Prevent the compiler from optimising the queries away */
+static int sink = 0;
+
+/* The recursive search that PortalSet::GetVisibleRooms() used to do */
+static void legacy_visible_rooms(PortalDoor<void> *see_through,
+                                 PortalRoom<void> *start_room,
+                                 array<PortalRoom<void> *> &visible_rooms,
+                                 array<PortalDoor<void> *> &ignore_doors)
+{
+    for (int i = 0; i < start_room->GetDoorCount(); ++i)
+    {
+        PortalDoor<void> *door = start_room->GetDoor(i);
+        if (door == see_through || ignore_doors.find(door) != INDEX_NONE)
+            continue;
+
+        if (see_through->TestCollide(*door))
+        {
+            PortalRoom<void> *other_room = door->GetRoom(start_room);
+            if (!other_room || visible_rooms.find(other_room) != INDEX_NONE)
+                continue;
+
+            ignore_doors.push_unique(door);
+            visible_rooms.push_unique(other_room);
+            door->BuildViewProj(see_through->GetView(), see_through->GetProj());
+            legacy_visible_rooms(door, other_room, visible_rooms, ignore_doors);
+        }
+    }
+}
+
+void bench_portal(int mode)
+{
+    UNUSED(mode);
+
+    float result[5] = { 0.0f };
+    lol::timer timer;
+
+    /* A maze of square rooms with doors on two walls out of three */
+    PortalSet<void> set;
+    for (int n = 0; n < MAZE_SIZE * MAZE_SIZE; ++n)
+        set << new PortalRoom<void>();
+
+    for (int j = 0; j < MAZE_SIZE; ++j)
+        for (int i = 0; i < MAZE_SIZE; ++i)
+        {
+            PortalRoom<void> *room = set.GetRoom(j * MAZE_SIZE + i);
+            if (i + 1 < MAZE_SIZE && rand(3) != 0)
+                (new PortalDoor<void>(vec3(4.f * i + 4.f, 0.f, -4.f * j - 2.f),
+                                      vec3::axis_x, vec3::axis_y, vec2(2.f)))
+                    ->ConnectRooms(set.GetRoom(j * MAZE_SIZE + i + 1), room);
+            if (j + 1 < MAZE_SIZE && rand(3) != 0)
+                (new PortalDoor<void>(vec3(4.f * i + 2.f, 0.f, -4.f * j - 4.f),
+                                      -vec3::axis_z, vec3::axis_y, vec2(2.f)))
+                    ->ConnectRooms(set.GetRoom((j + 1) * MAZE_SIZE + i), room);
+        }
+
+    /* Random cameras looking horizontally */
+    mat4 proj = mat4::perspective(radians(70.f), 4.f, 3.f, 0.1f, 1000.f);
+    array<mat4> views, view_projs;
+    array<PortalRoom<void> *> start_rooms;
+    for (int n = 0; n < CAMERA_COUNT; ++n)
+    {
+        ivec2 pos(rand(MAZE_SIZE), rand(MAZE_SIZE));
+        vec3 eye(4.f * pos.x + 2.f, 1.5f, -4.f * pos.y - 2.f);
+        float angle = rand(2.f * F_PI);
+        views.push(mat4::lookat(eye, eye + vec3(cos(angle), 0.f, -sin(angle)),
+                                vec3::axis_y));
+        view_projs.push(proj * views.last());
+        start_rooms.push(set.GetRoom(pos.y * MAZE_SIZE + pos.x));
+    }
+
+    /* Legacy recursion */
+    timer.get();
+    for (int n = 0; n < CAMERA_COUNT; ++n)
+    {
+        PortalDoor<void> camera(views[n], proj);
+        array<PortalRoom<void> *> visible_rooms;
+        array<PortalDoor<void> *> ignore_doors;
+        legacy_visible_rooms(&camera, start_rooms[n], visible_rooms, ignore_doors);
+        sink += visible_rooms.count();
+    }
+    result[0] = 1e6f * timer.get() / CAMERA_COUNT;
+
+    /* Screen rectangle traversal, one camera at a time */
+    PortalBitset visible;
+    timer.get();
+    for (int n = 0; n < CAMERA_COUNT; ++n)
+    {
+        set.GetVisibleRooms(view_projs[n], start_rooms[n], visible);
+        sink += visible.count();
+    }
+    result[1] = 1e6f * timer.get() / CAMERA_COUNT;
+
+    /* Offline PVS computation */
+    timer.get();
+    set.ComputePVS();
+    result[2] = 1e3f * timer.get();
+
+    timer.get();
+    for (int n = 0; n < CAMERA_COUNT; ++n)
+    {
+        set.GetVisibleRooms(view_projs[n], start_rooms[n], visible);
+        sink += visible.count();
+    }
+    result[3] = 1e6f * timer.get() / CAMERA_COUNT;
+
+    /* All cameras in one batch */
+    array<PortalBitset> batch;
+    timer.get();
+    set.GetVisibleRooms(view_projs, start_rooms, batch);
+    result[4] = 1e6f * timer.get() / CAMERA_COUNT;
+    for (auto const &bits : batch)
+        sink += bits.count();
+
+    msg::info("                          time\n");
+    msg::info("legacy recursion       %7.2f µs/query\n", result[0]);
+    msg::info("rectangle traversal    %7.2f µs/query\n", result[1]);
+    msg::info("PVS computation        %7.2f ms\n", result[2]);
+    msg::info("traversal with PVS     %7.2f µs/query\n", result[3]);
+    msg::info("batch with PVS         %7.2f µs/query\n", result[4]);
+
+    if (sink == 42)
+        msg::info(" \n");
+}
+
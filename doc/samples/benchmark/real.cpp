@@ -1,7 +1,7 @@
 //
 //  Lol Engine — Benchmark program
 //
-//  Copyright © 2005—2018 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
 //
 //  This program is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -78,5 +78,48 @@ void bench_real(int mode)
     msg::info("real = real / real           %7.3f\n", result[2]);
     msg::info("real = sin(real)             %7.3f\n", result[3]);
     msg::info("real = exp(real)             %7.3f\n", result[4]);
+
+    /* Elementary functions at several precisions; the number of calls
+     * is scaled down as the precision grows. */
+    static int const bits[] = { 128, 1024, 8192 };
+    static char const *names[] = { "sin", "cos", "exp", "log", "atan", "asin" };
+    float func_result[6][3] = { { 0.0f } };
+
+    int old_bigit_count = real::DEFAULT_BIGIT_COUNT;
+    for (int b = 0; b < 3; ++b)
+    {
+        real::DEFAULT_BIGIT_COUNT = bits[b] / real::bigit_bits();
+        int calls = 4096 / real::DEFAULT_BIGIT_COUNT;
+
+        /* Compute the constants outside of the measurements */
+        (void)real::R_PI();
+        (void)real::R_E();
+        (void)real::R_SQRT2();
+
+        for (int n = 0; n < 6; ++n)
+        {
+            timer.get();
+            for (int i = 0; i < calls; ++i)
+            {
+                real x = real(0.9 * i / calls + 0.05);
+                switch (n)
+                {
+                case 0: (void)sin(x); break;
+                case 1: (void)cos(x); break;
+                case 2: (void)exp(x); break;
+                case 3: (void)log(x); break;
+                case 4: (void)atan(x); break;
+                case 5: (void)asin(x); break;
+                }
+            }
+            func_result[n][b] = 1e6f * timer.get() / calls;
+        }
+    }
+    real::DEFAULT_BIGIT_COUNT = old_bigit_count;
+
+    msg::info("                     128 bits  1024 bits  8192 bits  (µs/elem)\n");
+    for (int n = 0; n < 6; ++n)
+        msg::info("real = %-4s(real)   %9.2f  %9.2f  %9.2f\n", names[n],
+                  func_result[n][0], func_result[n][1], func_result[n][2]);
 }
 
@@ -0,0 +1,116 @@
+//
+//  Lol Engine — Benchmark program
+//
+//  Copyright © 2005—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  This program is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <cstdio>
+#include <map>
+
+#include <lol/engine.h>
+
+using namespace lol;
+
+static int const KEY_COUNT = 1000000;
+
+/* Prevent the compiler from optimising the lookups away */
+static int sink = 0;
+
+/* Adapter so that std::map can be timed with the same code */
+struct std_tree : std::map<int, int>
+{
+    void insert(int key, int val) { (*this)[key] = val; }
+    bool try_get(int key, int *&val)
+    {
+        auto it = find(key);
+        return it != end() ? (val = &it->second, true) : false;
+    }
+};
+
+template<typename T> static int value_of(T const &kv) { return kv.value; }
+static int value_of(std::pair<int const, int> const &kv) { return kv.second; }
+
+/* Time insertions, lookups and a full iteration, in ns per element */
+template<typename T>
+static void bench_one(char const *name, array<int> const &keys)
+{
+    float result[3] = { 0.0f };
+    lol::timer timer;
+
+    T tree;
+
+    timer.get();
+    for (int key : keys)
+        tree.insert(key, key);
+    result[0] = 1e9f * timer.get() / keys.count();
+
+    timer.get();
+    for (int key : keys)
+    {
+        int *val;
+        if (tree.try_get(key, val))
+            sink += *val;
+    }
+    result[1] = 1e9f * timer.get() / keys.count();
+
+    timer.get();
+    for (auto kv : tree)
+        sink += value_of(kv);
+    result[2] = 1e9f * timer.get() / keys.count();
+
+    msg::info("%-22s %7.2f %7.2f %7.2f\n", name, result[0], result[1], result[2]);
+}
+
+void bench_tree(int mode)
+{
+    UNUSED(mode);
+
+    array<int> keys;
+    for (int n = 0; n < KEY_COUNT; ++n)
+        keys << rand<int>();
+
+    msg::info("                        insert  lookup iterate (ns/elem)\n");
+    bench_one<std_tree>("std::map", keys);
+    bench_one<avl_tree<int, int, node_heap>>("avl_tree (node_heap)", keys);
+    bench_one<avl_tree<int, int>>("avl_tree (node_pool)", keys);
+    bench_one<btree<int, int>>("btree", keys);
+
+    /* Bulk loading from sorted input */
+    array<int> sorted_keys, values;
+    std_tree ref;
+    for (int key : keys)
+        ref.insert(key, key);
+    for (auto const &kv : ref)
+    {
+        sorted_keys << kv.first;
+        values << kv.second;
+    }
+
+    lol::timer timer;
+    btree<int, int> tree;
+    timer.get();
+    tree.bulk_load(sorted_keys.data(), values.data(), sorted_keys.count());
+    float t = 1e9f * timer.get() / sorted_keys.count();
+    msg::info("%-22s %7.2f\n", "btree bulk_load", t);
+
+    /* Range scan over about 1% of the keys */
+    timer.get();
+    for (auto kv : tree.range(0, INT32_MAX / 50))
+        sink += kv.value;
+    t = 1e9f * timer.get() / (sorted_keys.count() / 100);
+    msg::info("%-22s %7.2f\n", "btree range scan", t);
+
+    if (sink == 42)
+        msg::info(" \n");
+}
+
@@ -25,11 +25,13 @@ static size_t const MATRIX_RUNS = 100;
 
 void bench_matrix(int mode)
 {
-    float result[5] = { 0.0f };
+    float result[11] = { 0.0f };
     lol::timer timer;
 
     /* Set up tables */
     mat4 *pm = new mat4[MATRIX_TABLE_SIZE + 1];
+    vec4 *pv = new vec4[MATRIX_TABLE_SIZE + 1];
+    vec3 *pv3 = new vec3[MATRIX_TABLE_SIZE + 1];
     float *pf = new float[MATRIX_TABLE_SIZE];
 
     for (size_t run = 0; run < MATRIX_RUNS; run++)
@@ -41,6 +43,12 @@ void bench_matrix(int mode)
                 for (int j = 0; j < 4; j++)
                     for (int k = 0; k < 4; k++)
                         pm[i][j][k] = rand(-2.0f, 2.0f);
+            for (size_t i = 0; i < MATRIX_TABLE_SIZE + 1; i++)
+            {
+                pv[i] = vec4(rand(-2.0f, 2.0f), rand(-2.0f, 2.0f),
+                             rand(-2.0f, 2.0f), rand(-2.0f, 2.0f));
+                pv3[i] = pv[i].xyz;
+            }
             break;
         }
 
@@ -73,9 +81,41 @@ void bench_matrix(int mode)
         for (size_t i = 0; i < MATRIX_TABLE_SIZE; i++)
             pm[i] = inverse(pm[i]);
         result[4] += timer.get();
+
+        /* Transform vectors, one at a time then in a batch */
+        timer.get();
+        for (size_t i = 0; i < MATRIX_TABLE_SIZE; i++)
+            pv[i] = pm[0] * pv[i];
+        result[5] += timer.get();
+
+        timer.get();
+        transform(pv, pv, MATRIX_TABLE_SIZE, pm[0]);
+        result[6] += timer.get();
+
+        /* Normalise vectors */
+        timer.get();
+        for (size_t i = 0; i < MATRIX_TABLE_SIZE; i++)
+            pv3[i] = normalize(pv3[i]);
+        result[7] += timer.get();
+
+        timer.get();
+        normalize_all(pv3, pv3, MATRIX_TABLE_SIZE);
+        result[8] += timer.get();
+
+        /* Dot products */
+        timer.get();
+        for (size_t i = 0; i < MATRIX_TABLE_SIZE; i++)
+            pf[i] = dot(pv[i], pv[i + 1]);
+        result[9] += timer.get();
+
+        timer.get();
+        dot_all(pf, pv, pv + 1, MATRIX_TABLE_SIZE);
+        result[10] += timer.get();
     }
 
     delete[] pm;
+    delete[] pv;
+    delete[] pv3;
     delete[] pf;
 
     for (size_t i = 0; i < sizeof(result) / sizeof(*result); i++)
@@ -87,5 +127,11 @@ void bench_matrix(int mode)
     msg::info("mat4 *= mat4             %7.3f\n", result[2]);
     msg::info("mat4 += mat4             %7.3f\n", result[3]);
     msg::info("mat4 = mat4.invert()     %7.3f\n", result[4]);
+    msg::info("vec4 = mat4 * vec4       %7.3f\n", result[5]);
+    msg::info("transform(vec4[], mat4)  %7.3f\n", result[6]);
+    msg::info("vec3 = normalize(vec3)   %7.3f\n", result[7]);
+    msg::info("normalize_all(vec3[])    %7.3f\n", result[8]);
+    msg::info("float = dot(vec4, vec4)  %7.3f\n", result[9]);
+    msg::info("dot_all(vec4[], vec4[])  %7.3f\n", result[10]);
 }
 
@@ -23,6 +23,17 @@ using namespace lol;
 void bench_real(int mode);
 void bench_matrix(int mode);
 void bench_half(int mode);
+void bench_image(int mode);
+void bench_bigint(int mode);
+void bench_portal(int mode);
+void bench_map(int mode);
+void bench_tree(int mode);
+void bench_log(int mode);
+void bench_messages(int mode);
+void bench_mesh(int mode);
+#if LOL_USE_BULLET
+void bench_physics(int mode);
+#endif
 
 int main(int argc, char **argv)
 {
@@ -48,6 +59,88 @@ int main(int argc, char **argv)
     msg::info("-----------------------------------\n");
     bench_half(2);
 
+    msg::info("-------------------------\n");
+    msg::info(" Image resampling (8-bit)\n");
+    msg::info("-------------------------\n");
+    bench_image(1);
+
+    msg::info("----------------------------------\n");
+    msg::info(" Image resampling (floating point)\n");
+    msg::info("----------------------------------\n");
+    bench_image(2);
+
+    msg::info("------------------------------------\n");
+    msg::info(" Palette quantisation (1 megapixel)\n");
+    msg::info("------------------------------------\n");
+    bench_image(3);
+
+    msg::info("----------------------------------\n");
+    msg::info(" Grey image dilation (1 megapixel)\n");
+    msg::info("----------------------------------\n");
+    bench_image(4);
+
+    msg::info("------------------------------------\n");
+    msg::info(" Image statistics (8K, 33 megapixel)\n");
+    msg::info("------------------------------------\n");
+    bench_image(5);
+
+    msg::info("----------------------------------\n");
+    msg::info(" Frame conversion (1080p, flipped)\n");
+    msg::info("----------------------------------\n");
+    bench_image(6);
+
+    msg::info("-----------------------------\n");
+    msg::info(" Texture atlas (2000 sprites)\n");
+    msg::info("-----------------------------\n");
+    bench_image(7);
+
+    msg::info("----------------------\n");
+    msg::info(" Big integers (960-bit)\n");
+    msg::info("----------------------\n");
+    bench_bigint(1);
+
+    msg::info("------------------------------------\n");
+    msg::info(" Portal visibility (64×64 room maze)\n");
+    msg::info("------------------------------------\n");
+    bench_portal(1);
+
+    msg::info("-------------------------------\n");
+    msg::info(" Maps (1000 random 64-bit keys)\n");
+    msg::info("-------------------------------\n");
+    bench_map(1);
+
+    msg::info("----------------------------------\n");
+    msg::info(" Maps (1000 file names, C strings)\n");
+    msg::info("----------------------------------\n");
+    bench_map(2);
+
+    msg::info("-----------------------------------\n");
+    msg::info(" Ordered maps (1000000 random keys)\n");
+    msg::info("-----------------------------------\n");
+    bench_tree(1);
+
+    msg::info("------------------------------------\n");
+    msg::info(" Logging (20000 messages per thread)\n");
+    msg::info("------------------------------------\n");
+    bench_log(1);
+
+    msg::info("----------------------------------\n");
+    msg::info(" Message service (200000 messages)\n");
+    msg::info("----------------------------------\n");
+    bench_messages(1);
+
+    msg::info("---------------------------------------\n");
+    msg::info(" Mesh subdivision (98304 triangles max)\n");
+    msg::info("---------------------------------------\n");
+    bench_mesh(1);
+
+#if LOL_USE_BULLET
+    msg::info("-------------------------------------------\n");
+    msg::info(" Physics (1000 boxes, 10000 rays per batch)\n");
+    msg::info("-------------------------------------------\n");
+    bench_physics(1);
+#endif
+
 #if defined _WIN32
     getchar();
 #endif
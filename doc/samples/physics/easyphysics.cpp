@@ -37,6 +37,7 @@ EasyPhysic::EasyPhysic(WorldEntity* NewOwnerEntity) :
     m_collision_shape(nullptr),
     m_convex_shape(nullptr),
     m_motion_state(nullptr),
+    m_has_previous_transform(false),
     m_mass(.0f),
     m_hit_restitution(.0f),
     m_collision_group(1),
@@ -124,6 +125,13 @@ mat4 EasyPhysic::GetTransform()
     {
         btTransform CurTransform;
         m_motion_state->getWorldTransform(CurTransform);
+        //Blend the last two fixed steps by the time left over in the simulation
+        if (m_owner_simulation && m_has_previous_transform)
+        {
+            float Alpha = m_owner_simulation->GetInterpolation();
+            CurTransform = btTransform(m_previous_transform.getRotation().slerp(CurTransform.getRotation(), Alpha),
+                                       m_previous_transform.getOrigin().lerp(CurTransform.getOrigin(), Alpha));
+        }
         CurTransform.getOpenGLMatrix(&m_local_to_world[0][0]);
     }
     else if (m_collision_object)
@@ -136,6 +144,7 @@ void EasyPhysic::SetTransform(const lol::vec3& base_location, const lol::quat& b
 {
     lol::mat4 PreviousMatrix = m_local_to_world;
     m_local_to_world = lol::mat4::translate(base_location) * lol::mat4(base_rotation);
+    m_has_previous_transform = false;
 
     if (m_ghost_object)
         m_ghost_object->setWorldTransform(btTransform(LOL2BT_QUAT(base_rotation), LOL2BT_VEC3(LOL2BT_UNIT * base_location)));
@@ -136,6 +136,8 @@ public:
 
 protected:
     lol::mat4                                       m_local_to_world;
+    btTransform                                     m_previous_transform;     //Before the last simulation step, for interpolation
+    bool                                            m_has_previous_transform;
     float                                           m_mass;
     float                                           m_hit_restitution;
     int                                             m_collision_group;
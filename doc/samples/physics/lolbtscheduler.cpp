@@ -0,0 +1,185 @@
+//
+//  Lol Engine — Bullet physics test
+//
+//  Copyright © 2012—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include "lolbtscheduler.h"
+
+namespace lol
+{
+
+namespace phys
+{
+
+#if BT_THREADSAFE
+
+BulletTaskScheduler::BulletTaskScheduler(int thread_count)
+  : btITaskScheduler("Lol"),
+    m_running(false),
+    m_next_chunk(0)
+{
+    setNumThreads(thread_count);
+}
+
+BulletTaskScheduler::~BulletTaskScheduler()
+{
+    StopWorkers();
+}
+
+int BulletTaskScheduler::getMaxNumThreads() const
+{
+    return BT_MAX_THREAD_COUNT;
+}
+
+int BulletTaskScheduler::getNumThreads() const
+{
+    return m_workers.count() + 1;
+}
+
+void BulletTaskScheduler::setNumThreads(int thread_count)
+{
+    StopWorkers();
+    if (has_threads())
+        StartWorkers(lol::clamp(thread_count, 1, BT_MAX_THREAD_COUNT) - 1);
+}
+
+//-----------------------------------------------------------------------------
+void BulletTaskScheduler::parallelFor(int begin, int end, int grain,
+                                      btIParallelForBody const &body)
+{
+    Run(begin, end, grain, [&body](int, int chunk_begin, int chunk_end)
+    {
+        body.forLoop(chunk_begin, chunk_end);
+    });
+}
+
+btScalar BulletTaskScheduler::parallelSum(int begin, int end, int grain,
+                                          btIParallelSumBody const &body)
+{
+    /* Partial sums are added in chunk order, so that the result does not
+     * depend on which thread ran which chunk. */
+    grain = lol::max(grain, 1);
+    array<btScalar> sums;
+    sums.resize((lol::max(end - begin, 0) + grain - 1) / grain);
+    Run(begin, end, grain, [&body, &sums](int chunk, int chunk_begin, int chunk_end)
+    {
+        sums[chunk] = body.sumLoop(chunk_begin, chunk_end);
+    });
+
+    btScalar ret = btScalar(0);
+    for (btScalar const &sum : sums)
+        ret += sum;
+    return ret;
+}
+
+//-----------------------------------------------------------------------------
+void BulletTaskScheduler::StartWorkers(int count)
+{
+    m_quit = false;
+    int generation = m_generation;
+    for (int n = 0; n < count; ++n)
+        m_workers << new thread([this, generation](thread *) { Work(generation); });
+}
+
+void BulletTaskScheduler::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_start_cond.notify_all();
+
+    // Deleting a thread waits for it to finish
+    for (thread *worker : m_workers)
+        delete worker;
+    m_workers.clear();
+}
+
+void BulletTaskScheduler::Run(int begin, int end, int grain, chunk_fn const &fn)
+{
+    grain = lol::max(grain, 1);
+    int chunk_count = (lol::max(end - begin, 0) + grain - 1) / grain;
+
+    /* Small loops, and loops started from inside a loop, are run right
+     * away on the calling thread. */
+    bool expected = false;
+    if (chunk_count <= 1 || !m_workers.count()
+         || !m_running.compare_exchange_strong(expected, true))
+    {
+        for (int chunk = 0; chunk < chunk_count; ++chunk)
+            fn(chunk, begin + chunk * grain, lol::min(begin + (chunk + 1) * grain, end));
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fn = &fn;
+        m_begin = begin;
+        m_end = end;
+        m_grain = grain;
+        m_chunk_count = chunk_count;
+        m_next_chunk = 0;
+        m_busy = m_workers.count();
+        ++m_generation;
+    }
+    m_start_cond.notify_all();
+
+    RunChunks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cond.wait(lock, [this]() { return m_busy == 0; });
+    m_fn = nullptr;
+    m_running = false;
+}
+
+void BulletTaskScheduler::RunChunks()
+{
+    for (;;)
+    {
+        int chunk = m_next_chunk++;
+        if (chunk >= m_chunk_count)
+            break;
+        int chunk_begin = m_begin + chunk * m_grain;
+        (*m_fn)(chunk, chunk_begin, lol::min(chunk_begin + m_grain, m_end));
+    }
+}
+
+void BulletTaskScheduler::Work(int generation)
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start_cond.wait(lock, [&]() { return m_quit || m_generation != generation; });
+            if (m_quit)
+                return;
+            generation = m_generation;
+        }
+
+        RunChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_busy == 0)
+                m_done_cond.notify_one();
+        }
+    }
+}
+
+#endif
+
+} /* namespace phys */
+
+} /* namespace lol */
+
@@ -0,0 +1,117 @@
+//
+//  Lol Engine — Bullet physics test
+//
+//  Copyright © 2012—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+#include <lol/engine.h>
+
+#if BT_THREADSAFE
+#   include <LinearMath/btThreads.h>
+#endif
+
+//
+// The BulletTaskScheduler class
+// -----------------------------
+// Runs Bullet's parallel loops on lol threads that live as long as the
+// scheduler, so that a simulation step does not pay for thread creation.
+// The calling thread takes part in every loop. Bullet only calls it when
+// it was built with BT_THREADSAFE.
+//
+// bullet_parallel_for() is like lol::parallel_for() for work that calls
+// into Bullet: it goes through the current Bullet scheduler, and it is a
+// single call when Bullet is not thread-safe.
+//
+
+namespace lol
+{
+
+namespace phys
+{
+
+#if BT_THREADSAFE
+
+class BulletTaskScheduler : public btITaskScheduler
+{
+public:
+    BulletTaskScheduler(int thread_count);
+    virtual ~BulletTaskScheduler();
+
+    virtual int getMaxNumThreads() const;
+    virtual int getNumThreads() const;
+    virtual void setNumThreads(int thread_count);
+
+    virtual void parallelFor(int begin, int end, int grain,
+                             btIParallelForBody const &body);
+    virtual btScalar parallelSum(int begin, int end, int grain,
+                                 btIParallelSumBody const &body);
+
+private:
+    typedef std::function<void(int, int, int)> chunk_fn;
+
+    void StartWorkers(int count);
+    void StopWorkers();
+    // Call fn(chunk, chunk_begin, chunk_end) on every chunk of [begin, end[
+    void Run(int begin, int end, int grain, chunk_fn const &fn);
+    void RunChunks();
+    void Work(int generation);
+
+    array<thread *> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_start_cond, m_done_cond;
+    int m_generation = 0, m_busy = 0;
+    bool m_quit = false;
+    std::atomic<bool> m_running;
+
+    // The loop being run
+    chunk_fn const *m_fn = nullptr;
+    int m_begin = 0, m_end = 0, m_grain = 1, m_chunk_count = 0;
+    std::atomic<int> m_next_chunk;
+};
+
+template<typename T>
+class BulletParallelForBody : public btIParallelForBody
+{
+public:
+    BulletParallelForBody(T const &fn) : m_fn(fn) {}
+    virtual void forLoop(int begin, int end) const { m_fn(begin, end); }
+
+private:
+    T const &m_fn;
+};
+
+template<typename T>
+void bullet_parallel_for(int count, T const &fn, int grain = 1)
+{
+    btParallelFor(0, count, grain, BulletParallelForBody<T>(fn));
+}
+
+#else
+
+template<typename T>
+void bullet_parallel_for(int count, T const &fn, int grain = 1)
+{
+    UNUSED(grain);
+    if (count > 0)
+        fn(0, count);
+}
+
+#endif
+
+} /* namespace phys */
+
+} /* namespace lol */
+
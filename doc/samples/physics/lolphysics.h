@@ -18,8 +18,14 @@
 #include <btBulletDynamicsCommon.h>
 #include <btBulletCollisionCommon.h>
 #include <BulletDynamics/Character/btKinematicCharacterController.h>
+#if BT_THREADSAFE
+#   include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#   include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#   include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#endif
 
 #include "lolbtphysicsintegration.h"
+#include "lolbtscheduler.h"
 #include "easyphysics.h"
 #include "easyconstraint.h"
 
@@ -65,6 +71,30 @@ struct RayCastResult
     unsigned int             m_flags; //???
 };
 
+//One ray of a batch. Hits on SourceCaster are ignored.
+struct RayCastQuery
+{
+    RayCastQuery(const vec3& RayFrom=vec3(.0f), const vec3& RayTo=vec3(.0f), EasyPhysic* SourceCaster=nullptr)
+      : m_ray_from(RayFrom),
+        m_ray_to(RayTo),
+        m_source_caster(SourceCaster)
+    {
+    }
+
+    vec3                    m_ray_from;
+    vec3                    m_ray_to;
+    EasyPhysic*             m_source_caster;
+};
+
+//The result of one ray of a batch; m_collider is nullptr when nothing was hit
+struct RayCastHit
+{
+    EasyPhysic*             m_collider;
+    vec3                    m_hit_normal;
+    vec3                    m_hit_point;
+    float                   m_hit_fraction;
+};
+
 class Simulation : public entity
 {
 public:
@@ -74,7 +104,10 @@ public:
         m_dispatcher(0),
         m_solver(0),
         m_dynamics_world(0),
-        m_timestep(1.f/60.f)
+        m_timestep(1.f/60.f),
+        m_max_substeps(4),
+        m_accumulator(.0f),
+        m_interpolation(.0f)
     {
         m_gamegroup = GAMEGROUP_SIMULATION;
     }
@@ -86,7 +119,9 @@ public:
     std::string GetName() const { return "<Simulation>"; }
 
 public:
-    void Init()
+    //With thread_count > 1 and a thread-safe Bullet, the world is stepped by
+    //Bullet's multi-threaded world and solvers, using a BulletTaskScheduler.
+    void Init(int thread_count = 1)
     {
         // Build the broadphase
         if (1)
@@ -100,6 +135,24 @@ public:
 
         // Set up the collision configuration and dispatcher
         m_collision_configuration = new btDefaultCollisionConfiguration();
+
+#if BT_THREADSAFE
+        if (thread_count > 1)
+        {
+            // Bullet only uses one scheduler at a time
+            m_task_scheduler = new BulletTaskScheduler(thread_count);
+            btSetTaskScheduler(m_task_scheduler);
+
+            m_dispatcher = new btCollisionDispatcherMt(m_collision_configuration);
+            m_solver_pool = new btConstraintSolverPoolMt(m_task_scheduler->getNumThreads());
+            m_solver = new btSequentialImpulseConstraintSolverMt;
+            m_dynamics_world = new btDiscreteDynamicsWorldMt(m_dispatcher, m_broadphase, m_solver_pool, m_solver, m_collision_configuration);
+            return;
+        }
+#else
+        UNUSED(thread_count);
+#endif
+
         m_dispatcher = new btCollisionDispatcher(m_collision_configuration);
 
         // The actual physics solver
@@ -115,13 +168,36 @@ public:
 
         //step the simulation
         if (m_dynamics_world)
+            Step(seconds);
+    }
+
+    //Steps the world by whole timesteps. The time left is carried over to
+    //the next call and used to interpolate the dynamic bodies between their
+    //last two states; if more than m_max_substeps are due, the rest is lost.
+    void Step(float seconds)
+    {
+        m_accumulator += seconds;
+        int steps = (int)(m_accumulator / m_timestep);
+        if (steps > m_max_substeps)
         {
-            //the "+1" is to have at least one Timestep and to ensure float to int .5f conversion.
-            int steps = (int)(seconds / m_timestep) + 1;
-            m_dynamics_world->stepSimulation(seconds, steps, m_timestep);
+            m_accumulator -= (steps - m_max_substeps) * m_timestep;
+            steps = m_max_substeps;
         }
+
+        for (int i = 0; i < steps; i++)
+        {
+            if (i == steps - 1)
+                SavePreviousTransforms();
+            m_dynamics_world->stepSimulation(m_timestep, 0);
+            m_accumulator -= m_timestep;
+        }
+
+        m_interpolation = lol::clamp(m_accumulator / m_timestep, .0f, 1.f);
     }
 
+    //How far, in timesteps, the current time is past the last step
+    float GetInterpolation() const { return m_interpolation; }
+
     //Rip-Off of the btKinematicClosestNotMeRayResultCallback
     class ClosestNotMeRayResultCallback : public btCollisionWorld::ClosestRayResultCallback
     {
@@ -144,96 +220,123 @@ public:
     };
 
     //Will stop at the first hit. Hit data are supposed to be irrelevant
-    class AnyHitRayResultCallback : public btCollisionWorld::ClosestRayResultCallback
+    class AnyHitRayResultCallback : public ClosestNotMeRayResultCallback
     {
     public:
-        AnyHitRayResultCallback(const btVector3& rayFromWorld, const btVector3& rayToWorld) :
-          btCollisionWorld::ClosestRayResultCallback(rayFromWorld, rayToWorld)
+        AnyHitRayResultCallback(btCollisionObject* Me, const btVector3& rayFromWorld, const btVector3& rayToWorld) :
+          ClosestNotMeRayResultCallback(Me, rayFromWorld, rayToWorld)
         {
         }
 
         virtual btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult,bool normalInWorldSpace)
         {
-            UNUSED(rayResult);
             UNUSED(normalInWorldSpace);
+            if (rayResult.m_collisionObject == m_me)
+                return 1.0;
+
+            //A zero fraction makes rayTest() stop looking
+            m_collisionObject = rayResult.m_collisionObject;
+            m_closestHitFraction = .0f;
             return .0f;
         }
     };
 
     //Returns true when hitting something. If SourceCaster is set, it will be ignored by Raycast.
+    //The result callbacks live on the stack, so this does not allocate unless HitResult grows.
     bool RayHits(RayCastResult& HitResult, eRaycastType RaycastType, const vec3& RayFrom, const vec3& RayTo, EasyPhysic* SourceCaster = nullptr)
     {
-        bool bResult = false;
-
-        btCollisionWorld::RayResultCallback* BtRayResult = nullptr;
-        btCollisionWorld::ClosestRayResultCallback* BtRayResult_Closest;
-        btCollisionWorld::AllHitsRayResultCallback* BtRayResult_AllHits;
+        btVector3 BtRayFrom = LOL2BTU_VEC3(RayFrom);
+        btVector3 BtRayTo = LOL2BTU_VEC3(RayTo);
+        btCollisionObject* Me = SourceCaster ? SourceCaster->m_collision_object : nullptr;
 
         switch (RaycastType)
         {
             case ERT_Closest:
             {
-                if (SourceCaster)
-                    BtRayResult_Closest = new ClosestNotMeRayResultCallback(SourceCaster->m_collision_object, LOL2BTU_VEC3(RayFrom), LOL2BTU_VEC3(RayTo));
-                else
-                    BtRayResult_Closest = new btCollisionWorld::ClosestRayResultCallback(LOL2BTU_VEC3(RayFrom), LOL2BTU_VEC3(RayTo));
-                BtRayResult = BtRayResult_Closest;
-                break;
+                ClosestNotMeRayResultCallback BtRayResult(Me, BtRayFrom, BtRayTo);
+                m_dynamics_world->rayTest(BtRayFrom, BtRayTo, BtRayResult);
+                if (!BtRayResult.hasHit())
+                    return false;
+
+                HitResult.m_collider_list        << (EasyPhysic*)BtRayResult.m_collisionObject->getUserPointer();
+                HitResult.m_hit_normal_list        << BT2LOLU_VEC3(BtRayResult.m_hitNormalWorld);
+                HitResult.m_hit_point_list        << BT2LOLU_VEC3(BtRayResult.m_hitPointWorld);
+                HitResult.m_hit_fraction_list    << BtRayResult.m_closestHitFraction;
+                return true;
             }
             case ERT_AllHit:
             {
-                BtRayResult_AllHits = new btCollisionWorld::AllHitsRayResultCallback(LOL2BTU_VEC3(RayFrom), LOL2BTU_VEC3(RayTo));
-                BtRayResult = BtRayResult_AllHits;
-                break;
+                btCollisionWorld::AllHitsRayResultCallback BtRayResult(BtRayFrom, BtRayTo);
+                m_dynamics_world->rayTest(BtRayFrom, BtRayTo, BtRayResult);
+                if (!BtRayResult.hasHit())
+                    return false;
+
+                for (int i = 0; i < BtRayResult.m_collisionObjects.size(); i++)
+                {
+                    HitResult.m_collider_list        << (EasyPhysic*)BtRayResult.m_collisionObjects[i]->getUserPointer();
+                    HitResult.m_hit_normal_list        << BT2LOLU_VEC3(BtRayResult.m_hitNormalWorld[i]);
+                    HitResult.m_hit_point_list        << BT2LOLU_VEC3(BtRayResult.m_hitPointWorld[i]);
+                    HitResult.m_hit_fraction_list    << BtRayResult.m_hitFractions[i];
+                }
+                return true;
             }
             case ERT_AnyHit:
             {
-                BtRayResult_Closest = new AnyHitRayResultCallback(LOL2BTU_VEC3(RayFrom), LOL2BTU_VEC3(RayTo));
-                BtRayResult = BtRayResult_Closest;
-                break;
+                AnyHitRayResultCallback BtRayResult(Me, BtRayFrom, BtRayTo);
+                m_dynamics_world->rayTest(BtRayFrom, BtRayTo, BtRayResult);
+                return BtRayResult.hasHit();
             }
             default:
             {
                 ASSERT(0, "Raycast not handled");
+                return false;
             }
         }
+    }
 
-        m_dynamics_world->rayTest(LOL2BTU_VEC3(RayFrom), LOL2BTU_VEC3(RayTo), *BtRayResult);
-        if (BtRayResult->hasHit())
-        {
-            bResult = true;
+    //Casts all the rays in Queries, in parallel when Bullet is thread-safe,
+    //and writes one result per ray into Hits, which is only resized. Only
+    //ERT_Closest and ERT_AnyHit are supported; ERT_AnyHit only sets m_collider.
+    void RayHits(array<RayCastHit>& Hits, eRaycastType RaycastType, array<RayCastQuery> const& Queries)
+    {
+        ASSERT(RaycastType == ERT_Closest || RaycastType == ERT_AnyHit, "Raycast not handled");
 
-            switch (RaycastType)
+        Hits.resize(Queries.count());
+        bullet_parallel_for(Queries.count(), [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++)
             {
-                case ERT_Closest:
-                {
-                    HitResult.m_collider_list        << (EasyPhysic*)BtRayResult_Closest->m_collisionObject->getUserPointer();
-                    HitResult.m_hit_normal_list        << BT2LOLU_VEC3(BtRayResult_Closest->m_hitNormalWorld);
-                    HitResult.m_hit_point_list        << BT2LOLU_VEC3(BtRayResult_Closest->m_hitPointWorld);
-                    HitResult.m_hit_fraction_list    << BtRayResult_Closest->m_closestHitFraction;
-                    break;
-                }
-                case ERT_AllHit:
+                RayCastQuery const& Query = Queries[i];
+                RayCastHit& Hit = Hits[i];
+                btVector3 BtRayFrom = LOL2BTU_VEC3(Query.m_ray_from);
+                btVector3 BtRayTo = LOL2BTU_VEC3(Query.m_ray_to);
+                btCollisionObject* Me = Query.m_source_caster ? Query.m_source_caster->m_collision_object : nullptr;
+
+                Hit.m_collider = nullptr;
+                Hit.m_hit_normal = vec3(.0f);
+                Hit.m_hit_point = vec3(.0f);
+                Hit.m_hit_fraction = .0f;
+
+                if (RaycastType == ERT_AnyHit)
                 {
-                    for (int i = 0; i < BtRayResult_AllHits->m_collisionObjects.size(); i++)
-                    {
-                        HitResult.m_collider_list        << (EasyPhysic*)BtRayResult_AllHits->m_collisionObjects[i]->getUserPointer();
-                        HitResult.m_hit_normal_list        << BT2LOLU_VEC3(BtRayResult_AllHits->m_hitNormalWorld[i]);
-                        HitResult.m_hit_point_list        << BT2LOLU_VEC3(BtRayResult_AllHits->m_hitPointWorld[i]);
-                        HitResult.m_hit_fraction_list    << BtRayResult_AllHits->m_hitFractions[i];
-                    }
-                    break;
+                    AnyHitRayResultCallback BtRayResult(Me, BtRayFrom, BtRayTo);
+                    m_dynamics_world->rayTest(BtRayFrom, BtRayTo, BtRayResult);
+                    if (BtRayResult.hasHit())
+                        Hit.m_collider = (EasyPhysic*)BtRayResult.m_collisionObject->getUserPointer();
+                    continue;
                 }
-                default:
+
+                ClosestNotMeRayResultCallback BtRayResult(Me, BtRayFrom, BtRayTo);
+                m_dynamics_world->rayTest(BtRayFrom, BtRayTo, BtRayResult);
+                if (BtRayResult.hasHit())
                 {
-                    ASSERT(0, "Raycast not handled");
+                    Hit.m_collider = (EasyPhysic*)BtRayResult.m_collisionObject->getUserPointer();
+                    Hit.m_hit_normal = BT2LOLU_VEC3(BtRayResult.m_hitNormalWorld);
+                    Hit.m_hit_point = BT2LOLU_VEC3(BtRayResult.m_hitPointWorld);
+                    Hit.m_hit_fraction = BtRayResult.m_closestHitFraction;
                 }
             }
-        }
-
-        delete BtRayResult;
-
-        return bResult;
+        }, 64);
     }
 
 
@@ -244,6 +347,22 @@ public:
         delete m_dispatcher;
         delete m_collision_configuration;
         delete m_broadphase;
+        m_dynamics_world = nullptr;
+        m_solver = nullptr;
+        m_dispatcher = nullptr;
+        m_collision_configuration = nullptr;
+        m_broadphase = nullptr;
+
+#if BT_THREADSAFE
+        delete m_solver_pool;
+        m_solver_pool = nullptr;
+        if (m_task_scheduler)
+        {
+            btSetTaskScheduler(btGetSequentialTaskScheduler());
+            delete m_task_scheduler;
+            m_task_scheduler = nullptr;
+        }
+#endif
     }
 
     btDiscreteDynamicsWorld* GetWorld()
@@ -270,7 +389,20 @@ private:
         UNUSED(NewWorldMax);
     }
 
-    void CustomSetTimestep(float NewTimestep) { }
+    void CustomSetTimestep(float NewTimestep) { UNUSED(NewTimestep); }
+
+    //Keeps the transforms of the dynamic bodies before the last step
+    void SavePreviousTransforms()
+    {
+        for (EasyPhysic* CurPhysic : m_dynamic_list)
+        {
+            if (CurPhysic->m_rigid_body)
+            {
+                CurPhysic->m_previous_transform = CurPhysic->m_rigid_body->getWorldTransform();
+                CurPhysic->m_has_previous_transform = true;
+            }
+        }
+    }
 
     //broadphase
     btBroadphaseInterface*                    m_broadphase;
@@ -282,6 +414,11 @@ private:
     btSequentialImpulseConstraintSolver*    m_solver;
     // The world.
     btDiscreteDynamicsWorld*                m_dynamics_world;
+    // The multi-threaded solvers and their scheduler, if any
+#if BT_THREADSAFE
+    btConstraintSolverPoolMt*               m_solver_pool = nullptr;
+    BulletTaskScheduler*                    m_task_scheduler = nullptr;
+#endif
 
 public:
     //Main logic :
@@ -320,6 +457,12 @@ public:
         }
     }
 
+    //Sets how many timesteps a single frame may run at most.
+    void SetMaxSubSteps(int NewMaxSubSteps)
+    {
+        m_max_substeps = lol::max(NewMaxSubSteps, 1);
+    }
+
 private:
 
     friend class EasyPhysic;
@@ -413,6 +556,9 @@ private:
 
     //Easy Physics data storage
     float                                    m_timestep;
+    int                                      m_max_substeps;
+    float                                    m_accumulator;
+    float                                    m_interpolation;
     bool                                    m_using_CCD;
     vec3                                    m_gravity;
     vec3                                    m_world_min;
@@ -0,0 +1,207 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+namespace lol
+{
+
+/* Chunk headers are padded so that chunk data is maximally aligned */
+static size_t const HEADER = (sizeof(void *) * 2 + alignof(std::max_align_t) - 1)
+                           / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+/*
+ * arena implementation
+ */
+
+arena::arena(size_t chunk_size)
+  : m_chunk_size(chunk_size)
+{
+}
+
+arena::~arena()
+{
+    while (m_chunks)
+    {
+        chunk *next = m_chunks->m_next;
+        heap_free(m_chunks);
+        m_chunks = next;
+    }
+}
+
+void *arena::alloc(size_t bytes, size_t align)
+{
+    uint8_t *p = (uint8_t *)(((uintptr_t)m_top + align - 1) & ~(uintptr_t)(align - 1));
+    if (!m_top || p + bytes > m_end)
+    {
+        add_chunk(bytes + align);
+        p = (uint8_t *)(((uintptr_t)m_top + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    m_used += p + bytes - m_top;
+    m_top = p + bytes;
+    return p;
+}
+
+void arena::free(void *p, size_t bytes)
+{
+    if ((uint8_t *)p + bytes == m_top)
+    {
+        m_used -= bytes;
+        m_top = (uint8_t *)p;
+    }
+}
+
+void arena::reset()
+{
+    /* Merge all chunks into a single one so that the next round does
+     * not need to allocate anything. */
+    if (m_chunks && m_chunks->m_next)
+    {
+        size_t total = m_capacity;
+        while (m_chunks)
+        {
+            chunk *next = m_chunks->m_next;
+            heap_free(m_chunks);
+            m_chunks = next;
+        }
+        m_capacity = 0;
+        add_chunk(total);
+    }
+
+    if (m_chunks)
+        m_top = (uint8_t *)m_chunks + HEADER;
+    m_used = 0;
+}
+
+void arena::add_chunk(size_t min_size)
+{
+    size_t size = min_size > m_chunk_size ? min_size : m_chunk_size;
+    chunk *c = (chunk *)heap_alloc(HEADER + size);
+    c->m_next = m_chunks;
+    c->m_size = size;
+    m_chunks = c;
+    m_capacity += size;
+
+    m_top = (uint8_t *)c + HEADER;
+    m_end = m_top + size;
+}
+
+/*
+ * stack_allocator implementation
+ */
+
+stack_allocator::stack_allocator(size_t chunk_size)
+  : arena(chunk_size)
+{
+}
+
+stack_allocator::marker stack_allocator::get_marker() const
+{
+    return marker { m_chunks, m_top, m_used };
+}
+
+void stack_allocator::rewind(marker const &m)
+{
+    /* Release the chunks that were added after the marker, except for
+     * the first one if there were none yet, so that rewinding to an
+     * empty stack does not give the memory back to the heap. */
+    while (m_chunks != m.m_chunk && (m.m_chunk || m_chunks->m_next))
+    {
+        chunk *next = m_chunks->m_next;
+        m_capacity -= m_chunks->m_size;
+        heap_free(m_chunks);
+        m_chunks = next;
+    }
+
+    if (!m_chunks)
+        return;
+
+    m_top = m.m_chunk ? m.m_top : (uint8_t *)m_chunks + HEADER;
+    m_end = (uint8_t *)m_chunks + HEADER + m_chunks->m_size;
+    m_used = m.m_used;
+}
+
+/*
+ * pool_allocator implementation
+ */
+
+pool_allocator::pool_allocator(size_t block_size, size_t blocks_per_chunk)
+  : m_blocks_per_chunk(blocks_per_chunk)
+{
+    /* Blocks must be able to hold a free list pointer, and keep the
+     * maximum alignment. */
+    size_t const align = alignof(std::max_align_t);
+    if (block_size < sizeof(block))
+        block_size = sizeof(block);
+    m_block_size = (block_size + align - 1) / align * align;
+}
+
+pool_allocator::~pool_allocator()
+{
+    while (m_chunks)
+    {
+        void *next = *(void **)m_chunks;
+        heap_free(m_chunks);
+        m_chunks = next;
+    }
+}
+
+void *pool_allocator::alloc(size_t bytes, size_t align)
+{
+    UNUSED(align);
+
+    if (bytes > m_block_size)
+        return heap_alloc(bytes);
+
+    if (!m_free)
+        grow();
+
+    block *ret = m_free;
+    m_free = ret->m_next;
+    ++m_count;
+    return ret;
+}
+
+void pool_allocator::free(void *p, size_t bytes)
+{
+    if (!p)
+        return;
+
+    if (bytes > m_block_size)
+    {
+        heap_free(p);
+        return;
+    }
+
+    block *b = (block *)p;
+    b->m_next = m_free;
+    m_free = b;
+    --m_count;
+}
+
+void pool_allocator::grow()
+{
+    uint8_t *data = (uint8_t *)heap_alloc(HEADER + m_block_size * m_blocks_per_chunk);
+    *(void **)data = m_chunks;
+    m_chunks = data;
+
+    for (size_t i = m_blocks_per_chunk; i--; )
+    {
+        block *b = (block *)(data + HEADER + i * m_block_size);
+        b->m_next = m_free;
+        m_free = b;
+    }
+}
+
+} /* namespace lol */
+
@@ -14,6 +14,10 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <vector>
 
 #if defined(_WIN32)
 #   define WIN32_LEAN_AND_MEAN
@@ -30,9 +34,635 @@
 #   include <cstdarg>
 #endif
 
+#if !defined _WIN32 && !defined __EMSCRIPTEN__ && !__NX__
+#   include <csignal>
+#   include <unistd.h>
+#   define LOL_LOG_CRASH_HANDLER 1
+#endif
+
 namespace lol
 {
 
+/*
+ * Per-thread message queues
+ *
+ * Each thread that logs owns a ring buffer of variable-sized records. The
+ * thread is the only producer; the only consumer is whoever holds the
+ * output mutex, usually the background thread. Records carry a global
+ * sequence number so that messages from all threads are written in the
+ * order they were logged. Rings are never freed: the ring of a thread
+ * that exited is handed to the next new thread once it is empty, which
+ * lets the crash handler walk the list without locking.
+ */
+
+namespace
+{
+
+size_t const RING_SIZE = 64 * 1024;
+size_t const MAX_RECORD = RING_SIZE / 4;
+uint32_t const PADDING = 0xffffffffu;
+
+struct record
+{
+    uint64_t m_seq;
+    uint32_t m_size;
+    uint32_t m_type;
+};
+
+inline size_t record_size(size_t len)
+{
+    return (sizeof(record) + len + 7) & ~(size_t)7;
+}
+
+std::atomic<uint64_t> g_seq { 0 };
+
+struct log_ring
+{
+    bool push(msg::message_type type, char const *text, size_t len)
+    {
+        size_t need = record_size(len);
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t offset = head % RING_SIZE;
+        size_t pad = RING_SIZE - offset < need ? RING_SIZE - offset : 0;
+
+        if (RING_SIZE - (head - tail) < pad + need)
+            return false;
+
+        /* Records never wrap around; mark the end of the buffer as
+         * padding if there is room for a header. */
+        if (pad)
+        {
+            if (pad >= sizeof(record))
+                ((record *)(m_data + offset))->m_size = PADDING;
+            head += pad;
+            offset = 0;
+        }
+
+        record *r = (record *)(m_data + offset);
+        r->m_seq = g_seq.fetch_add(1, std::memory_order_relaxed);
+        r->m_size = (uint32_t)len;
+        r->m_type = (uint32_t)type;
+        memcpy(r + 1, text, len);
+        m_head.store(head + need, std::memory_order_release);
+        return true;
+    }
+
+    record const *peek()
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+
+        while (tail != head)
+        {
+            size_t offset = tail % RING_SIZE;
+            record const *r = (record const *)(m_data + offset);
+            if (RING_SIZE - offset >= sizeof(record) && r->m_size != PADDING)
+            {
+                m_tail.store(tail, std::memory_order_release);
+                return r;
+            }
+            tail += RING_SIZE - offset;
+        }
+
+        m_tail.store(tail, std::memory_order_release);
+        return nullptr;
+    }
+
+    void pop(record const *r)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        m_tail.store(tail + record_size(r->m_size), std::memory_order_release);
+    }
+
+    bool empty() const
+    {
+        return used() == 0;
+    }
+
+    size_t used() const
+    {
+        return m_head.load(std::memory_order_acquire)
+                - m_tail.load(std::memory_order_acquire);
+    }
+
+    std::atomic<size_t> m_head { 0 }, m_tail { 0 };
+    std::atomic<bool> m_orphan { false };
+    log_ring *m_next = nullptr;
+    alignas(8) uint8_t m_data[RING_SIZE];
+};
+
+/*
+ * Global logger state; never destroyed, so that logging still works
+ * during static destruction.
+ */
+
+struct log_state
+{
+    log_state()
+    {
+        char const *var = getenv("LOL_LOG_SYNC");
+        m_async = threads_available() && !(var && var[0]);
+    }
+
+    /* Unlike has_threads(), this does not depend on the number of cores,
+     * since the background thread is about hiding I/O latency. */
+    static bool threads_available()
+    {
+#if defined __EMSCRIPTEN__ && !defined __EMSCRIPTEN_PTHREADS__
+        return false;
+#else
+        char const *var = getenv("LOL_NOTHREADS");
+        return !(var && var[0]);
+#endif
+    }
+
+    /* Must be called with m_output_mutex held */
+    void write(msg::message_type type, char const *text, size_t len);
+    void write_out();
+    bool drain();
+    void rotate();
+    void update_fd();
+
+    void start_thread();
+    void stop_thread();
+    void wake();
+
+    std::atomic<bool> m_async, m_console { true }, m_shutdown { false };
+    std::atomic<int> m_rate_limit { 0 };
+
+    std::mutex m_rings_mutex;
+    std::atomic<log_ring *> m_rings { nullptr };
+    thread *m_thread = nullptr;
+
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake_cond;
+    std::atomic<bool> m_sleeping { false }, m_stop { false };
+
+    std::mutex m_output_mutex;
+    std::vector<log_ring *> m_drain_list;
+    std::string m_console_buf, m_file_buf;
+    std::string m_path;
+    FILE *m_file = nullptr;
+    std::atomic<int> m_file_fd { -1 }; /* for the crash handler */
+    size_t m_max_size = 0, m_file_size = 0;
+    int m_max_files = 1;
+};
+
+log_state &get_state();
+
+char const * const g_prefix[] =
+{
+    "DEBUG",
+    "INFO",
+    "WARN",
+    "ERROR",
+};
+
+void log_state::write(msg::message_type type, char const *text, size_t len)
+{
+    if (m_console)
+    {
+#if __ANDROID__
+        static int const prio[] =
+        {
+            ANDROID_LOG_DEBUG,
+            ANDROID_LOG_INFO,
+            ANDROID_LOG_WARN,
+            ANDROID_LOG_ERROR
+        };
+
+        __android_log_print(prio[(int)type], "LOL", "%.*s", (int)len, text);
+#elif defined _WIN32
+        std::string buf = std::string(g_prefix[(int)type]) + ": "
+                        + std::string(text, len);
+
+        array<WCHAR> widechar;
+        widechar.resize(buf.length() + 1);
+        MultiByteToWideChar(CP_UTF8, 0, buf.c_str(), (int)buf.length() + 1, widechar.data(), widechar.count());
+        OutputDebugStringW(widechar.data());
+#else
+        m_console_buf.append(g_prefix[(int)type]).append(": ").append(text, len);
+#endif
+    }
+
+    if (m_file)
+    {
+        /* Rotate before the file grows past its maximum size */
+        size_t size = strlen(g_prefix[(int)type]) + 2 + len;
+        size_t current = m_file_size + m_file_buf.length();
+        if (m_max_size && current && current + size > m_max_size)
+        {
+            write_out();
+            rotate();
+        }
+
+        m_file_buf.append(g_prefix[(int)type]).append(": ").append(text, len);
+    }
+}
+
+void log_state::write_out()
+{
+    if (m_console_buf.length())
+    {
+#if defined __EMSCRIPTEN__
+        fwrite(m_console_buf.c_str(), 1, m_console_buf.length(), stdout);
+        fflush(stdout);
+#else
+        fwrite(m_console_buf.c_str(), 1, m_console_buf.length(), stderr);
+        fflush(stderr);
+#endif
+        m_console_buf.clear();
+    }
+
+    if (m_file_buf.length())
+    {
+        if (m_file)
+        {
+            fwrite(m_file_buf.c_str(), 1, m_file_buf.length(), m_file);
+            fflush(m_file);
+            m_file_size += m_file_buf.length();
+        }
+        m_file_buf.clear();
+    }
+}
+
+void log_state::update_fd()
+{
+#if LOL_LOG_CRASH_HANDLER
+    m_file_fd = m_file ? fileno(m_file) : -1;
+#endif
+}
+
+void log_state::rotate()
+{
+    m_file_fd = -1;
+    fclose(m_file);
+
+    for (int i = m_max_files; i > 0; --i)
+    {
+        std::string src = i > 1 ? format("%s.%d", m_path.c_str(), i - 1) : m_path;
+        std::string dst = format("%s.%d", m_path.c_str(), i);
+        remove(dst.c_str());
+        rename(src.c_str(), dst.c_str());
+    }
+
+    m_file = fopen(m_path.c_str(), "wb");
+    m_file_size = 0;
+    update_fd();
+}
+
+/* Write all queued messages in order; return whether there were any */
+bool log_state::drain()
+{
+    /* Rings are only ever prepended, so the list needs no lock */
+    m_drain_list.clear();
+    for (log_ring *r = m_rings.load(std::memory_order_acquire); r; r = r->m_next)
+        m_drain_list.push_back(r);
+
+    bool ret = false;
+    for (;;)
+    {
+        log_ring *best = nullptr;
+        record const *best_record = nullptr;
+        for (log_ring *ring : m_drain_list)
+        {
+            record const *r = ring->peek();
+            if (r && (!best_record || r->m_seq < best_record->m_seq))
+            {
+                best = ring;
+                best_record = r;
+            }
+        }
+
+        if (!best)
+            break;
+
+        write((msg::message_type)best_record->m_type,
+              (char const *)(best_record + 1), best_record->m_size);
+        best->pop(best_record);
+        ret = true;
+
+        if (m_console_buf.length() + m_file_buf.length() > RING_SIZE)
+            write_out();
+    }
+
+    write_out();
+    return ret;
+}
+
+void log_state::start_thread()
+{
+    std::lock_guard<std::mutex> rings_lock(m_rings_mutex);
+    if (m_thread || m_shutdown)
+        return;
+
+    m_stop = false;
+    m_thread = new thread([this](thread *)
+    {
+        while (!m_stop)
+        {
+            bool busy;
+            {
+                std::lock_guard<std::mutex> output_lock(m_output_mutex);
+                busy = drain();
+            }
+
+            if (!busy)
+            {
+                /* Producers only wake us up for warnings or when their
+                 * ring is filling up; otherwise, messages wait for the
+                 * timeout, so that logging rarely costs a system call. */
+                std::unique_lock<std::mutex> wake_lock(m_wake_mutex);
+                m_sleeping = true;
+                m_wake_cond.wait_for(wake_lock, std::chrono::milliseconds(10));
+                m_sleeping = false;
+            }
+        }
+    });
+}
+
+void log_state::stop_thread()
+{
+    thread *t;
+    {
+        std::lock_guard<std::mutex> lock(m_rings_mutex);
+        t = m_thread;
+        m_thread = nullptr;
+    }
+
+    if (t)
+    {
+        m_stop = true;
+        m_wake_cond.notify_one();
+        delete t; /* joins the thread */
+    }
+
+    std::lock_guard<std::mutex> lock(m_output_mutex);
+    drain();
+}
+
+void log_state::wake()
+{
+    /* Only the producer that clears the flag signals. Taking the mutex
+     * ensures the consumer is already waiting, so the signal is not lost. */
+    if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false))
+    {
+        std::lock_guard<std::mutex> wake_lock(m_wake_mutex);
+        m_wake_cond.notify_one();
+    }
+}
+
+void shutdown()
+{
+    log_state &s = get_state();
+    s.m_shutdown = true;
+    s.m_async = false;
+    s.stop_thread();
+}
+
+#if LOL_LOG_CRASH_HANDLER
+/*
+ * Crash handler. Only async-signal-safe calls are allowed here, so the
+ * rings are read without being modified and copied out with write(2).
+ * Messages that the background thread was writing at the time of the
+ * crash may appear twice.
+ */
+
+int const g_crash_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+int const CRASH_SIGNALS = sizeof(g_crash_signals) / sizeof(*g_crash_signals);
+struct sigaction g_old_actions[CRASH_SIGNALS];
+log_state *g_crash_state = nullptr;
+volatile sig_atomic_t g_crashing = 0;
+
+void crash_write(int fd, char const *text, size_t len)
+{
+    while (len)
+    {
+        ssize_t ret = ::write(fd, text, len);
+        if (ret <= 0)
+            break;
+        text += ret;
+        len -= (size_t)ret;
+    }
+}
+
+/* Next record between “pos” and “end” in a ring, skipping padding */
+record const *crash_peek(log_ring const *ring, size_t &pos, size_t end)
+{
+    while (pos != end)
+    {
+        size_t offset = pos % RING_SIZE;
+        record const *r = (record const *)(ring->m_data + offset);
+        if (RING_SIZE - offset >= sizeof(record) && r->m_size != PADDING)
+            return r;
+        pos += RING_SIZE - offset;
+    }
+    return nullptr;
+}
+
+void crash_dump(log_state &s)
+{
+    /* Only messages queued before the crash are written, in case other
+     * threads keep logging. */
+    int const MAX_RINGS = 64;
+    log_ring const *rings[MAX_RINGS];
+    size_t pos[MAX_RINGS], end[MAX_RINGS];
+    int count = 0;
+
+    for (log_ring *r = s.m_rings.load(std::memory_order_acquire);
+         r && count < MAX_RINGS; r = r->m_next, ++count)
+    {
+        rings[count] = r;
+        pos[count] = r->m_tail.load(std::memory_order_acquire);
+        end[count] = r->m_head.load(std::memory_order_acquire);
+    }
+
+    bool const console = s.m_console;
+    int const fd = s.m_file_fd;
+
+    for (;;)
+    {
+        int best = -1;
+        record const *best_record = nullptr;
+        for (int i = 0; i < count; ++i)
+        {
+            record const *r = crash_peek(rings[i], pos[i], end[i]);
+            if (r && (!best_record || r->m_seq < best_record->m_seq))
+            {
+                best = i;
+                best_record = r;
+            }
+        }
+
+        if (best < 0)
+            break;
+
+        char const *prefix = g_prefix[best_record->m_type & 3];
+        for (int out : { console ? 2 : -1, fd })
+        {
+            if (out < 0)
+                continue;
+            crash_write(out, prefix, strlen(prefix));
+            crash_write(out, ": ", 2);
+            crash_write(out, (char const *)(best_record + 1),
+                        best_record->m_size);
+        }
+
+        pos[best] += record_size(best_record->m_size);
+    }
+}
+
+void crash_handler(int sig, siginfo_t *info, void *)
+{
+    if (!g_crashing)
+    {
+        g_crashing = 1;
+        if (g_crash_state)
+            crash_dump(*g_crash_state);
+    }
+
+    /* Hand the signal over to the previous handler. A fault will happen
+     * again when this handler returns; a signal sent by kill() or abort()
+     * is sent again, and delivered once this handler returns. */
+    for (int i = 0; i < CRASH_SIGNALS; ++i)
+        if (g_crash_signals[i] == sig)
+            sigaction(sig, &g_old_actions[i], nullptr);
+
+    if (info->si_code <= 0)
+        raise(sig);
+}
+#endif
+
+log_state &get_state()
+{
+    static log_state *state = []()
+    {
+        log_state *s = new log_state();
+        std::atexit(shutdown);
+        return s;
+    }();
+    return *state;
+}
+
+/*
+ * Thread-local state. Only trivial types are used here, because messages
+ * may be logged after the thread-local destructors have run.
+ */
+
+thread_local log_ring *tls_ring = nullptr;
+thread_local bool tls_exited = false;
+thread_local msg::field const *tls_fields = nullptr;
+
+/* Rate limiting: a token bucket refilled at the given rate */
+thread_local double tls_tokens = -1.0;
+thread_local int64_t tls_last_time = 0;
+thread_local int tls_suppressed = 0, tls_dropped = 0;
+
+struct ring_owner
+{
+    ~ring_owner()
+    {
+        if (tls_ring)
+            tls_ring->m_orphan = true;
+        tls_ring = nullptr;
+        tls_exited = true;
+    }
+};
+
+log_ring *get_ring(log_state &s)
+{
+    if (!tls_ring && !tls_exited)
+    {
+        static thread_local ring_owner owner;
+        (void)&owner;
+
+        {
+            std::lock_guard<std::mutex> lock(s.m_rings_mutex);
+
+            /* Reuse the ring of a thread that exited, if it was emptied */
+            for (log_ring *r = s.m_rings; r && !tls_ring; r = r->m_next)
+                if (r->m_orphan && r->empty())
+                    tls_ring = r;
+
+            if (tls_ring)
+                tls_ring->m_orphan = false;
+            else
+            {
+                tls_ring = new log_ring();
+                tls_ring->m_next = s.m_rings;
+                s.m_rings.store(tls_ring, std::memory_order_release);
+            }
+        }
+        s.start_thread();
+    }
+    return tls_ring;
+}
+
+bool rate_limit(int per_second)
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    double tokens = tls_tokens < 0.0 ? per_second
+                  : tls_tokens + 1e-9 * (now - tls_last_time) * per_second;
+    tls_tokens = std::min(tokens, (double)per_second);
+    tls_last_time = now;
+
+    if (tls_tokens < 1.0)
+    {
+        ++tls_suppressed;
+        return false;
+    }
+
+    tls_tokens -= 1.0;
+    return true;
+}
+
+/* Queue a message, or write it immediately if it cannot be queued */
+void emit(log_state &s, msg::message_type type, char const *text, size_t len)
+{
+    log_ring *ring = s.m_async && type != msg::message_type::error
+                   && len <= MAX_RECORD ? get_ring(s) : nullptr;
+
+    if (ring)
+    {
+        while (!ring->push(type, text, len))
+        {
+            /* Drop debug and info messages if the writer cannot keep up */
+            if (type < msg::message_type::warning)
+            {
+                ++tls_dropped;
+                return;
+            }
+
+            if (!s.m_async)
+            {
+                ring = nullptr;
+                break;
+            }
+
+            s.wake();
+            std::this_thread::yield();
+        }
+
+        if (ring)
+        {
+            if (type >= msg::message_type::warning
+                 || ring->used() > RING_SIZE / 4)
+                s.wake();
+            return;
+        }
+    }
+
+    /* Write everything queued so far, then this message */
+    std::lock_guard<std::mutex> lock(s.m_output_mutex);
+    s.drain();
+    s.write(type, text, len);
+    s.write_out();
+}
+
+} /* anonymous namespace */
+
 /*
  * Public log class
  */
@@ -69,6 +699,106 @@ void msg::error(char const *fmt, ...)
     va_end(ap);
 }
 
+void msg::set_async(bool async)
+{
+    log_state &s = get_state();
+    if (async && log_state::threads_available() && !s.m_shutdown)
+    {
+        s.m_async = true;
+        s.start_thread();
+    }
+    else
+    {
+        s.m_async = false;
+        s.stop_thread();
+    }
+}
+
+void msg::flush()
+{
+    log_state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.m_output_mutex);
+    s.drain();
+}
+
+void msg::install_crash_handler()
+{
+#if LOL_LOG_CRASH_HANDLER
+    static std::atomic<bool> installed { false };
+    if (installed.exchange(true))
+        return;
+
+    g_crash_state = &get_state();
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = crash_handler;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+
+    for (int i = 0; i < CRASH_SIGNALS; ++i)
+        sigaction(g_crash_signals[i], &sa, &g_old_actions[i]);
+#endif
+}
+
+void msg::set_rate_limit(int per_second)
+{
+    get_state().m_rate_limit = std::max(per_second, 0);
+}
+
+void msg::set_console(bool enabled)
+{
+    log_state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.m_output_mutex);
+    s.drain();
+    s.m_console = enabled;
+}
+
+void msg::set_log_file(std::string const &path, size_t max_size, int max_files)
+{
+    log_state &s = get_state();
+    std::lock_guard<std::mutex> lock(s.m_output_mutex);
+    s.drain();
+
+    if (s.m_file)
+    {
+        s.m_file_fd = -1;
+        fclose(s.m_file);
+    }
+
+    s.m_file = path.length() ? fopen(path.c_str(), "ab") : nullptr;
+    s.update_fd();
+    s.m_path = path;
+    s.m_max_size = max_size;
+    s.m_max_files = std::max(max_files, 0);
+    s.m_file_size = 0;
+
+    if (s.m_file)
+    {
+        fseek(s.m_file, 0, SEEK_END);
+        s.m_file_size = (size_t)ftell(s.m_file);
+    }
+    else if (path.length())
+    {
+        std::string error = format("cannot open log file %s\n", path.c_str());
+        s.write(message_type::error, error.c_str(), error.length());
+        s.write_out();
+    }
+}
+
+msg::field::field(char const *key, std::string const &value)
+  : m_key(key),
+    m_value(value),
+    m_prev(tls_fields)
+{
+    tls_fields = this;
+}
+
+msg::field::~field()
+{
+    tls_fields = m_prev;
+}
+
 /*
  * Private helper function
  */
@@ -87,44 +817,77 @@ void msg::helper(message_type type, char const *fmt, va_list ap)
     }
 #endif
 
-#if __ANDROID__
-    static int const prio[] =
+#if __NX__
+    nx::helper(type, fmt, ap);
+#else
+    log_state &s = get_state();
+
+    int limit = s.m_rate_limit;
+    if (limit && type < message_type::warning && !rate_limit(limit))
+        return;
+
+    if (tls_suppressed || tls_dropped)
     {
-        ANDROID_LOG_DEBUG,
-        ANDROID_LOG_INFO,
-        ANDROID_LOG_WARN,
-        ANDROID_LOG_ERROR
-    };
+        std::string notice = format("(%d messages suppressed, %d dropped)\n",
+                                    tls_suppressed, tls_dropped);
+        tls_suppressed = tls_dropped = 0;
+        emit(s, message_type::warning, notice.c_str(), notice.length());
+    }
 
-    std::string buf = vformat(fmt, ap);
-    __android_log_print(prio[(int)type], "LOL", "[%d] %s", (int)gettid(), &buf[0]);
+    /* Format the fields and the message into a stack buffer; fall back
+     * to the heap for long messages. */
+    field const *fields[16];
+    int field_count = 0;
+    for (field const *f = tls_fields; f && field_count < 16; f = f->m_prev)
+        fields[field_count++] = f;
 
-#elif __NX__
-    nx::helper(type, fmt, ap);
-#else
-    static char const * const prefix[] =
+    char buf[1024];
+    size_t len = 0;
+    auto append = [&](char const *str, size_t n)
     {
-        "DEBUG",
-        "INFO",
-        "WARN",
-        "ERROR",
+        if (len + n < sizeof(buf))
+            memcpy(buf + len, str, n);
+        len += n;
     };
 
-#   if defined _WIN32
-    std::string buf = std::string(prefix[(int)type]) + ": " + vformat(fmt, ap);
-
-    array<WCHAR> widechar;
-    widechar.resize(buf.length() + 1);
-    MultiByteToWideChar(CP_UTF8, 0, buf.c_str(), (int)buf.length() + 1, widechar.data(), widechar.count());
-    OutputDebugStringW(widechar.data());
-#   elif defined __EMSCRIPTEN__
-    fprintf(stdout, "%s: ", prefix[(int)type]);
-    vfprintf(stdout, fmt, ap);
-    fflush(stdout);
-#   else
-    fprintf(stderr, "%s: ", prefix[(int)type]);
-    vfprintf(stderr, fmt, ap);
-#   endif
+#if __ANDROID__
+    char tid[16];
+    append(tid, snprintf(tid, sizeof(tid), "[%d] ", (int)gettid()));
+#endif
+    for (int i = field_count; i--; )
+    {
+        append(i == field_count - 1 ? "[" : " ", 1);
+        append(fields[i]->m_key.c_str(), fields[i]->m_key.length());
+        append("=", 1);
+        append(fields[i]->m_value.c_str(), fields[i]->m_value.length());
+        append(i ? "" : "] ", i ? 0 : 2);
+    }
+
+    if (len < sizeof(buf))
+    {
+        va_list ap2;
+        va_copy(ap2, ap);
+        int ret = vsnprintf(buf + len, sizeof(buf) - len, fmt, ap2);
+        va_end(ap2);
+        if (ret >= 0 && len + ret < sizeof(buf))
+        {
+            emit(s, type, buf, len + ret);
+            return;
+        }
+    }
+
+    std::string str;
+#if __ANDROID__
+    str += format("[%d] ", (int)gettid());
+#endif
+    for (int i = field_count; i--; )
+    {
+        str += i == field_count - 1 ? "[" : " ";
+        str += fields[i]->m_key + "=" + fields[i]->m_value;
+        str += i ? "" : "] ";
+    }
+    str += vformat(fmt, ap);
+    emit(s, type, str.c_str(), str.length());
 #endif
 }
 
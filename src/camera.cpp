@@ -122,6 +122,11 @@ mat4 Camera::GetProjection() const
     return m_proj_matrix;
 }
 
+frustum Camera::GetFrustum() const
+{
+    return frustum(m_proj_matrix * m_view_matrix);
+}
+
 //-----------------------------------------------------------------------------
 //Projections manipulation functions
 //--
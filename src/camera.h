@@ -18,6 +18,7 @@
 //
 
 #include <lol/math/matrix.h>
+#include <lol/math/culling.h>
 
 #include "engine/worldentity.h"
 
@@ -49,6 +50,9 @@ public:
 
     mat4 GetProjection() const;
 
+    /* Clipping planes of the current view and projection */
+    frustum GetFrustum() const;
+
     //Projections manipulation functions
     void SetFov(float fov);
     void SetScreenInfos(float screen_size);
@@ -43,6 +43,32 @@ public:
     //cmd storage
     void    AddCmd(int cmd) { m_commands.push(cmd, m_floats.count(), m_ints.count()); }
 
+    //Combine the hash of command i and its arguments with seed; chaining
+    //this over a range of commands identifies the program they make.
+    uint64_t Hash(int i, uint64_t seed) const
+    {
+        ASSERT(0 <= i && i < m_commands.count());
+        bool last = i + 1 == m_commands.count();
+        int f_end = last ? m_floats.count() : m_commands[i + 1].m2;
+        int i_end = last ? m_ints.count() : m_commands[i + 1].m3;
+
+        uint64_t ret = Mix(seed, (uint64_t)m_commands[i].m1);
+        for (int n = m_commands[i].m2; n < f_end; ++n)
+        {
+            uint32_t bits;
+            memcpy(&bits, &m_floats[n], sizeof(bits));
+            ret = Mix(ret, bits);
+        }
+        for (int n = m_commands[i].m3; n < i_end; ++n)
+            ret = Mix(ret, (uint64_t)(uint32_t)m_ints[n]);
+        return ret;
+    }
+
+    static inline uint64_t Mix(uint64_t seed, uint64_t x)
+    {
+        return hash_mix(seed ^ x) + 0x9e3779b97f4a7c15ull;
+    }
+
     //GETTER
     inline float   F()      { return m_floats[m_f_cur++]; }
     inline int     I()      { return m_ints[m_i_cur++]; }
@@ -32,14 +32,50 @@ class DebugRecordData
     friend class DebugRecord;
 
 private:
+    void Feed(u8vec4 const *pixels, ptrdiff_t pitch, ivec2 size);
+
     std::string m_path;
     ivec2 m_size;
     int m_fps;
+    FrameCapture m_capture;
 #if defined USE_PIPI
     pipi_sequence_t *m_sequence;
+    array<uint32_t> m_buffer;
+#elif LOL_USE_FFMPEG
+    movie *m_movie;
 #endif
 };
 
+/* Send a captured frame to the encoder. Frames may arrive a few ticks
+ * late, so those from before a resize are dropped. */
+void DebugRecordData::Feed(u8vec4 const *pixels, ptrdiff_t pitch, ivec2 size)
+{
+    if (size != m_size)
+        return;
+
+#if defined USE_PIPI
+    if (!m_sequence)
+        return;
+
+    /* Flip while converting to the 0xAARRGGBB pixels pipi expects */
+    m_buffer.resize(size.x * size.y);
+    for (int y = 0; y < size.y; ++y, pixels += pitch)
+        for (int x = 0; x < size.x; ++x)
+        {
+            u8vec4 p = pixels[x];
+            m_buffer[y * size.x + x] = ((uint32_t)p.a << 24)
+                | ((uint32_t)p.r << 16) | ((uint32_t)p.g << 8) | p.b;
+        }
+
+    pipi_feed_sequence(m_sequence, (uint8_t *)&m_buffer[0], size.x, size.y);
+#elif LOL_USE_FFMPEG
+    if (m_movie)
+        m_movie->push_frame(pixels, pitch);
+#else
+    UNUSED(pixels, pitch);
+#endif
+}
+
 /*
  * Public DebugRecord class
  */
@@ -54,6 +90,8 @@ DebugRecord::DebugRecord(std::string const &path, float fps)
     m_data->m_fps = (int)(fps + 0.5f);
 #if defined USE_PIPI
     m_data->m_sequence = nullptr;
+#elif LOL_USE_FFMPEG
+    m_data->m_movie = nullptr;
 #endif
 
     m_drawgroup = tickable::group::draw::capture;
@@ -70,8 +108,15 @@ void DebugRecord::tick_draw(float seconds, Scene &scene)
 
     ivec2 size = Video::GetSize();
 
+    auto feed = [&](u8vec4 const *pixels, ptrdiff_t pitch, ivec2 frame_size)
+    {
+        m_data->Feed(pixels, pitch, frame_size);
+    };
+
     if (m_data->m_size != size)
     {
+        /* Frames still in flight belong to the previous sequence */
+        m_data->m_capture.Flush(feed);
         m_data->m_size = size;
 
 #if defined USE_PIPI
@@ -81,25 +126,39 @@ void DebugRecord::tick_draw(float seconds, Scene &scene)
         m_data->m_sequence = pipi_open_sequence(m_data->m_path, size.x, size.y,
                                                 1 /* RGB */, m_data->m_fps,
                                                 1, 1, 60 * 1024 * 1024);
+#elif LOL_USE_FFMPEG
+        delete m_data->m_movie;
+        m_data->m_movie = new movie(size);
+        if (!m_data->m_movie->open_file(m_data->m_path))
+        {
+            delete m_data->m_movie;
+            m_data->m_movie = nullptr;
+        }
 #endif
     }
 
-#if defined USE_PIPI
-    if (m_data->m_sequence)
-    {
-        uint32_t *buffer = new uint32_t[size.x * size.y];
-        Video::Capture(buffer);
-        pipi_feed_sequence(m_data->m_sequence, (uint8_t *)buffer,
-                           size.x, size.y);
-        delete[] buffer;
-    }
-#endif
+    m_data->m_capture.Capture(feed);
 }
 
 DebugRecord::~DebugRecord()
 {
     Ticker::StopRecording();
 
+    /* Encode the last frames still in flight before closing */
+    DebugRecordData *data = m_data;
+    m_data->m_capture.Flush([data](u8vec4 const *pixels, ptrdiff_t pitch,
+                                   ivec2 frame_size)
+    {
+        data->Feed(pixels, pitch, frame_size);
+    });
+
+#if defined USE_PIPI
+    if (m_data->m_sequence)
+        pipi_close_sequence(m_data->m_sequence);
+#elif LOL_USE_FFMPEG
+    delete m_data->m_movie;
+#endif
+
     delete m_data;
 }
 
@@ -17,6 +17,8 @@
 #include "commandstack.h"
 #include "easymeshrender.h"
 #include "easymeshbuild.h"
+#include "easymeshcache.h"
+#include "easymeshtopology.h"
 
 #include <map>
 
@@ -97,10 +99,16 @@ public:
     //Command-build (lua now) operations
     //-------------------------------------------------------------------------
     bool Compile(char const *command, bool Execute = true);
+    /* Run the recorded commands. Whole programs are looked up in and
+     * stored to EasyMeshCache, and independent brace groups may be built
+     * on several threads. */
     void ExecuteCmdStack(bool ExecAllStack = true);
 
 private:
     void UpdateVertexDict(array< int, int > &vertex_dict);
+    int ExecuteCmd(int i);
+    int ExecuteBraceGroups(int start, bool &expensive);
+    int FindBraceGroup(int start, vec4 &color_a, vec4 &color_b);
 
     //-------------------------------------------------------------------------
     //Mesh CSG operations
@@ -290,7 +298,7 @@ public:
         Acts as an OpenBrace
      */
     void DupAndScale(vec3 const &s, bool open_brace=false);
-    /* [cmd:ch] Performs a chamfer operation //TODO : Make it work
+    /* [cmd:ch] Performs a chamfer operation
         - f : Chamfer quantity.
      */
     void Chamfer(float f);
@@ -299,7 +307,7 @@ public:
      */
     void SplitTriangles(int pass);
 private:
-    void SplitTriangles(int pass, VertexDictionnary *vert_dict);
+    void SplitTriangles(int pass, MeshTopology *topo);
 public:
     /* [cmd:smth] Smooth the mesh by subdivising it.
         - pass : a pass is made of (n0 split then n1 smooth) repeat.
@@ -16,6 +16,47 @@
 namespace lol
 {
 
+//-----------------------------------------------------------------------------
+uint64_t EasyMeshBuildData::Hash(uint64_t seed) const
+{
+    uint32_t const ignored = MeshBuildOperation::CommandRecording
+                           | MeshBuildOperation::CommandExecution;
+
+    array<float> values;
+    values << m_color_a.x << m_color_a.y << m_color_a.z << m_color_a.w
+           << m_color_b.x << m_color_b.y << m_color_b.z << m_color_b.w
+           << m_texcoord_offset.x << m_texcoord_offset.y
+           << m_texcoord_offset2.x << m_texcoord_offset2.y
+           << m_texcoord_scale.x << m_texcoord_scale.y
+           << m_texcoord_scale2.x << m_texcoord_scale2.y;
+    for (int i = 0; i < MeshType::MAX; ++i)
+    {
+        for (int j = 0; j < m_texcoord_custom_build[i].count(); ++j)
+        {
+            auto const &bl_tr = m_texcoord_custom_build[i][j];
+            values << bl_tr.m1.x << bl_tr.m1.y << bl_tr.m2.x << bl_tr.m2.y;
+        }
+        for (int j = 0; j < m_texcoord_custom_build2[i].count(); ++j)
+        {
+            auto const &bl_tr = m_texcoord_custom_build2[i][j];
+            values << bl_tr.m1.x << bl_tr.m1.y << bl_tr.m2.x << bl_tr.m2.y;
+        }
+        seed = CommandStack::Mix(seed, m_texcoord_build_type[i]);
+        seed = CommandStack::Mix(seed, m_texcoord_build_type2[i]);
+        seed = CommandStack::Mix(seed, (uint64_t)m_texcoord_custom_build[i].count() << 32
+                                       | (uint32_t)m_texcoord_custom_build2[i].count());
+    }
+
+    seed = CommandStack::Mix(seed, m_build_flags & ~ignored);
+    for (float f : values)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        seed = CommandStack::Mix(seed, bits);
+    }
+    return seed;
+}
+
 //-----------------------------------------------------------------------------
 //helpers func to retrieve a vertex.
 int VertexDictionnary::FindVertexMaster(const int search_idx)
@@ -492,6 +492,10 @@ public:
     inline void Toggle(MeshBuildOperation mbo) { m_build_flags ^= mbo.ToScalar(); }
     inline void Set(MeshBuildOperation mbo, bool value) { if (value) Enable(mbo); else Disable(mbo); }
 
+    //Hash of everything a command program's result depends on, except
+    //the commands themselves and the recording/execution flags.
+    uint64_t Hash(uint64_t seed) const;
+
 public:
     CommandStack        m_stack;
     int                 m_i_cmd;
@@ -0,0 +1,258 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+namespace lol
+{
+
+/* Bump this whenever a change to the mesh operations alters their output,
+ * so that files written by older builds are ignored. */
+static uint32_t const LOLMESH_VERSION = 2;
+
+struct lolmesh_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t vertex_size;
+    uint64_t key;
+    uint32_t vert_count;
+    uint32_t index_count;
+    uint32_t cursor_count;
+    uint32_t build_flags;
+    float color_a[4];
+    float color_b[4];
+};
+
+static char const LOLMESH_MAGIC[8] = { 'L', 'O', 'L', 'M', 'E', 'S', 'H', '\0' };
+
+static struct easymesh_cache
+{
+    std::mutex m_mutex;
+    hash_map<uint64_t, std::shared_ptr<EasyMeshState const>> m_entries;
+    std::deque<uint64_t> m_order;
+    size_t m_bytes = 0, m_limit = 64 << 20;
+    std::string m_directory;
+    int64_t m_hits = 0, m_misses = 0;
+
+    // Must be called with the mutex held
+    void trim()
+    {
+        while (m_bytes > m_limit && m_order.size())
+        {
+            auto it = m_entries.find(m_order.front());
+            m_order.pop_front();
+            if (it == m_entries.end())
+                continue;
+            m_bytes -= it->second->GetBytes();
+            m_entries.erase(it);
+        }
+    }
+
+    std::string path(uint64_t key) const
+    {
+        return m_directory + format("/%016llx.lolmesh", (unsigned long long)key);
+    }
+}
+g_cache;
+
+//-----------------------------------------------------------------------------
+size_t EasyMeshState::GetBytes() const
+{
+    return sizeof(*this) + (size_t)m_vert.bytes() + (size_t)m_indices.bytes()
+         + (size_t)m_cursors.bytes();
+}
+
+//-----------------------------------------------------------------------------
+static std::shared_ptr<EasyMeshState const> load_lolmesh(std::string const &path,
+                                                         uint64_t key)
+{
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return nullptr;
+
+    auto state = std::make_shared<EasyMeshState>();
+    lolmesh_header h;
+    bool ok = fread(&h, sizeof(h), 1, fp) == 1
+               && !memcmp(h.magic, LOLMESH_MAGIC, sizeof(h.magic))
+               && h.version == LOLMESH_VERSION
+               && h.vertex_size == sizeof(VertexData)
+               && h.key == key
+               && h.vert_count <= 0x10000 && h.index_count <= (1 << 26)
+               && h.cursor_count > 0 && h.cursor_count <= 0x10000;
+    if (ok)
+    {
+        state->m_vert.resize(h.vert_count);
+        state->m_indices.resize(h.index_count);
+        state->m_cursors.resize(h.cursor_count);
+        ok = fread(state->m_vert.data(), sizeof(VertexData), h.vert_count, fp) == h.vert_count
+          && fread(state->m_indices.data(), sizeof(uint16_t), h.index_count, fp) == h.index_count;
+        for (uint32_t i = 0; ok && i < h.cursor_count; ++i)
+        {
+            int32_t cursor[2];
+            ok = fread(cursor, sizeof(cursor), 1, fp) == 1;
+            state->m_cursors[i].m1 = cursor[0];
+            state->m_cursors[i].m2 = cursor[1];
+        }
+        state->m_color_a = vec4(h.color_a[0], h.color_a[1], h.color_a[2], h.color_a[3]);
+        state->m_color_b = vec4(h.color_b[0], h.color_b[1], h.color_b[2], h.color_b[3]);
+        state->m_build_flags = h.build_flags;
+    }
+    fclose(fp);
+
+    if (!ok)
+    {
+        msg::warn("ignoring invalid mesh cache file %s\n", path.c_str());
+        return nullptr;
+    }
+    return state;
+}
+
+static void save_lolmesh(std::string const &path, uint64_t key,
+                         EasyMeshState const &state)
+{
+    /* Write to a temporary file first, so that other processes sharing
+     * the directory never see a partial file. */
+    std::string tmp = path + format(".%p.tmp", (void const *)&state);
+    FILE *fp = fopen(tmp.c_str(), "wb");
+    if (!fp)
+        return;
+
+    lolmesh_header h;
+    memcpy(h.magic, LOLMESH_MAGIC, sizeof(h.magic));
+    h.version = LOLMESH_VERSION;
+    h.vertex_size = sizeof(VertexData);
+    h.key = key;
+    h.vert_count = (uint32_t)state.m_vert.count();
+    h.index_count = (uint32_t)state.m_indices.count();
+    h.cursor_count = (uint32_t)state.m_cursors.count();
+    h.build_flags = state.m_build_flags;
+    for (int i = 0; i < 4; ++i)
+    {
+        h.color_a[i] = state.m_color_a[i];
+        h.color_b[i] = state.m_color_b[i];
+    }
+
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1
+           && fwrite(state.m_vert.data(), sizeof(VertexData), h.vert_count, fp) == h.vert_count
+           && fwrite(state.m_indices.data(), sizeof(uint16_t), h.index_count, fp) == h.index_count;
+    for (uint32_t i = 0; ok && i < h.cursor_count; ++i)
+    {
+        int32_t cursor[2] = { state.m_cursors[i].m1, state.m_cursors[i].m2 };
+        ok = fwrite(cursor, sizeof(cursor), 1, fp) == 1;
+    }
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        msg::warn("could not write mesh cache file %s\n", path.c_str());
+        remove(tmp.c_str());
+    }
+}
+
+//-----------------------------------------------------------------------------
+void EasyMeshCache::SetMemoryLimit(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(g_cache.m_mutex);
+    g_cache.m_limit = bytes;
+    g_cache.trim();
+}
+
+void EasyMeshCache::SetDirectory(std::string const &path)
+{
+    std::lock_guard<std::mutex> lock(g_cache.m_mutex);
+    g_cache.m_directory = path;
+}
+
+void EasyMeshCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(g_cache.m_mutex);
+    g_cache.m_entries.clear();
+    g_cache.m_order.clear();
+    g_cache.m_bytes = 0;
+    g_cache.m_hits = g_cache.m_misses = 0;
+}
+
+int64_t EasyMeshCache::GetHitCount()
+{
+    std::lock_guard<std::mutex> lock(g_cache.m_mutex);
+    return g_cache.m_hits;
+}
+
+int64_t EasyMeshCache::GetMissCount()
+{
+    std::lock_guard<std::mutex> lock(g_cache.m_mutex);
+    return g_cache.m_misses;
+}
+
+void EasyMeshCache::AddBuild(bool hit)
+{
+    std::lock_guard<std::mutex> lock(g_cache.m_mutex);
+    ++(hit ? g_cache.m_hits : g_cache.m_misses);
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<EasyMeshState const> EasyMeshCache::Find(uint64_t key, bool use_disk)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(g_cache.m_mutex);
+        auto it = g_cache.m_entries.find(key);
+        if (it != g_cache.m_entries.end())
+            return it->second;
+        if (!use_disk || g_cache.m_directory.empty())
+            return nullptr;
+        path = g_cache.path(key);
+    }
+
+    /* Read the file without holding the lock */
+    auto state = load_lolmesh(path, key);
+    if (!state)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(g_cache.m_mutex);
+    if (g_cache.m_entries.emplace(key, state).second)
+    {
+        g_cache.m_order.push_back(key);
+        g_cache.m_bytes += state->GetBytes();
+        g_cache.trim();
+    }
+    return state;
+}
+
+void EasyMeshCache::Store(uint64_t key, std::shared_ptr<EasyMeshState const> state,
+                          bool use_disk)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(g_cache.m_mutex);
+        if (g_cache.m_entries.emplace(key, state).second)
+        {
+            g_cache.m_order.push_back(key);
+            g_cache.m_bytes += state->GetBytes();
+            g_cache.trim();
+        }
+        if (use_disk && !g_cache.m_directory.empty())
+            path = g_cache.path(key);
+    }
+
+    if (path.length())
+        save_lolmesh(path, key, *state);
+}
+
+} /* namespace lol */
+
@@ -0,0 +1,68 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+//
+// The EasyMeshCache class
+// -----------------------
+// Built meshes are stored by the hash of the command program that made
+// them and of the build state it started from. EasyMesh::ExecuteCmdStack()
+// looks up whole programs and the state reached after their expensive
+// steps, so that a mesh built again, or sharing its first steps with an
+// already built mesh, skips the work already done. Whole programs can
+// also be stored as files, so that they survive across runs.
+//
+
+namespace lol
+{
+
+//Mesh data and the build state needed to resume a program
+struct EasyMeshState
+{
+    array<VertexData>   m_vert;
+    array<uint16_t>     m_indices;
+    array<int, int>     m_cursors;
+    vec4                m_color_a;
+    vec4                m_color_b;
+    uint32_t            m_build_flags;
+
+    size_t GetBytes() const;
+};
+
+class EasyMeshCache
+{
+public:
+    //In-memory budget, in bytes; the oldest entries are dropped first
+    static void SetMemoryLimit(size_t bytes);
+    //Directory where whole programs are stored; empty to disable
+    static void SetDirectory(std::string const &path);
+    static void Clear();
+
+    //Builds that reused cached work, and builds that started from scratch
+    static int64_t GetHitCount();
+    static int64_t GetMissCount();
+
+    //Internal interface for EasyMesh
+    static std::shared_ptr<EasyMeshState const> Find(uint64_t key, bool use_disk);
+    static void Store(uint64_t key, std::shared_ptr<EasyMeshState const> state,
+                      bool use_disk);
+    static void AddBuild(bool hit);
+};
+
+} /* namespace lol */
+
@@ -125,36 +125,57 @@ void EasyMesh::ComputeNormals(int start, int vcount)
         BD()->IsEnabled(MeshBuildOperation::PostBuildComputeNormals))
         return;
 
-    array< array<vec3> > normals;
-    normals.resize(m_vert.count());
+    array<vec3> tri_normals;
+    tri_normals.resize(vcount / 3);
+    int vmin = m_vert.count(), vmax = -1;
     for (int i = 0; i < vcount; i += 3)
     {
         vec3 v0 = m_vert[m_indices[start + i + 2]].m_coord
                 - m_vert[m_indices[start + i + 0]].m_coord;
         vec3 v1 = m_vert[m_indices[start + i + 1]].m_coord
                 - m_vert[m_indices[start + i + 0]].m_coord;
-        vec3 n = normalize(cross(v1, v0));
+        tri_normals[i / 3] = normalize(cross(v1, v0));
 
         for (int j = 0; j < 3; j++)
-            normals[m_indices[start + i + j]] << n;
+        {
+            vmin = lol::min(vmin, (int)m_indices[start + i + j]);
+            vmax = lol::max(vmax, (int)m_indices[start + i + j]);
+        }
     }
 
-    for (int i = 0; i < normals.count(); i++)
+    if (vmax < vmin)
+        return;
+
+    MeshTopology topo;
+    topo.Separate(vmin, vmax - vmin + 1);
+    topo.Build(m_indices, start, vcount / 3 * 3);
+
+    parallel_for(vmax - vmin + 1, [&](int begin, int end)
     {
-        if (normals[i].count() > 0)
+        array<vec3> normals;
+        for (int i = vmin + begin; i < vmin + end; i++)
         {
+            if (!topo.GetCornerCount(i))
+                continue;
+
             //remove doubles
-            for (int j = 0; j < normals[i].count(); ++j)
-                for (int k = j + 1; k < normals[i].count(); ++k)
-                    if (1.f - dot(normals[i][k], normals[i][j]) < .00001f)
-                        normals[i].remove(k--);
+            normals.clear();
+            for (int j = 0; j < topo.GetCornerCount(i); ++j)
+            {
+                vec3 n = tri_normals[topo.GetCorner(i, j) / 3];
+                bool found = false;
+                for (int k = 0; !found && k < normals.count(); ++k)
+                    found = 1.f - dot(n, normals[k]) < .00001f;
+                if (!found)
+                    normals << n;
+            }
 
             vec3 newv = vec3::zero;
-            for (int j = 0; j < normals[i].count(); ++j)
-                newv += normals[i][j];
-            m_vert[i].m_normal = normalize(newv / (float)normals[i].count());
+            for (int j = 0; j < normals.count(); ++j)
+                newv += normals[j];
+            m_vert[i].m_normal = normalize(newv / (float)normals.count());
         }
-    }
+    }, 1024);
 }
 
 //-----------------------------------------------------------------------------
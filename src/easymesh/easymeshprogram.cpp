@@ -0,0 +1,405 @@
+//
+//  EasyMesh-Program: The code executing recorded command programs
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//            © 2009—2015 Cédric Lecacheur <jordx@free.fr>
+//            © 2009—2015 Benjamin "Touky" Huet <huet.benjamin@gmail.com>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace lol
+{
+
+//-----------------------------------------------------------------------------
+#define EZSET(M0)                                               BD()->CmdStack().GetValue(M0);
+#define EZDEF_1(T0)                                             T0 m0; EZSET(m0)
+#define EZDEF_2(T0, T1)                                         EZDEF_1(T0) T1 m1; EZSET(m1)
+#define EZDEF_3(T0, T1, T2)                                     EZDEF_2(T0, T1) T2 m2; EZSET(m2)
+#define EZDEF_4(T0, T1, T2, T3)                                 EZDEF_3(T0, T1, T2) T3 m3; EZSET(m3)
+#define EZDEF_5(T0, T1, T2, T3, T4)                             EZDEF_4(T0, T1, T2, T3) T4 m4; EZSET(m4)
+#define EZDEF_6(T0, T1, T2, T3, T4, T5)                         EZDEF_5(T0, T1, T2, T3, T4) T5 m5; EZSET(m5)
+#define EZDEF_7(T0, T1, T2, T3, T4, T5, T6)                     EZDEF_6(T0, T1, T2, T3, T4, T5) T6 m6; EZSET(m6)
+#define EZDEF_8(T0, T1, T2, T3, T4, T5, T6, T7)                 EZDEF_7(T0, T1, T2, T3, T4, T5, T6) T7 m7; EZSET(m7)
+#define EZDEF_9(T0, T1, T2, T3, T4, T5, T6, T7, T8)             EZDEF_8(T0, T1, T2, T3, T4, T5, T6, T7) T8 m8; EZSET(m8)
+#define EZDEF_10(T0, T1, T2, T3, T4, T5, T6, T7, T8, T9)        EZDEF_9(T0, T1, T2, T3, T4, T5, T6, T7, T8) T9 m9; EZSET(m9)
+
+//----
+#define EZCALL_1(F)                                             F();
+#define EZCALL_2(F, T0)                                         EZDEF_1(T0) F(m0);
+#define EZCALL_3(F, T0, T1)                                     EZDEF_2(T0, T1) F(m0, m1);
+#define EZCALL_4(F, T0, T1, T2)                                 EZDEF_3(T0, T1, T2) F(m0, m1, m2);
+#define EZCALL_5(F, T0, T1, T2, T3)                             EZDEF_4(T0, T1, T2, T3) F(m0, m1, m2, m3);
+#define EZCALL_6(F, T0, T1, T2, T3, T4)                         EZDEF_5(T0, T1, T2, T3, T4) F(m0, m1, m2, m3, m4);
+#define EZCALL_7(F, T0, T1, T2, T3, T4, T5)                     EZDEF_6(T0, T1, T2, T3, T4, T5) F(m0, m1, m2, m3, m4, m5);
+#define EZCALL_8(F, T0, T1, T2, T3, T4, T5, T6)                 EZDEF_7(T0, T1, T2, T3, T4, T5, T6) F(m0, m1, m2, m3, m4, m5, m6);
+#define EZCALL_9(F, T0, T1, T2, T3, T4, T5, T6, T7)             EZDEF_8(T0, T1, T2, T3, T4, T5, T6, T7) F(m0, m1, m2, m3, m4, m5, m6, m7);
+#define EZCALL_10(F, T0, T1, T2, T3, T4, T5, T6, T7, T8)        EZDEF_9(T0, T1, T2, T3, T4, T5, T6, T7, T8) F(m0, m1, m2, m3, m4, m5, m6, m7, m8);
+#define EZCALL_11(F, T0, T1, T2, T3, T4, T5, T6, T7, T8, T9)    EZDEF_10(T0, T1, T2, T3, T4, T5, T6, T7, T8, T9) F(m0, m1, m2, m3, m4, m5, m6, m7, m8, m9);
+
+//----
+#define EZM_CALL_FUNC(...) \
+    LOL_CALL(LOL_CAT(EZCALL_, LOL_CALL(LOL_COUNT_TO_12, (__VA_ARGS__))), (__VA_ARGS__))
+
+//-----------------------------------------------------------------------------
+int EasyMesh::ExecuteCmd(int i)
+{
+#define DO_EXEC_CMD(MESH_CMD, FUNC_PARAMS)  \
+        case EasyMeshCmdType::MESH_CMD:     \
+    { EZM_CALL_FUNC FUNC_PARAMS; break; }
+
+    int cmd = BD()->CmdStack().GetCmd(i);
+    switch (cmd)
+    {
+        DO_EXEC_CMD(MeshCsg, (MeshCsg, CSGUsage))
+            DO_EXEC_CMD(LoopStart, (LoopStart, int))
+            DO_EXEC_CMD(LoopEnd, (LoopEnd))
+            DO_EXEC_CMD(OpenBrace, (OpenBrace))
+            DO_EXEC_CMD(CloseBrace, (CloseBrace))
+            DO_EXEC_CMD(ScaleWinding, (ToggleScaleWinding))
+            DO_EXEC_CMD(QuadWeighting, (ToggleQuadWeighting))
+            DO_EXEC_CMD(PostBuildNormal, (TogglePostBuildNormal))
+            DO_EXEC_CMD(PreventVertCleanup, (ToggleVerticeNoCleanup))
+            DO_EXEC_CMD(VerticesMerge, (VerticesMerge))
+            DO_EXEC_CMD(VerticesSeparate, (VerticesSeparate))
+            DO_EXEC_CMD(SetColorA, (SetCurColorA, vec4))
+            DO_EXEC_CMD(SetColorB, (SetCurColorB, vec4))
+            DO_EXEC_CMD(SetVertColor, (SetVertColor, vec4))
+            DO_EXEC_CMD(Translate, (Translate, vec3))
+            DO_EXEC_CMD(Rotate, (Rotate, float, vec3))
+            DO_EXEC_CMD(RadialJitter, (RadialJitter, float))
+            DO_EXEC_CMD(MeshTranform, (DoMeshTransform, MeshTransform, Axis, Axis, float, float, float, bool))
+            DO_EXEC_CMD(Scale, (Scale, vec3))
+            DO_EXEC_CMD(DupAndScale, (DupAndScale, vec3, bool))
+            DO_EXEC_CMD(Chamfer, (Chamfer, float))
+            DO_EXEC_CMD(SplitTriangles, (SplitTriangles, int))
+            DO_EXEC_CMD(SmoothMesh, (SmoothMesh, int, int, int))
+            DO_EXEC_CMD(AppendCylinder, (AppendCylinder, int, float, float, float, bool, bool, bool))
+            DO_EXEC_CMD(AppendCapsule, (AppendCapsule, int, float, float))
+            DO_EXEC_CMD(AppendTorus, (AppendTorus, int, float, float))
+            DO_EXEC_CMD(AppendBox, (AppendBox, vec3, float, bool))
+            DO_EXEC_CMD(AppendStar, (AppendStar, int, float, float, bool, bool))
+            DO_EXEC_CMD(AppendExpandedStar, (AppendExpandedStar, int, float, float, float))
+            DO_EXEC_CMD(AppendDisc, (AppendDisc, int, float, bool))
+            DO_EXEC_CMD(AppendSimpleTriangle, (AppendSimpleTriangle, float, bool))
+            DO_EXEC_CMD(AppendSimpleQuad, (AppendSimpleQuad, vec2, vec2, float, bool))
+            DO_EXEC_CMD(AppendCog, (AppendCog, int, float, float, float, float, float, float, float, float, bool))
+    default:
+        ASSERT(0, "Unknown command pseudo bytecode");
+    }
+    return cmd;
+
+#undef DO_EXEC_CMD
+}
+
+//-----------------------------------------------------------------------------
+// Commands after which the mesh state is worth keeping in the cache.
+static bool is_expensive(int cmd)
+{
+    return cmd == EasyMeshCmdType::MeshCsg
+        || cmd == EasyMeshCmdType::Chamfer
+        || cmd == EasyMeshCmdType::SplitTriangles
+        || cmd == EasyMeshCmdType::SmoothMesh;
+}
+
+/* Distinguishes the final mesh, after cleanup, from the state reached
+ * after the last command. */
+static uint64_t const FINAL_STATE = 0x6c6f6c6d657368ull;
+
+static std::shared_ptr<EasyMeshState const> save_state(EasyMesh &em)
+{
+    auto state = std::make_shared<EasyMeshState>();
+    state->m_vert = em.m_vert;
+    state->m_indices = em.m_indices;
+    state->m_cursors = em.m_cursors;
+    state->m_color_a = em.BD()->ColorA();
+    state->m_color_b = em.BD()->ColorB();
+    state->m_build_flags = em.BD()->m_build_flags;
+    return state;
+}
+
+static void restore_state(EasyMesh &em, EasyMeshState const &state)
+{
+    em.m_vert = state.m_vert;
+    em.m_indices = state.m_indices;
+    em.m_cursors = state.m_cursors;
+    em.BD()->ColorA() = state.m_color_a;
+    em.BD()->ColorB() = state.m_color_b;
+    em.BD()->m_build_flags = state.m_build_flags;
+}
+
+//-----------------------------------------------------------------------------
+void EasyMesh::ExecuteCmdStack(bool ExecAllStack)
+{
+    EasyMeshBuildData &bd = *BD();
+    CommandStack &stack = bd.CmdStack();
+    int const cmd_count = stack.GetCmdNb();
+
+    /* Whole programs built from an empty mesh are looked up in the cache,
+     * unless they use random numbers. keys[i] identifies the state reached
+     * before command i, and can_resume[i] tells whether that state may be
+     * cached: outside loops, and right after an expensive command. */
+    bool use_cache = ExecAllStack && bd.CmdExecNb() < 0
+                      && !m_vert.count() && !m_indices.count()
+                      && m_cursors.count() == 1 && !bd.LoopStack().count();
+    array<uint64_t> keys;
+    array<bool> can_resume;
+    if (use_cache)
+    {
+        keys.resize(cmd_count + 1);
+        can_resume.resize(cmd_count + 1, false);
+        keys[0] = bd.Hash(0);
+
+        int loop_depth = 0;
+        for (int i = 0; i < cmd_count && use_cache; ++i)
+        {
+            int cmd = stack.GetCmd(i);
+            if (cmd == EasyMeshCmdType::RadialJitter)
+                use_cache = false;
+            else if (cmd == EasyMeshCmdType::LoopStart)
+                ++loop_depth;
+            else if (cmd == EasyMeshCmdType::LoopEnd)
+                loop_depth = std::max(loop_depth - 1, 0);
+
+            keys[i + 1] = stack.Hash(i, keys[i]);
+            can_resume[i + 1] = loop_depth == 0 && (is_expensive(cmd)
+                                 || cmd == EasyMeshCmdType::CloseBrace);
+        }
+    }
+
+    uint64_t const final_key = use_cache ? CommandStack::Mix(keys[cmd_count], FINAL_STATE) : 0;
+    if (use_cache)
+    {
+        if (auto state = EasyMeshCache::Find(final_key, true))
+        {
+            EasyMeshCache::AddBuild(true);
+            restore_state(*this, *state);
+            bd.Cmdi() = cmd_count;
+            return;
+        }
+
+        /* Resume from the longest prefix already built */
+        bd.Cmdi() = 0;
+        for (int i = cmd_count; i > 0 && !bd.Cmdi(); --i)
+        {
+            if (!can_resume[i])
+                continue;
+            if (auto state = EasyMeshCache::Find(keys[i], false))
+            {
+                restore_state(*this, *state);
+                bd.Cmdi() = i;
+            }
+        }
+        EasyMeshCache::AddBuild(bd.Cmdi() > 0);
+    }
+
+    bd.Enable(MeshBuildOperation::CommandExecution);
+    if (ExecAllStack && !use_cache)
+        bd.Cmdi() = 0;
+
+    for (; bd.Cmdi() < cmd_count && bd.CmdExecNb() != 0; ++bd.Cmdi())
+    {
+        int i = bd.Cmdi();
+
+        /* Independent brace groups outside loops may run concurrently */
+        if (bd.CmdExecNb() < 0 && !bd.LoopStack().count() && has_threads())
+        {
+            bool expensive = false;
+            int end = ExecuteBraceGroups(i, expensive);
+            if (end > i)
+            {
+                if (use_cache && expensive && can_resume[end])
+                    EasyMeshCache::Store(keys[end], save_state(*this), false);
+                bd.Cmdi() = end - 1;
+                continue;
+            }
+        }
+
+        if (bd.CmdExecNb() > 0)
+            --bd.CmdExecNb();
+
+        int cmd = ExecuteCmd(i);
+        if (use_cache && is_expensive(cmd) && can_resume[i + 1] && bd.Cmdi() == i)
+            EasyMeshCache::Store(keys[i + 1], save_state(*this), false);
+    }
+    bd.Disable(MeshBuildOperation::CommandExecution);
+
+    if (!bd.IsEnabled(MeshBuildOperation::PreventVertCleanup))
+        VerticesCleanup();
+
+    if (bd.IsEnabled(MeshBuildOperation::PostBuildComputeNormals))
+        ComputeNormals(0, m_indices.count());
+
+    bd.Disable(MeshBuildOperation::PostBuildComputeNormals);
+    bd.Disable(MeshBuildOperation::PreventVertCleanup);
+
+    if (bd.CmdExecNb() > 0)
+        bd.CmdExecNb() = -1;
+
+    if (use_cache)
+        EasyMeshCache::Store(final_key, save_state(*this), true);
+}
+
+//-----------------------------------------------------------------------------
+// If the brace group starting at command “start” does not depend on or
+// modify the mesh outside it, return the index of the command after it,
+// and update the current colours with those it sets. Otherwise return -1.
+int EasyMesh::FindBraceGroup(int start, vec4 &color_a, vec4 &color_b)
+{
+    CommandStack &stack = BD()->CmdStack();
+    if (stack.GetCmd(start) != EasyMeshCmdType::OpenBrace)
+        return -1;
+
+    //Brace depth at each loop start; loop bodies must leave it unchanged
+    array<int> loop_depths;
+    int depth = 0;
+
+    for (int i = start; i < stack.GetCmdNb(); ++i)
+    {
+        switch (stack.GetCmd(i))
+        {
+        case EasyMeshCmdType::OpenBrace:
+            ++depth;
+            break;
+        case EasyMeshCmdType::DupAndScale:
+        {
+            vec3 scale = stack.V3();
+            UNUSED(scale);
+            if (stack.B())
+                ++depth;
+            break;
+        }
+        case EasyMeshCmdType::CloseBrace:
+            if (loop_depths.count() && loop_depths.last() >= depth)
+                return -1;
+            if (--depth == 0)
+                return i + 1;
+            break;
+        case EasyMeshCmdType::LoopStart:
+            loop_depths << depth;
+            break;
+        case EasyMeshCmdType::LoopEnd:
+            if (!loop_depths.count() || loop_depths.pop() != depth)
+                return -1;
+            break;
+        case EasyMeshCmdType::SetColorA:
+            color_a = stack.V4();
+            break;
+        case EasyMeshCmdType::SetColorB:
+            color_b = stack.V4();
+            break;
+        //These use vertices or state outside the group
+        case EasyMeshCmdType::MeshCsg:
+        case EasyMeshCmdType::VerticesMerge:
+        case EasyMeshCmdType::VerticesSeparate:
+        case EasyMeshCmdType::RadialJitter:
+        case EasyMeshCmdType::ScaleWinding:
+        case EasyMeshCmdType::QuadWeighting:
+        case EasyMeshCmdType::PostBuildNormal:
+        case EasyMeshCmdType::PreventVertCleanup:
+            return -1;
+        default:
+            break;
+        }
+    }
+
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+// Build the consecutive independent brace groups starting at command
+// “start” in separate meshes, possibly on several threads, then append
+// them in order. Return the index of the command after the last group,
+// or “start” if there are not at least two such groups.
+int EasyMesh::ExecuteBraceGroups(int start, bool &expensive)
+{
+    EasyMeshBuildData &bd = *BD();
+    CommandStack &stack = bd.CmdStack();
+
+    //<begin, end, color a, color b>
+    array<int, int, vec4, vec4> groups;
+    vec4 color_a = bd.ColorA(), color_b = bd.ColorB();
+    vec4 end_color_a = color_a, end_color_b = color_b;
+
+    for (int i = start; i < stack.GetCmdNb(); )
+    {
+        int cmd = stack.GetCmd(i);
+        if (cmd == EasyMeshCmdType::SetColorA || cmd == EasyMeshCmdType::SetColorB)
+        {
+            (cmd == EasyMeshCmdType::SetColorA ? color_a : color_b) = stack.V4();
+            ++i;
+            continue;
+        }
+
+        vec4 group_a = color_a, group_b = color_b;
+        int end = FindBraceGroup(i, color_a, color_b);
+        if (end < 0)
+            break;
+
+        groups.push(i, end, group_a, group_b);
+        end_color_a = color_a;
+        end_color_b = color_b;
+        i = end;
+    }
+
+    if (groups.count() < 2)
+        return start;
+
+    for (int i = start; i < groups.last().m2 && !expensive; ++i)
+        expensive = is_expensive(stack.GetCmd(i));
+
+    std::vector<EasyMeshState> results(groups.count());
+    parallel_for(groups.count(), [&](int begin, int end)
+    {
+        /* Each band needs its own copy of the build data, because reading
+         * commands moves the stack cursors. */
+        EasyMesh sub;
+        sub.m_build_data = new EasyMeshBuildData(bd);
+        EasyMeshBuildData &sub_bd = *sub.m_build_data;
+
+        for (int g = begin; g < end; ++g)
+        {
+            sub.m_vert.clear();
+            sub.m_indices.clear();
+            sub_bd.ColorA() = groups[g].m3;
+            sub_bd.ColorB() = groups[g].m4;
+
+            for (sub_bd.Cmdi() = groups[g].m1; sub_bd.Cmdi() < groups[g].m2; ++sub_bd.Cmdi())
+                sub.ExecuteCmd(sub_bd.Cmdi());
+
+            results[g].m_vert = std::move(sub.m_vert);
+            results[g].m_indices = std::move(sub.m_indices);
+        }
+
+        delete sub.m_build_data;
+        sub.m_build_data = nullptr;
+    });
+
+    for (auto const &result : results)
+    {
+        int base = m_vert.count();
+        m_vert.reserve(base + result.m_vert.count());
+        for (int i = 0; i < result.m_vert.count(); ++i)
+            m_vert << result.m_vert[i];
+        m_indices.reserve(m_indices.count() + result.m_indices.count());
+        for (int i = 0; i < result.m_indices.count(); ++i)
+            m_indices << (uint16_t)(result.m_indices[i] + base);
+    }
+
+    bd.ColorA() = end_color_a;
+    bd.ColorB() = end_color_b;
+    return groups.last().m2;
+}
+
+} /* namespace lol */
+
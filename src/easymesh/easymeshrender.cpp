@@ -194,7 +194,8 @@ void DefaultShaderData::SetupShaderDatas(mat4 const &model)
     mat3 normalmat = transpose(inverse(mat3(modelview)));
     /* FIXME: this should be hidden in the shader */
     array<Light *> const &lights = scene.GetLights();
-    array<vec4> light_data;
+    array<vec4> light_data(&scene.GetFrameArena());
+    light_data.reserve(2 * max(lights.count(), LOL_MAX_LIGHT_COUNT));
     //This is not very nice, but necessary for emscripten WebGL generation.
     float f = 0.f;
 
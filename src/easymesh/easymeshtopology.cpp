@@ -0,0 +1,176 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <cmath>
+
+namespace lol
+{
+
+//-----------------------------------------------------------------------------
+static inline uint64_t cell_key(ivec3 const &cell)
+{
+    /* Distinct cells may share a key; they are told apart by the distance
+     * test, so this only costs a few extra comparisons. */
+    return (uint64_t)(cell.x & 0x1fffff)
+         | (uint64_t)(cell.y & 0x1fffff) << 21
+         | (uint64_t)(cell.z & 0x1fffff) << 42;
+}
+
+void MeshTopology::Weld(array<VertexData> const &vert, int vbase)
+{
+    float const epsilon = TestEpsilon::Get();
+    /* Vertices are matched when their squared distance is below epsilon,
+     * so with cells of that size a match is always in a neighbour cell. */
+    float const cell_size = lol::max(std::sqrt(epsilon), 1e-6f);
+
+    m_vbase = vbase;
+    m_master.resize(vert.count() - vbase);
+
+    //Masters are chained per cell, most recent first
+    hash_map<uint64_t, int> heads;
+    array<int> chain;
+    chain.resize(m_master.count(), -1);
+
+    for (int i = 0; i < m_master.count(); ++i)
+    {
+        vec3 const &p = vert[vbase + i].m_coord;
+        vec3 const fcell = lol::clamp(p / cell_size, vec3(-1e6f), vec3(1e6f));
+        ivec3 const cell((int)std::floor(fcell.x), (int)std::floor(fcell.y),
+                         (int)std::floor(fcell.z));
+
+        //Like VertexDictionnary, pick the first master that matches
+        int found = -1;
+        for (int n = 0; n < 27; ++n)
+        {
+            auto it = heads.find(cell_key(cell + ivec3(n % 3 - 1, n / 3 % 3 - 1, n / 9 - 1)));
+            for (int j = it == heads.end() ? -1 : it->second; j >= 0; j = chain[j])
+            {
+                if ((found < 0 || j < found)
+                     && sqlength(vert[vbase + j].m_coord - p) < epsilon)
+                    found = j;
+            }
+        }
+
+        if (found >= 0)
+        {
+            m_master[i] = vbase + found;
+            continue;
+        }
+
+        m_master[i] = vbase + i;
+        int &head = heads.emplace(cell_key(cell), -1).first->second;
+        chain[i] = head;
+        head = i;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void MeshTopology::Separate(int vbase, int vcount)
+{
+    m_vbase = vbase;
+    m_master.resize(vcount);
+    for (int i = 0; i < vcount; ++i)
+        m_master[i] = vbase + i;
+}
+
+void MeshTopology::AddVertex(int master)
+{
+    m_master << (master < 0 ? m_vbase + m_master.count() : master);
+}
+
+//-----------------------------------------------------------------------------
+void MeshTopology::Build(array<uint16_t> const &indices, int ibase, int icount)
+{
+    int const vcount = m_master.count();
+
+    m_corner_vert.resize(icount);
+    for (int c = 0; c < icount; ++c)
+        m_corner_vert[c] = GetMaster(indices[ibase + c]);
+
+    //Sort corners by master; this is a counting sort, so it is stable
+    m_corner_start.resize(vcount + 1);
+    for (int i = 0; i <= vcount; ++i)
+        m_corner_start[i] = 0;
+    for (int c = 0; c < icount; ++c)
+        ++m_corner_start[m_corner_vert[c] - m_vbase + 1];
+    for (int i = 0; i < vcount; ++i)
+        m_corner_start[i + 1] += m_corner_start[i];
+
+    m_corners.resize(icount);
+    array<int> fill;
+    fill.resize(vcount);
+    for (int i = 0; i < vcount; ++i)
+        fill[i] = m_corner_start[i];
+    for (int c = 0; c < icount; ++c)
+        m_corners[fill[m_corner_vert[c] - m_vbase]++] = c;
+
+    /* The corner o facing c uses the same edge in reverse: if c's edge
+     * goes from a to b, then next(o) uses b and prev(o) uses a. Only the
+     * corners of b need to be looked at. */
+    m_opposite.resize(icount);
+    parallel_for(icount, [&](int begin, int end)
+    {
+        for (int c = begin; c < end; ++c)
+        {
+            int const a = m_corner_vert[Next(c)], b = m_corner_vert[Prev(c)];
+            m_opposite[c] = -1;
+            if (a == b)
+                continue;
+            for (int n = 0; n < GetCornerCount(b); ++n)
+            {
+                int const k = GetCorner(b, n);
+                if (k / 3 != c / 3 && m_corner_vert[Next(k)] == a)
+                {
+                    m_opposite[c] = Prev(k);
+                    break;
+                }
+            }
+        }
+    }, 4096);
+}
+
+//-----------------------------------------------------------------------------
+void MeshTopology::BuildNeighbours()
+{
+    int const vcount = m_master.count();
+
+    //Same order as VertexDictionnary::FindConnectedVertices()
+    m_neighbour_start.resize(vcount + 1);
+    m_neighbours.clear();
+    m_neighbours.reserve(m_corner_vert.count() * 2);
+    for (int i = 0; i < vcount; ++i)
+    {
+        int const v = m_vbase + i;
+        int const first = m_neighbours.count();
+        m_neighbour_start[i] = first;
+
+        for (int n = 0; n < GetCornerCount(v); ++n)
+        {
+            int const t = GetCorner(v, n) / 3 * 3;
+            for (int j = 0; j < 3; ++j)
+            {
+                int const w = m_corner_vert[t + j];
+                bool found = (w == v);
+                for (int k = first; !found && k < m_neighbours.count(); ++k)
+                    found = (m_neighbours[k] == w);
+                if (!found)
+                    m_neighbours << w;
+            }
+        }
+    }
+    m_neighbour_start[vcount] = m_neighbours.count();
+}
+
+} /* namespace lol */
+
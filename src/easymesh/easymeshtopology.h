@@ -0,0 +1,75 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// The MeshTopology class
+// ----------------------
+// A corner table over a range of EasyMesh triangles. Corner c is index
+// c of the range; corners 3t, 3t+1 and 3t+2 belong to triangle t. Vertices
+// sharing a position are welded to a master vertex, and the table stores
+// for every corner the master it uses and the corner facing it across its
+// opposite edge, and for every master the corners using it and the masters
+// it is connected to. All of this is built in linear time, and the welding
+// is carried over by EasyMesh::SplitTriangles() so that positions are only
+// ever compared once.
+//
+
+namespace lol
+{
+
+class MeshTopology
+{
+public:
+    //Weld vertices [vbase, vert.count()[ that are closer than TestEpsilon
+    void Weld(array<VertexData> const &vert, int vbase);
+    //Make every vertex of [vbase, vbase + vcount[ its own master
+    void Separate(int vbase, int vcount);
+    //Append a vertex whose master is “master”, or itself if negative
+    void AddVertex(int master = -1);
+
+    //Build the corners of triangles [ibase, ibase + icount[
+    void Build(array<uint16_t> const &indices, int ibase, int icount);
+    //Build the neighbour lists, once the corners are built
+    void BuildNeighbours();
+
+    int GetVertexBase() const { return m_vbase; }
+    int GetVertexCount() const { return m_master.count(); }
+    int GetCornerCount() const { return m_corner_vert.count(); }
+
+    //Vertex indices are absolute, like in EasyMesh::m_indices
+    int GetMaster(int v) const { return m_master[v - m_vbase]; }
+    int GetVertex(int c) const { return m_corner_vert[c]; }
+    //The corner across the edge opposite to c, or -1 on borders
+    int GetOpposite(int c) const { return m_opposite[c]; }
+
+    //Corners using master v, in triangle order
+    int GetCornerCount(int v) const { return m_corner_start[v - m_vbase + 1] - m_corner_start[v - m_vbase]; }
+    int GetCorner(int v, int n) const { return m_corners[m_corner_start[v - m_vbase] + n]; }
+    //Masters sharing an edge with master v, in triangle order
+    int GetNeighbourCount(int v) const { return m_neighbour_start[v - m_vbase + 1] - m_neighbour_start[v - m_vbase]; }
+    int GetNeighbour(int v, int n) const { return m_neighbours[m_neighbour_start[v - m_vbase] + n]; }
+
+    static inline int Next(int c) { return c % 3 == 2 ? c - 2 : c + 1; }
+    static inline int Prev(int c) { return c % 3 == 0 ? c + 2 : c - 1; }
+
+private:
+    int m_vbase = 0;
+    array<int> m_master;
+    array<int> m_corner_vert, m_opposite;
+    array<int> m_corner_start, m_corners;
+    array<int> m_neighbour_start, m_neighbours;
+};
+
+} /* namespace lol */
+
@@ -274,47 +274,163 @@ void EasyMesh::Chamfer(float f)
         return;
     }
 
-    int vlen = m_vert.count() - m_cursors.last().m1;
-    int ilen = m_indices.count() - m_cursors.last().m2;
+    int vbase = m_cursors.last().m1;
+    int ibase = m_cursors.last().m2;
+    int ilen = m_indices.count() - ibase;
+
+    MeshTopology topo;
+    topo.Weld(m_vert, vbase);
+    topo.Build(m_indices, ibase, ilen);
+
+    array<vec3> tri_normals;
+    tri_normals.resize(ilen / 3);
+    for (int t = 0; t < ilen / 3; t++)
+    {
+        vec3 v0 = m_vert[m_indices[ibase + t * 3 + 2]].m_coord
+                - m_vert[m_indices[ibase + t * 3]].m_coord;
+        vec3 v1 = m_vert[m_indices[ibase + t * 3 + 1]].m_coord
+                - m_vert[m_indices[ibase + t * 3]].m_coord;
+        tri_normals[t] = normalize(cross(v1, v0));
+    }
 
     /* Step 1: enumerate all faces. This is done by merging triangles
      * that are coplanar and share an edge. */
-    int *triangle_classes = new int[ilen / 3];
-    for (int i = 0; i < ilen / 3; i++)
-        triangle_classes[i] = -1;
+    array<int> triangle_classes, todo;
+    triangle_classes.resize(ilen / 3, -1);
+    int class_count = 0;
+    for (int t = 0; t < ilen / 3; t++)
+    {
+        if (triangle_classes[t] >= 0)
+            continue;
+        triangle_classes[t] = class_count;
+        todo << t;
+        while (todo.count())
+        {
+            int cur = todo.pop();
+            for (int k = 0; k < 3; k++)
+            {
+                int o = topo.GetOpposite(cur * 3 + k);
+                if (o >= 0 && triangle_classes[o / 3] < 0
+                     && 1.f - dot(tri_normals[o / 3], tri_normals[cur]) < .00001f)
+                {
+                    triangle_classes[o / 3] = class_count;
+                    todo << o / 3;
+                }
+            }
+        }
+        ++class_count;
+    }
 
-    for (int i = 0; i < ilen / 3; i++)
+    /* Step 2: give every face its own vertices */
+    array<int> vert_classes;
+    vert_classes.resize(m_vert.count() - vbase, -1);
+    hash_map<uint64_t, int> dups;
+    for (int c = 0; c < ilen; c++)
     {
+        int cl = triangle_classes[c / 3];
+        int v = m_indices[ibase + c];
+        if (vert_classes[v - vbase] < 0)
+            vert_classes[v - vbase] = cl;
+        if (vert_classes[v - vbase] == cl)
+            continue;
 
+        auto it = dups.emplace((uint64_t)v << 32 | (uint32_t)cl, m_vert.count());
+        if (it.second)
+        {
+            AddDupVertex(v);
+            topo.AddVertex(topo.GetMaster(v));
+            vert_classes << cl;
+        }
+        m_indices[ibase + c] = it.first->second;
     }
 
-    /* Fun shit: reduce all triangles */
-    int *vertices = new int[vlen];
-    memset(vertices, 0, vlen * sizeof(int));
-    for (int i = 0; i < ilen; i++)
-        vertices[m_indices[i]]++;
-
-    for (int i = 0; i < ilen / 3; i++)
+    /* Step 3: move the vertices on face borders towards the face centre */
+    array<vec3> centres;
+    array<int> counts;
+    centres.resize(class_count, vec3(0.f));
+    counts.resize(class_count, 0);
+    for (int i = 0; i < vert_classes.count(); i++)
+    {
+        if (vert_classes[i] < 0)
+            continue;
+        centres[vert_classes[i]] += m_vert[vbase + i].m_coord;
+        ++counts[vert_classes[i]];
+    }
 
+    array<vec3> new_coords;
+    new_coords.resize(vert_classes.count());
+    for (int i = 0; i < vert_classes.count(); i++)
     {
-    #if 0
-        if (vertices[m_indices[i * 3]] > 1)
+        int v = vbase + i;
+        vec3 p = new_coords[i] = m_vert[v].m_coord;
+        int cl = vert_classes[i];
+        if (cl < 0)
             continue;
-        if (vertices[m_indices[i * 3 + 1]] > 1)
+
+        int master = topo.GetMaster(v);
+        bool border = false;
+        for (int n = 0; !border && n < topo.GetCornerCount(master); n++)
+            border = triangle_classes[topo.GetCorner(master, n) / 3] != cl;
+        if (border)
+            new_coords[i] = p - normalize(p - centres[cl] / (float)counts[cl]) * f;
+    }
+
+    /* Step 4: bridge the faces with a quad on each of their shared edges */
+    for (int c = 0; c < ilen; c++)
+    {
+        int o = topo.GetOpposite(c);
+        if (o < c || triangle_classes[o / 3] == triangle_classes[c / 3])
             continue;
-        if (vertices[m_indices[i * 3 + 2]] > 1)
+        int a = m_indices[ibase + MeshTopology::Next(c)];
+        int b = m_indices[ibase + MeshTopology::Prev(c)];
+        int a2 = m_indices[ibase + MeshTopology::Prev(o)];
+        int b2 = m_indices[ibase + MeshTopology::Next(o)];
+        AddTriangle(b, a, a2, 0);
+        AddTriangle(b, a2, b2, 0);
+    }
+
+    /* Step 5: close the holes left where three faces or more meet */
+    array<int> ring, ring_classes;
+    for (int i = 0; i < topo.GetVertexCount(); i++)
+    {
+        int v = vbase + i;
+        if (topo.GetMaster(v) != v || !topo.GetCornerCount(v))
             continue;
-    #endif
 
-        vec3 bary = 1.f / 3.f * (m_vert[m_indices[i * 3]].m_coord +
-                                 m_vert[m_indices[i * 3 + 1]].m_coord +
-                                 m_vert[m_indices[i * 3 + 2]].m_coord);
-        for (int k = 0; k < 3; k++)
+        //Walk around the vertex; give up if it is on a mesh border
+        ring.clear();
+        ring_classes.clear();
+        int c0 = topo.GetCorner(v, 0), c = c0, steps = 0;
+        do
         {
-            vec3 &p = m_vert[m_indices[i * 3 + k]].m_coord;
-            p -= normalize(p - bary) * f;
+            int cl = triangle_classes[c / 3];
+            if (!ring_classes.count() || ring_classes.last() != cl)
+            {
+                ring << m_indices[ibase + c];
+                ring_classes << cl;
+            }
+            int o = topo.GetOpposite(MeshTopology::Prev(c));
+            c = o < 0 ? -1 : MeshTopology::Prev(o);
         }
+        while (c >= 0 && c != c0 && ++steps < topo.GetCornerCount(v));
+
+        if (c != c0)
+            continue;
+        if (ring.count() > 1 && ring_classes.last() == ring_classes[0])
+            ring.pop();
+        if (ring.count() < 3)
+            continue;
+
+        /* Walking that way goes clockwise around outward faces, so the
+         * fan is wound backwards. */
+        for (int n = 1; n + 1 < ring.count(); n++)
+            AddTriangle(ring[0], ring[n + 1], ring[n], 0);
     }
+
+    for (int i = 0; i < new_coords.count(); i++)
+        m_vert[vbase + i].m_coord = new_coords[i];
+
+    ComputeNormals(ibase, m_indices.count() - ibase);
 }
 
 //-----------------------------------------------------------------------------
@@ -331,35 +447,53 @@ void EasyMesh::SplitTriangles(int pass)
 }
 
 //-----------------------------------------------------------------------------
-void EasyMesh::SplitTriangles(int pass, VertexDictionnary *vert_dict)
+static inline uint32_t edge_key(int a, int b)
 {
+    return (uint32_t)lol::min(a, b) << 16 | (uint32_t)lol::max(a, b);
+}
+
+void EasyMesh::SplitTriangles(int pass, MeshTopology *topo)
+{
+    hash_map<uint32_t, int> midpoints, masters;
+
     while (pass--)
     {
+        /* Triangles sharing an edge share its midpoint, and midpoints of
+         * edges between welded vertices are welded too. */
+        midpoints.clear();
+        masters.clear();
+
         int trimax = m_indices.count();
         for (int i = m_cursors.last().m2; i < trimax; i += 3)
         {
-            int vbase = m_vert.count();
-            int j = -1;
-            while (++j < 3)
+            int mid[3];
+            for (int j = 0; j < 3; j++)
             {
-                AddLerpVertex(m_indices[i + j], m_indices[i + (j + 1) % 3], .5f);
-                if (vert_dict)
-                    vert_dict->RegisterVertex(vbase + j, m_vert[vbase + j].m_coord);
+                int a = m_indices[i + j], b = m_indices[i + (j + 1) % 3];
+                auto it = midpoints.emplace(edge_key(a, b), m_vert.count());
+                mid[j] = it.first->second;
+                if (!it.second)
+                    continue;
+
+                AddLerpVertex(a, b, .5f);
+                if (topo)
+                    topo->AddVertex(masters.emplace(edge_key(topo->GetMaster(a),
+                                                             topo->GetMaster(b)),
+                                                    mid[j]).first->second);
             }
             //Add new triangles
-            AddTriangle(vbase, m_indices[i + 1], vbase + 1, 0);
-            AddTriangle(vbase + 2, vbase + 1, m_indices[i + 2], 0);
-            AddTriangle(vbase, vbase + 1, vbase + 2, 0);
+            AddTriangle(mid[0], m_indices[i + 1], mid[1], 0);
+            AddTriangle(mid[2], mid[1], m_indices[i + 2], 0);
+            AddTriangle(mid[0], mid[1], mid[2], 0);
             //Change current triangle
-            m_indices[i + 1] = vbase;
-            m_indices[i + 2] = vbase + 2;
+            m_indices[i + 1] = mid[0];
+            m_indices[i + 2] = mid[2];
         }
     }
     ComputeNormals(m_cursors.last().m2, m_indices.count() - m_cursors.last().m2);
 }
 
 //-----------------------------------------------------------------------------
-//TODO : Add an half-edges implementation to refine smooth.
 //TODO : Smooth should only use connected vertices that are on edges of the mesh (See box).
 void EasyMesh::SmoothMesh(int main_pass, int split_per_main_pass, int smooth_per_main_pass)
 {
@@ -370,71 +504,81 @@ void EasyMesh::SmoothMesh(int main_pass, int split_per_main_pass, int smooth_per
         return;
     }
 
-    VertexDictionnary vert_dict;
-    array<vec3> smooth_buf[2];
-    array<int> master_list;
-    array<int> matching_ids;
-    array<int> connected_vert;
-    int smbuf = 0;
+    int vbase = m_cursors.last().m1;
+    int ibase = m_cursors.last().m2;
 
-    for (int i = m_cursors.last().m1; i < m_vert.count(); i++)
-        vert_dict.RegisterVertex(i, m_vert[i].m_coord);
+    /* Vertices are welded once; splitting keeps the welding up to date,
+     * and the connectivity is rebuilt after each split. */
+    MeshTopology topo;
+    topo.Weld(m_vert, vbase);
+
+    array<vec3> smooth_buf[2];
 
     while (main_pass--)
     {
-        int split_pass = split_per_main_pass;
-        int smooth_pass = smooth_per_main_pass;
-
-        SplitTriangles(split_pass, &vert_dict);
-
-        matching_ids.reserve(m_vert.count() - m_cursors.last().m1);
-        connected_vert.reserve(m_vert.count() - m_cursors.last().m1);
-        smooth_buf[0].resize(m_vert.count() - m_cursors.last().m1);
-        smooth_buf[1].resize(m_vert.count() - m_cursors.last().m1);
-
-        for (int i = m_cursors.last().m1; i < m_vert.count(); i++)
-            smooth_buf[smbuf][i - m_cursors.last().m1] = m_vert[i].m_coord;
-
-        while (smooth_pass--)
+        SplitTriangles(split_per_main_pass, &topo);
+        topo.Build(m_indices, ibase, m_indices.count() - ibase);
+        topo.BuildNeighbours();
+
+        int vcount = m_vert.count() - vbase;
+        smooth_buf[0].resize(vcount);
+        smooth_buf[1].resize(vcount);
+        for (int i = 0; i < vcount; i++)
+            smooth_buf[0][i] = m_vert[vbase + i].m_coord;
+
+        int smbuf = 0;
+        for (int smooth_pass = smooth_per_main_pass; smooth_pass--; smbuf = 1 - smbuf)
         {
-            master_list.clear();
-            if (vert_dict.GetMasterList(master_list))
+            array<vec3> const &src = smooth_buf[smbuf];
+            array<vec3> &dst = smooth_buf[1 - smbuf];
+
+            //Move master vertices
+            parallel_for(vcount, [&](int begin, int end)
             {
-                for (int i = 0; i < master_list.count(); i++)
+                for (int i = begin; i < end; i++)
                 {
-                    connected_vert.clear();
-                    if (vert_dict.FindConnectedVertices(master_list[i], m_indices, m_cursors.last().m2, connected_vert))
+                    int v = vbase + i;
+                    int count = topo.GetNeighbourCount(v);
+                    if (topo.GetMaster(v) != v || !count)
                     {
-                        //Calculate vertices sum
-                        vec3 vert_sum = vec3(.0f);
-                        for (int j = 0; j < connected_vert.count(); j++)
-                            vert_sum += smooth_buf[smbuf][connected_vert[j] - m_cursors.last().m1];
-
-                        //Calculate new master vertex
-                        float n = (float)connected_vert.count();
-                        //b(n) = 5/4 - pow(3 + 2 * cos(2.f * F_PI / n), 2) / 32
-                        float beta = 3.f + 2.f * cos(2.f * F_PI / n);
-                        beta = 5.f / 4.f - beta * beta / 32.f;
-                        //a(n) = n * (1 - b(n)) / b(n)
-                        float alpha = (n * (1 - beta)) / beta;
-                        //V = (a(n) * v + v1 + ... + vn) / (a(n) + n)
-                        vec3 new_vert = (alpha * smooth_buf[smbuf][master_list[i] - m_cursors.last().m1] + vert_sum) / (alpha + n);
-
-                        //Set all matching vertices to new value
-                        matching_ids.clear();
-                        matching_ids << master_list[i];
-                        vert_dict.FindMatchingVertices(master_list[i], matching_ids);
-                        for (int j = 0; j < matching_ids.count(); j++)
-                            smooth_buf[1 - smbuf][matching_ids[j] - m_cursors.last().m1] = new_vert;
+                        dst[i] = src[i];
+                        continue;
                     }
+
+                    //Calculate vertices sum
+                    vec3 vert_sum = vec3(.0f);
+                    for (int j = 0; j < count; j++)
+                        vert_sum += src[topo.GetNeighbour(v, j) - vbase];
+
+                    //Calculate new master vertex
+                    float n = (float)count;
+                    //b(n) = 5/4 - pow(3 + 2 * cos(2.f * F_PI / n), 2) / 32
+                    float beta = 3.f + 2.f * cos(2.f * F_PI / n);
+                    beta = 5.f / 4.f - beta * beta / 32.f;
+                    //a(n) = n * (1 - b(n)) / b(n)
+                    float alpha = (n * (1 - beta)) / beta;
+                    //V = (a(n) * v + v1 + ... + vn) / (a(n) + n)
+                    dst[i] = (alpha * src[i] + vert_sum) / (alpha + n);
                 }
-            }
-            smbuf = 1 - smbuf;
+            }, 1024);
+
+            //Set all matching vertices to the new value of their master
+            parallel_for(vcount, [&](int begin, int end)
+            {
+                for (int i = begin; i < end; i++)
+                {
+                    int master = topo.GetMaster(vbase + i);
+                    if (master != vbase + i)
+                        dst[i] = dst[master - vbase];
+                }
+            }, 4096);
         }
 
-        for (int i = 0; i < smooth_buf[smbuf].count(); i++)
-            m_vert[i + m_cursors.last().m1].m_coord = smooth_buf[smbuf][i];
+        for (int i = 0; i < vcount; i++)
+            m_vert[vbase + i].m_coord = smooth_buf[smbuf][i];
     }
+
+    ComputeNormals(ibase, m_indices.count() - ibase);
 }
 
 } /* namespace lol */
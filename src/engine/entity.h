@@ -22,6 +22,7 @@
 
 #include <cstdint>
 
+#include <lol/base/hash_map.h>
 #include <lol/engine/tickable.h>
 
 namespace lol
@@ -96,7 +97,7 @@ inline bool entity::has_flags(entity::flags f) { return (m_flags & f) != flags::
 
 template<typename T> struct entity_dict
 {
-    T *get(std::string const &key)
+    template<typename Q> T *get(Q const &key)
     {
         auto it = m_cache1.find(key);
         return it != m_cache1.end() ? it->second : nullptr;
@@ -112,12 +113,15 @@ template<typename T> struct entity_dict
     void erase(T *entity)
     {
         // FIXME: temporary; we need Ticker::Ref etc.
-        m_cache1.erase(m_cache2[entity]);
-        m_cache2.erase(entity);
+        auto it = m_cache2.find(entity);
+        if (it == m_cache2.end())
+            return;
+        m_cache1.erase(it->second);
+        m_cache2.erase(it);
     }
 
-    std::map<std::string, T*> m_cache1;
-    std::map<T*, std::string> m_cache2;
+    hash_map<std::string, T*> m_cache1;
+    hash_map<T*, std::string> m_cache2;
 };
 
 } /* namespace lol */
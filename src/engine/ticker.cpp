@@ -72,6 +72,9 @@ private:
     array<int> DEPRECATED_m_scenes[(int)tickable::group::all::end];
     int DEPRECATED_nentities = 0;
 
+    /* Scratch memory for collect_garbage() */
+    arena m_gc_arena { 4096 };
+
     /* Fixed framerate management */
     int m_frame = 0, m_recording = 0;
     timer m_timer;
@@ -491,7 +494,8 @@ void ticker_data::collect_garbage()
     /* Garbage collect objects that can be destroyed. We can do this
      * before inserting awaiting objects, because only objects already
      * in the tick lists can be marked for destruction. */
-    array<entity*> destroy_list;
+    m_gc_arena.reset();
+    array<entity*> destroy_list(&m_gc_arena);
     for (int g = 0; g < (int)tickable::group::all::end; ++g)
     {
         for (int i = DEPRECATED_m_list[g].count(); i--;)
@@ -120,5 +120,10 @@ ivec2 Font::GetSize() const
     return data->size;
 }
 
+TileSet *Font::GetTileSet() const
+{
+    return data->tileset;
+}
+
 } /* namespace lol */
 
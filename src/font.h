@@ -23,6 +23,7 @@ namespace lol
 {
 
 class FontData;
+class TileSet;
 
 class Font : public entity
 {
@@ -42,6 +43,7 @@ public:
     /* New methods */
     void Print(Scene &scene, vec3 pos, std::string const &str, vec2 scale = vec2(1.0f), float spacing = 0.0f);
     ivec2 GetSize() const;
+    TileSet *GetTileSet() const;
 
 private:
     FontData *data;
@@ -32,6 +32,11 @@
 // FIXME: fine-tune this define
 #if defined LOL_USE_GLEW || defined HAVE_GL_2X || defined HAVE_GLES_2X
 
+/* Program binaries need OpenGL 4.1 or ARB_get_program_binary */
+#if !defined HAVE_GLES_2X && defined GL_PROGRAM_BINARY_LENGTH
+#   define LOL_SHADER_BINARY 1
+#endif
+
 namespace lol
 {
 
@@ -83,19 +88,33 @@ private:
     std::string m_name;
 
     GLuint prog_id, vert_id, frag_id;
-    // Benlitz: using a simple array could be faster since there is never more than a few attribute locations to store
-    std::map<uint64_t, GLint> attrib_locations;
-    std::map<uint64_t, bool> attrib_errors;
+    hash_map<uint64_t, GLint> attrib_locations;
+    hash_map<uint64_t, bool> attrib_errors;
     size_t vert_crc, frag_crc;
 
+    /* Uniform locations, filled at link time and looked up by name */
+    hash_map<std::string, GLint> uniform_locations;
+
     /* Shader patcher */
     static int GetVersion();
     static std::string Patch(std::string const &code, ShaderType type);
+
+    /* Program binary cache */
+    static std::string BinaryPath(std::string const &vert,
+                                  std::string const &frag, uint64_t &key);
+    bool LoadBinary(std::string const &path, uint64_t key);
+    void SaveBinary(std::string const &path, uint64_t key);
 };
 
 /* Global shader cache */
 static std::set<std::shared_ptr<Shader>> g_shaders;
 
+/* LolFx sources already parsed, with their vertex and fragment code */
+static hash_map<std::string, std::pair<std::string, std::string>> g_lolfx;
+
+/* Where program binaries are stored; empty if disabled */
+static std::string g_binary_dir;
+
 /*
  * LolFx parser
  */
@@ -187,16 +206,24 @@ struct lolfx_parser::action<lolfx_parser::code_section>
 
 std::shared_ptr<Shader> Shader::Create(std::string const &name, std::string const &code)
 {
-    lolfx_parser p(code);
+    auto it = g_lolfx.find(code);
+    if (it == g_lolfx.end())
+    {
+        lolfx_parser p(code);
+
+        ASSERT(has_key(p.m_programs, "vert.glsl"),
+               "no vertex shader in %s", name.c_str());
 
-    ASSERT(has_key(p.m_programs, "vert.glsl"),
-           "no vertex shader in %s", name.c_str());
+        ASSERT(has_key(p.m_programs, "frag.glsl"),
+               "no fragment shader in %s", name.c_str());
 
-    ASSERT(has_key(p.m_programs, "frag.glsl"),
-           "no fragment shader in %s", name.c_str());
+        g_lolfx[code] = std::make_pair(p.m_programs["vert.glsl"],
+                                       p.m_programs["frag.glsl"]);
+        it = g_lolfx.find(code);
+    }
 
-    std::string vert = p.m_programs["vert.glsl"];
-    std::string frag = p.m_programs["frag.glsl"];
+    std::string const &vert = it->second.first;
+    std::string const &frag = it->second.second;
 
     size_t new_vert_crc = std::hash<std::string>{}(vert);
     size_t new_frag_crc = std::hash<std::string>{}(frag);
@@ -205,7 +232,10 @@ std::shared_ptr<Shader> Shader::Create(std::string const &name, std::string cons
     {
         if (shader->data->vert_crc == new_vert_crc
              && shader->data->frag_crc == new_frag_crc)
+        {
+            Profiler::Count(Profiler::COUNTER_SHADER_CACHE_HIT);
             return shader;
+        }
     }
 
     // FIXME: the cache never expires!
@@ -214,80 +244,106 @@ std::shared_ptr<Shader> Shader::Create(std::string const &name, std::string cons
     return ret;
 }
 
+void Shader::SetBinaryCache(std::string const &dir)
+{
+    g_binary_dir = dir;
+}
+
 Shader::Shader(std::string const &name,
                std::string const &vert, std::string const &frag)
   : data(std::make_unique<ShaderData>())
 {
     data->m_name = name;
+    data->vert_id = data->frag_id = 0;
+    data->vert_crc = std::hash<std::string>{}(vert);
+    data->frag_crc = std::hash<std::string>{}(frag);
 
     char errbuf[4096];
-    std::string shader_code;
     GLchar const *gl_code;
     GLint status;
     GLsizei len;
 
-    /* Compile vertex shader */
-    data->vert_crc = std::hash<std::string>{}(vert);
+    std::string vert_code = ShaderData::Patch(vert, ShaderType::Vertex);
+    std::string frag_code = ShaderData::Patch(frag, ShaderType::Fragment);
 
-    shader_code = ShaderData::Patch(vert, ShaderType::Vertex);
-    data->vert_id = glCreateShader(GL_VERTEX_SHADER);
-    gl_code = shader_code.c_str();
-    glShaderSource(data->vert_id, 1, &gl_code, nullptr);
-    glCompileShader(data->vert_id);
+    data->prog_id = glCreateProgram();
 
-    glGetShaderInfoLog(data->vert_id, sizeof(errbuf), &len, errbuf);
-    glGetShaderiv(data->vert_id, GL_COMPILE_STATUS, &status);
-    if (status != GL_TRUE)
+    /* Try the binary cache before compiling anything */
+    uint64_t key = 0;
+    std::string binary_path = ShaderData::BinaryPath(vert_code, frag_code, key);
+    if (binary_path.length() && data->LoadBinary(binary_path, key))
     {
-        msg::error("failed to compile vertex shader %s: %s\n",
-                   name.c_str(), errbuf);
-        msg::error("shader source:\n%s\n", shader_code.c_str());
+        Profiler::Count(Profiler::COUNTER_SHADER_BINARY_HIT);
     }
-    else if (len > 16)
+    else
     {
-        msg::debug("compile log for vertex shader %s: %s\n", name.c_str(), errbuf);
-        msg::debug("shader source:\n%s\n", shader_code.c_str());
-    }
+        Profiler::Count(Profiler::COUNTER_SHADER_COMPILE);
 
-    /* Compile fragment shader */
-    data->frag_crc = std::hash<std::string>{}(frag);
+        /* Compile vertex shader */
+        data->vert_id = glCreateShader(GL_VERTEX_SHADER);
+        gl_code = vert_code.c_str();
+        glShaderSource(data->vert_id, 1, &gl_code, nullptr);
+        glCompileShader(data->vert_id);
 
-    shader_code = ShaderData::Patch(frag, ShaderType::Fragment);
-    data->frag_id = glCreateShader(GL_FRAGMENT_SHADER);
-    gl_code = shader_code.c_str();
-    glShaderSource(data->frag_id, 1, &gl_code, nullptr);
-    glCompileShader(data->frag_id);
+        glGetShaderInfoLog(data->vert_id, sizeof(errbuf), &len, errbuf);
+        glGetShaderiv(data->vert_id, GL_COMPILE_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            msg::error("failed to compile vertex shader %s: %s\n",
+                       name.c_str(), errbuf);
+            msg::error("shader source:\n%s\n", vert_code.c_str());
+        }
+        else if (len > 16)
+        {
+            msg::debug("compile log for vertex shader %s: %s\n", name.c_str(), errbuf);
+            msg::debug("shader source:\n%s\n", vert_code.c_str());
+        }
 
-    glGetShaderInfoLog(data->frag_id, sizeof(errbuf), &len, errbuf);
-    glGetShaderiv(data->frag_id, GL_COMPILE_STATUS, &status);
-    if (status != GL_TRUE)
-    {
-        msg::error("failed to compile fragment shader %s: %s\n",
-                   name.c_str(), errbuf);
-        msg::error("shader source:\n%s\n", shader_code.c_str());
-    }
-    else if (len > 16)
-    {
-        msg::debug("compile log for fragment shader %s: %s\n",
-                   name.c_str(), errbuf);
-        msg::debug("shader source:\n%s\n", shader_code.c_str());
-    }
+        /* Compile fragment shader */
+        data->frag_id = glCreateShader(GL_FRAGMENT_SHADER);
+        gl_code = frag_code.c_str();
+        glShaderSource(data->frag_id, 1, &gl_code, nullptr);
+        glCompileShader(data->frag_id);
 
-    /* Create program */
-    data->prog_id = glCreateProgram();
-    glAttachShader(data->prog_id, data->vert_id);
-    glAttachShader(data->prog_id, data->frag_id);
+        glGetShaderInfoLog(data->frag_id, sizeof(errbuf), &len, errbuf);
+        glGetShaderiv(data->frag_id, GL_COMPILE_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            msg::error("failed to compile fragment shader %s: %s\n",
+                       name.c_str(), errbuf);
+            msg::error("shader source:\n%s\n", frag_code.c_str());
+        }
+        else if (len > 16)
+        {
+            msg::debug("compile log for fragment shader %s: %s\n",
+                       name.c_str(), errbuf);
+            msg::debug("shader source:\n%s\n", frag_code.c_str());
+        }
 
-    glLinkProgram(data->prog_id);
-    glGetProgramInfoLog(data->prog_id, sizeof(errbuf), &len, errbuf);
-    glGetProgramiv(data->prog_id, GL_LINK_STATUS, &status);
-    if (status != GL_TRUE)
-    {
-        msg::error("failed to link program %s: %s\n", name.c_str(), errbuf);
-    }
-    else if (len > 16)
-    {
-        msg::debug("link log for program %s: %s\n", name.c_str(), errbuf);
+        /* Link program */
+        glAttachShader(data->prog_id, data->vert_id);
+        glAttachShader(data->prog_id, data->frag_id);
+
+#if LOL_SHADER_BINARY
+        if (binary_path.length())
+            glProgramParameteri(data->prog_id,
+                                GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+
+        glLinkProgram(data->prog_id);
+        glGetProgramInfoLog(data->prog_id, sizeof(errbuf), &len, errbuf);
+        glGetProgramiv(data->prog_id, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            msg::error("failed to link program %s: %s\n", name.c_str(), errbuf);
+        }
+        else
+        {
+            if (len > 16)
+                msg::debug("link log for program %s: %s\n", name.c_str(), errbuf);
+            if (binary_path.length())
+                data->SaveBinary(binary_path, key);
+        }
     }
 
     GLint validated;
@@ -354,6 +410,38 @@ Shader::Shader(std::string const &name,
     }
 
     delete[] name_buffer;
+
+    /* Resolve all uniform locations now, so that looking them up later
+     * does not need to go through the driver. */
+    GLint num_uniforms;
+    glGetProgramiv(data->prog_id, GL_ACTIVE_UNIFORMS, &num_uniforms);
+
+#if __EMSCRIPTEN__
+    max_len = 256;
+#else
+    glGetProgramiv(data->prog_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_len);
+#endif
+
+    name_buffer = new char[max_len + 1];
+    for (int i = 0; i < num_uniforms; ++i)
+    {
+        GLsizei uniform_len;
+        GLint uniform_size;
+        GLenum uniform_type;
+        glGetActiveUniform(data->prog_id, i, max_len, &uniform_len,
+                           &uniform_size, &uniform_type, name_buffer);
+
+        std::string uniform_name(name_buffer);
+        GLint location = glGetUniformLocation(data->prog_id, name_buffer);
+        data->uniform_locations[uniform_name] = location;
+
+        /* Arrays are listed as “name[0]” but usually looked up as “name” */
+        if (ends_with(uniform_name, "[0]"))
+            data->uniform_locations[uniform_name.substr(0,
+                                   uniform_name.length() - 3)] = location;
+    }
+
+    delete[] name_buffer;
 }
 
 int Shader::GetAttribCount() const
@@ -389,8 +477,22 @@ ShaderUniform Shader::GetUniformLocation(std::string const& uni) const
 }
 ShaderUniform Shader::GetUniformLocation(char const *uni) const
 {
+    Profiler::Count(Profiler::COUNTER_UNIFORM_LOOKUP);
+
+    GLint location;
+    auto it = data->uniform_locations.find(uni);
+    if (it != data->uniform_locations.end())
+        location = it->second;
+    else
+    {
+        /* Not an active uniform, or an array element such as “u_data[3]”;
+         * ask the driver once and remember the answer. */
+        location = glGetUniformLocation(data->prog_id, uni);
+        data->uniform_locations[std::string(uni)] = location;
+    }
+
     ShaderUniform ret;
-    ret.frag = (uintptr_t)glGetUniformLocation(data->prog_id, uni);
+    ret.frag = (uintptr_t)location;
     ret.vert = 0;
     return ret;
 }
@@ -498,13 +600,142 @@ void Shader::Unbind() const
 
 Shader::~Shader()
 {
-    glDetachShader(data->prog_id, data->vert_id);
-    glDetachShader(data->prog_id, data->frag_id);
-    glDeleteShader(data->vert_id);
-    glDeleteShader(data->frag_id);
+    /* Programs loaded from binaries have no shader objects */
+    if (data->vert_id)
+    {
+        glDetachShader(data->prog_id, data->vert_id);
+        glDeleteShader(data->vert_id);
+    }
+    if (data->frag_id)
+    {
+        glDetachShader(data->prog_id, data->frag_id);
+        glDeleteShader(data->frag_id);
+    }
     glDeleteProgram(data->prog_id);
 }
 
+/*
+ * Program binary cache. Binaries are only valid for the driver that
+ * produced them, so the driver identification is part of the key.
+ */
+
+std::string ShaderData::BinaryPath(std::string const &vert,
+                                   std::string const &frag, uint64_t &key)
+{
+#if LOL_SHADER_BINARY
+    if (!g_binary_dir.length())
+        return "";
+
+#   if defined LOL_USE_GLEW && !defined __APPLE__
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+        return "";
+#   endif
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0)
+        return "";
+
+    std::string driver;
+    for (GLenum e : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        char const *str = (char const *)glGetString(e);
+        driver += str ? str : "";
+        driver += '\n';
+    }
+
+    /* Hash the three strings separately so that the separators matter */
+    hash<std::string> h;
+    key = hash_mix(h(driver) ^ hash_mix(h(vert) + 1) ^ hash_mix(h(frag) + 2));
+    return g_binary_dir + "/" + format("%016llx.bin", (unsigned long long)key);
+#else
+    UNUSED(vert, frag, key);
+    return "";
+#endif
+}
+
+/* File layout: “LOLB”, the 64-bit key, the GL binary format, the binary
+ * length, then the binary itself. */
+bool ShaderData::LoadBinary(std::string const &path, uint64_t key)
+{
+#if LOL_SHADER_BINARY
+    File f;
+    f.Open(path, FileAccess::Read, true);
+    if (!f.IsValid())
+        return false;
+
+    char magic[4];
+    uint64_t file_key = 0;
+    uint32_t binary_format = 0, binary_len = 0;
+    bool ok = f.Read((uint8_t *)magic, 4) == 4 && !memcmp(magic, "LOLB", 4)
+           && f.Read((uint8_t *)&file_key, 8) == 8 && file_key == key
+           && f.Read((uint8_t *)&binary_format, 4) == 4
+           && f.Read((uint8_t *)&binary_len, 4) == 4 && binary_len > 0;
+
+    array<uint8_t> binary;
+    if (ok)
+    {
+        binary.resize(binary_len);
+        ok = f.Read(&binary[0], (int)binary_len) == (int)binary_len;
+    }
+    f.Close();
+
+    if (!ok)
+        return false;
+
+    /* The driver may still reject the binary, e.g. after an update */
+    GLint status;
+    glProgramBinary(prog_id, binary_format, &binary[0], binary_len);
+    glGetProgramiv(prog_id, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+#else
+    UNUSED(path, key);
+    return false;
+#endif
+}
+
+void ShaderData::SaveBinary(std::string const &path, uint64_t key)
+{
+#if LOL_SHADER_BINARY
+    GLint binary_len = 0;
+    glGetProgramiv(prog_id, GL_PROGRAM_BINARY_LENGTH, &binary_len);
+    if (binary_len <= 0)
+        return;
+
+    array<uint8_t> binary;
+    binary.resize(binary_len);
+    GLenum binary_format = 0;
+    glGetProgramBinary(prog_id, binary_len, &binary_len, &binary_format,
+                       &binary[0]);
+
+    /* Write to a temporary file first, so that a crash or another
+     * instance sharing the directory never leaves a partial file. */
+    std::string tmp = path + format(".%p.tmp", (void const *)this);
+    File f;
+    f.Open(tmp, FileAccess::Write, true);
+    if (!f.IsValid())
+    {
+        msg::debug("cannot write program binary %s\n", path.c_str());
+        return;
+    }
+
+    uint32_t header[2] = { (uint32_t)binary_format, (uint32_t)binary_len };
+    bool ok = f.Write("LOLB", 4) == 4
+           && f.Write(&key, 8) == 8
+           && f.Write(header, 8) == 8
+           && f.Write(&binary[0], binary_len) == binary_len;
+    f.Close();
+
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        msg::debug("cannot write program binary %s\n", path.c_str());
+        remove(tmp.c_str());
+    }
+#else
+    UNUSED(path, key);
+#endif
+}
+
 /* Try to detect shader compiler features */
 int ShaderData::GetVersion()
 {
@@ -0,0 +1,418 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+/*
+ * Image atlases
+ */
+
+namespace lol
+{
+
+/*
+ * MaxRects bin packing
+ */
+
+rect_packer::rect_packer(ivec2 size)
+  : m_size(size),
+    m_used(0)
+{
+    if (size.x > 0 && size.y > 0)
+        m_free << ibox2(ivec2(0), size);
+}
+
+bool rect_packer::insert(ivec2 size, ibox2 &placed)
+{
+    /* Best short side fit, ties broken by the long side */
+    int best = -1, best_short = INT_MAX, best_long = INT_MAX;
+
+    for (int i = 0; i < m_free.count(); ++i)
+    {
+        ivec2 left = m_free[i].extent() - size;
+        if (left.x < 0 || left.y < 0)
+            continue;
+
+        int s = lol::min(left.x, left.y), l = lol::max(left.x, left.y);
+        if (s < best_short || (s == best_short && l < best_long))
+        {
+            best = i;
+            best_short = s;
+            best_long = l;
+        }
+    }
+
+    if (best < 0)
+        return false;
+
+    placed = ibox2(m_free[best].aa, m_free[best].aa + size);
+    occupy(placed);
+    return true;
+}
+
+void rect_packer::occupy(ibox2 area)
+{
+    m_used += (int64_t)area.extent().x * area.extent().y;
+
+    /* Replace every free rectangle that intersects the area with the
+     * (up to four) maximal rectangles around it. */
+    array<ibox2> split;
+    for (int i = m_free.count(); i--; )
+    {
+        ibox2 const f = m_free[i];
+        if (area.aa.x >= f.bb.x || area.bb.x <= f.aa.x
+             || area.aa.y >= f.bb.y || area.bb.y <= f.aa.y)
+            continue;
+
+        m_free.remove_swap(i);
+
+        if (area.aa.x > f.aa.x)
+            split << ibox2(f.aa, ivec2(area.aa.x, f.bb.y));
+        if (area.bb.x < f.bb.x)
+            split << ibox2(ivec2(area.bb.x, f.aa.y), f.bb);
+        if (area.aa.y > f.aa.y)
+            split << ibox2(f.aa, ivec2(f.bb.x, area.aa.y));
+        if (area.bb.y < f.bb.y)
+            split << ibox2(ivec2(f.aa.x, area.bb.y), f.bb);
+    }
+
+    prune(split);
+}
+
+static inline bool contains(ibox2 const &outer, ibox2 const &inner)
+{
+    return inner.aa.x >= outer.aa.x && inner.aa.y >= outer.aa.y
+        && inner.bb.x <= outer.bb.x && inner.bb.y <= outer.bb.y;
+}
+
+/* Keep the new free rectangles that do not lie inside another one. The
+ * remaining old ones cannot lie inside a new one, since they were already
+ * maximal, so the full quadratic pass is never needed. */
+void rect_packer::prune(array<ibox2> const &split)
+{
+    int const old_count = m_free.count();
+
+    for (int i = 0; i < split.count(); ++i)
+    {
+        bool keep = true;
+        for (int j = 0; keep && j < old_count; ++j)
+            keep = !contains(m_free[j], split[i]);
+        /* Among identical new rectangles, only keep the first one */
+        for (int j = 0; keep && j < split.count(); ++j)
+            keep = j == i || !contains(split[j], split[i])
+                    || (j > i && split[j] == split[i]);
+        if (keep)
+            m_free << split[i];
+    }
+}
+
+float rect_packer::occupancy() const
+{
+    int64_t total = (int64_t)m_size.x * m_size.y;
+    return total ? (float)((double)m_used / total) : 0.f;
+}
+
+/*
+ * Atlas pages
+ */
+
+static int const MAX_MIP_LEVELS = 15;
+
+image_atlas::image_atlas(ivec2 page_size, int padding, int mip_levels)
+  : m_page_size(page_size),
+    m_mip_levels(lol::clamp(mip_levels, 0, MAX_MIP_LEVELS))
+{
+    /* A texel of mip level n covers 2^n texels of the page */
+    m_padding = lol::max(padding, m_mip_levels ? 1 << m_mip_levels : 0);
+}
+
+/* The padded area reserved for a placed rectangle. Its size is a multiple
+ * of the mip alignment, and so is its position because every area given
+ * to the packer has such a size. */
+ibox2 image_atlas::cell(ibox2 const &rect) const
+{
+    int const align = 1 << m_mip_levels;
+    ivec2 size = rect.extent() + ivec2(2 * m_padding);
+    size = (size + ivec2(align - 1)) / align * align;
+    return ibox2(rect.aa - ivec2(m_padding), rect.aa - ivec2(m_padding) + size);
+}
+
+/* Find room for all rectangles in “packer”, largest ones first */
+bool image_atlas::place(rect_packer &packer, array<ibox2> const &rects,
+                        array<ibox2> &placed) const
+{
+    array<int> order;
+    for (int i = 0; i < rects.count(); ++i)
+        order << i;
+
+    std::sort(&order[0], &order[0] + order.count(), [&](int a, int b)
+    {
+        ivec2 sa = rects[a].extent(), sb = rects[b].extent();
+        return lol::max(sa.x, sa.y) > lol::max(sb.x, sb.y);
+    });
+
+    placed.resize(rects.count());
+    for (int i = 0; i < order.count(); ++i)
+    {
+        ivec2 const size = rects[order[i]].extent();
+        ibox2 box;
+        if (!packer.insert(cell(ibox2(ivec2(0), size)).extent(), box))
+            return false;
+        placed[order[i]] = ibox2(box.aa + ivec2(m_padding),
+                                 box.aa + ivec2(m_padding) + size);
+    }
+
+    return true;
+}
+
+int image_atlas::add(std::string const &name, image const &img,
+                     array<ibox2> const &rects)
+{
+    array<ibox2> placed;
+    int page = -1;
+
+    /* Incremental additions go to the first page with enough room */
+    for (int n = 0; n < m_pages.count() && page < 0; ++n)
+    {
+        rect_packer trial = m_pages[n].packer;
+        if (place(trial, rects, placed))
+        {
+            m_pages[n].packer = trial;
+            page = n;
+        }
+    }
+
+    if (page < 0)
+    {
+        rect_packer trial(m_page_size);
+        if (!place(trial, rects, placed))
+            return -1;
+
+        atlas_page p;
+        p.img = image(m_page_size);
+        p.packer = trial;
+        p.version = 0;
+
+        u8vec4 *pixels = p.img.lock<PixelFormat::RGBA_8>();
+        std::fill(pixels, pixels + m_page_size.x * m_page_size.y, u8vec4(0));
+        p.img.unlock(pixels);
+
+        m_pages.push(p);
+        page = m_pages.count() - 1;
+    }
+
+    /* Copy each rectangle and extrude its edges into the whole cell */
+    image src = img;
+    ivec2 const src_size = src.size();
+    u8vec4 const *in = src.lock<PixelFormat::RGBA_8>();
+    u8vec4 *out = m_pages[page].img.lock<PixelFormat::RGBA_8>();
+
+    for (int i = 0; i < rects.count(); ++i)
+    {
+        ivec2 const size = rects[i].extent();
+        if (size.x <= 0 || size.y <= 0)
+            continue;
+
+        ibox2 const area = cell(placed[i]);
+        ivec2 const lo = area.aa - placed[i].aa, hi = area.bb - placed[i].aa;
+        for (int y = lo.y; y < hi.y; ++y)
+        for (int x = lo.x; x < hi.x; ++x)
+        {
+            ivec2 s = rects[i].aa + ivec2(lol::clamp(x, 0, size.x - 1),
+                                          lol::clamp(y, 0, size.y - 1));
+            s = lol::clamp(s, ivec2(0), src_size - ivec2(1));
+            ivec2 d = placed[i].aa + ivec2(x, y);
+            out[d.y * m_page_size.x + d.x] = in[s.y * src_size.x + s.x];
+        }
+    }
+
+    m_pages[page].img.unlock(out);
+    src.unlock(in);
+    ++m_pages[page].version;
+
+    group g;
+    g.name = name;
+    g.page = page;
+    g.rects = placed;
+    m_groups.push(g);
+
+    return m_groups.count() - 1;
+}
+
+int image_atlas::find(std::string const &name) const
+{
+    for (int i = 0; i < m_groups.count(); ++i)
+        if (m_groups[i].name == name)
+            return i;
+    return -1;
+}
+
+float image_atlas::efficiency() const
+{
+    int64_t used = 0;
+    for (auto const &g : m_groups)
+        for (auto const &r : g.rects)
+            used += (int64_t)r.extent().x * r.extent().y;
+
+    int64_t total = (int64_t)m_page_size.x * m_page_size.y * m_pages.count();
+    return total ? (float)((double)used / total) : 0.f;
+}
+
+/*
+ * Persistence. All values are little-endian 32-bit integers: “LOLA”,
+ * version, page size, padding, mip levels, page and group counts, then for each
+ * group its name length, name, page, rectangle count and rectangles,
+ * then the raw RGBA pixels of each page.
+ */
+
+static int const ATLAS_VERSION = 2;
+static int const MAX_NAME = 4096;
+
+bool image_atlas::save(std::string const &path) const
+{
+    File f;
+    f.Open(path, FileAccess::Write, true);
+    if (!f.IsValid())
+        return false;
+
+    array<int32_t> header;
+    header << ATLAS_VERSION << m_page_size.x << m_page_size.y << m_padding
+           << m_mip_levels << m_pages.count() << m_groups.count();
+
+    bool ok = f.Write("LOLA", 4) == 4;
+    ok &= f.Write(&header[0], 4 * header.count()) == 4 * header.count();
+
+    for (auto const &g : m_groups)
+    {
+        array<int32_t> data;
+        data << (int32_t)g.name.length();
+        ok &= f.Write(&data[0], 4) == 4;
+        ok &= f.Write(g.name) == (int)g.name.length();
+
+        data.clear();
+        data << g.page << g.rects.count();
+        for (auto const &r : g.rects)
+            data << r.aa.x << r.aa.y << r.bb.x << r.bb.y;
+        ok &= f.Write(&data[0], 4 * data.count()) == 4 * data.count();
+    }
+
+    int const bytes = m_page_size.x * m_page_size.y * 4;
+    for (auto const &p : m_pages)
+    {
+        image tmp = p.img;
+        u8vec4 const *pixels = tmp.lock<PixelFormat::RGBA_8>();
+        ok &= f.Write(pixels, bytes) == bytes;
+        tmp.unlock(pixels);
+    }
+
+    f.Close();
+    return ok;
+}
+
+bool image_atlas::load(std::string const &path)
+{
+    File f;
+    f.Open(path, FileAccess::Read, true);
+    if (!f.IsValid())
+        return false;
+
+    auto read_int = [&](int32_t &x)
+    {
+        return f.Read((uint8_t *)&x, 4) == 4;
+    };
+
+    /* Pages must be addressable with an int byte count */
+    char magic[4];
+    int32_t version, width, height, padding, mip_levels, pages, groups;
+    bool ok = f.Read((uint8_t *)magic, 4) == 4 && !memcmp(magic, "LOLA", 4)
+           && read_int(version) && version == ATLAS_VERSION
+           && read_int(width) && read_int(height) && width > 0 && height > 0
+           && (int64_t)width * height <= INT_MAX / 4
+           && read_int(padding) && padding >= 0
+           && padding <= width && padding <= height
+           && read_int(mip_levels) && mip_levels >= 0
+           && mip_levels <= MAX_MIP_LEVELS
+           && (!mip_levels || padding >= 1 << mip_levels)
+           && read_int(pages) && pages >= 0
+           && read_int(groups) && groups >= 0;
+
+    array<group> new_groups;
+    array<atlas_page> new_pages;
+
+    for (int i = 0; ok && i < groups; ++i)
+    {
+        group g;
+        int32_t len, count;
+        ok = read_int(len) && len >= 0 && len <= MAX_NAME;
+        if (ok && len > 0)
+        {
+            g.name.resize(len);
+            ok = f.Read((uint8_t *)&g.name[0], len) == len;
+        }
+        ok = ok && read_int(g.page) && g.page >= 0 && g.page < pages
+                && read_int(count) && count >= 0;
+        for (int j = 0; ok && j < count; ++j)
+        {
+            ibox2 r;
+            ok = read_int(r.aa.x) && read_int(r.aa.y)
+              && read_int(r.bb.x) && read_int(r.bb.y)
+              && r.aa.x >= 0 && r.aa.y >= 0 && r.aa.x <= r.bb.x
+              && r.aa.y <= r.bb.y && r.bb.x <= width && r.bb.y <= height;
+            g.rects << r;
+        }
+        new_groups.push(g);
+    }
+
+    int const bytes = width * height * 4;
+    for (int n = 0; ok && n < pages; ++n)
+    {
+        atlas_page p;
+        p.img = image(ivec2(width, height));
+        p.packer = rect_packer(ivec2(width, height));
+        p.version = 1;
+
+        u8vec4 *pixels = p.img.lock<PixelFormat::RGBA_8>();
+        ok = f.Read((uint8_t *)pixels, bytes) == bytes;
+        p.img.unlock(pixels);
+        new_pages.push(p);
+    }
+
+    f.Close();
+    if (!ok)
+        return false;
+
+    m_page_size = ivec2(width, height);
+    m_padding = padding;
+    m_mip_levels = mip_levels;
+
+    /* Rebuild the free space of each page from the saved rectangles */
+    for (auto const &g : new_groups)
+        for (auto const &r : g.rects)
+        {
+            ibox2 const area = cell(r);
+            new_pages[g.page].packer.occupy(
+                ibox2(lol::max(area.aa, ivec2(0)),
+                      lol::min(area.bb, m_page_size)));
+        }
+
+    m_groups = new_groups;
+    m_pages = new_pages;
+    return true;
+}
+
+} /* namespace lol */
+
@@ -0,0 +1,240 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#if defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
+/*
+ * Batch colour conversion kernels. These work on arrays of RGBA pixels
+ * and produce the same results as the scalar Color:: functions, up to
+ * floating point rounding.
+ */
+
+namespace lol
+{
+
+/* Apply dst.rgb = m * src.rgb + offset to count pixels, optionally
+ * clamping to [0, 1]; alpha is copied through. The SSE version transposes
+ * groups of four pixels into structure-of-arrays form so that each
+ * instruction computes one channel of four pixels at once. */
+static void transform_rgb(vec4 *dst, vec4 const *src, size_t count,
+                          mat3 const &m, vec3 const &offset, bool clamp01)
+{
+    size_t n = 0;
+
+#if defined __SSE__
+    __m128 const m00 = _mm_set1_ps(m[0][0]), m01 = _mm_set1_ps(m[0][1]),
+                 m02 = _mm_set1_ps(m[0][2]), m10 = _mm_set1_ps(m[1][0]),
+                 m11 = _mm_set1_ps(m[1][1]), m12 = _mm_set1_ps(m[1][2]),
+                 m20 = _mm_set1_ps(m[2][0]), m21 = _mm_set1_ps(m[2][1]),
+                 m22 = _mm_set1_ps(m[2][2]);
+    __m128 const o0 = _mm_set1_ps(offset.x), o1 = _mm_set1_ps(offset.y),
+                 o2 = _mm_set1_ps(offset.z);
+    __m128 const zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+
+    for (; n + 4 <= count; n += 4)
+    {
+        __m128 r = _mm_loadu_ps(&src[n].x);
+        __m128 g = _mm_loadu_ps(&src[n + 1].x);
+        __m128 b = _mm_loadu_ps(&src[n + 2].x);
+        __m128 a = _mm_loadu_ps(&src[n + 3].x);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        __m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, m00),
+                                         _mm_mul_ps(g, m10)),
+                              _mm_add_ps(_mm_mul_ps(b, m20), o0));
+        __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, m01),
+                                         _mm_mul_ps(g, m11)),
+                              _mm_add_ps(_mm_mul_ps(b, m21), o1));
+        __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, m02),
+                                         _mm_mul_ps(g, m12)),
+                              _mm_add_ps(_mm_mul_ps(b, m22), o2));
+
+        if (clamp01)
+        {
+            x = _mm_min_ps(_mm_max_ps(x, zero), one);
+            y = _mm_min_ps(_mm_max_ps(y, zero), one);
+            z = _mm_min_ps(_mm_max_ps(z, zero), one);
+        }
+
+        _MM_TRANSPOSE4_PS(x, y, z, a);
+        _mm_storeu_ps(&dst[n].x, x);
+        _mm_storeu_ps(&dst[n + 1].x, y);
+        _mm_storeu_ps(&dst[n + 2].x, z);
+        _mm_storeu_ps(&dst[n + 3].x, a);
+    }
+#endif
+
+    for (; n < count; ++n)
+    {
+        vec3 tmp = m * src[n].rgb + offset;
+        dst[n] = vec4(clamp01 ? clamp(tmp, 0.f, 1.f) : tmp, src[n].a);
+    }
+}
+
+/*
+ * sRGB transfer functions
+ */
+
+static inline float srgb_to_linear(float x)
+{
+    static float const k = 1.f / pow(1.055f, 2.4f);
+    return x > 0.04045f ? pow(x + 0.055f, 2.4f) * k : x * (1.f / 12.92f);
+}
+
+static inline float linear_to_srgb(float x)
+{
+    return x > 0.0031308f ? 1.055f * pow(x, 1.f / 2.4f) - 0.055f
+                          : 12.92f * x;
+}
+
+/* There are only 256 possible 8-bit inputs, so tabulate them */
+struct srgb_table
+{
+    srgb_table()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            to_linear[i] = srgb_to_linear(i / 255.f);
+            to_float[i] = i / 255.f;
+        }
+    }
+
+    float to_linear[256], to_float[256];
+};
+
+static srgb_table const &get_srgb_table()
+{
+    static srgb_table const table;
+    return table;
+}
+
+void Color::sRGBToLinearRGB(vec4 *dst, vec4 const *src, size_t count)
+{
+    for (size_t n = 0; n < count; ++n)
+        dst[n] = vec4(srgb_to_linear(src[n].r), srgb_to_linear(src[n].g),
+                      srgb_to_linear(src[n].b), src[n].a);
+}
+
+void Color::sRGBToLinearRGB(vec4 *dst, u8vec4 const *src, size_t count)
+{
+    srgb_table const &t = get_srgb_table();
+    for (size_t n = 0; n < count; ++n)
+        dst[n] = vec4(t.to_linear[src[n].r], t.to_linear[src[n].g],
+                      t.to_linear[src[n].b], t.to_float[src[n].a]);
+}
+
+void Color::LinearRGBTosRGB(vec4 *dst, vec4 const *src, size_t count)
+{
+    for (size_t n = 0; n < count; ++n)
+        dst[n] = vec4(linear_to_srgb(src[n].r), linear_to_srgb(src[n].g),
+                      linear_to_srgb(src[n].b), src[n].a);
+}
+
+/*
+ * Linear conversions; the YUV scaling and offsets are folded into the
+ * matrix so that every pixel costs a single affine transform.
+ */
+
+void Color::RGBToYUV(vec4 *dst, vec4 const *src, size_t count)
+{
+    mat3 m(vec3(0.299f * 220.f / 255.f, -0.14713f,  0.615f),
+           vec3(0.587f * 220.f / 255.f, -0.28886f, -0.51499f),
+           vec3(0.114f * 220.f / 255.f,  0.436f,   -0.10001f));
+    transform_rgb(dst, src, count, m, vec3(16.f / 255.f, 0.5f, 0.5f), true);
+}
+
+void Color::YUVToRGB(vec4 *dst, vec4 const *src, size_t count)
+{
+    mat3 m(vec3(1.f,       1.f,      1.f),
+           vec3(0.f,      -0.39465f, 2.03211f),
+           vec3(1.13983f, -0.58060f, 0.f));
+    vec3 offset = m * vec3(-16.f / 220.f, -0.5f, -0.5f);
+    m[0] *= 255.f / 220.f;
+    transform_rgb(dst, src, count, m, offset, true);
+}
+
+void Color::LinearRGBToCIEXYZ(vec4 *dst, vec4 const *src, size_t count)
+{
+    mat3 m(vec3(41.24f, 21.26f,  1.93f),
+           vec3(35.76f, 71.52f, 11.92f),
+           vec3(18.05f,  7.22f, 95.05f));
+    transform_rgb(dst, src, count, m, vec3(0.f), false);
+}
+
+void Color::CIEXYZToLinearRGB(vec4 *dst, vec4 const *src, size_t count)
+{
+    mat3 m(vec3( 0.032406f, -0.009689f,  0.000557f),
+           vec3(-0.015372f,  0.018758f, -0.002040f),
+           vec3(-0.004986f,  0.000415f,  0.010570f));
+    transform_rgb(dst, src, count, m, vec3(0.f), false);
+}
+
+/*
+ * Non-linear conversions: these are branchy and stay scalar, but are
+ * inlined in a single loop instead of being called once per pixel.
+ */
+
+void Color::RGBToHSV(vec4 *dst, vec4 const *src, size_t count)
+{
+    for (size_t n = 0; n < count; ++n)
+        dst[n] = RGBToHSV(src[n]);
+}
+
+void Color::HSVToRGB(vec4 *dst, vec4 const *src, size_t count)
+{
+    for (size_t n = 0; n < count; ++n)
+        dst[n] = HSVToRGB(src[n]);
+}
+
+void Color::CIEXYZToCIELab(vec4 *dst, vec4 const *src, size_t count)
+{
+    float const a = (6.0f * 6.0f * 6.0f) / (29 * 29 * 29);
+    float const b = (29.0f * 29.0f) / (3 * 6 * 6);
+    float const c = 4.0f / 29;
+    vec3 const inv_white = vec3(1.f) / vec3(95.047f, 100.f, 108.883f);
+
+    for (size_t n = 0; n < count; ++n)
+    {
+        vec3 t = src[n].rgb * inv_white;
+        vec3 f(t.x > a ? std::cbrt(t.x) : b * t.x + c,
+               t.y > a ? std::cbrt(t.y) : b * t.y + c,
+               t.z > a ? std::cbrt(t.z) : b * t.z + c);
+        dst[n] = vec4(116.f * f.y - 16.f, 500.f * (f.x - f.y),
+                      200.f * (f.y - f.z), src[n].a);
+    }
+}
+
+void Color::LinearRGBToCIELab(vec4 *dst, vec4 const *src, size_t count)
+{
+    /* Work in small chunks so that the intermediate XYZ values
+     * stay in the L1 cache. */
+    for (size_t n = 0; n < count; n += 256)
+    {
+        size_t todo = lol::min(count - n, (size_t)256);
+        LinearRGBToCIEXYZ(dst + n, src + n, todo);
+        CIEXYZToCIELab(dst + n, dst + n, todo);
+    }
+}
+
+void Color::DistanceCIEDE2000(float *dst, vec3 const *lab, vec3 ref,
+                              size_t count)
+{
+    for (size_t n = 0; n < count; ++n)
+        dst[n] = DistanceCIEDE2000(lab[n], ref);
+}
+
+} /* namespace lol */
+
@@ -14,6 +14,14 @@
 
 /*
  * Direct Binary Search dithering
+ *
+ * This follows the efficient formulation from Analoui and Allebach,
+ * “Model-based halftoning using direct binary search” (1992): instead of
+ * convolving the error with the human visual system (HVS) filter for
+ * every candidate change, we maintain the cross-correlation c_ep of the
+ * error with the autocorrelation c_pp of the filter. The perceived error
+ * delta of a toggle or a swap then only costs a few lookups, and c_ep
+ * needs to be updated only when a change is actually applied.
  */
 
 #define CELL 16
@@ -21,166 +29,278 @@
 #define N 7
 #define NN ((N * 2 + 1))
 
+/* The autocorrelation of the HVS filter has twice its radius */
+#define R (N * 2)
+#define RR ((R * 2 + 1))
+
 namespace lol
 {
 
-/* FIXME: though the algorithm is supposed to stop, we do not have a real,
- * guaranteed stop condition here. */
-image image::dither_dbs() const
+/* Cells are processed concurrently when they are three cells apart in
+ * both directions. A change in a cell affects c_ep up to R + 1 pixels
+ * away from it, so this requires the cells to be larger than that. */
+static_assert(CELL > R + 1, "DBS cells are too small for the HVS filter");
+
+image image::dither_dbs(int max_passes, float tolerance,
+                        array<dbs_pass> *stats) const
 {
-    ivec2 isize = size();
+    ivec2 const isize = size();
+
+    /* Our human visual system filter is the sum of two separable
+     * gaussians g1 and g2. Its autocorrelation is thus the sum of the
+     * separable terms h11, h22 and twice h12, where hab = ga ⋆ gb. */
+    float g1[NN], g2[NN], t = 0.f;
+    for (int i = 0; i < NN; i++)
+    {
+        g1[i] = exp(-sq((i - N) / 1.6f) / 2.f);
+        g2[i] = exp(-sq((i - N) / 0.6f) / 2.f);
+    }
 
-    /* Build our human visual system kernel. */
-    array2d<float> ker;
-    ker.resize(ivec2(NN, NN));
-    float t = 0.f;
     for (int j = 0; j < NN; j++)
         for (int i = 0; i < NN; i++)
+            t += g1[i] * g1[j] + g2[i] * g2[j];
+
+    float h[3][RR];
+    for (int k = 0; k < RR; k++)
+    {
+        h[0][k] = h[1][k] = h[2][k] = 0.f;
+        for (int i = lol::max(0, k - R); i < lol::min(NN, k - R + NN); i++)
         {
-            vec2 v = vec2((float)(i - N), (float)(j - N));
-            ker[i][j] = exp(-sqlength(v / 1.6f) / 2.f)
-                      + exp(-sqlength(v / 0.6f) / 2.f);
-            t += ker[i][j];
+            h[0][k] += g1[i] * g1[i + R - k];
+            h[1][k] += g2[i] * g2[i + R - k];
+            h[2][k] += g1[i] * g2[i + R - k];
         }
+    }
+    float const weights[3] = { 1.f / (t * t), 1.f / (t * t), 2.f / (t * t) };
 
-    for (int j = 0; j < NN; j++)
-        for (int i = 0; i < NN; i++)
-            ker[i][j] /= t;
-
-    /* A list of cells in our picture. If no change is done to a cell
-     * for two iterations, we stop considering changes to it. */
-    ivec2 const csize = (isize + ivec2(CELL - 1)) / CELL;
-    array2d<int> changelist(csize);
-    memset(changelist.data(), 0, changelist.bytes());
+    float cpp[RR][RR];
+    for (int j = 0; j < RR; j++)
+        for (int i = 0; i < RR; i++)
+            cpp[j][i] = weights[0] * h[0][i] * h[0][j]
+                      + weights[1] * h[1][i] * h[1][j]
+                      + weights[2] * h[2][i] * h[2][j];
 
     image dst = *this;
     dst.set_format(PixelFormat::Y_F32);
 
-    image tmp1 = dst.Convolution(ker);
-    array2d<float> &tmp1data = tmp1.lock2d<PixelFormat::Y_F32>();
+    image src = dst;
+    float const *srcdata = src.lock<PixelFormat::Y_F32>();
 
     dst = dst.dither_random();
-    array2d<float> &dstdata = dst.lock2d<PixelFormat::Y_F32>();
+    float *dstdata = dst.lock<PixelFormat::Y_F32>();
 
-    image tmp2 = dst.Convolution(ker);
-    array2d<float> &tmp2data = tmp2.lock2d<PixelFormat::Y_F32>();
+    int const w = isize.x;
+    auto offset = [w](ivec2 pos) { return (ptrdiff_t)pos.y * w + pos.x; };
 
-    for (int run = 0, last_change = 0; ; ++run)
+    /* Compute c_ep = c_pp * (dst - src), one separable term at a time */
+    array<float> cep, tmp;
+    cep.resize(w * isize.y, 0.f);
+    tmp.resize(w * isize.y);
+
+    for (int n = 0; n < 3; n++)
     {
-        int const cell = run % (csize.x * csize.y);
-        int const cx = cell % csize.x;
-        int const cy = cell / csize.x;
+        parallel_for(isize.y, [&](int begin, int end)
+        {
+            for (int y = begin; y < end; y++)
+            {
+                float const *d = dstdata + (ptrdiff_t)y * w;
+                float const *s = srcdata + (ptrdiff_t)y * w;
+                for (int x = 0; x < w; x++)
+                {
+                    float sum = 0.f;
+                    int kmin = lol::max(-R, -x);
+                    int kmax = lol::min(R, w - 1 - x);
+                    for (int k = kmin; k <= kmax; k++)
+                        sum += h[n][k + R] * (d[x + k] - s[x + k]);
+                    tmp[offset(ivec2(x, y))] = sum;
+                }
+            }
+        }, 16);
 
-        /* Bail out if no change was done for the last full image run */
-        if (run > last_change + csize.x * csize.y)
-            break;
+        parallel_for(isize.y, [&](int begin, int end)
+        {
+            for (int y = begin; y < end; y++)
+            {
+                int kmin = lol::max(-R, -y);
+                int kmax = lol::min(R, isize.y - 1 - y);
+                for (int x = 0; x < w; x++)
+                {
+                    float sum = 0.f;
+                    for (int k = kmin; k <= kmax; k++)
+                        sum += h[n][k + R] * tmp[offset(ivec2(x, y + k))];
+                    cep[offset(ivec2(x, y))] += weights[n] * sum;
+                }
+            }
+        }, 16);
+    }
 
-        /* Skip cell if it was already ignored twice */
-        if (changelist[cx][cy] >= 2)
-            continue;
+    /* The perceived error is the dot product of the error with c_ep */
+    double error = 0.0;
+    for (int n = 0; n < w * isize.y; n++)
+        error += (dstdata[n] - srcdata[n]) * cep[n];
 
+    /* Add a0 × c_pp(· − pos) to c_ep */
+    auto update = [&](ivec2 pos, float a0)
+    {
+        int imin = lol::max(-R, -pos.x), imax = lol::min(R, w - 1 - pos.x);
+        int jmin = lol::max(-R, -pos.y), jmax = lol::min(R, isize.y - 1 - pos.y);
+        for (int j = jmin; j <= jmax; j++)
+        {
+            float *line = &cep[offset(pos + ivec2(0, j))];
+            for (int i = imin; i <= imax; i++)
+                line[i] += a0 * cpp[j + R][i + R];
+        }
+    };
+
+    /* Try all possible toggle and swaps for every pixel of a cell, apply
+     * the best one, and return the number of changes and the gain. */
+    auto process_cell = [&](ivec2 cell, double &gain)
+    {
+        static ivec2 const op_list[] =
+        {
+            { 0, 1 },   { 0, -1 }, { -1, 0 }, { 1, 0 },
+            { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 },
+        };
+
+        float const c0 = cpp[R][R];
         int changes = 0;
 
         for (int pixel = 0; pixel < CELL * CELL; ++pixel)
         {
-            ivec2 const pos(cx * CELL + pixel % CELL,
-                            cy * CELL + pixel / CELL);
+            ivec2 const pos(cell.x * CELL + pixel % CELL,
+                            cell.y * CELL + pixel / CELL);
 
-            if (!(pos >= ivec2(0)) || !(pos < isize))
+            if (!(pos < isize))
                 continue;
 
-            /* The best operation we can do */
-            ivec2 best_op(0);
-            float best_error = 0.f;
-
-            float d = dstdata[pos];
+            float const d = dstdata[offset(pos)];
+            float const e = cep[offset(pos)];
 
-            /* Compute the effect of all possible toggle and swaps */
-            static ivec2 const op_list[] =
-            {
-                { 0, 0 },
-                { 0, 1 },   { 0, -1 }, { -1, 0 }, { 1, 0 },
-                { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 },
-            };
+            /* Toggling is the default operation */
+            ivec2 best_op(0);
+            float a0 = 1.f - 2.f * d;
+            float best_error = -(a0 * a0 * c0 + 2.f * a0 * e);
 
-            for (ivec2 const op : op_list)
+            for (ivec2 const &op : op_list)
             {
-                if (!(pos + op >= ivec2(0)) || !(pos + op < isize))
+                ivec2 const pos2 = pos + op;
+                if (!(pos2 >= ivec2(0)) || !(pos2 < isize))
                     continue;
 
-                bool flip = (op == ivec2(0));
-
-                float d2 = flip ? 1 - d : dstdata[pos + op];
-
-                if (!flip && d2 == d)
+                float const d2 = dstdata[offset(pos2)];
+                if (d2 == d)
                     continue;
 
-                /* TODO: implement min/max for 3+ arguments */
-                int imin = max(max(-N, op.x - N), -pos.x);
-                int imax = min(min(N + 1, op.x + NN - N), isize.x - pos.x);
-                int jmin = max(max(-N, op.y - N), -pos.y);
-                int jmax = min(min(N + 1, op.y + NN - N), isize.y - pos.y);
+                float a = d2 - d;
+                float delta_error = 2.f * a * a * (cpp[op.y + R][op.x + R] - c0)
+                                  - 2.f * a * (e - cep[offset(pos2)]);
 
-                float error = 0.f;
-                for (int j = jmin; j < jmax; j++)
-                for (int i = imin; i < imax; i++)
+                if (delta_error > best_error)
                 {
-                    ivec2 pos2 = pos + ivec2(i, j);
-
-                    float m = ker[i + N][j + N];
-                    if (!flip)
-                        m -= ker[i - op.x + N][j - op.y + N];
-                    float p = tmp1data[pos2];
-                    float q1 = tmp2data[pos2];
-                    float q2 = q1 + m * (d2 - d);
-                    error += sq(q1 - p) - sq(q2 - p);
-                }
-
-                if (error > best_error)
-                {
-                    best_error = error;
+                    best_error = delta_error;
                     best_op = op;
                 }
             }
 
             /* Only apply the change if interesting */
-            if (best_error > 0.f)
+            if (best_error <= 0.f)
+                continue;
+
+            if (best_op == ivec2(0))
+            {
+                dstdata[offset(pos)] = 1.f - d;
+                update(pos, a0);
+            }
+            else
             {
-                bool flip = (best_op == ivec2(0));
+                ivec2 const pos2 = pos + best_op;
+                float const d2 = dstdata[offset(pos2)];
+                dstdata[offset(pos)] = d2;
+                dstdata[offset(pos2)] = d;
+                update(pos, d2 - d);
+                update(pos2, d - d2);
+            }
 
-                float d2 = flip ? 1 - d : dstdata[pos + best_op];
-                dstdata[pos + best_op] = d;
-                dstdata[pos] = d2;
+            gain += best_error;
+            ++changes;
+        }
 
-                for (int j = -N; j <= N; j++)
-                for (int i = -N; i <= N; i++)
-                {
-                    ivec2 off(i, j);
-                    float delta = (d2 - d) * ker[i + N][j + N];
+        return changes;
+    };
+
+    /* Only cells that changed, or whose neighbours changed, during the
+     * previous pass can still be improved. */
+    ivec2 const csize = (isize + ivec2(CELL - 1)) / CELL;
+    array2d<uint8_t> dirty(csize), next_dirty(csize);
+    memset(dirty.data(), 1, dirty.bytes());
 
-                    if (pos + off >= ivec2(0) && pos + off < isize)
-                        tmp2data[pos + off] += delta;
+    array2d<int> changelist(csize);
+    array2d<double> gainlist(csize);
+
+    if (stats)
+        stats->clear();
 
-                    if (!flip && pos + off + best_op >= ivec2(0)
-                         && pos + off + best_op < isize)
-                        tmp2data[pos + off + best_op] -= delta;
+    for (int pass = 0; pass < max_passes; ++pass)
+    {
+        memset(next_dirty.data(), 0, next_dirty.bytes());
+        memset(changelist.data(), 0, changelist.bytes());
+        memset(gainlist.data(), 0, gainlist.bytes());
+
+        int cells = 0;
+        for (int phase = 0; phase < 9; ++phase)
+        {
+            array<ivec2> todo;
+            for (int cy = phase / 3; cy < csize.y; cy += 3)
+                for (int cx = phase % 3; cx < csize.x; cx += 3)
+                    if (dirty[cx][cy])
+                        todo.push(ivec2(cx, cy));
+
+            parallel_for(todo.count(), [&](int begin, int end)
+            {
+                for (int n = begin; n < end; ++n)
+                {
+                    ivec2 const cell = todo[n];
+                    int changes = process_cell(cell, gainlist[cell]);
+                    changelist[cell] = changes;
+                    if (!changes)
+                        continue;
+
+                    /* Cells of the same phase are far enough apart for
+                     * these neighbourhoods not to overlap. */
+                    for (int j = -1; j <= 1; ++j)
+                        for (int i = -1; i <= 1; ++i)
+                        {
+                            ivec2 c = cell + ivec2(i, j);
+                            if (c >= ivec2(0) && c < csize)
+                                next_dirty[c] = 1;
+                        }
                 }
+            });
 
-                ++changes;
-                last_change = run;
-            }
+            cells += todo.count();
         }
 
-        if (changes == 0)
-            ++changelist[cx][cy];
+        int changes = 0;
+        for (int cy = 0; cy < csize.y; ++cy)
+            for (int cx = 0; cx < csize.x; ++cx)
+            {
+                changes += changelist[cx][cy];
+                error -= gainlist[cx][cy];
+            }
+
+        if (stats)
+            stats->push(dbs_pass{ changes, cells, (float)error });
+
+        if (changes <= tolerance * isize.x * isize.y)
+            break;
+
+        std::swap(dirty, next_dirty);
     }
 
-    tmp1.unlock2d(tmp1data);
-    tmp2.unlock2d(tmp2data);
-    dst.unlock2d(dstdata);
+    src.unlock(srcdata);
+    dst.unlock(dstdata);
 
     return dst;
 }
 
 } /* namespace lol */
-
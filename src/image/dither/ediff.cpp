@@ -12,6 +12,8 @@
 
 #include <lol/engine-internal.h>
 
+#include "wavefront-private.h"
+
 /*
  * Generic error diffusion functions
  */
@@ -22,9 +24,14 @@ namespace lol
 /* Perform a generic error diffusion dithering. The first non-zero
  * element in ker is treated as the current pixel. All other non-zero
  * elements are the error diffusion coefficients.
- * Making the matrix generic is not terribly slower: the performance
- * hit is around 4% for Floyd-Steinberg and 13% for JaJuNi, with the
- * benefit of a lot less code. */
+ *
+ * Instead of pushing each pixel’s error to its neighbours, every pixel
+ * pulls the errors of the already processed pixels that affect it, in
+ * the exact order the push version would have added them. The result is
+ * thus bit-identical to the classic serial loop, but a row only depends
+ * on a few pixels of the rows above, which allows for wavefront-parallel
+ * processing: each row trails the previous one by the kernel’s reach.
+ * The kernel is flattened into a list of non-zero taps beforehand. */
 image image::dither_ediff(array2d<float> const &ker, ScanMode scan) const
 {
     image dst = *this;
@@ -37,36 +44,91 @@ image image::dither_ediff(array2d<float> const &ker, ScanMode scan) const
         if (ker[kx][0] > 0.f)
             break;
 
-    float *pixels = dst.lock<PixelFormat::Y_F32>();
-    for (int y = 0; y < isize.y; y++)
+    /* Taps are ordered by source row, then by source scan order, which
+     * is decreasing i regardless of the scan direction. */
+    struct tap { int j, dx; float weight; };
+    array<tap> taps;
+    for (int j = ksize.y - 1; j >= 0; j--)
+        for (int i = ksize.x - 1; i >= 0; i--)
+            if ((j > 0 || i > kx) && ker[i][j] != 0.f)
+                taps.push(tap{ j, i - kx, ker[i][j] });
+
+    int const w = isize.x;
+    int const reach = lol::max(kx, ksize.x - 1 - kx);
+
+    auto reversed = [&](int y)
     {
-        bool reverse = (y & 1) && (scan == ScanMode::Serpentine);
+        return (y & 1) && scan == ScanMode::Serpentine;
+    };
 
-        for (int x = 0; x < isize.x; x++)
-        {
-            int x2 = reverse ? isize.x - 1 - x : x;
-            int s = reverse ? -1 : 1;
+    array<float> errors;
+    errors.resize(isize.x * isize.y);
 
-            float p = pixels[y * isize.x + x2];
-            float q = p < 0.5f ? 0.f : 1.f;
-            pixels[y * isize.x + x2] = q;
+    float *pixels = dst.lock<PixelFormat::Y_F32>();
+    wavefront wf(isize.y);
 
-            float e = (p - q);
+    wf.run([&](int y)
+    {
+        int const s = reversed(y) ? -1 : 1;
+        float *line = pixels + (ptrdiff_t)y * w;
+        float *eline = errors.data() + (ptrdiff_t)y * w;
 
-            for (int j = 0; j < ksize.y && y < isize.y - j; j++)
-                for (int i = 0; i < ksize.x; i++)
+        /* How far each of the rows above is known to have progressed */
+        array<int> known;
+        known.resize(ksize.y, 0);
+        int const rows = lol::min(ksize.y - 1, y);
+
+        for (int x = 0; x < w; x++)
+        {
+            int x2 = s < 0 ? w - 1 - x : x;
+
+            /* Wait for all sources of this pixel in the rows above */
+            for (int j = 1; j <= rows; j++)
+            {
+                int need = reversed(y - j) ? w - lol::max(0, x2 - kx)
+                                           : lol::min(w, x2 + kx + 1);
+                if (known[j - 1] < need)
+                    known[j - 1] = wf.wait(y - j, need);
+            }
+
+            float p = line[x2];
+
+            if (x2 >= reach && x2 < w - reach)
+            {
+                for (auto const &t : taps)
                 {
-                    if (j == 0 && i <= kx)
+                    if (t.j > y)
                         continue;
-
-                    if (x + i - kx < 0 || x + i - kx >= isize.x)
+                    int sj = t.j ? (reversed(y - t.j) ? -1 : 1) : s;
+                    p += errors[(ptrdiff_t)(y - t.j) * w + x2 - t.dx * sj]
+                           * t.weight;
+                }
+            }
+            else
+            {
+                for (auto const &t : taps)
+                {
+                    if (t.j > y)
                         continue;
-
-                    pixels[(y + j) * isize.x + x2 + (i - kx) * s]
-                       += e * ker[i][j];
+                    int sj = t.j ? (reversed(y - t.j) ? -1 : 1) : s;
+                    int sx = x2 - t.dx * sj;
+                    if (sx < 0 || sx >= w)
+                        continue;
+                    p += errors[(ptrdiff_t)(y - t.j) * w + sx] * t.weight;
                 }
+            }
+
+            float q = p < 0.5f ? 0.f : 1.f;
+            line[x2] = q;
+            eline[x2] = p - q;
+
+            if ((x & 31) == 31)
+                wf.publish(y, x + 1);
         }
-    }
+
+        wf.publish(y, w);
+    });
+
     dst.unlock(pixels);
 
     return dst;
@@ -12,6 +12,8 @@
 
 #include <lol/engine-internal.h>
 
+#include "wavefront-private.h"
+
 /*
  * Ostromoukhov dithering functions
  *
@@ -71,6 +73,10 @@ static inline vec3 GetDiffusion(float v)
     return ret;
 }
 
+/* Like dither_ediff(), every pixel pulls the errors of its already
+ * processed neighbours instead of having them pushed, which gives the
+ * same result as the serial algorithm while letting each row start as
+ * soon as the row above is two pixels ahead. */
 image image::dither_ostromoukhov(ScanMode scan) const
 {
     image dst = *this;
@@ -79,31 +85,57 @@ image image::dither_ostromoukhov(ScanMode scan) const
     int w = dst.size().x;
     int h = dst.size().y;
 
-    for (int y = 0; y < h; y++)
+    auto reversed = [&](int y)
     {
-        bool reverse = (y & 1) && (scan == ScanMode::Serpentine);
+        return (y & 1) && scan == ScanMode::Serpentine;
+    };
 
-        for (int x = 0; x < w; x++)
-        {
-            int x2 = reverse ? w - 1 - x : x;
-            int s = reverse ? -1 : 1;
+    /* The three weighted errors emitted by each pixel */
+    array<vec3> errors;
+    errors.resize(w * h);
 
-            float p = pixels[y * w + x2];
-            float q = p < 0.5f ? 0.f : 1.f;
-            pixels[y * w + x2] = q;
+    wavefront wf(h);
 
-            vec3 e = (p - q) * GetDiffusion(p);
+    wf.run([&](int y)
+    {
+        int const s = reversed(y) ? -1 : 1;
+        int const s2 = y > 0 && reversed(y - 1) ? -1 : 1;
+        float *line = pixels + (ptrdiff_t)y * w;
+        vec3 *eline = errors.data() + (ptrdiff_t)y * w;
+        vec3 const *eprev = eline - w;
+        int known = 0;
 
-            if(x < w - 1)
-                pixels[y * w + x2 + s] += e[0];
-            if(y < h - 1)
+        for (int x = 0; x < w; x++)
+        {
+            int x2 = s < 0 ? w - 1 - x : x;
+            float p = line[x2];
+
+            /* Errors from the row above, in the order it was scanned */
+            if (y > 0)
             {
-                if(x > 0)
-                    pixels[(y + 1) * w + x2 - s] += e[1];
-                pixels[(y + 1) * w + x2] += e[2];
+                int need = s2 < 0 ? w - lol::max(0, x2 - 1)
+                                  : lol::min(w, x2 + 2);
+                if (known < need)
+                    known = wf.wait(y - 1, need);
+
+                p += eprev[x2][2];
+                if (x2 + s2 >= 0 && x2 + s2 < w)
+                    p += eprev[x2 + s2][1];
             }
+
+            if (x > 0)
+                p += eline[x2 - s][0];
+
+            float q = p < 0.5f ? 0.f : 1.f;
+            line[x2] = q;
+            eline[x2] = (p - q) * GetDiffusion(p);
+
+            if ((x & 31) == 31)
+                wf.publish(y, x + 1);
         }
-    }
+
+        wf.publish(y, w);
+    });
 
     dst.unlock(pixels);
 
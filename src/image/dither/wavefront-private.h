@@ -0,0 +1,79 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2004—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+//
+// The wavefront class
+// -------------------
+// Schedules row-by-row image processing where each row depends on the
+// rows above it. Rows are handed out to threads in round-robin order, and
+// each row publishes how many pixels it has processed so far so that the
+// rows below can start as soon as the pixels they read are ready.
+//
+
+namespace lol
+{
+
+class wavefront
+{
+public:
+    wavefront(int rows)
+      : m_rows(rows),
+        m_progress(new std::atomic<int>[rows])
+    {
+        for (int y = 0; y < rows; ++y)
+            m_progress[y].store(0, std::memory_order_relaxed);
+    }
+
+    /* Block until row y has processed at least count pixels, and
+     * return the current number of processed pixels. */
+    inline int wait(int y, int count) const
+    {
+        int ret;
+        while ((ret = m_progress[y].load(std::memory_order_acquire)) < count)
+            std::this_thread::yield();
+        return ret;
+    }
+
+    inline void publish(int y, int count)
+    {
+        m_progress[y].store(count, std::memory_order_release);
+    }
+
+    /* Call fn(y) for every row. Each thread processes its rows in order,
+     * so the earliest unfinished row can always make progress. */
+    template<typename T>
+    void run(T const &fn)
+    {
+        int threads = has_threads() ? (int)std::thread::hardware_concurrency()
+                                    : 1;
+        threads = std::max(1, std::min(threads, m_rows));
+
+        parallel_for(threads, [&](int begin, int end)
+        {
+            for (int y = 0; y < m_rows; ++y)
+                if (y % threads >= begin && y % threads < end)
+                    fn(y);
+        });
+    }
+
+private:
+    int m_rows;
+    std::unique_ptr<std::atomic<int>[]> m_progress;
+};
+
+} /* namespace lol */
+
@@ -88,51 +88,90 @@ image image::Contrast(float val) const
 image image::AutoContrast() const
 {
     image ret = *this;
+    int width = size().x;
 
+    pixel_stats const st = statistics();
     float min_val = 1.f, max_val = 0.f;
-    int count = size().x * size().y;
 
     if (format() == PixelFormat::Y_8 || format() == PixelFormat::Y_F32)
     {
-        float *pixels = ret.lock<PixelFormat::Y_F32>();
-        for (int n = 0; n < count; ++n)
-        {
-            min_val = lol::min(min_val, pixels[n]);
-            max_val = lol::max(max_val, pixels[n]);
-        }
-
+        min_val = lol::min(min_val, st.min.x);
+        max_val = lol::max(max_val, st.max.x);
         float t = max_val > min_val ? 1.f / (max_val - min_val) : 1.f;
-        for (int n = 0; n < count; ++n)
-            pixels[n] = (pixels[n] - min_val) * t;
 
+        float *pixels = ret.lock<PixelFormat::Y_F32>();
+        parallel_for(size().y, [&](int y0, int y1)
+        {
+            for (int n = y0 * width; n < y1 * width; ++n)
+                pixels[n] = (pixels[n] - min_val) * t;
+        }, 16);
         ret.unlock(pixels);
     }
     else
     {
-        vec4 *pixels = ret.lock<PixelFormat::RGBA_F32>();
-        for (int n = 0; n < count; ++n)
-        {
-            min_val = lol::min(min_val, pixels[n].r);
-            min_val = lol::min(min_val, pixels[n].g);
-            min_val = lol::min(min_val, pixels[n].b);
-            max_val = lol::max(max_val, pixels[n].r);
-            max_val = lol::max(max_val, pixels[n].g);
-            max_val = lol::max(max_val, pixels[n].b);
-        }
-
+        min_val = lol::min(min_val, lol::min(lol::min(st.min.r, st.min.g), st.min.b));
+        max_val = lol::max(max_val, lol::max(lol::max(st.max.r, st.max.g), st.max.b));
         float t = max_val > min_val ? 1.f / (max_val - min_val) : 1.f;
-        for (int n = 0; n < count; ++n)
-            pixels[n] = vec4((pixels[n].r - min_val) * t,
-                             (pixels[n].g - min_val) * t,
-                             (pixels[n].b - min_val) * t,
-                             pixels[n].a);;
 
+        vec4 *pixels = ret.lock<PixelFormat::RGBA_F32>();
+        parallel_for(size().y, [&](int y0, int y1)
+        {
+            for (int n = y0 * width; n < y1 * width; ++n)
+                pixels[n] = vec4((pixels[n].rgb - vec3(min_val)) * t,
+                                 pixels[n].a);
+        }, 16);
         ret.unlock(pixels);
     }
 
     return ret;
 }
 
+/* Otsu’s method: pick the histogram split that maximises the variance
+ * between the two classes. */
+static float otsu_threshold(array<ivec4> const &hist, int channel)
+{
+    double total = 0.0, weighted = 0.0;
+    for (int i = 0; i < hist.count(); ++i)
+    {
+        total += hist[i][channel];
+        weighted += (double)i * hist[i][channel];
+    }
+
+    double best = -1.0, w0 = 0.0, s0 = 0.0;
+    int split = 0;
+    for (int i = 0; i + 1 < hist.count(); ++i)
+    {
+        w0 += hist[i][channel];
+        s0 += (double)i * hist[i][channel];
+        double const w1 = total - w0;
+        if (w0 == 0.0 || w1 == 0.0)
+            continue;
+
+        double const d = s0 / w0 - (weighted - s0) / w1;
+        double const between = w0 * w1 * d * d;
+        if (between > best)
+        {
+            best = between;
+            split = i;
+        }
+    }
+
+    /* Values in bins up to “split” are below the threshold */
+    return (float)(split + 1) / hist.count();
+}
+
+image image::AutoThreshold() const
+{
+    array<ivec4> const hist = histogram(256);
+
+    if (format() == PixelFormat::Y_8 || format() == PixelFormat::Y_F32)
+        return Threshold(otsu_threshold(hist, 0));
+
+    return Threshold(vec3(otsu_threshold(hist, 0),
+                          otsu_threshold(hist, 1),
+                          otsu_threshold(hist, 2)));
+}
+
 image image::Invert() const
 {
     image ret = *this;
@@ -156,14 +195,70 @@ image image::Invert() const
     return ret;
 }
 
+image image::sRGBToLinearRGB() const
+{
+    image ret(size());
+    int width = size().x;
+    vec4 *dstp = ret.lock<PixelFormat::RGBA_F32>();
+
+    /* 8-bit images go through the lookup table directly */
+    if (format() == PixelFormat::Y_8 || format() == PixelFormat::RGB_8
+         || format() == PixelFormat::RGBA_8)
+    {
+        image tmp = *this;
+        u8vec4 const *srcp = tmp.lock<PixelFormat::RGBA_8>();
+        parallel_for(size().y, [&](int y0, int y1)
+        {
+            ptrdiff_t offset = (ptrdiff_t)y0 * width;
+            Color::sRGBToLinearRGB(dstp + offset, srcp + offset,
+                                   (size_t)(y1 - y0) * width);
+        }, 16);
+        tmp.unlock(srcp);
+    }
+    else
+    {
+        image tmp = *this;
+        vec4 const *srcp = tmp.lock<PixelFormat::RGBA_F32>();
+        parallel_for(size().y, [&](int y0, int y1)
+        {
+            ptrdiff_t offset = (ptrdiff_t)y0 * width;
+            Color::sRGBToLinearRGB(dstp + offset, srcp + offset,
+                                   (size_t)(y1 - y0) * width);
+        }, 16);
+        tmp.unlock(srcp);
+    }
+
+    ret.unlock(dstp);
+    return ret;
+}
+
+image image::LinearRGBTosRGB() const
+{
+    image ret = *this;
+    int width = size().x;
+
+    vec4 *pixels = ret.lock<PixelFormat::RGBA_F32>();
+    parallel_for(size().y, [&](int y0, int y1)
+    {
+        vec4 *p = pixels + (ptrdiff_t)y0 * width;
+        Color::LinearRGBTosRGB(p, p, (size_t)(y1 - y0) * width);
+    }, 16);
+    ret.unlock(pixels);
+
+    return ret;
+}
+
 image image::Threshold(float val) const
 {
     image ret = *this;
-    int count = size().x * size().y;
+    int width = size().x;
 
     float *pixels = ret.lock<PixelFormat::Y_F32>();
-    for (int n = 0; n < count; ++n)
-        pixels[n] = pixels[n] > val ? 1.f : 0.f;
+    parallel_for(size().y, [&](int y0, int y1)
+    {
+        for (int n = y0 * width; n < y1 * width; ++n)
+            pixels[n] = pixels[n] > val ? 1.f : 0.f;
+    }, 16);
     ret.unlock(pixels);
 
     return ret;
@@ -172,14 +267,17 @@ image image::Threshold(float val) const
 image image::Threshold(vec3 val) const
 {
     image ret = *this;
-    int count = size().x * size().y;
+    int width = size().x;
 
     vec4 *pixels = ret.lock<PixelFormat::RGBA_F32>();
-    for (int n = 0; n < count; ++n)
-        pixels[n] = vec4(pixels[n].r > val.r ? 1.f : 0.f,
-                         pixels[n].g > val.g ? 1.f : 0.f,
-                         pixels[n].b > val.b ? 1.f : 0.f,
-                         pixels[n].a);
+    parallel_for(size().y, [&](int y0, int y1)
+    {
+        for (int n = y0 * width; n < y1 * width; ++n)
+            pixels[n] = vec4(pixels[n].r > val.r ? 1.f : 0.f,
+                             pixels[n].g > val.g ? 1.f : 0.f,
+                             pixels[n].b > val.b ? 1.f : 0.f,
+                             pixels[n].a);
+    }, 16);
     ret.unlock(pixels);
 
     return ret;
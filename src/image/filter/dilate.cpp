@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2004—2017 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2004—2019 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -12,126 +12,489 @@
 
 #include <lol/engine-internal.h>
 
+#include <algorithm>
+#include <limits>
+
+#if defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
 /*
- * Dilate and erode functions
+ * Morphology functions: dilate, erode, open, close, top-hat
+ *
+ * Rectangles are separable, and each 1D pass uses the van Herk/Gil-Werman
+ * algorithm: lines are cut into blocks as long as the window, and running
+ * extrema from the start and from the end of each block give the extremum
+ * of any window with three comparisons per pixel, whatever its size.
+ *
+ * Discs are the union of the rectangles found at the corners of their
+ * outline. Large discs are approximated with fewer rectangles, except on
+ * binary grey images where an exact distance transform is used instead.
+ *
+ * Pixels outside the image are ignored, as if the image was clamped.
  */
 
-/* FIXME: these functions are almost the same, try to merge them
- * somewhat efficiently. */
-/* TODO: - dilate by k (Manhattan distance)
- *       - dilate by r (euclidian distance, with non-integer r) */
-
 namespace lol
 {
 
-image image::Dilate()
+/* Discs needing more rectangles than this are approximated */
+static int const MORPH_MAX_RECTS = 8;
+/* Width in pixels of the column strips of vertical passes */
+static int const MORPH_STRIP = 64;
+
+static double const MORPH_FAR = std::numeric_limits<double>::infinity();
+
+template<bool MAX> static inline float morph_identity()
+{
+    return MAX ? -std::numeric_limits<float>::infinity()
+               : std::numeric_limits<float>::infinity();
+}
+
+/* One vec4 maps to one SSE register, and holds either a whole RGBA pixel
+ * or the same pixel of four bands of a grey image. */
+template<bool MAX> static inline vec4 morph_op(vec4 const &a, vec4 const &b)
+{
+#if defined __SSE__
+    vec4 ret;
+    __m128 x = _mm_loadu_ps(&a.x), y = _mm_loadu_ps(&b.x);
+    _mm_storeu_ps(&ret.x, MAX ? _mm_max_ps(x, y) : _mm_min_ps(x, y));
+    return ret;
+#else
+    return MAX ? lol::max(a, b) : lol::min(a, b);
+#endif
+}
+
+/* Number of lines of the van Herk/Gil-Werman buffers for n outputs */
+static inline int vhgw_length(int n, int k)
+{
+    return (n + 2 * k - 2) / k * k;
+}
+
+/* out[x] = op(f[x], …, f[x + k - 1]) for every x in [0, n[, where each
+ * line of f, g and h holds “lanes” consecutive vec4 values. */
+template<bool MAX>
+static void vhgw(vec4 const *f, vec4 *g, vec4 *h, vec4 *out,
+                 ptrdiff_t out_stride, int n, int k, int lanes)
+{
+    int const length = vhgw_length(n, k);
+
+    for (int b = 0; b < length; b += k)
+    {
+        vec4 const *fb = f + (ptrdiff_t)b * lanes;
+        vec4 *gb = g + (ptrdiff_t)b * lanes;
+        vec4 *hb = h + (ptrdiff_t)b * lanes;
+        int const last = (k - 1) * lanes;
+
+        for (int l = 0; l < lanes; ++l)
+        {
+            gb[l] = fb[l];
+            hb[last + l] = fb[last + l];
+        }
+
+        for (int i = lanes; i < k * lanes; ++i)
+            gb[i] = morph_op<MAX>(gb[i - lanes], fb[i]);
+        for (int i = last - 1; i >= 0; --i)
+            hb[i] = morph_op<MAX>(hb[i + lanes], fb[i]);
+    }
+
+    for (int x = 0; x < n; ++x)
+    {
+        vec4 const *hx = h + (ptrdiff_t)x * lanes;
+        vec4 const *gx = g + (ptrdiff_t)(x + k - 1) * lanes;
+        vec4 *line = out + (ptrdiff_t)x * out_stride;
+        for (int l = 0; l < lanes; ++l)
+            line[l] = morph_op<MAX>(hx[l], gx[l]);
+    }
+}
+
+template<bool MAX>
+static void morph_rows(vec4 const *src, vec4 *dst, ivec2 size, int r)
+{
+    int const k = 2 * r + 1;
+    int const length = vhgw_length(size.x, k);
+
+    parallel_for(size.y, [&](int y0, int y1)
+    {
+        array<vec4> f, g, h;
+        f.resize(length, vec4(morph_identity<MAX>()));
+        g.resize(length);
+        h.resize(length);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            vec4 *line = dst + (ptrdiff_t)y * size.x;
+            vec4 const *srcline = src + (ptrdiff_t)y * size.x;
+            std::copy(srcline, srcline + size.x, &f[r]);
+            vhgw<MAX>(&f[0], &g[0], &h[0], line, 1, size.x, k, 1);
+        }
+    }, 4);
+}
+
+/* Vertical passes work on strips of whole rows, so that the running
+ * extrema are computed MORPH_STRIP pixels at a time. */
+template<bool MAX>
+static void morph_columns(vec4 const *src, vec4 *dst, ivec2 size, int r)
 {
-    ivec2 isize = size();
+    int const k = 2 * r + 1;
+    int const length = vhgw_length(size.y, k);
+    int const strips = (size.x + MORPH_STRIP - 1) / MORPH_STRIP;
+
+    parallel_for(strips, [&](int s0, int s1)
+    {
+        array<vec4> f, g, h;
+        f.resize(length * MORPH_STRIP);
+        g.resize(length * MORPH_STRIP);
+        h.resize(length * MORPH_STRIP);
+
+        for (int s = s0; s < s1; ++s)
+        {
+            int const x0 = s * MORPH_STRIP;
+            int const lanes = lol::min(MORPH_STRIP, size.x - x0);
+
+            for (int i = 0; i < length; ++i)
+            {
+                vec4 *line = &f[i * lanes];
+                int const y = i - r;
+                if (y >= 0 && y < size.y)
+                {
+                    vec4 const *srcline = src + (ptrdiff_t)y * size.x + x0;
+                    std::copy(srcline, srcline + lanes, line);
+                }
+                else
+                    for (int l = 0; l < lanes; ++l)
+                        line[l] = vec4(morph_identity<MAX>());
+            }
+
+            vhgw<MAX>(&f[0], &g[0], &h[0], dst + x0, size.x, size.y, k, lanes);
+        }
+    });
+}
+
+/* Apply the union of rectangles “rects” (given as half sizes) to src */
+template<bool MAX>
+static void morph_lanes(array<vec4> const &src, array<vec4> &dst, ivec2 size,
+                        array<ivec2> const &rects)
+{
+    array<vec4> tmp, rect;
+    tmp.resize(src.count());
+    if (rects.count() > 1)
+        rect.resize(src.count());
+    dst.resize(src.count());
+
+    for (int n = 0; n < rects.count(); ++n)
+    {
+        ivec2 const r = rects[n];
+        vec4 *out = rects.count() > 1 ? &rect[0] : &dst[0];
+
+        if (r.x > 0 && r.y > 0)
+        {
+            morph_rows<MAX>(&src[0], &tmp[0], size, r.x);
+            morph_columns<MAX>(&tmp[0], out, size, r.y);
+        }
+        else if (r.x > 0)
+            morph_rows<MAX>(&src[0], out, size, r.x);
+        else if (r.y > 0)
+            morph_columns<MAX>(&src[0], out, size, r.y);
+        else
+            std::copy(&src[0], &src[0] + src.count(), out);
+
+        if (rects.count() > 1)
+        {
+            if (n == 0)
+                std::copy(out, out + src.count(), &dst[0]);
+            else
+                for (int i = 0; i < src.count(); ++i)
+                    dst[i] = morph_op<MAX>(dst[i], out[i]);
+        }
+    }
+}
+
+/* The rectangles whose union is the structuring element, as half sizes.
+ * A disc contains the points where x² ry² + y² rx² ≤ rx² ry², and only
+ * the rectangles at the corners of its outline are needed. */
+static array<ivec2> morph_rects(ivec2 radii, MorphologyShape shape)
+{
+    array<ivec2> ret;
+
+    if (shape == MorphologyShape::Rectangle || radii.x == 0 || radii.y == 0)
+    {
+        ret << radii;
+        return ret;
+    }
+
+    int64_t const rx2 = (int64_t)radii.x * radii.x;
+    int64_t const ry2 = (int64_t)radii.y * radii.y;
+
+    array<int> widths;
+    for (int dy = 0, w = radii.x; dy <= radii.y; ++dy)
+    {
+        while ((int64_t)w * w * ry2 + (int64_t)dy * dy * rx2 > rx2 * ry2)
+            --w;
+        widths << w;
+    }
+
+    for (int dy = 0; dy <= radii.y; ++dy)
+        if (dy == radii.y || widths[dy + 1] < widths[dy])
+            ret << ivec2(widths[dy], dy);
+
+    return ret;
+}
+
+/* Keep MORPH_MAX_RECTS rectangles evenly spread along the outline; the
+ * first and last ones are always kept so that the extent is unchanged. */
+static array<ivec2> morph_approximate(array<ivec2> const &rects)
+{
+    if (rects.count() <= MORPH_MAX_RECTS)
+        return rects;
+
+    array<ivec2> ret;
+    for (int n = 0; n < MORPH_MAX_RECTS; ++n)
+        ret << rects[(int)((int64_t)n * (rects.count() - 1)
+                                      / (MORPH_MAX_RECTS - 1))];
+    return ret;
+}
+
+static bool morph_is_binary(float const *pixels, int count)
+{
+    for (int n = 0; n < count; ++n)
+        if (pixels[n] != 0.f && pixels[n] != 1.f)
+            return false;
+    return true;
+}
+
+/* Lower envelope of the parabolas w (p - q)² + f(q) over the points q
+ * where f(q) is finite (Felzenszwalb and Huttenlocher). */
+static void morph_edt(double const *f, double *d, int n, double w,
+                      int *v, double *z)
+{
+    int k = -1;
+    for (int q = 0; q < n; ++q)
+    {
+        if (f[q] == MORPH_FAR)
+            continue;
+
+        double s = -MORPH_FAR;
+        while (k >= 0)
+        {
+            int const p = v[k];
+            s = ((f[q] + w * q * q) - (f[p] + w * p * p)) / (2.0 * w * (q - p));
+            if (s > z[k])
+                break;
+            --k;
+        }
+
+        v[++k] = q;
+        z[k] = k ? s : -MORPH_FAR;
+    }
+
+    for (int p = 0, j = 0; p < n; ++p)
+    {
+        if (k < 0)
+        {
+            d[p] = MORPH_FAR;
+            continue;
+        }
+
+        while (j < k && z[j + 1] < p)
+            ++j;
+        double const dp = p - v[j];
+        d[p] = w * dp * dp + f[v[j]];
+    }
+}
+
+/* Exact disc morphology on binary images, in linear time whatever the
+ * radius: a pixel becomes “target” if a target pixel lies within the
+ * disc, using integer costs dx² ry² + dy² rx². */
+template<bool MAX>
+static void morph_distance(float const *src, float *dst, ivec2 size,
+                           ivec2 radii)
+{
+    float const target = MAX ? 1.f : 0.f;
+    double const wx = (double)radii.y * radii.y;
+    double const wy = (double)radii.x * radii.x;
+
+    array<double> cost;
+    cost.resize(size.x * size.y);
+
+    parallel_for(size.x, [&](int x0, int x1)
+    {
+        array<double> f, d, z;
+        array<int> v;
+        f.resize(size.y);
+        d.resize(size.y);
+        z.resize(size.y);
+        v.resize(size.y);
+
+        for (int x = x0; x < x1; ++x)
+        {
+            for (int y = 0; y < size.y; ++y)
+                f[y] = src[y * size.x + x] == target ? 0.0 : MORPH_FAR;
+            morph_edt(&f[0], &d[0], size.y, wy, &v[0], &z[0]);
+            for (int y = 0; y < size.y; ++y)
+                cost[y * size.x + x] = d[y];
+        }
+    }, 16);
+
+    parallel_for(size.y, [&](int y0, int y1)
+    {
+        array<double> d, z;
+        array<int> v;
+        d.resize(size.x);
+        z.resize(size.x);
+        v.resize(size.x);
+
+        for (int y = y0; y < y1; ++y)
+        {
+            morph_edt(&cost[y * size.x], &d[0], size.x, wx, &v[0], &z[0]);
+            for (int x = 0; x < size.x; ++x)
+                dst[y * size.x + x] = d[x] <= wx * wy ? target : 1.f - target;
+        }
+    }, 16);
+}
+
+template<bool MAX>
+static image morph(image const &src, ivec2 radii, MorphologyShape shape)
+{
+    ivec2 const isize = src.size();
+    int const count = isize.x * isize.y;
+    image tmp = src;
     image ret(isize);
 
-    if (format() == PixelFormat::Y_8 || format() == PixelFormat::Y_F32)
+    radii = lol::max(radii, ivec2(0));
+    array<ivec2> rects = morph_rects(radii, shape);
+
+    if (src.format() == PixelFormat::Y_8 || src.format() == PixelFormat::Y_F32)
     {
-        float const *srcp = lock<PixelFormat::Y_F32>();
+        float const *srcp = tmp.lock<PixelFormat::Y_F32>();
         float *dstp = ret.lock<PixelFormat::Y_F32>();
 
-        for (int y = 0; y < isize.y; ++y)
-            for (int x = 0; x < isize.x; ++x)
+        if (count == 0)
+        {
+            /* Nothing to do */
+        }
+        else if (rects.count() > MORPH_MAX_RECTS
+                  && morph_is_binary(srcp, count))
+        {
+            morph_distance<MAX>(srcp, dstp, isize, radii);
+        }
+        else
+        {
+            rects = morph_approximate(rects);
+
+            /* Pack four bands of rows side by side, each with “margin”
+             * extra rows above and below so that vertical passes see the
+             * same neighbours as in the image. */
+            int const band = (isize.y + 3) / 4, margin = radii.y;
+            ivec2 const psize(isize.x, band + 2 * margin);
+            array<vec4> packed, out;
+            packed.resize(psize.x * psize.y);
+
+            for (int j = 0; j < psize.y; ++j)
             {
-                int y2 = lol::max(y - 1, 0);
-                int x2 = lol::max(x - 1, 0);
-                int y3 = lol::min(y + 1, isize.y - 1);
-                int x3 = lol::min(x + 1, isize.x - 1);
-
-                float t = srcp[y * isize.x + x];
-                t = lol::max(t, srcp[y * isize.x + x2]);
-                t = lol::max(t, srcp[y * isize.x + x3]);
-                t = lol::max(t, srcp[y2 * isize.x + x]);
-                t = lol::max(t, srcp[y3 * isize.x + x]);
-                dstp[y * isize.x + x] = t;
+                vec4 *line = &packed[j * psize.x];
+                for (int c = 0; c < 4; ++c)
+                {
+                    int const y = c * band - margin + j;
+                    for (int x = 0; x < isize.x; ++x)
+                        line[x][c] = y >= 0 && y < isize.y
+                                   ? srcp[y * isize.x + x]
+                                   : morph_identity<MAX>();
+                }
             }
 
-        unlock(srcp);
+            morph_lanes<MAX>(packed, out, psize, rects);
+
+            for (int c = 0; c < 4; ++c)
+                for (int j = 0; j < band && c * band + j < isize.y; ++j)
+                {
+                    vec4 const *line = &out[(j + margin) * psize.x];
+                    float *dstline = dstp + (c * band + j) * isize.x;
+                    for (int x = 0; x < isize.x; ++x)
+                        dstline[x] = line[x][c];
+                }
+        }
+
+        tmp.unlock(srcp);
         ret.unlock(dstp);
     }
     else
     {
-        vec4 const *srcp = lock<PixelFormat::RGBA_F32>();
+        vec4 const *srcp = tmp.lock<PixelFormat::RGBA_F32>();
         vec4 *dstp = ret.lock<PixelFormat::RGBA_F32>();
 
-        for (int y = 0; y < isize.y; ++y)
-            for (int x = 0; x < isize.x; ++x)
-            {
-                int y2 = lol::max(y - 1, 0);
-                int x2 = lol::max(x - 1, 0);
-                int y3 = lol::min(y + 1, isize.y - 1);
-                int x3 = lol::min(x + 1, isize.x - 1);
-
-                vec3 t = srcp[y * isize.x + x].rgb;
-                t = lol::max(t, srcp[y * isize.x + x2].rgb);
-                t = lol::max(t, srcp[y * isize.x + x3].rgb);
-                t = lol::max(t, srcp[y2 * isize.x + x].rgb);
-                t = lol::max(t, srcp[y3 * isize.x + x].rgb);
-                dstp[y * isize.x + x] = vec4(t, srcp[y * isize.x + x].a);
-            }
+        if (count > 0)
+        {
+            array<vec4> pixels, out;
+            pixels.resize(count);
+            std::copy(srcp, srcp + count, &pixels[0]);
+
+            morph_lanes<MAX>(pixels, out, isize, morph_approximate(rects));
+
+            /* Alpha is left untouched */
+            for (int n = 0; n < count; ++n)
+                dstp[n] = vec4(out[n].rgb, srcp[n].a);
+        }
 
-        unlock(srcp);
+        tmp.unlock(srcp);
         ret.unlock(dstp);
     }
 
     return ret;
 }
 
+image image::Dilate()
+{
+    return Dilate(ivec2(1), MorphologyShape::Disc);
+}
+
 image image::Erode()
 {
-    ivec2 isize = size();
-    image ret(isize);
+    return Erode(ivec2(1), MorphologyShape::Disc);
+}
+
+image image::Dilate(ivec2 radii, MorphologyShape shape) const
+{
+    return morph<true>(*this, radii, shape);
+}
+
+image image::Erode(ivec2 radii, MorphologyShape shape) const
+{
+    return morph<false>(*this, radii, shape);
+}
+
+image image::Open(ivec2 radii, MorphologyShape shape) const
+{
+    return Erode(radii, shape).Dilate(radii, shape);
+}
+
+image image::Close(ivec2 radii, MorphologyShape shape) const
+{
+    return Dilate(radii, shape).Erode(radii, shape);
+}
+
+image image::TopHat(ivec2 radii, MorphologyShape shape) const
+{
+    ivec2 const isize = size();
+    int const count = isize.x * isize.y;
+    image tmp = *this;
+    image ret = Open(radii, shape);
 
     if (format() == PixelFormat::Y_8 || format() == PixelFormat::Y_F32)
     {
-        float const *srcp = lock<PixelFormat::Y_F32>();
+        float const *srcp = tmp.lock<PixelFormat::Y_F32>();
         float *dstp = ret.lock<PixelFormat::Y_F32>();
-
-        for (int y = 0; y < isize.y; ++y)
-            for (int x = 0; x < isize.x; ++x)
-            {
-                int y2 = lol::max(y - 1, 0);
-                int x2 = lol::max(x - 1, 0);
-                int y3 = lol::min(y + 1, isize.y - 1);
-                int x3 = lol::min(x + 1, isize.x - 1);
-
-                float t = srcp[y * isize.x + x];
-                t = lol::max(t, srcp[y * isize.x + x2]);
-                t = lol::max(t, srcp[y * isize.x + x3]);
-                t = lol::max(t, srcp[y2 * isize.x + x]);
-                t = lol::max(t, srcp[y3 * isize.x + x]);
-                dstp[y * isize.x + x] = t;
-            }
-
-        unlock(srcp);
+        for (int n = 0; n < count; ++n)
+            dstp[n] = srcp[n] - dstp[n];
+        tmp.unlock(srcp);
         ret.unlock(dstp);
     }
     else
     {
-        vec4 const *srcp = lock<PixelFormat::RGBA_F32>();
+        vec4 const *srcp = tmp.lock<PixelFormat::RGBA_F32>();
         vec4 *dstp = ret.lock<PixelFormat::RGBA_F32>();
-
-        for (int y = 0; y < isize.y; ++y)
-            for (int x = 0; x < isize.x; ++x)
-            {
-                int y2 = lol::max(y - 1, 0);
-                int x2 = lol::max(x - 1, 0);
-                int y3 = lol::min(y + 1, isize.y - 1);
-                int x3 = lol::min(x + 1, isize.x - 1);
-
-                vec3 t = srcp[y * isize.x + x].rgb;
-                t = lol::min(t, srcp[y * isize.x + x2].rgb);
-                t = lol::min(t, srcp[y * isize.x + x3].rgb);
-                t = lol::min(t, srcp[y2 * isize.x + x].rgb);
-                t = lol::min(t, srcp[y3 * isize.x + x].rgb);
-                dstp[y * isize.x + x] = vec4(t, srcp[y * isize.x + x].a);
-            }
-
-        unlock(srcp);
+        for (int n = 0; n < count; ++n)
+            dstp[n] = vec4(srcp[n].rgb - dstp[n].rgb, srcp[n].a);
+        tmp.unlock(srcp);
         ret.unlock(dstp);
     }
 
@@ -12,6 +12,8 @@
 
 #include <lol/engine-internal.h>
 
+#include <algorithm>
+
 /*
  * Median filter functions
  */
@@ -20,21 +22,12 @@
  * be done to improve the performance:
  *  - prefetch the neighbourhood; most neighbours are the same as the
  *    previous pixels.
- *  - use a better sort algorithm; bubble sort is ridiculous
- *  - even better, use state-of-the art median selection, ie. O(3n), for
- *    most common combinations (9, 25, 49, 81). */
+ *  - use state-of-the art median selection, ie. O(3n), for most common
+ *    combinations (9, 25, 49, 81). */
 
 namespace lol
 {
 
-static int cmpfloat(void const *i1, void const *i2)
-{
-    float a = *(float const *)i1;
-    float b = *(float const *)i2;
-
-    return (a > b) - (a < b);
-}
-
 image image::Median(ivec2 ksize) const
 {
     ivec2 const isize = size();
@@ -44,39 +37,45 @@ image image::Median(ivec2 ksize) const
     if (format() == PixelFormat::Y_8 || format() == PixelFormat::Y_F32)
     {
         ivec2 const lsize = 2 * ksize + ivec2(1);
-        array2d<float> list(lsize);
+        int const count = lsize.x * lsize.y;
 
         float *srcp = tmp.lock<PixelFormat::Y_F32>();
         float *dstp = ret.lock<PixelFormat::Y_F32>();
 
-        for (int y = 0; y < isize.y; y++)
+        parallel_for(isize.y, [&](int y0, int y1)
         {
-            for (int x = 0; x < isize.x; x++)
+            array<float> list;
+            list.resize(count);
+
+            for (int y = y0; y < y1; y++)
             {
-                /* Make a list of neighbours */
-                for (int j = -ksize.y; j <= ksize.y; j++)
+                for (int x = 0; x < isize.x; x++)
                 {
-                    int y2 = y + j;
-                    if (y2 < 0) y2 = isize.y - 1 - ((-y2 - 1) % isize.y);
-                    else if (y2 > 0) y2 = y2 % isize.y;
-
-                    for (int i = -ksize.x; i <= ksize.x; i++)
+                    /* Make a list of neighbours */
+                    float *p = &list[0];
+                    for (int j = -ksize.y; j <= ksize.y; j++)
                     {
-                        int x2 = x + i;
-                        if (x2 < 0) x2 = isize.x - 1 - ((-x2 - 1) % isize.x);
-                        else if (x2 > 0) x2 = x2 % isize.x;
+                        int y2 = y + j;
+                        if (y2 < 0) y2 = isize.y - 1 - ((-y2 - 1) % isize.y);
+                        else if (y2 > 0) y2 = y2 % isize.y;
 
-                        list[i + ksize.x][j + ksize.y] = srcp[y2 * isize.x + x2];
-                    }
-                }
+                        for (int i = -ksize.x; i <= ksize.x; i++)
+                        {
+                            int x2 = x + i;
+                            if (x2 < 0) x2 = isize.x - 1 - ((-x2 - 1) % isize.x);
+                            else if (x2 > 0) x2 = x2 % isize.x;
 
-                /* Sort the list */
-                qsort(&list[0][0], lsize.x * lsize.y, sizeof(float), cmpfloat);
+                            *p++ = srcp[y2 * isize.x + x2];
+                        }
+                    }
 
-                /* Store the median value */
-                dstp[y * isize.x + x] = *(&list[0][0] + lsize.x * lsize.y / 2);
+                    /* Select the median value, like percentile() does */
+                    std::nth_element(&list[0], &list[0] + count / 2,
+                                     &list[0] + count);
+                    dstp[y * isize.x + x] = list[count / 2];
+                }
             }
-        }
+        });
 
         tmp.unlock(srcp);
         ret.unlock(dstp);
@@ -84,66 +83,70 @@ image image::Median(ivec2 ksize) const
     else
     {
         ivec2 const lsize = 2 * ksize + ivec2(1);
-        array2d<vec3> list(lsize);
 
         vec4 *srcp = tmp.lock<PixelFormat::RGBA_F32>();
         vec4 *dstp = ret.lock<PixelFormat::RGBA_F32>();
 
-        for (int y = 0; y < isize.y; y++)
+        parallel_for(isize.y, [&](int y0, int y1)
         {
-            for (int x = 0; x < isize.x; x++)
+            array2d<vec3> list(lsize);
+
+            for (int y = y0; y < y1; y++)
             {
-                /* Make a list of neighbours */
-                for (int j = -ksize.y; j <= ksize.y; j++)
+                for (int x = 0; x < isize.x; x++)
                 {
-                    int y2 = y + j;
-                    if (y2 < 0) y2 = isize.y - 1 - ((-y2 - 1) % isize.y);
-                    else if (y2 > 0) y2 = y2 % isize.y;
-
-                    for (int i = -ksize.x; i <= ksize.x; i++)
+                    /* Make a list of neighbours */
+                    for (int j = -ksize.y; j <= ksize.y; j++)
                     {
-                        int x2 = x + i;
-                        if (x2 < 0) x2 = isize.x - 1 - ((-x2 - 1) % isize.x);
-                        else if (x2 > 0) x2 = x2 % isize.x;
+                        int y2 = y + j;
+                        if (y2 < 0) y2 = isize.y - 1 - ((-y2 - 1) % isize.y);
+                        else if (y2 > 0) y2 = y2 % isize.y;
+
+                        for (int i = -ksize.x; i <= ksize.x; i++)
+                        {
+                            int x2 = x + i;
+                            if (x2 < 0) x2 = isize.x - 1 - ((-x2 - 1) % isize.x);
+                            else if (x2 > 0) x2 = x2 % isize.x;
 
-                        list[i + ksize.x][j + ksize.y] = srcp[y2 * isize.x + x2].rgb;
+                            list[i + ksize.x][j + ksize.y] = srcp[y2 * isize.x + x2].rgb;
+                        }
                     }
-                }
 
-                /* Algorithm constants, empirically chosen */
-                int const N = 5;
-                float const K = 1.5f;
+                    /* Algorithm constants, empirically chosen */
+                    int const N = 5;
+                    float const K = 1.5f;
 
-                /* Iterate using Weiszfeld’s algorithm */
-                vec3 oldmed(0.f), median(0.f);
-                for (int iter = 0; ; ++iter)
-                {
-                    oldmed = median;
-                    vec3 s1(0.f);
-                    float s2 = 0.f;
-                    for (int j = 0; j < lsize.y; ++j)
-                        for (int i = 0; i < lsize.x; ++i)
+                    /* Iterate using Weiszfeld’s algorithm */
+                    vec3 oldmed(0.f), median(0.f);
+                    for (int iter = 0; ; ++iter)
+                    {
+                        oldmed = median;
+                        vec3 s1(0.f);
+                        float s2 = 0.f;
+                        for (int j = 0; j < lsize.y; ++j)
+                            for (int i = 0; i < lsize.x; ++i)
+                            {
+                                float d = 1.0f /
+                                          (1e-10f + distance(median, list[i][j]));
+                                s1 += list[i][j] * d;
+                                s2 += d;
+                            }
+                        median = s1 / s2;
+
+                        if (iter > 1 && iter < N)
                         {
-                            float d = 1.0f /
-                                      (1e-10f + distance(median, list[i][j]));
-                            s1 += list[i][j] * d;
-                            s2 += d;
+                            median += K * (median - oldmed);
                         }
-                    median = s1 / s2;
 
-                    if (iter > 1 && iter < N)
-                    {
-                        median += K * (median - oldmed);
+                        if (iter > 3 && distance(oldmed, median) < 1.e-5f)
+                            break;
                     }
 
-                    if (iter > 3 && distance(oldmed, median) < 1.e-5f)
-                        break;
+                    /* Store the median value */
+                    dstp[y * isize.x + x] = vec4(median, srcp[y * isize.x + x].a);
                 }
-
-                /* Store the median value */
-                dstp[y * isize.x + x] = vec4(median, srcp[y * isize.x + x].a);
             }
-        }
+        });
 
         tmp.unlock(srcp);
         ret.unlock(dstp);
@@ -22,11 +22,14 @@ namespace lol
 image image::YUVToRGB() const
 {
     image ret = *this;
-    int count = size().x * size().y;
+    int width = size().x;
 
     vec4 *pixels = ret.lock<PixelFormat::RGBA_F32>();
-    for (int n = 0; n < count; ++n)
-        pixels[n] = Color::YUVToRGB(pixels[n]);
+    parallel_for(size().y, [&](int y0, int y1)
+    {
+        vec4 *p = pixels + (ptrdiff_t)y0 * width;
+        Color::YUVToRGB(p, p, (size_t)(y1 - y0) * width);
+    }, 16);
     ret.unlock(pixels);
 
     return ret;
@@ -35,11 +38,14 @@ image image::YUVToRGB() const
 image image::RGBToYUV() const
 {
     image ret = *this;
-    int count = size().x * size().y;
+    int width = size().x;
 
     vec4 *pixels = ret.lock<PixelFormat::RGBA_F32>();
-    for (int n = 0; n < count; ++n)
-        pixels[n] = Color::RGBToYUV(pixels[n]);
+    parallel_for(size().y, [&](int y0, int y1)
+    {
+        vec4 *p = pixels + (ptrdiff_t)y0 * width;
+        Color::RGBToYUV(p, p, (size_t)(y1 - y0) * width);
+    }, 16);
     ret.unlock(pixels);
 
     return ret;
@@ -12,6 +12,12 @@
 
 #include <lol/engine-internal.h>
 
+#include <cstring>
+
+#if defined __SSE2__
+#   include <emmintrin.h>
+#endif
+
 #if LOL_USE_FFMPEG
 extern "C"
 {
@@ -45,32 +51,192 @@ static std::string error2string(int errnum)
 }*/
 #endif
 
+/*
+ * Frame conversion
+ */
+
+void convert_to_rgb332(u8vec4 const *src, ptrdiff_t pitch, ivec2 size,
+                       uint8_t *dst, ptrdiff_t dst_pitch)
+{
+    for (int y = 0; y < size.y; ++y, src += pitch, dst += dst_pitch)
+    {
+        int x = 0;
+
+#if defined __SSE2__
+        /* Pixels are little-endian 0xAABBGGRR words, so each output byte
+         * is (p & 0xe0) | ((p >> 11) & 0x1c) | ((p >> 22) & 0x03). */
+        __m128i const m0 = _mm_set1_epi32(0xe0);
+        __m128i const m1 = _mm_set1_epi32(0x1c);
+        __m128i const m2 = _mm_set1_epi32(0x03);
+
+        for ( ; x + 8 <= size.x; x += 8)
+        {
+            __m128i p[2];
+            for (int i = 0; i < 2; ++i)
+            {
+                __m128i v = _mm_loadu_si128((__m128i const *)(src + x + 4 * i));
+                p[i] = _mm_or_si128(_mm_and_si128(v, m0),
+                       _mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 11), m1),
+                                    _mm_and_si128(_mm_srli_epi32(v, 22), m2)));
+            }
+
+            __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(p[0], p[1]),
+                                             _mm_setzero_si128());
+            _mm_storel_epi64((__m128i *)(dst + x), bytes);
+        }
+#endif
+
+        for ( ; x < size.x; ++x)
+            dst[x] = (src[x].r & 0xe0) | ((src[x].g & 0xe0) >> 3) | (src[x].b >> 6);
+    }
+}
+
+/* ITU-R BT.601 coefficients for 8-bit studio range YUV */
+static int const yuv_y[3] = {  66, 129,  25 };
+static int const yuv_u[3] = { -38, -74, 112 };
+static int const yuv_v[3] = { 112, -94, -18 };
+
+static inline uint8_t rgb_to_y(u8vec4 p)
+{
+    return (uint8_t)(((yuv_y[0] * p.r + yuv_y[1] * p.g + yuv_y[2] * p.b
+                        + 128) >> 8) + 16);
+}
+
+/* Chroma of a 2×2 block, given the sum of its pixels */
+static inline uint8_t sum_to_chroma(int const *k, ivec3 s)
+{
+    return (uint8_t)(((k[0] * s.r + k[1] * s.g + k[2] * s.b + 512) >> 10) + 128);
+}
+
+void convert_to_yuv420(u8vec4 const *src, ptrdiff_t pitch, ivec2 size,
+                       uint8_t *const planes[3], int const pitches[3])
+{
+#if defined __SSE2__
+    __m128i const ky = _mm_setr_epi16(yuv_y[0], yuv_y[1], yuv_y[2], 0,
+                                      yuv_y[0], yuv_y[1], yuv_y[2], 0);
+    __m128i const ku = _mm_setr_epi16(yuv_u[0], yuv_u[1], yuv_u[2], 0,
+                                      yuv_u[0], yuv_u[1], yuv_u[2], 0);
+    __m128i const kv = _mm_setr_epi16(yuv_v[0], yuv_v[1], yuv_v[2], 0,
+                                      yuv_v[0], yuv_v[1], yuv_v[2], 0);
+    __m128i const zero = _mm_setzero_si128();
+#endif
+
+    for (int y = 0; y < size.y; y += 2)
+    {
+        /* With an odd height, the last row is its own neighbour */
+        u8vec4 const *row[2] = { src + y * pitch,
+                                 src + std::min(y + 1, size.y - 1) * pitch };
+        uint8_t *luma[2] = { planes[0] + y * pitches[0],
+                             planes[0] + (y + 1) * pitches[0] };
+        uint8_t *u = planes[1] + y / 2 * pitches[1];
+        uint8_t *v = planes[2] + y / 2 * pitches[2];
+        int const rows = std::min(2, size.y - y);
+
+        int x = 0;
+
+#if defined __SSE2__
+        for ( ; x + 4 <= size.x; x += 4)
+        {
+            __m128i sum_lo = zero, sum_hi = zero;
+
+            for (int j = 0; j < 2; ++j)
+            {
+                /* Expand 4 pixels to 16 bits, two pixels per register */
+                __m128i p = _mm_loadu_si128((__m128i const *)(row[j] + x));
+                __m128i lo = _mm_unpacklo_epi8(p, zero);
+                __m128i hi = _mm_unpackhi_epi8(p, zero);
+                sum_lo = _mm_add_epi16(sum_lo, lo);
+                sum_hi = _mm_add_epi16(sum_hi, hi);
+
+                if (j >= rows)
+                    continue;
+
+                /* madd yields { k0·r + k1·g, k2·b } for each pixel */
+                __m128i a = _mm_madd_epi16(lo, ky);
+                __m128i b = _mm_madd_epi16(hi, ky);
+                __m128i even = _mm_castps_si128(_mm_shuffle_ps(
+                        _mm_castsi128_ps(a), _mm_castsi128_ps(b), 0x88));
+                __m128i odd = _mm_castps_si128(_mm_shuffle_ps(
+                        _mm_castsi128_ps(a), _mm_castsi128_ps(b), 0xdd));
+                __m128i l = _mm_add_epi32(_mm_add_epi32(even, odd),
+                                          _mm_set1_epi32(128));
+                l = _mm_add_epi32(_mm_srai_epi32(l, 8), _mm_set1_epi32(16));
+                l = _mm_packus_epi16(_mm_packs_epi32(l, zero), zero);
+                int32_t word = _mm_cvtsi128_si32(l);
+                memcpy(luma[j] + x, &word, sizeof(word));
+            }
+
+            /* sum_lo and sum_hi hold the two 2×2 blocks, one pixel column
+             * per half; madd then a horizontal sum gives each chroma. */
+            __m128i k[2] = { ku, kv };
+            uint8_t *chroma[2] = { u, v };
+            for (int c = 0; c < 2; ++c)
+            {
+                __m128i a = _mm_madd_epi16(sum_lo, k[c]);
+                __m128i b = _mm_madd_epi16(sum_hi, k[c]);
+                __m128i t = _mm_add_epi32(_mm_unpacklo_epi32(a, b),
+                                          _mm_unpackhi_epi32(a, b));
+                t = _mm_add_epi32(t, _mm_srli_si128(t, 8));
+                t = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(t,
+                                      _mm_set1_epi32(512)), 10),
+                                  _mm_set1_epi32(128));
+                chroma[c][x / 2] = (uint8_t)_mm_cvtsi128_si32(t);
+                chroma[c][x / 2 + 1] = (uint8_t)_mm_cvtsi128_si32(
+                                                _mm_srli_si128(t, 4));
+            }
+        }
+#endif
+
+        for ( ; x < size.x; x += 2)
+        {
+            /* With an odd width, the last column is its own neighbour */
+            int const x1 = std::min(x + 1, size.x - 1);
+            ivec3 sum(0);
+
+            for (int j = 0; j < 2; ++j)
+            {
+                sum += ivec3(row[j][x].rgb) + ivec3(row[j][x1].rgb);
+                if (j < rows)
+                {
+                    luma[j][x] = rgb_to_y(row[j][x]);
+                    if (x1 != x)
+                        luma[j][x1] = rgb_to_y(row[j][x1]);
+                }
+            }
+
+            u[x / 2] = sum_to_chroma(yuv_u, sum);
+            v[x / 2] = sum_to_chroma(yuv_v, sum);
+        }
+    }
+}
+
 movie::movie(ivec2 size)
   : m_avformat(nullptr),
     m_avcodec(nullptr),
     m_stream(nullptr),
-    m_frame(nullptr),
     m_size(size),
-    m_index(0)
+    m_index(0),
+    m_encoder(nullptr),
+    m_failed(false),
+    m_header_written(false)
 {
-#if LOL_USE_FFMPEG
-    m_frame = av_frame_alloc();
-    ASSERT(m_frame);
-
-    m_frame->format = AV_PIX_FMT_RGB8; // 3:3:2 packed for GIF
-    m_frame->width = m_size.x;
-    m_frame->height = m_size.y;
+    for (auto &frame : m_frames)
+        frame = nullptr;
+}
 
-    int ret = av_frame_get_buffer(m_frame, 32);
-    ASSERT(ret >= 0);
-#endif
+movie::~movie()
+{
+    if (m_avformat)
+        close();
 }
 
 bool movie::open_file(std::string const &filename)
 {
 #if LOL_USE_FFMPEG
-    /* Third argument specifies format */
-    avformat_alloc_output_context2(&m_avformat, nullptr, "gif", filename.c_str());
+    /* Guess the format from the file name, otherwise fall back to GIF */
+    avformat_alloc_output_context2(&m_avformat, nullptr, nullptr, filename.c_str());
+    if (!m_avformat)
+        avformat_alloc_output_context2(&m_avformat, nullptr, "gif", filename.c_str());
     if (!m_avformat)
     {
         msg::debug("could not create output context");
@@ -96,6 +262,11 @@ bool movie::open_file(std::string const &filename)
         msg::error("could not write header: %s\n", ERROR_TO_STRING(ret));
         return false;
     }
+    m_header_written = true;
+
+    if (has_threads())
+        m_encoder = new thread([this](thread *) { encoder_thread(); });
+
     return true;
 #else
     UNUSED(filename);
@@ -104,22 +275,116 @@ bool movie::open_file(std::string const &filename)
 }
 
 bool movie::push_image(image &im)
+{
+    ASSERT(im.size() == m_size, "image size does not match movie size");
+
+    u8vec4 const *data = im.lock<PixelFormat::RGBA_8>();
+    bool ret = push_frame(data, m_size.x);
+    im.unlock(data);
+
+    return ret;
+}
+
+bool movie::push_frame(u8vec4 const *pixels, ptrdiff_t pitch)
 {
 #if LOL_USE_FFMPEG
+    if (m_failed)
+        return false;
+
+    // Blocks while the encoder lags QUEUE_SIZE frames behind
+    AVFrame *frame = m_encoder ? m_free.pop() : m_frames[0];
+
     // Make sure the encoder does not hold a reference on our
     // frame (GIF does that in order to compress using deltas).
-    if (av_frame_make_writable(m_frame) < 0)
+    if (av_frame_make_writable(frame) < 0)
+    {
+        if (m_encoder)
+            m_free.push(frame);
         return false;
+    }
 
-    // Convert image to 3:3:2. TODO: add some dithering
-    u8vec3 *data = im.lock<PixelFormat::RGB_8>();
-    for (int n = 0; n < im.size().x * im.size().y; ++n)
-        m_frame->data[0][n] = (data[n].r & 0xe0) | ((data[n].g & 0xe0) >> 3) | (data[n].b >> 6);
-    im.unlock(data);
+    // TODO: add some dithering to the 3:3:2 conversion
+    if (frame->format == AV_PIX_FMT_RGB8)
+        convert_to_rgb332(pixels, pitch, m_size,
+                          frame->data[0], frame->linesize[0]);
+    else
+        convert_to_yuv420(pixels, pitch, m_size,
+                          frame->data, frame->linesize);
+
+    frame->pts = m_index++;
 
-    m_frame->pts = m_index++;
+    if (m_encoder)
+    {
+        m_pending.push(frame);
+        return true;
+    }
+
+    return encode(frame);
+#else
+    UNUSED(pixels, pitch);
+    return true;
+#endif
+}
+
+void movie::close()
+{
+    if (m_encoder)
+    {
+        // A null frame stops the encoder thread
+        m_pending.push(nullptr);
+        delete m_encoder;
+        m_encoder = nullptr;
+    }
+
+#if LOL_USE_FFMPEG
+    if (!m_avformat)
+        return;
+
+    // Only a successfully opened file has frames to flush and needs a
+    // trailer; otherwise the codec may not even have been opened.
+    if (m_header_written)
+    {
+        // Flush any frames delayed by the codec
+        encode(nullptr);
+
+        // this must be done before m_avcodec is freed
+        av_write_trailer(m_avformat);
+        m_header_written = false;
+    }
+
+    avcodec_free_context(&m_avcodec);
+    for (auto &frame : m_frames)
+        av_frame_free(&frame);
+
+    if (!(m_avformat->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&m_avformat->pb);
+
+    avformat_free_context(m_avformat);
+    m_avformat = nullptr;
+#endif
+}
 
-    int ret = avcodec_send_frame(m_avcodec, m_frame);
+void movie::encoder_thread()
+{
+    for (;;)
+    {
+        AVFrame *frame = m_pending.pop();
+        if (!frame)
+            break;
+
+        if (!m_failed && !encode(frame))
+            m_failed = true;
+
+        m_free.push(frame);
+    }
+}
+
+/* Send a frame to the codec, or flush it if “frame” is null, then write
+ * all the resulting packets. */
+bool movie::encode(AVFrame *frame)
+{
+#if LOL_USE_FFMPEG
+    int ret = avcodec_send_frame(m_avcodec, frame);
     if (ret < 0)
     {
         msg::error("cannot send video frame: %s\n", ERROR_TO_STRING(ret));
@@ -150,28 +415,12 @@ bool movie::push_image(image &im)
         }
     }
 #else
-    UNUSED(im);
+    UNUSED(frame);
 #endif
 
     return true;
 }
 
-void movie::close()
-{
-#if LOL_USE_FFMPEG
-    // this must be done before m_avcodec is freed
-    av_write_trailer(m_avformat);
-
-    avcodec_free_context(&m_avcodec);
-    av_frame_free(&m_frame);
-
-    if (!(m_avformat->oformat->flags & AVFMT_NOFILE))
-        avio_closep(&m_avformat->pb);
-
-    avformat_free_context(m_avformat);
-#endif
-}
-
 bool movie::open_codec()
 {
 #if LOL_USE_FFMPEG
@@ -198,10 +447,28 @@ bool movie::open_codec()
         return false;
     }
 
+    // GIF only supports palettes, so use packed 3:3:2
+    AVPixelFormat format = codec->id == AV_CODEC_ID_GIF ? AV_PIX_FMT_RGB8
+                                                        : AV_PIX_FMT_YUV420P;
+
+    for (auto &frame : m_frames)
+    {
+        frame = av_frame_alloc();
+        ASSERT(frame);
+
+        frame->format = format;
+        frame->width = m_size.x;
+        frame->height = m_size.y;
+
+        int ret = av_frame_get_buffer(frame, 32);
+        ASSERT(ret >= 0);
+        m_free.push(frame);
+    }
+
     m_avcodec->codec_id = m_avformat->oformat->video_codec;
-    m_avcodec->width = m_frame->width;
-    m_avcodec->height = m_frame->height;
-    m_avcodec->pix_fmt = AVPixelFormat(m_frame->format);
+    m_avcodec->width = m_size.x;
+    m_avcodec->height = m_size.y;
+    m_avcodec->pix_fmt = format;
     m_avcodec->time_base = m_stream->time_base;
 
     if (m_avformat->oformat->flags & AVFMT_GLOBALHEADER)
@@ -0,0 +1,469 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2004—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+/*
+ * Colour quantisation: palette generation using median cut optionally
+ * followed by k-means refinement, and nearest palette colour lookup
+ * using a k-d tree.
+ */
+
+namespace lol
+{
+
+/* The space in which colour distances are measured. Image values are
+ * considered to be sRGB-encoded. */
+static inline vec3 to_space(vec4 const &c, ColorSpace space)
+{
+    if (space == ColorSpace::CIELab)
+        return Color::CIEXYZToCIELab(Color::LinearRGBToCIEXYZ(
+                                     Color::sRGBToLinearRGB(c.rgb)));
+    return c.rgb;
+}
+
+/*
+ * A static k-d tree over a set of colours. Nodes are stored implicitly:
+ * the median of each range is the node, and the two halves of the range
+ * are its children.
+ */
+
+class color_tree
+{
+public:
+    color_tree(array<vec3> const &keys)
+    {
+        for (int i = 0; i < keys.count(); ++i)
+            m_nodes.push(node{ keys[i], i, 0 });
+        build(0, m_nodes.count());
+    }
+
+    /* Return the index of the colour closest to p; ties are broken in
+     * favour of the lowest index so that results match a linear scan. */
+    int nearest(vec3 const &p) const
+    {
+        int best = -1;
+        float best_dist = std::numeric_limits<float>::max();
+        search(0, m_nodes.count(), p, best, best_dist);
+        return best;
+    }
+
+private:
+    struct node
+    {
+        vec3 key;
+        int index;
+        int axis;
+    };
+
+    void build(int begin, int end)
+    {
+        if (end - begin <= 1)
+            return;
+
+        /* Split along the axis with the largest spread */
+        vec3 lo = m_nodes[begin].key, hi = lo;
+        for (int i = begin + 1; i < end; ++i)
+        {
+            lo = lol::min(lo, m_nodes[i].key);
+            hi = lol::max(hi, m_nodes[i].key);
+        }
+
+        vec3 d = hi - lo;
+        int axis = d.x >= d.y && d.x >= d.z ? 0 : d.y >= d.z ? 1 : 2;
+        int mid = (begin + end) / 2;
+
+        std::nth_element(m_nodes.data() + begin, m_nodes.data() + mid,
+                         m_nodes.data() + end,
+                         [axis](node const &a, node const &b)
+                         { return a.key[axis] < b.key[axis]; });
+        m_nodes[mid].axis = axis;
+
+        build(begin, mid);
+        build(mid + 1, end);
+    }
+
+    void search(int begin, int end, vec3 const &p,
+                int &best, float &best_dist) const
+    {
+        if (begin >= end)
+            return;
+
+        int mid = (begin + end) / 2;
+        node const &n = m_nodes[mid];
+
+        float dist = sqlength(p - n.key);
+        if (dist < best_dist || (dist == best_dist && n.index < best))
+        {
+            best_dist = dist;
+            best = n.index;
+        }
+
+        float delta = p[n.axis] - n.key[n.axis];
+        if (delta < 0.f)
+        {
+            search(begin, mid, p, best, best_dist);
+            if (delta * delta <= best_dist)
+                search(mid + 1, end, p, best, best_dist);
+        }
+        else
+        {
+            search(mid + 1, end, p, best, best_dist);
+            if (delta * delta <= best_dist)
+                search(begin, mid, p, best, best_dist);
+        }
+    }
+
+    array<node> m_nodes;
+};
+
+/*
+ * Weighted colour samples. Rather than clustering every pixel, the image
+ * is first reduced to a 15-bit histogram where each bin remembers the
+ * mean of the pixels that fell into it.
+ */
+
+struct color_samples
+{
+    array<vec4> color;
+    array<vec3> key;
+    array<float> weight;
+};
+
+static int const HISTOGRAM_BITS = 5;
+static int const HISTOGRAM_SIZE = 1 << (3 * HISTOGRAM_BITS);
+
+static color_samples get_samples(vec4 const *pixels, int count,
+                                 ColorSpace space)
+{
+    struct bin { dvec4 sum; int64_t count; };
+
+    /* One histogram per band, merged in band order afterwards so that
+     * the result does not depend on thread scheduling. */
+    std::map<int, array<bin>> histograms;
+    mutex lock;
+
+    parallel_for(count, [&](int begin, int end)
+    {
+        array<bin> h;
+        h.resize(HISTOGRAM_SIZE, bin{ dvec4(0.0), 0 });
+
+        for (int n = begin; n < end; ++n)
+        {
+            ivec3 i = (ivec3)(lol::clamp(pixels[n].rgb, 0.f, 1.f)
+                                * ((1 << HISTOGRAM_BITS) - 0.001f));
+            bin &b = h[(i.r << (2 * HISTOGRAM_BITS))
+                        | (i.g << HISTOGRAM_BITS) | i.b];
+            b.sum += dvec4(pixels[n]);
+            ++b.count;
+        }
+
+        lock.lock();
+        histograms[begin] = h;
+        lock.unlock();
+    }, 65536);
+
+    color_samples ret;
+    for (int i = 0; i < HISTOGRAM_SIZE; ++i)
+    {
+        dvec4 sum(0.0);
+        int64_t total = 0;
+        for (auto const &h : histograms)
+        {
+            sum += h.second[i].sum;
+            total += h.second[i].count;
+        }
+
+        if (!total)
+            continue;
+
+        vec4 c = vec4(sum / (double)total);
+        ret.color.push(c);
+        ret.key.push(to_space(c, space));
+        ret.weight.push((float)total);
+    }
+
+    return ret;
+}
+
+/*
+ * Median cut: repeatedly split the box with the largest weighted squared
+ * error along its axis of largest variance, at the weighted median.
+ */
+
+static array<int> median_cut(color_samples const &s, int colors)
+{
+    struct box
+    {
+        int begin, end, axis;
+        float error;
+    };
+
+    array<int> order;
+    for (int i = 0; i < s.key.count(); ++i)
+        order.push(i);
+
+    auto analyse = [&](box &b)
+    {
+        double w = 0.0;
+        dvec3 mean(0.0), sq(0.0);
+        for (int i = b.begin; i < b.end; ++i)
+        {
+            dvec3 k(s.key[order[i]]);
+            w += s.weight[order[i]];
+            mean += s.weight[order[i]] * k;
+            sq += s.weight[order[i]] * k * k;
+        }
+        dvec3 var = sq - mean * mean / w;
+        b.axis = var.x >= var.y && var.x >= var.z ? 0 : var.y >= var.z ? 1 : 2;
+        b.error = b.end - b.begin > 1 ? (float)(var.x + var.y + var.z) : 0.f;
+    };
+
+    array<box> boxes;
+    boxes.push(box{ 0, order.count(), 0, 0.f });
+    analyse(boxes[0]);
+
+    while (boxes.count() < colors)
+    {
+        int best = 0;
+        for (int i = 1; i < boxes.count(); ++i)
+            if (boxes[i].error > boxes[best].error)
+                best = i;
+
+        box b = boxes[best];
+        if (b.error <= 0.f)
+            break;
+
+        std::sort(order.data() + b.begin, order.data() + b.end,
+                  [&](int i, int j) { return s.key[i][b.axis]
+                                              < s.key[j][b.axis]; });
+
+        float total = 0.f, half = 0.f;
+        for (int i = b.begin; i < b.end; ++i)
+            total += s.weight[order[i]];
+
+        int split = b.begin + 1;
+        for (int i = b.begin; i < b.end - 1; ++i)
+        {
+            half += s.weight[order[i]];
+            split = i + 1;
+            if (half >= 0.5f * total)
+                break;
+        }
+
+        boxes[best] = box{ b.begin, split, 0, 0.f };
+        boxes.push(box{ split, b.end, 0, 0.f });
+        analyse(boxes[best]);
+        analyse(boxes.last());
+    }
+
+    array<int> assignment;
+    assignment.resize(order.count());
+    for (int n = 0; n < boxes.count(); ++n)
+        for (int i = boxes[n].begin; i < boxes[n].end; ++i)
+            assignment[order[i]] = n;
+
+    return assignment;
+}
+
+/* Compute the weighted centroids of each cluster, in both the distance
+ * space and RGBA. Empty clusters keep their previous values. */
+static void get_centroids(color_samples const &s, array<int> const &assignment,
+                          array<vec3> &keys, array<vec4> &colors)
+{
+    array<dvec3> ksum;
+    array<dvec4> csum;
+    array<double> wsum;
+    ksum.resize(keys.count(), dvec3(0.0));
+    csum.resize(keys.count(), dvec4(0.0));
+    wsum.resize(keys.count(), 0.0);
+
+    for (int i = 0; i < assignment.count(); ++i)
+    {
+        int n = assignment[i];
+        ksum[n] += (double)s.weight[i] * dvec3(s.key[i]);
+        csum[n] += (double)s.weight[i] * dvec4(s.color[i]);
+        wsum[n] += s.weight[i];
+    }
+
+    for (int n = 0; n < keys.count(); ++n)
+    {
+        if (wsum[n] <= 0.0)
+            continue;
+        keys[n] = vec3(ksum[n] / wsum[n]);
+        colors[n] = vec4(csum[n] / wsum[n]);
+    }
+}
+
+array<vec4> image::quantize(int colors, QuantizeAlgorithm algorithm,
+                            ColorSpace space) const
+{
+    image tmp = *this;
+    vec4 const *pixels = tmp.lock<PixelFormat::RGBA_F32>();
+    color_samples s = get_samples(pixels, size().x * size().y, space);
+    tmp.unlock(pixels);
+
+    array<int> assignment = median_cut(s, lol::max(colors, 1));
+
+    int count = 0;
+    for (int n : assignment)
+        count = lol::max(count, n + 1);
+
+    array<vec3> keys;
+    array<vec4> palette;
+    keys.resize(count);
+    palette.resize(count);
+    get_centroids(s, assignment, keys, palette);
+
+    /* Lloyd iterations, stopped when no sample changes cluster */
+    if (algorithm == QuantizeAlgorithm::KMeans)
+    {
+        for (int iter = 0; iter < 32; ++iter)
+        {
+            color_tree tree(keys);
+            array<int> next;
+            next.resize(assignment.count());
+
+            parallel_for(assignment.count(), [&](int begin, int end)
+            {
+                for (int i = begin; i < end; ++i)
+                    next[i] = tree.nearest(s.key[i]);
+            }, 1024);
+
+            int changes = 0;
+            for (int i = 0; i < assignment.count(); ++i)
+                changes += next[i] != assignment[i];
+
+            assignment = next;
+            get_centroids(s, assignment, keys, palette);
+
+            if (!changes)
+                break;
+        }
+    }
+
+    return palette;
+}
+
+/*
+ * Remapping to an existing palette
+ */
+
+static array<vec3> get_keys(array<vec4> const &palette, ColorSpace space)
+{
+    array<vec3> keys;
+    for (auto const &c : palette)
+        keys.push(to_space(c, space));
+    return keys;
+}
+
+image image::remap(array<vec4> const &palette, ColorSpace space) const
+{
+    ASSERT(palette.count() > 0, "cannot remap to an empty palette");
+
+    image ret = *this;
+    int width = size().x;
+    color_tree tree(get_keys(palette, space));
+
+    vec4 *pixels = ret.lock<PixelFormat::RGBA_F32>();
+    parallel_for(size().y, [&](int y0, int y1)
+    {
+        for (ptrdiff_t n = (ptrdiff_t)y0 * width; n < (ptrdiff_t)y1 * width; ++n)
+            pixels[n] = palette[tree.nearest(to_space(pixels[n], space))];
+    }, 16);
+    ret.unlock(pixels);
+
+    return ret;
+}
+
+image image::remap_indices(array<vec4> const &palette, ColorSpace space) const
+{
+    ASSERT(palette.count() > 0, "cannot remap to an empty palette");
+    ASSERT(palette.count() <= 256, "palette has more than 256 colours");
+
+    image tmp = *this;
+    image ret(size());
+    int width = size().x;
+    color_tree tree(get_keys(palette, space));
+
+    vec4 const *srcp = tmp.lock<PixelFormat::RGBA_F32>();
+    uint8_t *dstp = ret.lock<PixelFormat::Y_8>();
+    parallel_for(size().y, [&](int y0, int y1)
+    {
+        for (ptrdiff_t n = (ptrdiff_t)y0 * width; n < (ptrdiff_t)y1 * width; ++n)
+            dstp[n] = (uint8_t)tree.nearest(to_space(srcp[n], space));
+    }, 16);
+    ret.unlock(dstp);
+    tmp.unlock(srcp);
+
+    return ret;
+}
+
+/* Same as the monochrome dither_ediff(), except that each pixel snaps to
+ * the closest palette colour and the error is diffused per channel. */
+image image::dither_ediff(array2d<float> const &ker,
+                          array<vec4> const &palette, ScanMode scan) const
+{
+    ASSERT(palette.count() > 0, "cannot dither to an empty palette");
+
+    image dst = *this;
+
+    ivec2 isize = dst.size();
+    ivec2 ksize = ker.size();
+    color_tree tree(get_keys(palette, ColorSpace::RGB));
+
+    int kx;
+    for (kx = 0; kx < ksize.x; kx++)
+        if (ker[kx][0] > 0.f)
+            break;
+
+    vec4 *pixels = dst.lock<PixelFormat::RGBA_F32>();
+    for (int y = 0; y < isize.y; y++)
+    {
+        bool reverse = (y & 1) && (scan == ScanMode::Serpentine);
+
+        for (int x = 0; x < isize.x; x++)
+        {
+            int x2 = reverse ? isize.x - 1 - x : x;
+            int s = reverse ? -1 : 1;
+
+            vec4 p = pixels[y * isize.x + x2];
+            vec4 q = palette[tree.nearest(p.rgb)];
+            pixels[y * isize.x + x2] = q;
+
+            vec3 e = p.rgb - q.rgb;
+
+            for (int j = 0; j < ksize.y && y < isize.y - j; j++)
+                for (int i = 0; i < ksize.x; i++)
+                {
+                    if (j == 0 && i <= kx)
+                        continue;
+
+                    if (x + i - kx < 0 || x + i - kx >= isize.x)
+                        continue;
+
+                    vec4 &t = pixels[(y + j) * isize.x + x2 + (i - kx) * s];
+                    t = vec4(t.rgb + e * ker[i][j], t.a);
+                }
+        }
+    }
+    dst.unlock(pixels);
+
+    return dst;
+}
+
+} /* namespace lol */
+
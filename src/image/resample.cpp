@@ -12,6 +12,10 @@
 
 #include <lol/engine-internal.h>
 
+#if defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
 /*
  * Image resizing functions
  */
@@ -19,7 +23,8 @@
 namespace lol
 {
 
-static image ResizeBicubic(image &src, ivec2 size);
+static image ResizeSeparable(image &src, ivec2 size,
+                             ResampleAlgorithm algorithm);
 static image ResizeBresenham(image &src, ivec2 size);
 
 image image::Resize(ivec2 size, ResampleAlgorithm algorithm)
@@ -27,101 +32,313 @@ image image::Resize(ivec2 size, ResampleAlgorithm algorithm)
     switch (algorithm)
     {
         case ResampleAlgorithm::Bicubic:
-            return ResizeBicubic(*this, size);
+        case ResampleAlgorithm::Box:
+        case ResampleAlgorithm::Bilinear:
+        case ResampleAlgorithm::Mitchell:
+        case ResampleAlgorithm::Lanczos3:
+            return ResizeSeparable(*this, size, algorithm);
         case ResampleAlgorithm::Bresenham:
         default:
             return ResizeBresenham(*this, size);
     }
 }
 
-static image ResizeBicubic(image &src, ivec2 size)
+/*
+ * Separable resampling filters. They are expressed in source pixel units
+ * and are stretched by the scaling ratio when downscaling, so that every
+ * source pixel contributes to the result (area averaging).
+ */
+
+static float box_filter(float t)
 {
-    image dst(size);
-    ivec2 const oldsize = src.size();
+    return t >= -0.5f && t < 0.5f ? 1.f : 0.f;
+}
 
-    vec4 const *srcp = src.lock<PixelFormat::RGBA_F32>();
-    vec4 *dstp = dst.lock<PixelFormat::RGBA_F32>();
+static float triangle_filter(float t)
+{
+    t = lol::abs(t);
+    return t < 1.f ? 1.f - t : 0.f;
+}
+
+/* Mitchell–Netravali cubics: (B, C) = (0, ½) is Catmull-Rom, which is
+ * what the historical bicubic implementation used, and (⅓, ⅓) is the
+ * filter recommended by Mitchell and Netravali. */
+static inline float cubic_filter(float t, float b, float c)
+{
+    t = lol::abs(t);
+    if (t < 1.f)
+        return ((12.f - 9.f * b - 6.f * c) * t * t * t
+                 + (-18.f + 12.f * b + 6.f * c) * t * t
+                 + (6.f - 2.f * b)) / 6.f;
+    if (t < 2.f)
+        return ((-b - 6.f * c) * t * t * t
+                 + (6.f * b + 30.f * c) * t * t
+                 + (-12.f * b - 48.f * c) * t
+                 + (8.f * b + 24.f * c)) / 6.f;
+    return 0.f;
+}
+
+static float catmull_rom_filter(float t)
+{
+    return cubic_filter(t, 0.f, 0.5f);
+}
+
+static float mitchell_filter(float t)
+{
+    return cubic_filter(t, 1.f / 3.f, 1.f / 3.f);
+}
+
+static inline float sinc(float t)
+{
+    if (lol::abs(t) < 1e-6f)
+        return 1.f;
+    return lol::sin(F_PI * t) / (F_PI * t);
+}
+
+static float lanczos3_filter(float t)
+{
+    return lol::abs(t) < 3.f ? sinc(t) * sinc(t / 3.f) : 0.f;
+}
+
+struct resample_filter
+{
+    float (*eval)(float);
+    float support;
+};
+
+static resample_filter get_filter(ResampleAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case ResampleAlgorithm::Box: return { box_filter, 0.5f };
+        case ResampleAlgorithm::Bilinear: return { triangle_filter, 1.f };
+        case ResampleAlgorithm::Mitchell: return { mitchell_filter, 2.f };
+        case ResampleAlgorithm::Lanczos3: return { lanczos3_filter, 3.f };
+        case ResampleAlgorithm::Bicubic:
+        default: return { catmull_rom_filter, 2.f };
+    }
+}
+
+/*
+ * Filter weights for one dimension. They only depend on the source and
+ * destination sizes, so they are computed once per row (or column) of the
+ * destination instead of once per pixel. Taps falling outside the source
+ * are dropped and the remaining weights renormalised, which removes all
+ * index clamping from the inner loops.
+ */
+
+struct resample_weights
+{
+    resample_weights(int src_size, int dst_size, resample_filter const &f)
+    {
+        float ratio = (float)src_size / dst_size;
+        float fscale = lol::max(ratio, 1.f);
+        float support = f.support * fscale;
+
+        taps = (int)lol::ceil(support) * 2 + 1;
+        first.resize(dst_size);
+        count.resize(dst_size);
+        coeffs.resize(dst_size * taps, 0.f);
+        fixed.resize(dst_size * taps, 0);
+
+        for (int i = 0; i < dst_size; ++i)
+        {
+            float center = (i + 0.5f) * ratio;
+            int xmin = lol::max((int)(center - support + 0.5f), 0);
+            int xmax = lol::min((int)(center + support + 0.5f), src_size);
+            xmax = lol::min(xmax, xmin + taps);
+
+            float *w = &coeffs[i * taps];
+            float total = 0.f;
+            for (int x = xmin; x < xmax; ++x)
+                total += w[x - xmin] = f.eval((x + 0.5f - center) / fscale);
+
+            /* Can only happen with the box filter on exact boundaries */
+            if (total == 0.f)
+            {
+                xmin = lol::min((int)center, src_size - 1);
+                xmax = xmin + 1;
+                w[0] = total = 1.f;
+            }
+
+            first[i] = xmin;
+            count[i] = xmax - xmin;
+
+            /* Fixed-point weights for 8-bit paths; the rounding residual
+             * goes to the central tap so that each set sums to exactly 1. */
+            int16_t *fw = &fixed[i * taps];
+            int sum = 0, best = 0;
+            for (int k = 0; k < count[i]; ++k)
+            {
+                w[k] /= total;
+                fw[k] = (int16_t)lol::round(w[k] * (1 << FIXED_BITS));
+                sum += fw[k];
+                if (w[k] > w[best])
+                    best = k;
+            }
+            fw[best] += (int16_t)((1 << FIXED_BITS) - sum);
+        }
+    }
+
+    static int const FIXED_BITS = 14;
+
+    int taps;
+    array<int> first, count;
+    array<float> coeffs;
+    array<int16_t> fixed;
+};
+
+/*
+ * Floating point path: one vec4 maps to one SSE register, so the inner
+ * loops are plain multiply-adds on whole pixels.
+ */
+
+static inline void madd(vec4 &acc, vec4 const &p, float w)
+{
+#if defined __SSE__
+    __m128 a = _mm_loadu_ps(&acc.x);
+    a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(&p.x), _mm_set1_ps(w)));
+    _mm_storeu_ps(&acc.x, a);
+#else
+    acc += p * w;
+#endif
+}
+
+static void resample_rows(vec4 const *src, int src_width, vec4 *dst,
+                          int dst_width, int y0, int y1,
+                          resample_weights const &wx)
+{
+    for (int y = y0; y < y1; ++y)
+    {
+        vec4 const *line = src + (ptrdiff_t)y * src_width;
+        vec4 *out = dst + (ptrdiff_t)y * dst_width;
+
+        for (int x = 0; x < dst_width; ++x)
+        {
+            vec4 const *p = line + wx.first[x];
+            float const *w = &wx.coeffs[x * wx.taps];
+            vec4 acc(0.f);
+            for (int k = 0; k < wx.count[x]; ++k)
+                madd(acc, p[k], w[k]);
+            out[x] = acc;
+        }
+    }
+}
+
+static void resample_columns(vec4 const *src, vec4 *dst, int width,
+                             int y0, int y1, resample_weights const &wy)
+{
+    for (int y = y0; y < y1; ++y)
+    {
+        vec4 *out = dst + (ptrdiff_t)y * width;
+        vec4 const *p = src + (ptrdiff_t)wy.first[y] * width;
+        float const *w = &wy.coeffs[y * wy.taps];
+
+        /* Accumulate whole rows to keep memory accesses sequential */
+        for (int x = 0; x < width; ++x)
+            out[x] = vec4(0.f);
+        for (int k = 0; k < wy.count[y]; ++k, p += width)
+            for (int x = 0; x < width; ++x)
+                madd(out[x], p[x], w[k]);
+        for (int x = 0; x < width; ++x)
+            out[x] = lol::clamp(out[x], 0.f, 1.f);
+    }
+}
 
-    float scalex = size.x > 1 ? (oldsize.x - 1.f) / (size.x - 1) : 1.f;
-    float scaley = size.y > 1 ? (oldsize.y - 1.f) / (size.y - 1) : 1.f;
+/*
+ * 8-bit path: fixed-point weights and integer accumulators, no conversion
+ * of the source image to floating point.
+ */
+
+static inline uint8_t fixed_to_u8(int32_t val)
+{
+    val = (val + (1 << (resample_weights::FIXED_BITS - 1)))
+            >> resample_weights::FIXED_BITS;
+    return (uint8_t)lol::clamp(val, 0, 255);
+}
 
-    for (int y = 0; y < size.y; ++y)
+static void resample_rows(u8vec4 const *src, int src_width, u8vec4 *dst,
+                          int dst_width, int y0, int y1,
+                          resample_weights const &wx)
+{
+    for (int y = y0; y < y1; ++y)
     {
-        float yfloat = scaley * y;
-        int yint = (int)yfloat;
-        float y1 = yfloat - yint;
+        u8vec4 const *line = src + (ptrdiff_t)y * src_width;
+        u8vec4 *out = dst + (ptrdiff_t)y * dst_width;
+
+        for (int x = 0; x < dst_width; ++x)
+        {
+            u8vec4 const *p = line + wx.first[x];
+            int16_t const *w = &wx.fixed[x * wx.taps];
+            int32_t r = 0, g = 0, b = 0, a = 0;
+            for (int k = 0; k < wx.count[x]; ++k)
+            {
+                r += p[k].r * w[k];
+                g += p[k].g * w[k];
+                b += p[k].b * w[k];
+                a += p[k].a * w[k];
+            }
+            out[x] = u8vec4(fixed_to_u8(r), fixed_to_u8(g),
+                            fixed_to_u8(b), fixed_to_u8(a));
+        }
+    }
+}
 
-        vec4 const *p0 = srcp + oldsize.x * lol::min(lol::max(0, yint - 1), oldsize.y - 1);
-        vec4 const *p1 = srcp + oldsize.x * lol::min(lol::max(0, yint    ), oldsize.y - 1);
-        vec4 const *p2 = srcp + oldsize.x * lol::min(lol::max(0, yint + 1), oldsize.y - 1);
-        vec4 const *p3 = srcp + oldsize.x * lol::min(lol::max(0, yint + 2), oldsize.y - 1);
+static void resample_columns(u8vec4 const *src, u8vec4 *dst, int width,
+                             int y0, int y1, resample_weights const &wy)
+{
+    /* One row of interleaved accumulators per band; the loops below
+     * operate on flat integer arrays so that compilers vectorise them. */
+    array<int32_t> acc;
+    acc.resize(width * 4);
 
-        for (int x = 0; x < size.x; ++x)
+    for (int y = y0; y < y1; ++y)
+    {
+        uint8_t const *p = &src[(ptrdiff_t)wy.first[y] * width].r;
+        int16_t const *w = &wy.fixed[y * wy.taps];
+
+        memset((void *)acc.data(), 0, acc.bytes());
+        for (int k = 0; k < wy.count[y]; ++k, p += width * 4)
         {
-            float xfloat = scalex * x;
-            int xint = (int)xfloat;
-            float x1 = xfloat - xint;
-
-            int const i0 = lol::min(lol::max(0, xint - 1), oldsize.x - 1);
-            int const i1 = lol::min(lol::max(0, xint    ), oldsize.x - 1);
-            int const i2 = lol::min(lol::max(0, xint + 1), oldsize.x - 1);
-            int const i3 = lol::min(lol::max(0, xint + 2), oldsize.x - 1);
-
-            vec4 a00 = p1[i1];
-            vec4 a01 = .5f * (p2[i1] - p0[i1]);
-            vec4 a02 = p0[i1] - 2.5f * p1[i1]
-                        + 2.f * p2[i1] - .5f * p3[i1];
-            vec4 a03 = .5f * (p3[i1] - p0[i1]) + 1.5f * (p1[i1] - p2[i1]);
-
-            vec4 a10 = .5f * (p1[i2] - p1[i0]);
-            vec4 a11 = .25f * (p0[i0] - p2[i0] - p0[i2] + p2[i2]);
-            vec4 a12 = .5f * (p0[i2] - p0[i0]) + 1.25f * (p1[i0] - p1[i2])
-                        + .25f * (p3[i0] - p3[i2]) + p2[i2] - p2[i0];
-            vec4 a13 = .25f * (p0[i0] - p3[i0] - p0[i2] + p3[i2])
-                        + .75f * (p2[i0] - p1[i0] + p1[i2] - p2[i2]);
-
-            vec4 a20 = p1[i0] - 2.5f * p1[i1]
-                        + 2.f * p1[i2] - .5f * p1[i3];
-            vec4 a21 = .5f * (p2[i0] - p0[i0]) + 1.25f * (p0[i1] - p2[i1])
-                        + .25f * (p0[i3] - p2[i3]) - p0[i2] + p2[i2];
-            vec4 a22 = p0[i0] - p3[i2] - 2.5f * (p1[i0] + p0[i1])
-                        + 2.f * (p2[i0] + p0[i2]) - .5f * (p3[i0] + p0[i3])
-                        + 6.25f * p1[i1] - 5.f * (p2[i1] + p1[i2])
-                        + 1.25f * (p3[i1] + p1[i3])
-                        + 4.f * p2[i2] - p2[i3] + .25f * p3[i3];
-            vec4 a23 = 1.5f * (p1[i0] - p2[i0]) + .5f * (p3[i0] - p0[i0])
-                        + 1.25f * (p0[i1] - p3[i1])
-                        + 3.75f * (p2[i1] - p1[i1]) + p3[i2] - p0[i2]
-                        + 3.f * (p1[i2] - p2[i2]) + .25f * (p0[i3] - p3[i3])
-                        + .75f * (p2[i3] - p1[i3]);
-
-            vec4 a30 = .5f * (p1[i3] - p1[i0]) + 1.5f * (p1[i1] - p1[i2]);
-            vec4 a31 = .25f * (p0[i0] - p2[i0]) + .25f * (p2[i3] - p0[i3])
-                        + .75f * (p2[i1] - p0[i1] + p0[i2] - p2[i2]);
-            vec4 a32 = -.5f * p0[i0] + 1.25f * p1[i0] - p2[i0]
-                        + .25f * p3[i0] + 1.5f * p0[i1] - 3.75f * p1[i1]
-                        + 3.f * p2[i1] - .75f * p3[i1] - 1.5f * p0[i2]
-                        + 3.75f * p1[i2] - 3.f * p2[i2] + .75f * p3[i2]
-                        + .5f * p0[i3] - 1.25f * p1[i3] + p2[i3]
-                        - .25f * p3[i3];
-            vec4 a33 = .25f * p0[i0] - .75f * p1[i0] + .75f * p2[i0]
-                        - .25f * p3[i0] - .75f * p0[i1] + 2.25f * p1[i1]
-                        - 2.25f * p2[i1] + .75f * p3[i1] + .75f * p0[i2]
-                        - 2.25f * p1[i2] + 2.25f * p2[i2] - .75f * p3[i2]
-                        - .25f * p0[i3] + .75f * p1[i3] - .75f * p2[i3]
-                        + .25f * p3[i3];
-
-            float y2 = y1 * y1; float y3 = y2 * y1;
-            float x2 = x1 * x1; float x3 = x2 * x1;
-
-            vec4 p = a00 + a01 * y1 + a02 * y2 + a03 * y3
-                   + a10 * x1 + a11 * x1 * y1 + a12 * x1 * y2 + a13 * x1 * y3
-                   + a20 * x2 + a21 * x2 * y1 + a22 * x2 * y2 + a23 * x2 * y3
-                   + a30 * x3 + a31 * x3 * y1 + a32 * x3 * y2 + a33 * x3 * y3;
-
-            dstp[y * size.x + x] = lol::clamp(p, 0.f, 1.f);
+            int32_t *a = acc.data();
+            int32_t const wk = w[k];
+            for (int x = 0; x < width * 4; ++x)
+                a[x] += p[x] * wk;
         }
+
+        uint8_t *out = &dst[(ptrdiff_t)y * width].r;
+        for (int x = 0; x < width * 4; ++x)
+            out[x] = fixed_to_u8(acc[x]);
     }
+}
+
+/* Horizontal pass into an intermediate buffer, then vertical pass into
+ * the destination; both passes are split into bands of rows. */
+template<PixelFormat T>
+static image resize_separable(image &src, ivec2 size,
+                              resample_weights const &wx,
+                              resample_weights const &wy)
+{
+    typedef typename PixelType<T>::type pixel_t;
+
+    image dst(size);
+    ivec2 const oldsize = src.size();
+
+    pixel_t const *srcp = src.lock<T>();
+    pixel_t *dstp = dst.lock<T>();
+
+    array<pixel_t> tmp;
+    tmp.resize(size.x * oldsize.y);
+
+    parallel_for(oldsize.y, [&](int y0, int y1)
+    {
+        resample_rows(srcp, oldsize.x, tmp.data(), size.x, y0, y1, wx);
+    }, 16);
+
+    parallel_for(size.y, [&](int y0, int y1)
+    {
+        resample_columns(tmp.data(), dstp, size.x, y0, y1, wy);
+    }, 16);
 
     dst.unlock(dstp);
     src.unlock(srcp);
@@ -129,6 +346,29 @@ static image ResizeBicubic(image &src, ivec2 size)
     return dst;
 }
 
+static image ResizeSeparable(image &src, ivec2 size,
+                             ResampleAlgorithm algorithm)
+{
+    resample_filter const f = get_filter(algorithm);
+    ivec2 const oldsize = src.size();
+
+    if (size.x <= 0 || size.y <= 0 || oldsize.x <= 0 || oldsize.y <= 0)
+        return image(lol::max(size, ivec2(0)));
+
+    resample_weights wx(oldsize.x, size.x, f);
+    resample_weights wy(oldsize.y, size.y, f);
+
+    switch (src.format())
+    {
+        case PixelFormat::Y_8:
+        case PixelFormat::RGB_8:
+        case PixelFormat::RGBA_8:
+            return resize_separable<PixelFormat::RGBA_8>(src, size, wx, wy);
+        default:
+            return resize_separable<PixelFormat::RGBA_F32>(src, size, wx, wy);
+    }
+}
+
 /* This is Bresenham resizing. I “rediscovered” it independently but
  * it was actually first described in 1995 by Tim Kientzle in “Scaling
  * Bitmaps with Bresenham”. */
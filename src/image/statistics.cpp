@@ -0,0 +1,424 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2004—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <algorithm>
+#include <mutex>
+
+#if defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
+/*
+ * Image statistics: min/max, sum, mean/variance, histograms, percentiles
+ * and summed-area tables.
+ *
+ * Images are cut into tiles of whole rows that are reduced in parallel.
+ * Floating point results are always combined tile by tile in the same
+ * order, so they do not depend on the number of threads. Integer results
+ * such as histograms are merged as threads finish.
+ */
+
+namespace lol
+{
+
+/* Rows per tile */
+static int const STATS_TILE = 16;
+/* Bins of the first pass of percentile() */
+static int const STATS_BINS = 4096;
+/* Lanes summed in single precision before moving to double precision */
+static int const STATS_CHUNK = 256;
+
+/* Count, extrema, mean and sum of squared deviations of a set of pixels */
+struct stats_partial
+{
+    int count = 0;
+    vec4 min = vec4(0.f), max = vec4(0.f);
+    dvec4 mean = dvec4(0.0), m2 = dvec4(0.0);
+
+    /* Merge another set (Chan et al.); the order of merges is fixed by
+     * the callers, which keeps results deterministic. */
+    void merge(stats_partial const &other)
+    {
+        if (!other.count)
+            return;
+
+        if (!count)
+        {
+            *this = other;
+            return;
+        }
+
+        double const n = (double)count + other.count;
+        dvec4 const delta = other.mean - mean;
+        mean += delta * ((double)other.count / n);
+        m2 += other.m2 + delta * delta * ((double)count * other.count / n);
+        min = lol::min(min, other.min);
+        max = lol::max(max, other.max);
+        count += other.count;
+    }
+};
+
+/* Sums of n lanes of four floats, shifted by k so that the single
+ * precision accumulators keep their accuracy. */
+struct stats_lanes
+{
+    vec4 s1, s2, min, max;
+};
+
+static void stats_accumulate(float const *p, int n, vec4 k, stats_lanes &ret)
+{
+#if defined __SSE__
+    __m128 const vk = _mm_loadu_ps(&k.x);
+    __m128 s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps();
+    __m128 mn = _mm_loadu_ps(p), mx = mn;
+
+    for (int i = 0; i < n; ++i)
+    {
+        __m128 v = _mm_loadu_ps(p + 4 * i);
+        __m128 d = _mm_sub_ps(v, vk);
+        s1 = _mm_add_ps(s1, d);
+        s2 = _mm_add_ps(s2, _mm_mul_ps(d, d));
+        mn = _mm_min_ps(mn, v);
+        mx = _mm_max_ps(mx, v);
+    }
+
+    _mm_storeu_ps(&ret.s1.x, s1);
+    _mm_storeu_ps(&ret.s2.x, s2);
+    _mm_storeu_ps(&ret.min.x, mn);
+    _mm_storeu_ps(&ret.max.x, mx);
+#else
+    ret.s1 = ret.s2 = vec4(0.f);
+    ret.min = ret.max = vec4(p[0], p[1], p[2], p[3]);
+
+    for (int i = 0; i < n; ++i)
+    {
+        vec4 v(p[4 * i], p[4 * i + 1], p[4 * i + 2], p[4 * i + 3]);
+        vec4 d = v - k;
+        ret.s1 += d;
+        ret.s2 += d * d;
+        ret.min = lol::min(ret.min, v);
+        ret.max = lol::max(ret.max, v);
+    }
+#endif
+}
+
+/* Sums of the shifted values of a row of n lanes, in double precision */
+static void stats_sums(float const *p, int n, vec4 k, dvec4 &s1, dvec4 &s2,
+                       vec4 &mn, vec4 &mx)
+{
+    s1 = s2 = dvec4(0.0);
+    mn = mx = vec4(p[0], p[1], p[2], p[3]);
+
+    for (int i = 0; i < n; i += STATS_CHUNK)
+    {
+        stats_lanes lanes;
+        stats_accumulate(p + 4 * i, lol::min(STATS_CHUNK, n - i), k, lanes);
+        s1 += dvec4(lanes.s1);
+        s2 += dvec4(lanes.s2);
+        mn = lol::min(mn, lanes.min);
+        mx = lol::max(mx, lanes.max);
+    }
+}
+
+static stats_partial stats_row(vec4 const *p, int width)
+{
+    dvec4 s1, s2;
+    stats_partial ret;
+    stats_sums(&p[0].x, width, p[0], s1, s2, ret.min, ret.max);
+
+    ret.count = width;
+    ret.mean = dvec4(p[0]) + s1 / (double)width;
+    ret.m2 = lol::max(s2 - s1 * s1 / (double)width, dvec4(0.0));
+    return ret;
+}
+
+/* Grey rows are read four pixels at a time, then the lanes are summed */
+static stats_partial stats_row(float const *p, int width)
+{
+    int const quads = width / 4;
+    double s1 = 0.0, s2 = 0.0;
+    float mn = p[0], mx = p[0];
+
+    if (quads)
+    {
+        dvec4 l1, l2;
+        vec4 lmin, lmax;
+        stats_sums(p, quads, vec4(p[0]), l1, l2, lmin, lmax);
+        s1 = l1.x + l1.y + l1.z + l1.w;
+        s2 = l2.x + l2.y + l2.z + l2.w;
+        mn = lol::min(lol::min(lmin.x, lmin.y), lol::min(lmin.z, lmin.w));
+        mx = lol::max(lol::max(lmax.x, lmax.y), lol::max(lmax.z, lmax.w));
+    }
+
+    for (int x = quads * 4; x < width; ++x)
+    {
+        double d = (double)p[x] - p[0];
+        s1 += d;
+        s2 += d * d;
+        mn = lol::min(mn, p[x]);
+        mx = lol::max(mx, p[x]);
+    }
+
+    stats_partial ret;
+    ret.count = width;
+    ret.min = vec4(mn, 0.f, 0.f, 0.f);
+    ret.max = vec4(mx, 0.f, 0.f, 0.f);
+    ret.mean = dvec4(p[0] + s1 / width, 0.0, 0.0, 0.0);
+    ret.m2 = dvec4(lol::max(s2 - s1 * s1 / width, 0.0), 0.0, 0.0, 0.0);
+    return ret;
+}
+
+template<typename T>
+static stats_partial stats_reduce(T const *pixels, ivec2 size)
+{
+    int const tiles = (size.y + STATS_TILE - 1) / STATS_TILE;
+    array<stats_partial> partials;
+    partials.resize(tiles);
+
+    parallel_for(tiles, [&](int t0, int t1)
+    {
+        for (int t = t0; t < t1; ++t)
+        {
+            int const y1 = lol::min((t + 1) * STATS_TILE, size.y);
+            for (int y = t * STATS_TILE; y < y1; ++y)
+                partials[t].merge(stats_row(pixels + (ptrdiff_t)y * size.x,
+                                            size.x));
+        }
+    });
+
+    stats_partial ret;
+    for (auto const &partial : partials)
+        ret.merge(partial);
+    return ret;
+}
+
+image::pixel_stats image::statistics() const
+{
+    ivec2 const isize = size();
+    image tmp = *this;
+    stats_partial partial;
+
+    if (isize.x > 0 && isize.y > 0)
+    {
+        if (format() == PixelFormat::Y_8 || format() == PixelFormat::Y_F32)
+        {
+            float const *pixels = tmp.lock<PixelFormat::Y_F32>();
+            partial = stats_reduce(pixels, isize);
+            tmp.unlock(pixels);
+        }
+        else
+        {
+            vec4 const *pixels = tmp.lock<PixelFormat::RGBA_F32>();
+            partial = stats_reduce(pixels, isize);
+            tmp.unlock(pixels);
+        }
+    }
+
+    pixel_stats ret;
+    ret.count = partial.count;
+    ret.min = partial.min;
+    ret.max = partial.max;
+    ret.sum = partial.mean * (double)partial.count;
+    ret.mean = partial.mean;
+    ret.variance = partial.count ? partial.m2 / (double)partial.count
+                                 : dvec4(0.0);
+    return ret;
+}
+
+/* Call fn(p, channels, count) on bands of grey or RGBA pixels, where p
+ * points to “count” pixels of “channels” floats each. */
+template<typename T>
+static void stats_bands(image const &img, T const &fn)
+{
+    ivec2 const isize = img.size();
+    image tmp = img;
+
+    if (img.format() == PixelFormat::Y_8 || img.format() == PixelFormat::Y_F32)
+    {
+        float const *pixels = tmp.lock<PixelFormat::Y_F32>();
+        parallel_for(isize.y, [&](int y0, int y1)
+        {
+            fn(pixels + (ptrdiff_t)y0 * isize.x, 1, (y1 - y0) * isize.x);
+        }, STATS_TILE);
+        tmp.unlock(pixels);
+    }
+    else
+    {
+        vec4 const *pixels = tmp.lock<PixelFormat::RGBA_F32>();
+        parallel_for(isize.y, [&](int y0, int y1)
+        {
+            fn(&pixels[(ptrdiff_t)y0 * isize.x].x, 4, (y1 - y0) * isize.x);
+        }, STATS_TILE);
+        tmp.unlock(pixels);
+    }
+}
+
+array<ivec4> image::histogram(int bins) const
+{
+    array<ivec4> ret;
+    ret.resize(lol::max(bins, 1), ivec4(0));
+    std::mutex mutex;
+
+    stats_bands(*this, [&](float const *p, int channels, int count)
+    {
+        array<ivec4> local;
+        local.resize(ret.count(), ivec4(0));
+
+        for (int n = 0; n < count; ++n, p += channels)
+            for (int c = 0; c < channels; ++c)
+            {
+                int bin = (int)(lol::clamp(p[c], 0.f, 1.f) * ret.count());
+                ++local[lol::min(bin, ret.count() - 1)][c];
+            }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < ret.count(); ++i)
+            ret[i] += local[i];
+    });
+
+    return ret;
+}
+
+vec4 image::percentile(float p) const
+{
+    pixel_stats const st = statistics();
+    if (!st.count)
+        return vec4(0.f);
+
+    /* Bin the values between the extrema, find the bin that holds the
+     * requested rank, then select the exact value among that bin. */
+    int const rank = (int)lol::round(lol::clamp(p, 0.f, 1.f) * (st.count - 1));
+    vec4 const scale = vec4((float)STATS_BINS)
+                     / lol::max(st.max - st.min, vec4(1e-30f));
+
+    auto bin_of = [&](float v, int c)
+    {
+        return lol::min((int)((v - st.min[c]) * scale[c]), STATS_BINS - 1);
+    };
+
+    array<ivec4> bins;
+    bins.resize(STATS_BINS, ivec4(0));
+    std::mutex mutex;
+
+    stats_bands(*this, [&](float const *q, int channels, int count)
+    {
+        array<ivec4> local;
+        local.resize(STATS_BINS, ivec4(0));
+        for (int n = 0; n < count; ++n, q += channels)
+            for (int c = 0; c < channels; ++c)
+                ++local[bin_of(q[c], c)][c];
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < STATS_BINS; ++i)
+            bins[i] += local[i];
+    });
+
+    ivec4 target(-1), offset(0);
+    for (int c = 0; c < 4; ++c)
+        for (int i = 0, seen = 0; i < STATS_BINS && target[c] < 0; ++i)
+        {
+            if (seen + bins[i][c] > rank)
+            {
+                target[c] = i;
+                offset[c] = rank - seen;
+            }
+            seen += bins[i][c];
+        }
+
+    /* The selected value does not depend on the order of the candidates */
+    array<float> candidates[4];
+    stats_bands(*this, [&](float const *q, int channels, int count)
+    {
+        array<float> local[4];
+        for (int n = 0; n < count; ++n, q += channels)
+            for (int c = 0; c < channels; ++c)
+                if (bin_of(q[c], c) == target[c])
+                    local[c] << q[c];
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int c = 0; c < 4; ++c)
+            candidates[c] += local[c];
+    });
+
+    vec4 ret(0.f);
+    for (int c = 0; c < 4; ++c)
+    {
+        array<float> &list = candidates[c];
+        if (!list.count())
+            continue;
+        std::nth_element(&list[0], &list[0] + offset[c],
+                         &list[0] + list.count());
+        ret[c] = list[offset[c]];
+    }
+    return ret;
+}
+
+static inline dvec4 stats_value(float v) { return dvec4(v, 0.0, 0.0, 0.0); }
+static inline dvec4 stats_value(vec4 v) { return dvec4(v); }
+
+/* Prefix sums along rows, then down columns in strips */
+template<typename T>
+static void stats_summed_area(T const *pixels, dvec4 *sat, ivec2 size)
+{
+    parallel_for(size.y, [&](int y0, int y1)
+    {
+        for (int y = y0; y < y1; ++y)
+        {
+            T const *line = pixels + (ptrdiff_t)y * size.x;
+            dvec4 *out = sat + (ptrdiff_t)y * size.x;
+            dvec4 sum(0.0);
+            for (int x = 0; x < size.x; ++x)
+                out[x] = sum += stats_value(line[x]);
+        }
+    }, STATS_TILE);
+
+    parallel_for(size.x, [&](int x0, int x1)
+    {
+        for (int y = 1; y < size.y; ++y)
+        {
+            dvec4 const *prev = sat + (ptrdiff_t)(y - 1) * size.x;
+            dvec4 *out = sat + (ptrdiff_t)y * size.x;
+            for (int x = x0; x < x1; ++x)
+                out[x] += prev[x];
+        }
+    }, 64);
+}
+
+array2d<dvec4> image::summed_area() const
+{
+    ivec2 const isize = size();
+    image tmp = *this;
+    array2d<dvec4> ret(isize);
+
+    if (isize.x <= 0 || isize.y <= 0)
+        return ret;
+
+    if (format() == PixelFormat::Y_8 || format() == PixelFormat::Y_F32)
+    {
+        float const *pixels = tmp.lock<PixelFormat::Y_F32>();
+        stats_summed_area(pixels, &ret[0][0], isize);
+        tmp.unlock(pixels);
+    }
+    else
+    {
+        vec4 const *pixels = tmp.lock<PixelFormat::RGBA_F32>();
+        stats_summed_area(pixels, &ret[0][0], isize);
+        tmp.unlock(pixels);
+    }
+
+    return ret;
+}
+
+} /* namespace lol */
+
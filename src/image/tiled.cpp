@@ -0,0 +1,459 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN 1
+#   include <windows.h>
+#   undef WIN32_LEAN_AND_MEAN
+#elif defined HAVE_SYS_MMAN_H && defined HAVE_UNISTD_H
+#   include <sys/mman.h>
+#   include <unistd.h>
+#   define LOL_TILED_MMAP 1
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+/*
+ * Tiled images
+ *
+ * Tile n lives at offset n × tile_bytes in the scratch file, where
+ * tile_bytes is rounded up to the mapping granularity. Resident tiles are
+ * either mapped views of the file, or heap copies that are written back
+ * when evicted on platforms without memory mapping, or when the mapping
+ * could not be created. New tiles read as zeroes in both cases. Dirty heap
+ * tiles that cannot be written back are never evicted.
+ */
+
+namespace lol
+{
+
+/* Default memory budget for resident tiles */
+static size_t const TILED_DEFAULT_BUDGET = 256 << 20;
+
+/* Scratch files easily exceed 2 GiB, which a long cannot always reach */
+static bool seek_scratch(FILE *f, uint64_t offset)
+{
+#if defined(_WIN32)
+    return _fseeki64(f, (__int64)offset, SEEK_SET) == 0;
+#else
+    return (uint64_t)(off_t)offset == offset
+            && fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+class tiled_image_data
+{
+    friend class tiled_image;
+
+    struct tile
+    {
+        uint8_t *data = nullptr;
+        int pins = 0;
+        bool dirty = false;
+        uint64_t last_use = 0;
+    };
+
+    tiled_image_data(ivec2 size, PixelFormat format, ivec2 tile_size)
+      : m_size(size),
+        m_tile_size(tile_size),
+        m_tile_count((size + tile_size - ivec2(1)) / tile_size),
+        m_format(format),
+        m_pixel_bytes(BytesPerPixel(format)),
+        m_budget(TILED_DEFAULT_BUDGET)
+    {
+        m_tiles.resize(m_tile_count.x * m_tile_count.y);
+
+        size_t granularity = 1;
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        granularity = info.dwAllocationGranularity;
+#elif LOL_TILED_MMAP
+        granularity = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+        size_t bytes = (size_t)m_tile_size.x * m_tile_size.y * m_pixel_bytes;
+        m_tile_bytes = (bytes + granularity - 1) / granularity * granularity;
+
+        open_scratch((uint64_t)m_tile_bytes * m_tiles.count());
+    }
+
+    ~tiled_image_data()
+    {
+        /* The scratch file is discarded, so skip writing tiles back */
+        for (int n = 0; n < m_resident.count(); ++n)
+        {
+            m_tiles[m_resident[n]].dirty = false;
+            unload(m_resident[n]);
+        }
+        close_scratch();
+    }
+
+    /* Scratch file management */
+    void open_scratch(uint64_t total)
+    {
+#if defined(_WIN32)
+        char dir[MAX_PATH], path[MAX_PATH];
+        m_handle = INVALID_HANDLE_VALUE;
+        m_mapping = nullptr;
+        if (GetTempPathA(MAX_PATH, dir) && GetTempFileNameA(dir, "lol", 0, path))
+            m_handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0,
+                                   nullptr, CREATE_ALWAYS,
+                                   FILE_ATTRIBUTE_TEMPORARY
+                                    | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (m_handle != INVALID_HANDLE_VALUE && total)
+            m_mapping = CreateFileMappingA(m_handle, nullptr, PAGE_READWRITE,
+                                           (DWORD)(total >> 32),
+                                           (DWORD)total, nullptr);
+        /* Fall back to heap tiles backed by a plain file */
+        if (!m_mapping && total)
+        {
+            m_file = tmpfile();
+            if (!m_file)
+                msg::error("cannot create tiled image scratch file\n");
+        }
+#else
+        m_file = tmpfile();
+        if (!m_file)
+            msg::error("cannot create tiled image scratch file\n");
+#   if LOL_TILED_MMAP
+        else if ((uint64_t)(off_t)total != total
+                  || ftruncate(fileno(m_file), (off_t)total) != 0)
+            msg::error("cannot resize tiled image scratch file\n");
+#   else
+        UNUSED(total);
+#   endif
+#endif
+    }
+
+    void close_scratch()
+    {
+#if defined(_WIN32)
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        if (m_handle != INVALID_HANDLE_VALUE)
+            CloseHandle(m_handle);
+#endif
+        if (m_file)
+            fclose(m_file);
+    }
+
+    /* Bring a tile into memory; called with the mutex held */
+    void load(int n)
+    {
+        uint64_t offset = (uint64_t)n * m_tile_bytes;
+        uint8_t *data = nullptr;
+
+#if defined(_WIN32)
+        if (m_mapping)
+            data = (uint8_t *)MapViewOfFile(m_mapping, FILE_MAP_WRITE,
+                                            (DWORD)(offset >> 32),
+                                            (DWORD)offset, m_tile_bytes);
+#elif LOL_TILED_MMAP
+        if (m_file)
+        {
+            void *p = mmap(nullptr, m_tile_bytes, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fileno(m_file), (off_t)offset);
+            data = p == MAP_FAILED ? nullptr : (uint8_t *)p;
+        }
+#endif
+
+        /* Without a mapping, keep a heap copy of the tile */
+        if (!data)
+        {
+            data = new uint8_t[m_tile_bytes];
+            size_t done = 0;
+            if (m_file && seek_scratch(m_file, offset))
+                done = fread(data, 1, m_tile_bytes, m_file);
+            memset(data + done, 0, m_tile_bytes - done);
+            m_heap.resize(m_tiles.count(), false);
+            m_heap[n] = true;
+        }
+
+        m_tiles[n].data = data;
+        m_resident << n;
+        m_usage += m_tile_bytes;
+    }
+
+    bool is_heap(int n) const
+    {
+        return m_heap.count() && m_heap[n];
+    }
+
+    bool write_back(int n)
+    {
+        uint64_t offset = (uint64_t)n * m_tile_bytes;
+        return m_file && seek_scratch(m_file, offset)
+                && fwrite(m_tiles[n].data, 1, m_tile_bytes, m_file)
+                    == m_tile_bytes;
+    }
+
+    /* Release a tile, or return false and keep it if its pixels could not
+     * be written back to the scratch file */
+    bool unload(int n)
+    {
+        tile &t = m_tiles[n];
+
+        if (is_heap(n))
+        {
+            if (t.dirty && !write_back(n))
+                return false;
+            delete[] t.data;
+            m_heap[n] = false;
+        }
+        else
+        {
+#if defined(_WIN32)
+            UnmapViewOfFile(t.data);
+#elif LOL_TILED_MMAP
+            munmap(t.data, m_tile_bytes);
+#endif
+        }
+
+        t.data = nullptr;
+        t.dirty = false;
+        m_usage -= m_tile_bytes;
+        return true;
+    }
+
+    /* Evict least recently used tiles until the budget is met */
+    void trim()
+    {
+        while (m_usage > m_budget)
+        {
+            int best = -1;
+            for (int i = 0; i < m_resident.count(); ++i)
+            {
+                tile const &t = m_tiles[m_resident[i]];
+                if (t.pins || (t.dirty && is_heap(m_resident[i]) && !m_file))
+                    continue;
+                if (best < 0 || t.last_use < m_tiles[m_resident[best]].last_use)
+                    best = i;
+            }
+
+            /* Stay over budget rather than lose pixels */
+            if (best < 0 || !unload(m_resident[best]))
+                break;
+
+            m_resident.remove_swap(best);
+        }
+    }
+
+    uint8_t *pin(int n)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tile &t = m_tiles[n];
+        if (!t.data)
+            load(n);
+        ++t.pins;
+        t.last_use = ++m_clock;
+        trim();
+        return t.data;
+    }
+
+    void unpin(int n, bool dirty)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tile &t = m_tiles[n];
+        --t.pins;
+        t.dirty |= dirty;
+        trim();
+    }
+
+    ivec2 m_size, m_tile_size, m_tile_count;
+    PixelFormat m_format;
+    size_t m_pixel_bytes, m_tile_bytes;
+    size_t m_budget, m_usage = 0;
+    uint64_t m_clock = 0;
+
+    array<tile> m_tiles;
+    array<int> m_resident;
+    array<bool> m_heap;
+    std::mutex m_mutex;
+
+    FILE *m_file = nullptr;
+#if defined(_WIN32)
+    HANDLE m_handle, m_mapping;
+#endif
+};
+
+tiled_image::tiled_image(ivec2 size, PixelFormat format, ivec2 tile_size)
+{
+    ASSERT(format == PixelFormat::Y_F32 || format == PixelFormat::RGBA_F32,
+           "tiled images only support Y_F32 and RGBA_F32");
+    m_data = new tiled_image_data(lol::max(size, ivec2(0)), format,
+                                  lol::max(tile_size, ivec2(1)));
+}
+
+tiled_image::~tiled_image()
+{
+    delete m_data;
+}
+
+ivec2 tiled_image::size() const
+{
+    return m_data->m_size;
+}
+
+PixelFormat tiled_image::format() const
+{
+    return m_data->m_format;
+}
+
+ivec2 tiled_image::tile_size() const
+{
+    return m_data->m_tile_size;
+}
+
+void tiled_image::set_cache_budget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_data->m_mutex);
+    m_data->m_budget = bytes;
+    m_data->trim();
+}
+
+size_t tiled_image::cache_budget() const
+{
+    return m_data->m_budget;
+}
+
+size_t tiled_image::cache_usage() const
+{
+    std::lock_guard<std::mutex> lock(m_data->m_mutex);
+    return m_data->m_usage;
+}
+
+void tiled_image::write(image const &src, ivec2 origin)
+{
+    copy_from(src, ibox2(ivec2(0), src.size()), origin);
+}
+
+/* Copy the “box” area of src to “origin”, clipped to the tiled image */
+void tiled_image::copy_from(image const &src, ibox2 box, ivec2 origin)
+{
+    tiled_image_data &d = *m_data;
+
+    ivec2 const lo = lol::max(origin, ivec2(0));
+    ivec2 const hi = lol::min(origin + box.extent(), d.m_size);
+    if (lo.x >= hi.x || lo.y >= hi.y)
+        return;
+
+    image tmp = src;
+    tmp.set_format(d.m_format);
+    uint8_t const *pixels = (uint8_t const *)tmp.lock();
+    int const width = src.size().x;
+
+    ivec2 const t0 = lo / d.m_tile_size, t1 = (hi - ivec2(1)) / d.m_tile_size;
+    for (int ty = t0.y; ty <= t1.y; ++ty)
+    for (int tx = t0.x; tx <= t1.x; ++tx)
+    {
+        int const n = ty * d.m_tile_count.x + tx;
+        ivec2 const corner = ivec2(tx, ty) * d.m_tile_size;
+        ivec2 const a = lol::max(lo, corner);
+        ivec2 const b = lol::min(hi, corner + d.m_tile_size);
+
+        uint8_t *data = d.pin(n);
+        for (int y = a.y; y < b.y; ++y)
+        {
+            ivec2 const s = ivec2(a.x, y) - origin + box.aa;
+            memcpy(data + ((y - corner.y) * d.m_tile_size.x + a.x - corner.x)
+                            * d.m_pixel_bytes,
+                   pixels + ((size_t)s.y * width + s.x) * d.m_pixel_bytes,
+                   (b.x - a.x) * d.m_pixel_bytes);
+        }
+        d.unpin(n, true);
+    }
+
+    tmp.unlock(pixels);
+}
+
+image tiled_image::read(ibox2 box) const
+{
+    tiled_image_data &d = *m_data;
+    ivec2 const extent = box.extent();
+
+    image ret(extent);
+    ret.set_format(d.m_format);
+    uint8_t *pixels = (uint8_t *)ret.lock();
+    memset(pixels, 0, (size_t)extent.x * extent.y * d.m_pixel_bytes);
+
+    /* Areas outside the tiled image are left blank */
+    ivec2 const lo = lol::max(box.aa, ivec2(0));
+    ivec2 const hi = lol::min(box.bb, d.m_size);
+
+    if (lo.x < hi.x && lo.y < hi.y)
+    {
+        ivec2 const t0 = lo / d.m_tile_size;
+        ivec2 const t1 = (hi - ivec2(1)) / d.m_tile_size;
+        for (int ty = t0.y; ty <= t1.y; ++ty)
+        for (int tx = t0.x; tx <= t1.x; ++tx)
+        {
+            int const n = ty * d.m_tile_count.x + tx;
+            ivec2 const corner = ivec2(tx, ty) * d.m_tile_size;
+            ivec2 const a = lol::max(lo, corner);
+            ivec2 const b = lol::min(hi, corner + d.m_tile_size);
+
+            uint8_t const *data = d.pin(n);
+            for (int y = a.y; y < b.y; ++y)
+            {
+                ivec2 const p = ivec2(a.x, y) - box.aa;
+                memcpy(pixels + ((size_t)p.y * extent.x + p.x) * d.m_pixel_bytes,
+                       data + ((y - corner.y) * d.m_tile_size.x + a.x - corner.x)
+                               * d.m_pixel_bytes,
+                       (b.x - a.x) * d.m_pixel_bytes);
+            }
+            d.unpin(n, false);
+        }
+    }
+
+    ret.unlock(pixels);
+    return ret;
+}
+
+void tiled_image::process(tiled_image &dst, ivec2 halo,
+                          std::function<image(image const &)> const &filter) const
+{
+    tiled_image_data const &d = *m_data;
+
+    ASSERT(&dst != this, "tiled images cannot be processed in place");
+    ASSERT(dst.size() == size(), "tiled image sizes do not match");
+
+    halo = lol::max(halo, ivec2(0));
+
+    /* Tiles are streamed in raster order within each band, so that the
+     * halos of consecutive tiles are usually still in the cache. */
+    parallel_for(d.m_tile_count.x * d.m_tile_count.y, [&](int n0, int n1)
+    {
+        for (int n = n0; n < n1; ++n)
+        {
+            ivec2 const corner = ivec2(n % d.m_tile_count.x,
+                                       n / d.m_tile_count.x) * d.m_tile_size;
+            ibox2 const area(corner,
+                             lol::min(corner + d.m_tile_size, d.m_size));
+            ibox2 const input(lol::max(area.aa - halo, ivec2(0)),
+                              lol::min(area.bb + halo, d.m_size));
+
+            image out = filter(read(input));
+            ASSERT(out.size() == input.extent(),
+                   "tile filters must preserve the image size");
+
+            dst.copy_from(out, ibox2(area.aa - input.aa, area.bb - input.aa),
+                          area.aa);
+        }
+    });
+}
+
+} /* namespace lol */
+
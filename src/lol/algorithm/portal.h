@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2015 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
 //            © 2013—2015 Benjamin “Touky” Huet <huet.benjamin@gmail.com>
 //
 //  Lol Engine is free software. It comes without any warranty, to
@@ -13,11 +13,24 @@
 
 #pragma once
 
+//
+// The portal system
+// -----------------
+// Rooms are connected by rectangular doors. Visibility queries walk the
+// room graph from the camera, narrowing the visible screen rectangle at
+// each door. An optional potentially visible set (PVS) for each room can
+// be computed offline to prune the walk; it is conservative, ie. it may
+// contain rooms that are never actually visible, but never misses one.
+//
+
 #include <lol/base/array.h>
 #include <lol/debug/lines.h>
 #include <lol/image/color.h>
+#include <lol/math/geometry.h>
+#include <lol/sys/thread.h>
 
 #include <cfloat> /* for FLT_MAX */
+#include <cstring> /* for memcmp() */
 
 namespace lol
 {
@@ -27,6 +40,49 @@ template <typename TE> class PortalRoom;
 template <typename TE> class PortalDoor;
 template <typename TE> class PortalSet;
 
+//Set of rooms or doors, indexed by their ID in a PortalSet
+class PortalBitset
+{
+public:
+    void resize(int bits)
+    {
+        m_words.resize((bits + 63) / 64);
+        clear();
+    }
+
+    void clear()
+    {
+        for (auto &w : m_words)
+            w = 0;
+    }
+
+    void set(int i)        { m_words[i >> 6] |= (uint64_t)1 << (i & 63); }
+    bool get(int i) const  { return (m_words[i >> 6] >> (i & 63)) & 1; }
+
+    int count() const
+    {
+        int ret = 0;
+        for (auto w : m_words)
+            for (; w; w &= w - 1)
+                ++ret;
+        return ret;
+    }
+
+    bool operator ==(PortalBitset const &that) const
+    {
+        if (m_words.count() != that.m_words.count())
+            return false;
+        for (int i = 0; i < m_words.count(); ++i)
+            if (m_words[i] != that.m_words[i])
+                return false;
+        return true;
+    }
+
+    bool operator !=(PortalBitset const &that) const { return !(*this == that); }
+
+    array<uint64_t> m_words;
+};
+
 //--
 namespace Debug {
 template <typename TE, typename TV = void>
@@ -67,6 +123,7 @@ private:
 
         m_rooms[0]  = nullptr;
         m_rooms[1]  = nullptr;
+        m_id        = -1;
     }
 
 public:
@@ -196,6 +253,11 @@ public:
 
     //View proj getter (doesn't check matrix validity)
     mat4 GetViewProj() { return m_proj * m_view; }
+    mat4 GetView() const { return m_view; }
+    mat4 GetProj() const { return m_proj; }
+
+    //Index in the owning PortalSet, or -1
+    int GetID() const { return m_id; }
 
     //--
     bool TestCollide(const vec3& point)
@@ -242,6 +304,7 @@ private:
     vec3                        m_up;
     vec2                        m_size;
     PortalRoom<TE>*             m_rooms[2]; //0: Back, 1: Front
+    int                         m_id;
 };
 
 //--
@@ -255,6 +318,8 @@ public:
     PortalRoom(TE* element = nullptr)
     {
         m_element = element;
+        m_set = nullptr;
+        m_id = -1;
     }
     ~PortalRoom()
     {
@@ -266,6 +331,9 @@ public:
     PortalRoom& operator<<(class PortalDoor<TE>* door)
     {
         m_doors.push_unique(door);
+        //Doors connected to a room of a set belong to the set
+        if (m_set && door->m_id < 0)
+            *m_set << door;
         return *this;
     }
     PortalRoom& operator>>(class PortalDoor<TE>* door)
@@ -276,11 +344,17 @@ public:
 
     int GetDoorCount()              { return m_doors.count(); }
     PortalDoor<TE>* GetDoor(int i)  { return m_doors[i]; }
+    TE* GetElement()                { return m_element; }
+
+    //Index in the owning PortalSet, or -1
+    int GetID() const { return m_id; }
 
 private:
     //Portals associated with this room.
     array<PortalDoor<TE>*>      m_doors;
     TE*                         m_element;
+    PortalSet<TE>*              m_set;
+    int                         m_id;
 };
 
 //--
@@ -301,8 +375,11 @@ public:
     //Visible room getter
     void GetVisibleRooms(PortalDoor<TE>* see_through, PortalRoom<TE>* start_room, array<PortalRoom<TE>*>& visible_rooms)
     {
-        array<PortalDoor<TE>*> ignore_doors;
-        GetVisibleRooms(see_through, start_room, visible_rooms, ignore_doors);
+        PortalBitset visible;
+        GetVisibleRooms(see_through->GetViewProj(), start_room, visible);
+        for (int i = 0; i < m_rooms.count(); ++i)
+            if (visible.get(i) && m_rooms[i] != start_room)
+                visible_rooms.push_unique(m_rooms[i]);
     #if LOL_BUILD_DEBUG
         for (auto room : visible_rooms)
         {
@@ -315,42 +392,321 @@ public:
             tmp /= tmp.w;
             Debug::DrawBox(tmp.xyz - vec3(1.f), tmp.xyz + vec3(1.f), Color::yellow);
         }
-        for (auto port : ignore_doors)
+    #endif //LOL_BUILD_DEBUG
+    }
+
+    //Rooms visible from a camera located in start_room, as a set of room
+    //IDs that includes start_room itself. Uses the PVS if available.
+    void GetVisibleRooms(mat4 const &view_proj, PortalRoom<TE>* start_room, PortalBitset& visible)
+    {
+        Traverse(view_proj, start_room, visible, m_traversal);
+    }
+
+    //Same as above for several cameras at once, in parallel if possible
+    void GetVisibleRooms(array<mat4> const &view_projs, array<PortalRoom<TE>*> const &start_rooms, array<PortalBitset>& visible) const
+    {
+        ASSERT(view_projs.count() == start_rooms.count());
+        visible.resize(view_projs.count());
+        parallel_for((int)view_projs.count(), [&](int begin, int end)
+        {
+            traversal t;
+            for (int i = begin; i < end; ++i)
+                Traverse(view_projs[i], start_rooms[i], visible[i], t);
+        });
+    }
+
+    //Compute the potentially visible set of every room. A room is kept
+    //if a line could go through a sequence of doors to reach it: each
+    //door must have a point in front of the previous door and of the
+    //first one, with door normals pointing towards their front room.
+    void ComputePVS()
+    {
+        int room_count = m_rooms.count(), door_count = m_doors.count();
+
+        m_pvs.resize(room_count);
+        for (auto &bits : m_pvs)
+            bits.resize(room_count);
+
+        //Directed doors: 2 * id goes from the back room to the front
+        //room, 2 * id + 1 from the front room to the back room.
+        array<vec3> points;
+        array<vec4> planes;
+        array<int> dest;
+        points.resize(4 * door_count);
+        for (int d = 0; d < door_count; ++d)
         {
-            Debug::Draw(*port, Color::magenta);
-            Debug::DrawViewProj(port->m_view, port->m_proj, Color::magenta);
+            PortalDoor<TE>* door = m_doors[d];
+            door->GetPoints(points.data() + 4 * d);
+            for (int dir = 0; dir < 2; ++dir)
+            {
+                vec3 n = dir ? -door->m_normal : door->m_normal;
+                PortalRoom<TE>* room = door->m_rooms[1 - dir];
+                planes.push(vec4(n, -dot(n, door->m_center)));
+                dest.push(room && IsInSet(room) ? room->m_id : -1);
+            }
+        }
+
+        //Can a line go through directed door a, then through b?
+        auto might_see = [&](int a, int b)
+        {
+            float const eps = 1e-4f;
+            bool in_front = false, behind = false;
+            for (int k = 0; k < 4; ++k)
+            {
+                in_front |= dot(planes[a].xyz, points[4 * (b / 2) + k]) + planes[a].w > -eps;
+                behind |= dot(planes[b].xyz, points[4 * (a / 2) + k]) + planes[b].w < eps;
+            }
+            return in_front && behind;
+        };
+
+        //Flood the room graph from every door of every room, going
+        //through each directed door at most once per flood.
+        PortalBitset visited;
+        visited.resize(2 * door_count);
+        array<int> stack;
+
+        for (int r = 0; r < room_count; ++r)
+        {
+            PortalRoom<TE>* room = m_rooms[r];
+            m_pvs[r].set(r);
+
+            for (auto door : room->m_doors)
+            {
+                int a = Leave(door, room);
+                if (a < 0 || dest[a] < 0)
+                    continue;
+
+                visited.clear();
+                visited.set(a);
+                m_pvs[r].set(dest[a]);
+                stack.push(a);
+
+                while (stack.count())
+                {
+                    int x = stack.pop();
+                    PortalRoom<TE>* next_room = m_rooms[dest[x]];
+                    for (auto next_door : next_room->m_doors)
+                    {
+                        int y = Leave(next_door, next_room);
+                        if (y < 0 || y / 2 == x / 2 || dest[y] < 0 || visited.get(y))
+                            continue;
+                        if (!might_see(a, y) || !might_see(x, y))
+                            continue;
+                        visited.set(y);
+                        m_pvs[r].set(dest[y]);
+                        stack.push(y);
+                    }
+                }
+            }
         }
-    #endif //LOL_BUILD_DEBUG
     }
+
+    //PVS access; it is discarded whenever rooms or doors are added or
+    //removed, and must be recomputed if doors are moved.
+    bool HasPVS() const { return m_pvs.count() > 0; }
+    void ClearPVS() { m_pvs.clear(); }
+    PortalBitset const& GetPVS(PortalRoom<TE>* room) const { return m_pvs[room->m_id]; }
+
+    //PVS serialisation. LoadPVS() fails if the data was not computed
+    //for the same number of rooms.
+    array<uint8_t> SavePVS() const
+    {
+        array<uint8_t> data;
+        auto put32 = [&](uint32_t x)
+        {
+            for (int i = 0; i < 4; ++i)
+                data.push((uint8_t)(x >> (8 * i)));
+        };
+
+        put32(0x5356504cu); /* "LPVS" */
+        put32((uint32_t)m_pvs.count());
+        for (auto const &bits : m_pvs)
+            for (auto w : bits.m_words)
+                for (int i = 0; i < 8; ++i)
+                    data.push((uint8_t)(w >> (8 * i)));
+        return data;
+    }
+
+    bool LoadPVS(array<uint8_t> const &data)
+    {
+        auto get = [&](int offset, int bytes)
+        {
+            uint64_t ret = 0;
+            for (int i = 0; i < bytes; ++i)
+                ret |= (uint64_t)data[offset + i] << (8 * i);
+            return ret;
+        };
+
+        int room_count = m_rooms.count(), words = (room_count + 63) / 64;
+        if (data.count() != 8 + 8 * words * room_count
+             || get(0, 4) != 0x5356504cu || (int)get(4, 4) != room_count)
+            return false;
+
+        m_pvs.resize(room_count);
+        for (int r = 0, offset = 8; r < room_count; ++r)
+        {
+            m_pvs[r].resize(room_count);
+            for (int w = 0; w < words; ++w, offset += 8)
+                m_pvs[r].m_words[w] = get(offset, 8);
+        }
+        return true;
+    }
+
 private:
-    void GetVisibleRooms(PortalDoor<TE>* see_through, PortalRoom<TE>* start_room, array<PortalRoom<TE>*>& visible_rooms, array<PortalDoor<TE>*>& ignore_doors)
+    //Scratch data for a traversal, reused across queries
+    struct traversal
     {
-        for (auto door : start_room->m_doors)
+        array<vec4> door_rects;
+        array<int> door_stamps;
+        int stamp = 0;
+        array<PortalRoom<TE>*, vec4> stack;
+    };
+
+    //Screen rectangle (xmin, ymin, xmax, ymax) covered by a door in
+    //normalised device coordinates. The parts of the door that are
+    //behind the camera are clipped away first.
+    static vec4 ProjectDoor(PortalDoor<TE> const& door, mat4 const &view_proj)
+    {
+        float const eps = 1e-5f;
+
+        vec3 points[4];
+        door.GetPoints(points);
+
+        vec4 q[4];
+        for (int i = 0; i < 4; ++i)
+            q[i] = view_proj * vec4(points[i], 1.f);
+
+        vec4 rect(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (int i = 0, j = 3; i < 4; j = i++)
+        {
+            //Keep each point in front of the camera, and the point where
+            //the edge coming to it crosses the w = eps plane.
+            vec4 const &a = q[j], &b = q[i];
+            if ((a.w > eps) != (b.w > eps))
+            {
+                vec4 c = a + (b - a) * ((eps - a.w) / (b.w - a.w));
+                vec2 s = c.xy / eps;
+                rect = vec4(lol::min(rect.xy, s), lol::max(rect.zw, s));
+            }
+            if (b.w > eps)
+            {
+                vec2 s = b.xy / b.w;
+                rect = vec4(lol::min(rect.xy, s), lol::max(rect.zw, s));
+            }
+        }
+
+        return rect;
+    }
+
+    //Walk the room graph, clipping door rectangles against the part of
+    //the screen through which we look into each room. A door is walked
+    //through again only if we see a part of it that was not seen yet.
+    void Traverse(mat4 const &view_proj, PortalRoom<TE>* start_room, PortalBitset& visible, traversal& t) const
+    {
+        visible.resize(m_rooms.count());
+        if (!IsInSet(start_room))
+            return;
+        visible.set(start_room->m_id);
+
+        if (t.door_stamps.count() != m_doors.count())
+        {
+            t.door_stamps.resize(m_doors.count());
+            t.door_rects.resize(m_doors.count());
+            for (auto &stamp : t.door_stamps)
+                stamp = 0;
+            t.stamp = 0;
+        }
+        ++t.stamp;
+
+        PortalBitset const *pvs = HasPVS() ? &m_pvs[start_room->m_id] : nullptr;
+
+        t.stack.clear();
+        t.stack.push(start_room, vec4(-1.f, -1.f, 1.f, 1.f));
+        while (t.stack.count())
         {
-            if (door == see_through || ignore_doors.Find(door) != INDEX_NONE)
-                continue;
+            PortalRoom<TE>* room = t.stack.last().m1;
+            vec4 rect = t.stack.last().m2;
+            t.stack.pop();
 
-            if (see_through->TestCollide(*door))
+            for (auto door : room->m_doors)
             {
-                PortalRoom<TE>* other_room = door->GetRoom(start_room);
-                if (visible_rooms.Find(other_room) != INDEX_NONE)
+                PortalRoom<TE>* other_room = door->GetRoom(room);
+                if (!other_room || !IsInSet(other_room) || door->m_id < 0)
+                    continue;
+                if (pvs && !pvs->get(other_room->m_id))
+                    continue;
+
+                vec4 r = ProjectDoor(*door, view_proj);
+                r = vec4(lol::max(r.xy, rect.xy), lol::min(r.zw, rect.zw));
+                if (r.x >= r.z || r.y >= r.w)
                     continue;
 
-                ignore_doors.push_unique(door);
-                visible_rooms.push_unique(other_room);
-                door->BuildViewProj(see_through->m_view, see_through->m_proj);
-                GetVisibleRooms(door, other_room, visible_rooms, ignore_doors);
+                int id = door->m_id;
+                if (t.door_stamps[id] == t.stamp)
+                {
+                    vec4 &old = t.door_rects[id];
+                    if (r.x >= old.x && r.y >= old.y && r.z <= old.z && r.w <= old.w)
+                        continue;
+                    old = vec4(lol::min(old.xy, r.xy), lol::max(old.zw, r.zw));
+                }
+                else
+                {
+                    t.door_stamps[id] = t.stamp;
+                    t.door_rects[id] = r;
+                }
+
+                visible.set(other_room->m_id);
+                t.stack.push(other_room, r);
             }
         }
     }
+
+    //Directed door index when leaving room through door, or -1
+    static int Leave(PortalDoor<TE>* door, PortalRoom<TE>* room)
+    {
+        if (door->m_id < 0)
+            return -1;
+        if (door->m_rooms[0] == room)
+            return 2 * door->m_id;
+        if (door->m_rooms[1] == room)
+            return 2 * door->m_id + 1;
+        return -1;
+    }
+
+    bool IsInSet(PortalRoom<TE>* room) const
+    {
+        return room->m_id >= 0 && room->m_id < m_rooms.count() && m_rooms[room->m_id] == room;
+    }
+
+    bool IsInSet(PortalDoor<TE>* door) const
+    {
+        return door->m_id >= 0 && door->m_id < m_doors.count() && m_doors[door->m_id] == door;
+    }
+
+    //Renumber rooms and doors after a removal
+    void UpdateIDs()
+    {
+        for (int i = 0; i < m_rooms.count(); ++i)
+            m_rooms[i]->m_id = i;
+        for (int i = 0; i < m_doors.count(); ++i)
+            m_doors[i]->m_id = i;
+        m_pvs.clear();
+    }
+
 public:
 
     //Operator
     PortalSet<TE>& operator<<(class PortalRoom<TE>* room)
     {
-        m_rooms.push_unique(room);
+        if (!IsInSet(room))
+        {
+            room->m_id = m_rooms.count();
+            room->m_set = this;
+            m_rooms.push(room);
+            m_pvs.clear();
+        }
         for (auto door : room->m_doors)
-            m_doors.push_unique(door);
+            *this << door;
         return *this;
     }
     //--
@@ -359,18 +715,28 @@ public:
         for (auto door : room->m_doors)
             *this >> door;
         m_rooms.remove_item(room);
+        room->m_id = -1;
+        room->m_set = nullptr;
+        UpdateIDs();
         return *this;
     }
     //--
     PortalSet<TE>& operator<<(class PortalDoor<TE>* door)
     {
-        m_doors.push_unique(door);
+        if (!IsInSet(door))
+        {
+            door->m_id = m_doors.count();
+            m_doors.push(door);
+            m_pvs.clear();
+        }
         return *this;
     }
     //--
     PortalSet<TE>& operator>>(class PortalDoor<TE>* door)
     {
         m_doors.remove_item(door);
+        door->m_id = -1;
+        UpdateIDs();
         return *this;
     }
 
@@ -384,7 +750,10 @@ private:
     //Portals associated with this room.
     array<PortalRoom<TE>*>          m_rooms;
     array<PortalDoor<TE>*>          m_doors;
+    //Potentially visible rooms for each room, indexed by room ID
+    array<PortalBitset>             m_pvs;
+    //Scratch data for single queries
+    traversal                       m_traversal;
 };
 
 } /* namespace lol */
-
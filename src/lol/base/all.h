@@ -17,9 +17,14 @@
 #include <lol/base/log.h>
 #include <lol/base/assert.h>
 #include <lol/base/tuple.h>
+#include <lol/base/allocator.h>
 #include <lol/base/array.h>
+#include <lol/base/pool.h>
 #include <lol/base/avl_tree.h>
+#include <lol/base/btree.h>
 #include <lol/base/string.h>
 #include <lol/base/map.h>
+#include <lol/base/hash_map.h>
+#include <lol/base/flat_map.h>
 #include <lol/base/enum.h>
 
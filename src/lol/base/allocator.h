@@ -0,0 +1,157 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// Memory allocators
+// -----------------
+// Containers such as array can be given an allocator to take their
+// memory from instead of the global heap:
+//  - arena: a linear allocator for temporary data; everything it handed
+//    out is released at once by reset(), and its memory is reused.
+//  - stack_allocator: an arena that can also roll back to a marker, for
+//    scratch memory in nested function calls.
+//  - pool_allocator: blocks of a single size, recycled through a free
+//    list; larger requests go to the heap.
+// All of them only touch the heap when they run out of memory, and all
+// heap allocations done by containers are counted so that the profiler
+// can report them.
+//
+
+#include <new>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace lol
+{
+
+/* Global counters of the heap allocations made by the engine's
+ * containers and allocators. */
+struct alloc_counters
+{
+    std::atomic<int64_t> allocs { 0 };
+    std::atomic<int64_t> frees { 0 };
+    std::atomic<int64_t> bytes { 0 };
+};
+
+inline alloc_counters &get_alloc_counters()
+{
+    static alloc_counters counters;
+    return counters;
+}
+
+inline void *heap_alloc(size_t bytes)
+{
+    alloc_counters &c = get_alloc_counters();
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+    c.bytes.fetch_add((int64_t)bytes, std::memory_order_relaxed);
+    return ::operator new(bytes);
+}
+
+inline void heap_free(void *p)
+{
+    if (!p)
+        return;
+    get_alloc_counters().frees.fetch_add(1, std::memory_order_relaxed);
+    ::operator delete(p);
+}
+
+class allocator
+{
+public:
+    virtual ~allocator() {}
+
+    /* Alignment must be a power of two no larger than that of
+     * std::max_align_t. */
+    virtual void *alloc(size_t bytes, size_t align) = 0;
+    virtual void free(void *p, size_t bytes) = 0;
+};
+
+class arena : public allocator
+{
+public:
+    arena(size_t chunk_size = 64 * 1024);
+    virtual ~arena();
+
+    virtual void *alloc(size_t bytes, size_t align);
+
+    /* Only the most recent allocation is actually released, so memory
+     * freed in reverse allocation order is reused; everything else is
+     * kept until the next reset(). */
+    virtual void free(void *p, size_t bytes);
+
+    /* Release everything at once. Memory is kept for the next round; if
+     * the previous round needed several chunks, they are replaced with a
+     * single chunk large enough for all of them. */
+    void reset();
+
+    /* Bytes currently handed out, and total bytes reserved */
+    inline size_t used() const { return m_used; }
+    inline size_t capacity() const { return m_capacity; }
+
+protected:
+    struct chunk
+    {
+        chunk *m_next;
+        size_t m_size;
+    };
+
+    void add_chunk(size_t min_size);
+
+    chunk *m_chunks = nullptr;
+    uint8_t *m_top = nullptr, *m_end = nullptr;
+    size_t m_chunk_size, m_used = 0, m_capacity = 0;
+};
+
+class stack_allocator : public arena
+{
+public:
+    stack_allocator(size_t chunk_size = 64 * 1024);
+
+    /* Roll back all allocations made since get_marker() was called */
+    struct marker
+    {
+        chunk *m_chunk;
+        uint8_t *m_top;
+        size_t m_used;
+    };
+
+    marker get_marker() const;
+    void rewind(marker const &m);
+};
+
+class pool_allocator : public allocator
+{
+public:
+    pool_allocator(size_t block_size, size_t blocks_per_chunk = 256);
+    virtual ~pool_allocator();
+
+    virtual void *alloc(size_t bytes, size_t align);
+    virtual void free(void *p, size_t bytes);
+
+    inline size_t block_size() const { return m_block_size; }
+    inline size_t count() const { return m_count; }
+
+private:
+    struct block { block *m_next; };
+
+    void grow();
+
+    size_t m_block_size, m_blocks_per_chunk, m_count = 0;
+    block *m_free = nullptr;
+    void *m_chunks = nullptr;
+};
+
+} /* namespace lol */
+
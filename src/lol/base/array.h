@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2015 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
 //            © 2013—2015 Benjamin “Touky” Huet <huet.benjamin@gmail.com>
 //
 //  Lol Engine is free software. It comes without any warranty, to
@@ -18,13 +18,19 @@
 // ---------------
 // A very simple array class not unlike the std::vector, with some nice
 // additional features, eg. array<int,float> for automatic arrays of tuples.
+// Arrays take their memory from the heap unless they are given one of the
+// allocators from allocator.h.
 //
 
 #include <lol/base/assert.h>
 #include <lol/base/tuple.h>
+#include <lol/base/allocator.h>
 
 #include <new> /* for placement new */
 #include <algorithm> /* for std::swap */
+#include <utility> /* for std::move */
+#include <type_traits>
+#include <cstring>
 #include <stdint.h>
 #include <initializer_list>
 
@@ -55,14 +61,22 @@ template<typename T, typename ARRAY> class LOL_ATTR_NODISCARD array_base
 public:
     typedef T element_t;
 
-    inline array_base() : m_data(0), m_count(0), m_reserved(0)
+    inline array_base() : m_data(0), m_count(0), m_reserved(0), m_alloc(0)
+    {
+    }
+
+    /* Use the given allocator instead of the heap. The allocator must
+     * outlive the array. */
+    inline explicit array_base(allocator *alloc)
+      : m_data(0), m_count(0), m_reserved(0), m_alloc(alloc)
     {
     }
 
     inline array_base(std::initializer_list<element_t> const &list)
       : m_data(0),
         m_count(0),
-        m_reserved(0)
+        m_reserved(0),
+        m_alloc(0)
     {
         reserve(list.size());
         for (auto elem : list)
@@ -73,10 +87,12 @@ public:
     {
         for (ptrdiff_t i = 0; i < m_count; i++)
             m_data[i].~element_t();
-        delete[] reinterpret_cast<uint8_t *>(m_data);
+        release(m_alloc, m_data, m_reserved);
     }
 
-    array_base(array_base const& that) : m_data(0), m_count(0), m_reserved(0)
+    /* Copies use the heap, whatever the original array was using */
+    array_base(array_base const& that)
+      : m_data(0), m_count(0), m_reserved(0), m_alloc(0)
     {
         /* Reserve the exact number of values instead of what the other
          * array had reserved. Just a method for not wasting too much. */
@@ -86,6 +102,41 @@ public:
         m_count = that.m_count;
     }
 
+    /* Moved arrays keep their allocator */
+    array_base(array_base &&that)
+      : m_data(that.m_data),
+        m_count(that.m_count),
+        m_reserved(that.m_reserved),
+        m_alloc(that.m_alloc)
+    {
+        that.m_data = 0;
+        that.m_count = that.m_reserved = 0;
+    }
+
+    array_base& operator=(array_base &&that)
+    {
+        if ((uintptr_t)this == (uintptr_t)&that)
+            return *this;
+
+        if (m_alloc == that.m_alloc)
+        {
+            std::swap(m_data, that.m_data);
+            std::swap(m_count, that.m_count);
+            std::swap(m_reserved, that.m_reserved);
+        }
+        else
+        {
+            /* Different allocators: move the elements one by one */
+            clear();
+            reserve(that.m_count);
+            for (ptrdiff_t i = 0; i < that.m_count; i++)
+                new(&m_data[i]) element_t(std::move(that.m_data[i]));
+            m_count = that.m_count;
+            that.clear();
+        }
+        return *this;
+    }
+
     array_base& operator=(array_base const& that)
     {
         if ((uintptr_t)this != (uintptr_t)&that)
@@ -217,6 +268,22 @@ public:
         return *this;
     }
 
+    inline array_base& operator<<(T &&x)
+    {
+        if (m_count >= m_reserved)
+        {
+            T tmp = std::move(x);
+            grow();
+            new (&m_data[m_count]) element_t(std::move(tmp));
+        }
+        else
+        {
+            new (&m_data[m_count]) element_t(std::move(x));
+        }
+        ++m_count;
+        return *this;
+    }
+
     inline array_base& operator>>(T const &x)
     {
         remove_item(x);
@@ -228,6 +295,11 @@ public:
         *this << x;
     }
 
+    inline void push(T &&x)
+    {
+        *this << std::move(x);
+    }
+
     inline bool push_unique(T const &x)
     {
         if (find(x) != INDEX_NONE)
@@ -238,21 +310,26 @@ public:
     }
 
     inline void insert(T const &x, ptrdiff_t pos)
+    {
+        insert(T(x), pos);
+    }
+
+    inline void insert(T &&x, ptrdiff_t pos)
     {
         ASSERT(pos >= 0 && pos <= m_count,
                "cannot insert at index %ld in array of size %ld",
                (long int)pos, (long int)m_count);
 
         if (m_count >= m_reserved)
+        {
+            T tmp = std::move(x);
             grow();
-
-        for (ptrdiff_t i = m_count; i > pos; --i)
+            insert_at(std::move(tmp), pos);
+        }
+        else
         {
-            new (&m_data[i]) element_t(m_data[i - 1]);
-            m_data[i - 1].~element_t();
+            insert_at(std::move(x), pos);
         }
-        new (&m_data[pos]) element_t(x);
-        ++m_count;
     }
 
     inline bool insert_unique(T const &x, ptrdiff_t pos)
@@ -301,7 +378,7 @@ public:
     inline T pop()
     {
         ASSERT(m_count > 0);
-        element_t tmp = last();
+        element_t tmp = std::move(last());
         remove(m_count - 1, 1);
         return tmp;
     }
@@ -326,7 +403,7 @@ public:
             pos = m_count + pos;
 
         for (ptrdiff_t i = pos; i + todelete < m_count; i++)
-            m_data[i] = m_data[i + todelete];
+            m_data[i] = std::move(m_data[i + todelete]);
         for (ptrdiff_t i = m_count - todelete; i < m_count; i++)
             m_data[i].~element_t();
         m_count -= todelete;
@@ -345,7 +422,7 @@ public:
         for (ptrdiff_t i = 0; i < todelete; i++)
         {
             if (pos + i < m_count - 1 - i)
-                m_data[pos + i] = m_data[m_count - 1 - i];
+                m_data[pos + i] = std::move(m_data[m_count - 1 - i]);
             m_data[m_count - 1 - i].~element_t();
         }
         m_count -= todelete;
@@ -377,23 +454,26 @@ public:
         if (toreserve <= m_reserved)
             return;
 
-        /* This cast is not very nice, because we kill any alignment
-         * information we could have. But until C++ gives us the proper
-         * tools to deal with it, we assume new uint8_t[] returns properly
-         * aligned data. */
-        element_t *tmp = reinterpret_cast<element_t *>(reinterpret_cast<uintptr_t>
-                               (new uint8_t[sizeof(element_t) * toreserve]));
-        ASSERT(tmp, "out of memory in array class");
-        for (ptrdiff_t i = 0; i < m_count; i++)
-        {
-            new(&tmp[i]) element_t(m_data[i]);
-            m_data[i].~element_t();
-        }
-        delete[] reinterpret_cast<uint8_t *>(m_data);
+        reallocate(toreserve);
+    }
+
+    /* Switch to another allocator (null means the heap), moving the
+     * current elements if there are any. */
+    void set_allocator(allocator *alloc)
+    {
+        if (alloc == m_alloc)
+            return;
+
+        element_t *tmp = m_count ? acquire(alloc, m_count) : 0;
+        relocate(tmp, m_data, m_count);
+        release(m_alloc, m_data, m_reserved);
         m_data = tmp;
-        m_reserved = toreserve;
+        m_reserved = m_count;
+        m_alloc = alloc;
     }
 
+    inline allocator *get_allocator() const { return m_alloc; }
+
     void shuffle();
 
     void sort(SortAlgorithm algorithm);
@@ -470,8 +550,67 @@ protected:
         reserve(m_count * 13 / 8 + 8);
     }
 
+    /* Shift elements to make room at pos; reserve() must have been called */
+    void insert_at(T &&x, ptrdiff_t pos)
+    {
+        for (ptrdiff_t i = m_count; i > pos; --i)
+        {
+            new (&m_data[i]) element_t(std::move(m_data[i - 1]));
+            m_data[i - 1].~element_t();
+        }
+        new (&m_data[pos]) element_t(std::move(x));
+        ++m_count;
+    }
+
+    static inline element_t *acquire(allocator *alloc, ptrdiff_t count)
+    {
+        size_t bytes = sizeof(element_t) * count;
+        void *ret = alloc ? alloc->alloc(bytes, alignof(element_t))
+                          : heap_alloc(bytes);
+        ASSERT(ret, "out of memory in array class");
+        return reinterpret_cast<element_t *>(ret);
+    }
+
+    static inline void release(allocator *alloc, element_t *data, ptrdiff_t count)
+    {
+        if (!data)
+            return;
+        if (alloc)
+            alloc->free(data, sizeof(element_t) * count);
+        else
+            heap_free(data);
+    }
+
+    /* Move elements to uninitialised memory and destroy the originals;
+     * trivially copyable types are simply copied. */
+    static inline void relocate(element_t *dst, element_t *src, ptrdiff_t count)
+    {
+        if (std::is_trivially_copyable<element_t>::value)
+        {
+            if (count)
+                memcpy((void *)dst, (void const *)src, sizeof(element_t) * count);
+            return;
+        }
+
+        for (ptrdiff_t i = 0; i < count; i++)
+        {
+            new(&dst[i]) element_t(std::move(src[i]));
+            src[i].~element_t();
+        }
+    }
+
+    void reallocate(ptrdiff_t toreserve)
+    {
+        element_t *tmp = acquire(m_alloc, toreserve);
+        relocate(tmp, m_data, m_count);
+        release(m_alloc, m_data, m_reserved);
+        m_data = tmp;
+        m_reserved = toreserve;
+    }
+
     element_t *m_data;
     ptrdiff_t m_count, m_reserved;
+    allocator *m_alloc;
 };
 
 /*
@@ -497,6 +636,10 @@ public:
     inline array(std::initializer_list<element_t> const &list)
       : array_base<element_t, array<T...>>::array_base(list)
     {}
+
+    inline explicit array(allocator *alloc)
+      : array_base<element_t, array<T...>>::array_base(alloc)
+    {}
 #endif
 
 public:
@@ -526,7 +669,7 @@ public:
 
         for (ptrdiff_t i = this->m_count; i > pos; --i)
         {
-            new (&this->m_data[i]) element_t(this->m_data[i - 1]);
+            new (&this->m_data[i]) element_t(std::move(this->m_data[i - 1]));
             this->m_data[i - 1].~element_t();
         }
         new (&this->m_data[pos]) tuple<T...>({ args... });
@@ -551,6 +694,10 @@ public:
     inline array(std::initializer_list<element_t> const &list)
       : array_base<T, array<T>>::array_base(list)
     {}
+
+    inline explicit array(allocator *alloc)
+      : array_base<T, array<T>>::array_base(alloc)
+    {}
 #endif
 };
 
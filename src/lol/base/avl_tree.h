@@ -14,12 +14,21 @@
 
 #pragma once
 
+//
+// The avl_tree class
+// ------------------
+// A balanced binary search tree. Nodes come from the allocator given as
+// the third template parameter, a node_pool by default; see pool.h.
+//
+
+#include <lol/base/pool.h>
+
 namespace lol
 {
 
 #include <lol/base/all.h>
 
-template<typename K, typename V>
+template<typename K, typename V, template<typename> class A = node_pool>
 class avl_tree
 {
 public:
@@ -59,12 +68,12 @@ public:
     {
         if (!m_root)
         {
-            m_root = new tree_node(key, value, &m_root);
+            m_root = m_pool.create(key, value, &m_root);
             ++m_count;
             return true;
         }
 
-        if (m_root->insert(key, value))
+        if (m_root->insert(key, value, m_pool))
         {
             ++m_count;
             return true;
@@ -78,7 +87,7 @@ public:
         if (!m_root)
             return false;
 
-        if (m_root->erase(key))
+        if (m_root->erase(key, m_pool))
         {
             --m_count;
             return true;
@@ -105,7 +114,7 @@ public:
             while (node)
             {
                 tree_node * next = node->get_next();
-                delete node;
+                m_pool.destroy(node);
                 node = next;
             }
         }
@@ -219,7 +228,7 @@ protected:
 
         /* Insert a value in tree and return true or update an existing value for
          * the existing key and return false */
-        bool insert(K const & key, V const & value)
+        bool insert(K const & key, V const & value, A<tree_node> & pool)
         {
             int i = -1 + (key < m_key) + 2 * (m_key < key);
 
@@ -228,12 +237,12 @@ protected:
             if (i < 0)
                 m_value = value;
             else if (m_child[i])
-                created = m_child[i]->insert(key, value);
+                created = m_child[i]->insert(key, value, pool);
             else
             {
                 created = true;
 
-                m_child[i] = new tree_node(key, value, &m_child[i]);
+                m_child[i] = pool.create(key, value, &m_child[i]);
 
                 m_child[i]->m_chain[i] = m_chain[i];
                 m_child[i]->m_chain[i ? 0 : 1] = this;
@@ -252,7 +261,7 @@ protected:
         }
 
         /* Erase a value in tree and return true or return false */
-        bool erase(K const & key)
+        bool erase(K const & key, A<tree_node> & pool)
         {
             int i = -1 + (key < m_key) + 2 * (m_key < key);
 
@@ -265,14 +274,14 @@ protected:
                 erased = true;
                 suicide = true;
             }
-            else if (m_child[i] && m_child[i]->erase(key))
+            else if (m_child[i] && m_child[i]->erase(key, pool))
             {
                 rebalance_if_needed();
                 erased = true;
             }
 
             if (suicide)
-                delete this;
+                pool.destroy(this);
 
             return erased;
         }
@@ -640,6 +649,8 @@ protected:
     tree_node * m_root;
 
     int m_count;
+
+    A<tree_node> m_pool;
 };
 
 }
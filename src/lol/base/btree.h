@@ -0,0 +1,825 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// The btree class
+// ---------------
+// An ordered map with the same interface as avl_tree, stored as a B+-tree
+// whose nodes span a few cache lines. Keys of a node are contiguous, so
+// a lookup does one short search per level instead of chasing a pointer
+// per comparison, and all values live in leaves that are linked together
+// for fast in-order iteration and range scans.
+//
+// Keys and values must be default constructible and copyable; nodes hold
+// fixed-size arrays of them.
+//
+
+#include <lol/base/assert.h>
+#include <lol/base/pool.h>
+
+#include <cstddef>
+
+namespace lol
+{
+
+template<typename K, typename V, template<typename> class A = node_pool>
+class btree
+{
+protected:
+    /* Aim for nodes of about four cache lines */
+    static int const NODE_BYTES = 256;
+
+    static constexpr int node_size(size_t elem)
+    {
+        return NODE_BYTES / (int)elem < 4 ? 4
+             : NODE_BYTES / (int)elem > 64 ? 64 : NODE_BYTES / (int)elem;
+    }
+
+    static int const LEAF_SIZE = node_size(sizeof(K) + sizeof(V));
+    static int const INNER_SIZE = node_size(sizeof(K) + sizeof(void *));
+    static int const MAX_DEPTH = 32;
+
+    struct node
+    {
+        int m_count = 0;
+        bool m_leaf;
+    };
+
+    struct leaf_node : node
+    {
+        leaf_node() { this->m_leaf = true; }
+
+        leaf_node *m_prev = nullptr, *m_next = nullptr;
+        K m_keys[LEAF_SIZE];
+        V m_values[LEAF_SIZE];
+    };
+
+    /* m_keys[i] is less than or equal to all the keys below m_child[i + 1],
+     * and greater than all the keys below m_child[i]. */
+    struct inner_node : node
+    {
+        inner_node() { this->m_leaf = false; }
+
+        K m_keys[INNER_SIZE];
+        node *m_child[INNER_SIZE + 1];
+    };
+
+    /* Index of the first key in [keys, keys + count) that is not less
+     * than key, and index of the child that may contain key. */
+    static inline int lower_index(K const *keys, int count, K const &key)
+    {
+        int lo = 0;
+        while (count > 0)
+        {
+            int half = count / 2;
+            if (keys[lo + half] < key)
+            {
+                lo += half + 1;
+                count -= half + 1;
+            }
+            else
+                count = half;
+        }
+        return lo;
+    }
+
+    static inline int child_index(inner_node const *n, K const &key)
+    {
+        int lo = 0, count = n->m_count;
+        while (count > 0)
+        {
+            int half = count / 2;
+            if (!(key < n->m_keys[lo + half]))
+            {
+                lo += half + 1;
+                count -= half + 1;
+            }
+            else
+                count = half;
+        }
+        return lo;
+    }
+
+public:
+    struct output_value
+    {
+        output_value(K const & key_, V & value_) :
+            key(key_),
+            value(value_)
+        {
+        }
+
+        K const & key;
+        V & value;
+    };
+
+    struct const_output_value
+    {
+        const_output_value(K const & key_, V const & value_) :
+            key(key_),
+            value(value_)
+        {
+        }
+
+        K const & key;
+        V const & value;
+    };
+
+    template<typename O> class iterator_base
+    {
+    public:
+        iterator_base(leaf_node *leaf, int index) :
+            m_leaf(leaf),
+            m_index(index)
+        {
+        }
+
+        iterator_base & operator++(int)
+        {
+            next();
+            return *this;
+        }
+
+        iterator_base & operator--(int)
+        {
+            previous();
+            return *this;
+        }
+
+        iterator_base operator++()
+        {
+            iterator_base ret = *this;
+            next();
+            return ret;
+        }
+
+        iterator_base operator--()
+        {
+            iterator_base ret = *this;
+            previous();
+            return ret;
+        }
+
+        O operator*()
+        {
+            return O(m_leaf->m_keys[m_index], m_leaf->m_values[m_index]);
+        }
+
+        bool operator!=(iterator_base const & that) const
+        {
+            return m_leaf != that.m_leaf || m_index != that.m_index;
+        }
+
+    protected:
+        void next()
+        {
+            if (++m_index >= m_leaf->m_count)
+            {
+                m_leaf = m_leaf->m_next;
+                m_index = 0;
+            }
+        }
+
+        void previous()
+        {
+            if (--m_index < 0)
+            {
+                m_leaf = m_leaf->m_prev;
+                m_index = m_leaf ? m_leaf->m_count - 1 : 0;
+            }
+        }
+
+        leaf_node * m_leaf;
+        int m_index;
+    };
+
+    typedef iterator_base<output_value> iterator;
+    typedef iterator_base<const_output_value> const_iterator;
+
+    /* A range of elements, for use in range-based for loops */
+    template<typename I> struct range_view
+    {
+        I m_begin, m_end;
+
+        I begin() const { return m_begin; }
+        I end() const { return m_end; }
+    };
+
+    btree() = default;
+
+    btree(btree const & other)
+    {
+        for (auto it : other)
+            insert(it.key, it.value);
+    }
+
+    btree & operator=(btree const & other)
+    {
+        if (&other != this)
+        {
+            clear();
+
+            for (auto it : other)
+                insert(it.key, it.value);
+        }
+
+        return *this;
+    }
+
+    ~btree()
+    {
+        clear();
+    }
+
+    /* Insert a value and return true, or update the value of an existing
+     * key and return false. */
+    bool insert(K const & key, V const & value)
+    {
+        if (!m_root)
+        {
+            leaf_node *leaf = m_leaves.create();
+            leaf->m_keys[0] = key;
+            leaf->m_values[0] = value;
+            leaf->m_count = 1;
+            m_root = m_first = m_last = leaf;
+            m_count = 1;
+            return true;
+        }
+
+        inner_node *path[MAX_DEPTH];
+        int slots[MAX_DEPTH];
+        int depth = 0;
+
+        node *n = m_root;
+        while (!n->m_leaf)
+        {
+            inner_node *inner = (inner_node *)n;
+            path[depth] = inner;
+            slots[depth] = child_index(inner, key);
+            n = inner->m_child[slots[depth++]];
+        }
+
+        leaf_node *leaf = (leaf_node *)n;
+        int pos = lower_index(leaf->m_keys, leaf->m_count, key);
+        if (pos < leaf->m_count && !(key < leaf->m_keys[pos]))
+        {
+            leaf->m_values[pos] = value;
+            return false;
+        }
+
+        ++m_count;
+
+        if (leaf->m_count < LEAF_SIZE)
+        {
+            leaf_insert(leaf, pos, key, value);
+            return true;
+        }
+
+        /* Split the leaf, then insert the new separator in the parents,
+         * splitting them as long as they are full. */
+        leaf_node *right = split_leaf(leaf);
+        if (pos <= leaf->m_count)
+            leaf_insert(leaf, pos, key, value);
+        else
+            leaf_insert(right, pos - leaf->m_count, key, value);
+
+        K sep = right->m_keys[0];
+        node *child = right;
+
+        while (depth--)
+        {
+            inner_node *parent = path[depth];
+            int p = slots[depth];
+
+            if (parent->m_count < INNER_SIZE)
+            {
+                inner_insert(parent, p, sep, child);
+                return true;
+            }
+
+            int mid = INNER_SIZE / 2;
+            K up = parent->m_keys[mid];
+            inner_node *sibling = m_inners.create();
+            sibling->m_count = INNER_SIZE - mid - 1;
+            for (int i = 0; i < sibling->m_count; ++i)
+                sibling->m_keys[i] = parent->m_keys[mid + 1 + i];
+            for (int i = 0; i <= sibling->m_count; ++i)
+                sibling->m_child[i] = parent->m_child[mid + 1 + i];
+            parent->m_count = mid;
+
+            if (p <= mid)
+                inner_insert(parent, p, sep, child);
+            else
+                inner_insert(sibling, p - mid - 1, sep, child);
+
+            sep = up;
+            child = sibling;
+        }
+
+        /* The root was split */
+        inner_node *root = m_inners.create();
+        root->m_count = 1;
+        root->m_keys[0] = sep;
+        root->m_child[0] = m_root;
+        root->m_child[1] = child;
+        m_root = root;
+        return true;
+    }
+
+    bool erase(K const & key)
+    {
+        if (!m_root)
+            return false;
+
+        inner_node *path[MAX_DEPTH];
+        int slots[MAX_DEPTH];
+        int depth = 0;
+
+        node *n = m_root;
+        while (!n->m_leaf)
+        {
+            inner_node *inner = (inner_node *)n;
+            path[depth] = inner;
+            slots[depth] = child_index(inner, key);
+            n = inner->m_child[slots[depth++]];
+        }
+
+        leaf_node *leaf = (leaf_node *)n;
+        int pos = lower_index(leaf->m_keys, leaf->m_count, key);
+        if (pos == leaf->m_count || key < leaf->m_keys[pos])
+            return false;
+
+        --m_count;
+        for (int i = pos + 1; i < leaf->m_count; ++i)
+        {
+            leaf->m_keys[i - 1] = leaf->m_keys[i];
+            leaf->m_values[i - 1] = leaf->m_values[i];
+        }
+        --leaf->m_count;
+
+        if (!depth)
+        {
+            if (!leaf->m_count)
+            {
+                m_leaves.destroy(leaf);
+                m_root = m_first = m_last = nullptr;
+            }
+            return true;
+        }
+
+        if (leaf->m_count >= LEAF_SIZE / 2)
+            return true;
+
+        /* The leaf is too small: borrow an element from a sibling, or
+         * merge with it and fix the parents on the way up. */
+        if (!fix_leaf(leaf, path[depth - 1], slots[depth - 1]))
+            return true;
+
+        while (--depth)
+        {
+            inner_node *inner = path[depth];
+            if (inner->m_count >= INNER_SIZE / 2)
+                return true;
+            if (!fix_inner(inner, path[depth - 1], slots[depth - 1]))
+                return true;
+        }
+
+        /* Collapse the root if it has a single child left */
+        inner_node *root = (inner_node *)m_root;
+        if (!root->m_count)
+        {
+            m_root = root->m_child[0];
+            m_inners.destroy(root);
+        }
+
+        return true;
+    }
+
+    bool exists(K const & key) const
+    {
+        leaf_node *leaf;
+        int pos;
+        return find(key, leaf, pos);
+    }
+
+    bool try_get(K const & key, V * & value_ptr) const
+    {
+        leaf_node *leaf;
+        int pos;
+        if (!find(key, leaf, pos))
+            return false;
+
+        value_ptr = &leaf->m_values[pos];
+        return true;
+    }
+
+    bool try_get_min(K const * & key_ptr, V * & value_ptr) const
+    {
+        if (!m_first)
+            return false;
+
+        key_ptr = &m_first->m_keys[0];
+        value_ptr = &m_first->m_values[0];
+        return true;
+    }
+
+    bool try_get_max(K const * & key_ptr, V * & value_ptr) const
+    {
+        if (!m_last)
+            return false;
+
+        key_ptr = &m_last->m_keys[m_last->m_count - 1];
+        value_ptr = &m_last->m_values[m_last->m_count - 1];
+        return true;
+    }
+
+    void clear()
+    {
+        if (m_root)
+            destroy(m_root);
+
+        m_root = nullptr;
+        m_first = m_last = nullptr;
+        m_count = 0;
+    }
+
+    /* Replace the contents of the tree with count elements whose keys
+     * are sorted in strictly increasing order. This is much faster than
+     * inserting them one by one. It uses as few nodes as possible and
+     * spreads elements evenly between them, so that a partial last node
+     * does not end up almost empty. */
+    void bulk_load(K const *keys, V const *values, size_t count)
+    {
+        clear();
+        if (!count)
+            return;
+
+        /* Spread elements evenly so that the last leaf is not too small */
+        size_t leaf_count = (count + LEAF_SIZE - 1) / LEAF_SIZE;
+        node **level = new node *[leaf_count];
+        K *mins = new K[leaf_count];
+
+        leaf_node *prev = nullptr;
+        for (size_t n = 0, i = 0; n < leaf_count; ++n)
+        {
+            leaf_node *leaf = m_leaves.create();
+            leaf->m_count = (int)(count * (n + 1) / leaf_count - count * n / leaf_count);
+            for (int k = 0; k < leaf->m_count; ++k, ++i)
+            {
+                ASSERT(i == 0 || keys[i - 1] < keys[i],
+                       "bulk_load() needs sorted unique keys");
+                leaf->m_keys[k] = keys[i];
+                leaf->m_values[k] = values[i];
+            }
+
+            leaf->m_prev = prev;
+            if (prev)
+                prev->m_next = leaf;
+            else
+                m_first = leaf;
+            prev = leaf;
+
+            level[n] = leaf;
+            mins[n] = leaf->m_keys[0];
+        }
+        m_last = prev;
+
+        /* Build the inner levels bottom-up, in place */
+        for (size_t nodes = leaf_count; nodes > 1; )
+        {
+            size_t parents = (nodes + INNER_SIZE) / (INNER_SIZE + 1);
+            for (size_t n = 0, i = 0; n < parents; ++n)
+            {
+                inner_node *inner = m_inners.create();
+                int children = (int)(nodes * (n + 1) / parents - nodes * n / parents);
+                K min = mins[i];
+                for (int k = 0; k < children; ++k, ++i)
+                {
+                    inner->m_child[k] = level[i];
+                    if (k)
+                        inner->m_keys[k - 1] = mins[i];
+                }
+                inner->m_count = children - 1;
+
+                level[n] = inner;
+                mins[n] = min;
+            }
+            nodes = parents;
+        }
+
+        m_root = level[0];
+        m_count = (int)count;
+
+        delete[] level;
+        delete[] mins;
+    }
+
+    int count() const
+    {
+        return m_count;
+    }
+
+    /* Number of nodes the allocators can hold without growing. This is
+     * only available with allocators that have a capacity, such as
+     * node_pool. */
+    size_t node_capacity() const
+    {
+        return m_leaves.capacity() + m_inners.capacity();
+    }
+
+    iterator begin()
+    {
+        return iterator(m_first, 0);
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(m_first, 0);
+    }
+
+    iterator end()
+    {
+        return iterator(nullptr, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(nullptr, 0);
+    }
+
+    /* First element whose key is not less than key */
+    iterator lower_bound(K const & key)
+    {
+        leaf_node *leaf;
+        int pos;
+        find(key, leaf, pos);
+        return iterator(leaf, pos);
+    }
+
+    const_iterator lower_bound(K const & key) const
+    {
+        leaf_node *leaf;
+        int pos;
+        find(key, leaf, pos);
+        return const_iterator(leaf, pos);
+    }
+
+    /* All elements with keys in [lo, hi) */
+    range_view<iterator> range(K const & lo, K const & hi)
+    {
+        return range_view<iterator>{ lower_bound(lo), lower_bound(hi) };
+    }
+
+    range_view<const_iterator> range(K const & lo, K const & hi) const
+    {
+        return range_view<const_iterator>{ lower_bound(lo), lower_bound(hi) };
+    }
+
+protected:
+    /* Find the first element not less than key. Returns true if its key
+     * is equal to key. The position is normalised so that it is never
+     * past the end of a leaf. */
+    bool find(K const & key, leaf_node * & leaf, int & pos) const
+    {
+        leaf = nullptr;
+        pos = 0;
+        if (!m_root)
+            return false;
+
+        node *n = m_root;
+        while (!n->m_leaf)
+        {
+            inner_node *inner = (inner_node *)n;
+            n = inner->m_child[child_index(inner, key)];
+        }
+
+        leaf = (leaf_node *)n;
+        pos = lower_index(leaf->m_keys, leaf->m_count, key);
+        if (pos == leaf->m_count)
+        {
+            leaf = leaf->m_next;
+            pos = 0;
+            return false;
+        }
+
+        return !(key < leaf->m_keys[pos]);
+    }
+
+    static void leaf_insert(leaf_node *leaf, int pos, K const & key, V const & value)
+    {
+        for (int i = leaf->m_count; i > pos; --i)
+        {
+            leaf->m_keys[i] = leaf->m_keys[i - 1];
+            leaf->m_values[i] = leaf->m_values[i - 1];
+        }
+        leaf->m_keys[pos] = key;
+        leaf->m_values[pos] = value;
+        ++leaf->m_count;
+    }
+
+    /* Insert key and its right child at position pos */
+    static void inner_insert(inner_node *inner, int pos, K const & key, node *child)
+    {
+        for (int i = inner->m_count; i > pos; --i)
+        {
+            inner->m_keys[i] = inner->m_keys[i - 1];
+            inner->m_child[i + 1] = inner->m_child[i];
+        }
+        inner->m_keys[pos] = key;
+        inner->m_child[pos + 1] = child;
+        ++inner->m_count;
+    }
+
+    /* Move the upper half of a full leaf to a new leaf on its right */
+    leaf_node *split_leaf(leaf_node *leaf)
+    {
+        leaf_node *right = m_leaves.create();
+        int mid = leaf->m_count / 2;
+        right->m_count = leaf->m_count - mid;
+        for (int i = 0; i < right->m_count; ++i)
+        {
+            right->m_keys[i] = leaf->m_keys[mid + i];
+            right->m_values[i] = leaf->m_values[mid + i];
+        }
+        leaf->m_count = mid;
+
+        right->m_prev = leaf;
+        right->m_next = leaf->m_next;
+        if (leaf->m_next)
+            leaf->m_next->m_prev = right;
+        else
+            m_last = right;
+        leaf->m_next = right;
+        return right;
+    }
+
+    /* Append src and the separator key to dst, then remove src */
+    void merge_leaves(leaf_node *dst, leaf_node *src)
+    {
+        for (int i = 0; i < src->m_count; ++i)
+        {
+            dst->m_keys[dst->m_count + i] = src->m_keys[i];
+            dst->m_values[dst->m_count + i] = src->m_values[i];
+        }
+        dst->m_count += src->m_count;
+
+        dst->m_next = src->m_next;
+        if (src->m_next)
+            src->m_next->m_prev = dst;
+        else
+            m_last = dst;
+        m_leaves.destroy(src);
+    }
+
+    void merge_inners(inner_node *dst, K const & sep, inner_node *src)
+    {
+        dst->m_keys[dst->m_count] = sep;
+        for (int i = 0; i < src->m_count; ++i)
+            dst->m_keys[dst->m_count + 1 + i] = src->m_keys[i];
+        for (int i = 0; i <= src->m_count; ++i)
+            dst->m_child[dst->m_count + 1 + i] = src->m_child[i];
+        dst->m_count += src->m_count + 1;
+        m_inners.destroy(src);
+    }
+
+    /* Remove key pos and the child to its right */
+    static void inner_remove(inner_node *inner, int pos)
+    {
+        for (int i = pos + 1; i < inner->m_count; ++i)
+        {
+            inner->m_keys[i - 1] = inner->m_keys[i];
+            inner->m_child[i] = inner->m_child[i + 1];
+        }
+        --inner->m_count;
+    }
+
+    /* Rebalance a leaf that lost too many elements. Return true if the
+     * parent lost a child and needs to be checked in turn. */
+    bool fix_leaf(leaf_node *leaf, inner_node *parent, int slot)
+    {
+        leaf_node *left = slot > 0 ? (leaf_node *)parent->m_child[slot - 1] : nullptr;
+        leaf_node *right = slot < parent->m_count ? (leaf_node *)parent->m_child[slot + 1] : nullptr;
+
+        if (left && left->m_count > LEAF_SIZE / 2)
+        {
+            --left->m_count;
+            leaf_insert(leaf, 0, left->m_keys[left->m_count], left->m_values[left->m_count]);
+            parent->m_keys[slot - 1] = leaf->m_keys[0];
+            return false;
+        }
+
+        if (right && right->m_count > LEAF_SIZE / 2)
+        {
+            leaf->m_keys[leaf->m_count] = right->m_keys[0];
+            leaf->m_values[leaf->m_count] = right->m_values[0];
+            ++leaf->m_count;
+            for (int i = 1; i < right->m_count; ++i)
+            {
+                right->m_keys[i - 1] = right->m_keys[i];
+                right->m_values[i - 1] = right->m_values[i];
+            }
+            --right->m_count;
+            parent->m_keys[slot] = right->m_keys[0];
+            return false;
+        }
+
+        if (left)
+        {
+            merge_leaves(left, leaf);
+            inner_remove(parent, slot - 1);
+        }
+        else
+        {
+            merge_leaves(leaf, right);
+            inner_remove(parent, slot);
+        }
+        return true;
+    }
+
+    bool fix_inner(inner_node *inner, inner_node *parent, int slot)
+    {
+        inner_node *left = slot > 0 ? (inner_node *)parent->m_child[slot - 1] : nullptr;
+        inner_node *right = slot < parent->m_count ? (inner_node *)parent->m_child[slot + 1] : nullptr;
+
+        if (left && left->m_count > INNER_SIZE / 2)
+        {
+            /* Rotate the last child of left through the parent */
+            inner->m_child[inner->m_count + 1] = inner->m_child[inner->m_count];
+            for (int i = inner->m_count; i > 0; --i)
+            {
+                inner->m_keys[i] = inner->m_keys[i - 1];
+                inner->m_child[i] = inner->m_child[i - 1];
+            }
+            inner->m_keys[0] = parent->m_keys[slot - 1];
+            inner->m_child[0] = left->m_child[left->m_count];
+            ++inner->m_count;
+            parent->m_keys[slot - 1] = left->m_keys[left->m_count - 1];
+            --left->m_count;
+            return false;
+        }
+
+        if (right && right->m_count > INNER_SIZE / 2)
+        {
+            /* Rotate the first child of right through the parent */
+            inner->m_keys[inner->m_count] = parent->m_keys[slot];
+            inner->m_child[inner->m_count + 1] = right->m_child[0];
+            ++inner->m_count;
+            parent->m_keys[slot] = right->m_keys[0];
+            for (int i = 1; i < right->m_count; ++i)
+                right->m_keys[i - 1] = right->m_keys[i];
+            for (int i = 1; i <= right->m_count; ++i)
+                right->m_child[i - 1] = right->m_child[i];
+            --right->m_count;
+            return false;
+        }
+
+        if (left)
+        {
+            merge_inners(left, parent->m_keys[slot - 1], inner);
+            inner_remove(parent, slot - 1);
+        }
+        else
+        {
+            merge_inners(inner, parent->m_keys[slot], right);
+            inner_remove(parent, slot);
+        }
+        return true;
+    }
+
+    void destroy(node *n)
+    {
+        if (n->m_leaf)
+        {
+            m_leaves.destroy((leaf_node *)n);
+            return;
+        }
+
+        inner_node *inner = (inner_node *)n;
+        for (int i = 0; i <= inner->m_count; ++i)
+            destroy(inner->m_child[i]);
+        m_inners.destroy(inner);
+    }
+
+    node * m_root = nullptr;
+    leaf_node * m_first = nullptr;
+    leaf_node * m_last = nullptr;
+
+    int m_count = 0;
+
+    A<leaf_node> m_leaves;
+    A<inner_node> m_inners;
+};
+
+} /* namespace lol */
+
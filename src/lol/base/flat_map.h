@@ -0,0 +1,154 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// The flat_map class
+// ------------------
+// A map stored as a sorted array of key/value pairs. Lookups are binary
+// searches over contiguous memory and iteration is a pointer walk, which
+// beats node-based maps for the small, mostly read-only tables that are
+// common in the engine. Insertions and removals are linear.
+//
+
+#include <lol/base/array.h>
+
+#include <utility>
+#include <functional>
+
+namespace lol
+{
+
+template<typename K, typename V, typename C = std::less<>>
+class flat_map
+{
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<K, V> value_type;
+    typedef value_type *iterator;
+    typedef value_type const *const_iterator;
+
+    inline flat_map() = default;
+
+    inline flat_map(std::initializer_list<value_type> list)
+    {
+        m_data.reserve(list.size());
+        for (auto const &kv : list)
+            insert(kv);
+    }
+
+    inline size_t size() const { return (size_t)m_data.count(); }
+    inline size_t count() const { return (size_t)m_data.count(); }
+    inline bool empty() const { return m_data.count() == 0; }
+
+    inline iterator begin() { return m_data.data(); }
+    inline iterator end() { return m_data.data() + m_data.count(); }
+    inline const_iterator begin() const { return m_data.data(); }
+    inline const_iterator end() const { return m_data.data() + m_data.count(); }
+
+    /* First element whose key is not less than the given key */
+    template<typename Q> inline iterator lower_bound(Q const &key)
+    {
+        return begin() + lower_index(key);
+    }
+
+    template<typename Q> inline const_iterator lower_bound(Q const &key) const
+    {
+        return begin() + lower_index(key);
+    }
+
+    template<typename Q> inline iterator find(Q const &key)
+    {
+        iterator it = lower_bound(key);
+        return it != end() && !C()(key, it->first) ? it : end();
+    }
+
+    template<typename Q> inline const_iterator find(Q const &key) const
+    {
+        const_iterator it = lower_bound(key);
+        return it != end() && !C()(key, it->first) ? it : end();
+    }
+
+    template<typename Q> inline size_t count(Q const &key) const
+    {
+        return find(key) != end() ? 1 : 0;
+    }
+
+    /* Insert a new element unless the key is already present. Returns
+     * the element with that key, and whether it was inserted. */
+    template<typename Q>
+    std::pair<iterator, bool> emplace(Q const &key, V const &val = V())
+    {
+        ptrdiff_t index = lower_index(key);
+        if (index < m_data.count() && !C()(key, m_data[index].first))
+            return std::make_pair(begin() + index, false);
+
+        m_data.insert(value_type(K(key), val), index);
+        return std::make_pair(begin() + index, true);
+    }
+
+    inline std::pair<iterator, bool> insert(value_type const &kv)
+    {
+        return emplace(kv.first, kv.second);
+    }
+
+    template<typename Q> inline V &operator [](Q const &key)
+    {
+        return emplace(key).first->second;
+    }
+
+    template<typename Q> size_t erase(Q const &key)
+    {
+        iterator it = find(key);
+        if (it == end())
+            return 0;
+        m_data.remove(it - begin());
+        return 1;
+    }
+
+    /* Return an iterator to the element following the erased one */
+    inline iterator erase(iterator it)
+    {
+        ptrdiff_t index = it - begin();
+        m_data.remove(index);
+        return begin() + index;
+    }
+
+    inline void clear() { m_data.clear(); }
+    inline void reserve(size_t count) { m_data.reserve((ptrdiff_t)count); }
+
+private:
+    template<typename Q> ptrdiff_t lower_index(Q const &key) const
+    {
+        value_type const *data = m_data.data();
+        ptrdiff_t lo = 0, len = m_data.count();
+        while (len > 0)
+        {
+            ptrdiff_t half = len / 2;
+            if (C()(data[lo + half].first, key))
+            {
+                lo += half + 1;
+                len -= half + 1;
+            }
+            else
+                len = half;
+        }
+        return lo;
+    }
+
+    array<value_type> m_data;
+};
+
+} /* namespace lol */
+
@@ -0,0 +1,490 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// The hash_map class
+// ------------------
+// An open addressing hash table. Each slot has a control byte that is
+// either EMPTY, DELETED, or the 7 low bits of the hash of its key, and
+// slots are probed in aligned groups of 16 so that all candidates of a
+// group are found with a couple of SSE2 instructions. Lookups touch the
+// control bytes and, most of the time, a single key.
+//
+// Iterators do not allocate. Any insertion may invalidate them; erasing
+// through erase(iterator) only invalidates the erased element.
+//
+
+#include <new>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <functional>
+#include <type_traits>
+#if __cpp_lib_string_view
+#   include <string_view>
+#endif
+#if defined __SSE2__
+#   include <emmintrin.h>
+#endif
+
+namespace lol
+{
+
+/* Finalisation step of MurmurHash3; spreads all the input bits over the
+ * whole result, which std::hash does not do for integers or pointers. */
+static inline uint64_t hash_mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+template<typename T> struct hash
+{
+    inline size_t operator()(T const &x) const
+    {
+        return (size_t)hash_mix(std::hash<T>()(x));
+    }
+};
+
+/* Strings are hashed with FNV-1a. This hash is transparent, so that maps
+ * with string keys can be queried with C strings or string views without
+ * building a temporary std::string. */
+template<> struct hash<std::string>
+{
+    typedef void is_transparent;
+
+    static inline size_t bytes(char const *s, size_t len)
+    {
+        uint64_t ret = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < len; ++i)
+            ret = (ret ^ (uint8_t)s[i]) * 0x100000001b3ull;
+        return (size_t)hash_mix(ret);
+    }
+
+    inline size_t operator()(std::string const &s) const
+    {
+        return bytes(s.data(), s.length());
+    }
+
+    inline size_t operator()(char const *s) const
+    {
+        return bytes(s, strlen(s));
+    }
+
+#if __cpp_lib_string_view
+    inline size_t operator()(std::string_view s) const
+    {
+        return bytes(s.data(), s.length());
+    }
+#endif
+};
+
+template<typename K, typename V, typename H = hash<K>,
+         typename E = std::equal_to<>>
+class hash_map
+{
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<K, V> value_type;
+
+    template<typename M, typename P> class iterator_base
+    {
+    public:
+        inline iterator_base(M *map, size_t index)
+          : m_map(map), m_index(index)
+        {
+            skip();
+        }
+
+        /* Allow iterator → const_iterator conversion */
+        template<typename M2, typename P2>
+        inline iterator_base(iterator_base<M2, P2> const &that)
+          : m_map(that.m_map), m_index(that.m_index)
+        {
+        }
+
+        inline P &operator *() const { return m_map->m_slots[m_index]; }
+        inline P *operator ->() const { return &m_map->m_slots[m_index]; }
+
+        inline iterator_base &operator ++()
+        {
+            ++m_index;
+            skip();
+            return *this;
+        }
+
+        inline bool operator ==(iterator_base const &that) const
+        {
+            return m_index == that.m_index;
+        }
+
+        inline bool operator !=(iterator_base const &that) const
+        {
+            return m_index != that.m_index;
+        }
+
+    private:
+        template<typename M2, typename P2> friend class iterator_base;
+        friend class hash_map;
+
+        inline void skip()
+        {
+            while (m_index < m_map->m_capacity && m_map->m_ctrl[m_index] < 0)
+                ++m_index;
+        }
+
+        M *m_map;
+        size_t m_index;
+    };
+
+    typedef iterator_base<hash_map, value_type> iterator;
+    typedef iterator_base<hash_map const, value_type const> const_iterator;
+
+    inline hash_map() = default;
+
+    inline hash_map(std::initializer_list<value_type> list)
+    {
+        reserve(list.size());
+        for (auto const &kv : list)
+            emplace(kv.first, kv.second);
+    }
+
+    inline hash_map(hash_map const &that)
+    {
+        reserve(that.m_size);
+        for (auto const &kv : that)
+            emplace(kv.first, kv.second);
+    }
+
+    inline hash_map(hash_map &&that)
+    {
+        swap(that);
+    }
+
+    inline hash_map &operator =(hash_map const &that)
+    {
+        if (this != &that)
+        {
+            hash_map tmp(that);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    inline hash_map &operator =(hash_map &&that)
+    {
+        swap(that);
+        return *this;
+    }
+
+    inline ~hash_map()
+    {
+        destroy();
+    }
+
+    inline void swap(hash_map &that)
+    {
+        std::swap(m_ctrl, that.m_ctrl);
+        std::swap(m_slots, that.m_slots);
+        std::swap(m_capacity, that.m_capacity);
+        std::swap(m_size, that.m_size);
+        std::swap(m_growth_left, that.m_growth_left);
+    }
+
+    inline size_t size() const { return m_size; }
+    inline size_t count() const { return m_size; }
+    inline bool empty() const { return m_size == 0; }
+    inline size_t capacity() const { return m_capacity; }
+
+    inline iterator begin() { return iterator(this, 0); }
+    inline iterator end() { return iterator(this, m_capacity); }
+    inline const_iterator begin() const { return const_iterator(this, 0); }
+    inline const_iterator end() const { return const_iterator(this, m_capacity); }
+
+    template<typename Q> inline iterator find(Q const &key)
+    {
+        return iterator(this, find_index(key));
+    }
+
+    template<typename Q> inline const_iterator find(Q const &key) const
+    {
+        return const_iterator(this, find_index(key));
+    }
+
+    template<typename Q> inline size_t count(Q const &key) const
+    {
+        return find_index(key) != m_capacity ? 1 : 0;
+    }
+
+    /* Insert a new element unless the key is already present. Returns
+     * the element with that key, and whether it was inserted. */
+    template<typename Q, typename... ARGS>
+    std::pair<iterator, bool> emplace(Q &&key, ARGS &&... args)
+    {
+        size_t hash = H()(key);
+        size_t index = find_index(key, hash);
+        if (index != m_capacity)
+            return std::make_pair(iterator(this, index), false);
+
+        index = prepare_insert(hash);
+        new (&m_slots[index]) value_type(std::piecewise_construct,
+                                         std::forward_as_tuple(std::forward<Q>(key)),
+                                         std::forward_as_tuple(std::forward<ARGS>(args)...));
+        return std::make_pair(iterator(this, index), true);
+    }
+
+    inline std::pair<iterator, bool> insert(value_type const &kv)
+    {
+        return emplace(kv.first, kv.second);
+    }
+
+    template<typename Q> inline V &operator [](Q &&key)
+    {
+        return emplace(std::forward<Q>(key)).first->second;
+    }
+
+    template<typename Q> inline size_t erase(Q const &key)
+    {
+        size_t index = find_index(key);
+        if (index == m_capacity)
+            return 0;
+        erase_index(index);
+        return 1;
+    }
+
+    /* Return an iterator to the element following the erased one */
+    inline iterator erase(iterator it)
+    {
+        erase_index(it.m_index);
+        return iterator(this, it.m_index + 1);
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < m_capacity; ++i)
+            if (m_ctrl[i] >= 0)
+                m_slots[i].~value_type();
+        if (m_capacity)
+            memset(m_ctrl, EMPTY, m_capacity);
+        m_size = 0;
+        m_growth_left = max_load(m_capacity);
+    }
+
+    /* Make room for at least count elements without rehashing */
+    void reserve(size_t count)
+    {
+        size_t capacity = GROUP;
+        while (max_load(capacity) < count)
+            capacity *= 2;
+        if (capacity > m_capacity)
+            rehash(capacity);
+    }
+
+private:
+    static int8_t const EMPTY = -128;
+    static int8_t const DELETED = -2;
+    static size_t const GROUP = 16;
+
+    /* Keep the load factor below 7/8 */
+    static inline size_t max_load(size_t capacity)
+    {
+        return capacity - capacity / 8;
+    }
+
+    static inline int8_t h2(size_t hash) { return (int8_t)(hash & 0x7f); }
+    static inline size_t h1(size_t hash) { return hash >> 7; }
+
+    /* Bit masks of the slots in a group whose control byte is equal to
+     * a given value, or that are free (empty or deleted). */
+#if defined __SSE2__
+    static inline uint32_t match(int8_t const *group, int8_t val)
+    {
+        __m128i ctrl = _mm_load_si128((__m128i const *)group);
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(val)));
+    }
+
+    static inline uint32_t match_free(int8_t const *group)
+    {
+        return (uint32_t)_mm_movemask_epi8(_mm_load_si128((__m128i const *)group));
+    }
+#else
+    static inline uint32_t match(int8_t const *group, int8_t val)
+    {
+        uint32_t ret = 0;
+        for (size_t i = 0; i < GROUP; ++i)
+            ret |= (uint32_t)(group[i] == val) << i;
+        return ret;
+    }
+
+    static inline uint32_t match_free(int8_t const *group)
+    {
+        uint32_t ret = 0;
+        for (size_t i = 0; i < GROUP; ++i)
+            ret |= (uint32_t)(group[i] < 0) << i;
+        return ret;
+    }
+#endif
+
+    static inline int lowest_bit(uint32_t mask)
+    {
+#if defined __GNUC__
+        return __builtin_ctz(mask);
+#else
+        int ret = 0;
+        while (!(mask & 1))
+            mask >>= 1, ++ret;
+        return ret;
+#endif
+    }
+
+    template<typename Q> inline size_t find_index(Q const &key) const
+    {
+        return m_capacity ? find_index(key, H()(key)) : m_capacity;
+    }
+
+    /* Groups are visited in triangular order, which reaches all of them
+     * when their count is a power of two. Only groups with no empty slot
+     * were ever skipped by an insertion, so the first empty slot ends
+     * the search. */
+    template<typename Q> size_t find_index(Q const &key, size_t hash) const
+    {
+        if (!m_capacity)
+            return 0;
+
+        size_t mask = m_capacity / GROUP - 1;
+        size_t group = h1(hash) & mask;
+        for (size_t step = 1; ; ++step)
+        {
+            int8_t const *ctrl = m_ctrl + group * GROUP;
+            for (uint32_t m = match(ctrl, h2(hash)); m; m &= m - 1)
+            {
+                size_t index = group * GROUP + lowest_bit(m);
+                if (E()(m_slots[index].first, key))
+                    return index;
+            }
+            if (match(ctrl, EMPTY))
+                return m_capacity;
+            group = (group + step) & mask;
+        }
+    }
+
+    /* Find a free slot for a key that is known to be absent, and mark
+     * it as used. The caller constructs the element. */
+    size_t prepare_insert(size_t hash)
+    {
+        if (!m_growth_left)
+        {
+            /* If most of the used slots are tombstones, cleaning them up
+             * is enough; otherwise, grow the table. */
+            size_t capacity = m_capacity ? m_capacity : GROUP;
+            if (m_size >= max_load(capacity) / 2)
+                capacity *= 2;
+            rehash(capacity);
+        }
+
+        size_t index = free_index(hash);
+        if (m_ctrl[index] == EMPTY)
+            --m_growth_left;
+        m_ctrl[index] = h2(hash);
+        ++m_size;
+        return index;
+    }
+
+    size_t free_index(size_t hash) const
+    {
+        size_t mask = m_capacity / GROUP - 1;
+        size_t group = h1(hash) & mask;
+        for (size_t step = 1; ; ++step)
+        {
+            uint32_t m = match_free(m_ctrl + group * GROUP);
+            if (m)
+                return group * GROUP + lowest_bit(m);
+            group = (group + step) & mask;
+        }
+    }
+
+    /* A slot can go back to EMPTY if its group already has an empty
+     * slot, since no probe sequence ever went past that group. */
+    void erase_index(size_t index)
+    {
+        m_slots[index].~value_type();
+        --m_size;
+        if (match(m_ctrl + index / GROUP * GROUP, EMPTY))
+        {
+            m_ctrl[index] = EMPTY;
+            ++m_growth_left;
+        }
+        else
+            m_ctrl[index] = DELETED;
+    }
+
+    void rehash(size_t capacity)
+    {
+        int8_t *old_ctrl = m_ctrl;
+        value_type *old_slots = m_slots;
+        size_t old_capacity = m_capacity;
+
+        /* Slots and control bytes share a single allocation; control
+         * bytes are aligned on a group boundary for the SSE2 loads. */
+        size_t slot_bytes = capacity * sizeof(value_type);
+        uint8_t *data = (uint8_t *)::operator new(slot_bytes + capacity + GROUP);
+        m_slots = (value_type *)data;
+        m_ctrl = (int8_t *)(data + slot_bytes);
+        m_ctrl += (GROUP - (uintptr_t)m_ctrl % GROUP) % GROUP;
+        memset(m_ctrl, EMPTY, capacity);
+        m_capacity = capacity;
+        m_growth_left = max_load(capacity) - m_size;
+
+        for (size_t i = 0; i < old_capacity; ++i)
+        {
+            if (old_ctrl[i] < 0)
+                continue;
+            size_t hash = H()(old_slots[i].first);
+            size_t index = free_index(hash);
+            m_ctrl[index] = h2(hash);
+            new (&m_slots[index]) value_type(std::move(old_slots[i]));
+            old_slots[i].~value_type();
+        }
+
+        if (old_capacity)
+            ::operator delete(old_slots);
+    }
+
+    void destroy()
+    {
+        for (size_t i = 0; i < m_capacity; ++i)
+            if (m_ctrl[i] >= 0)
+                m_slots[i].~value_type();
+        if (m_capacity)
+            ::operator delete(m_slots);
+        m_ctrl = nullptr;
+        m_slots = nullptr;
+        m_capacity = m_size = m_growth_left = 0;
+    }
+
+    int8_t *m_ctrl = nullptr;
+    value_type *m_slots = nullptr;
+    size_t m_capacity = 0, m_size = 0, m_growth_left = 0;
+};
+
+} /* namespace lol */
+
@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2015 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -17,9 +17,18 @@
 // -----------------
 // The central logging system.
 //
+// Messages are formatted on the calling thread, stored in a per-thread
+// lock-free ring buffer, and written by a background thread, so that
+// logging does not wait for the terminal or the disk. Errors are written
+// immediately, together with everything that was logged before them.
+// Pending messages are also written on exit and, if the application asks
+// for it, when the program crashes.
+//
 
 #include <stdint.h>
 #include <cstdarg>
+#include <cstddef>
+#include <string>
 
 namespace lol
 {
@@ -40,6 +49,54 @@ public:
         error,
     };
 
+    /* Write messages from the calling thread instead of the background
+     * thread. This is also the case if LOL_LOG_SYNC is set in the
+     * environment, or if the platform has no threads. */
+    static void set_async(bool async);
+
+    /* Wait until all pending messages are written */
+    static void flush();
+
+    /* Write pending messages when the program receives SIGSEGV, SIGBUS,
+     * SIGFPE, SIGILL or SIGABRT, then pass the signal on to the handlers
+     * that were installed before. Does nothing on platforms without
+     * POSIX signals. */
+    static void install_crash_handler();
+
+    /* Maximum number of debug and info messages per second and per
+     * thread, or 0 for no limit. Warnings and errors are never dropped. */
+    static void set_rate_limit(int per_second);
+
+    /* Enable or disable the platform's console output */
+    static void set_console(bool enabled);
+
+    /* Also write messages to a file. Once the file is larger than max_size
+     * bytes (unless max_size is 0), it is renamed to “path.1”, “path.1” to
+     * “path.2” and so on, keeping at most max_files old files. An empty
+     * path closes the file. */
+    static void set_log_file(std::string const &path,
+                             size_t max_size = 0, int max_files = 1);
+
+    /* A key/value pair prepended to all the messages logged by the current
+     * thread during the lifetime of the object, for instance:
+     *   msg::field f("level", name);
+     *   msg::info("loaded\n"); // “INFO: [level=e1m1] loaded” */
+    class field
+    {
+    public:
+        field(char const *key, std::string const &value);
+        ~field();
+
+        field(field const &) = delete;
+        field &operator =(field const &) = delete;
+
+    private:
+        friend class msg;
+
+        std::string m_key, m_value;
+        field const *m_prev;
+    };
+
 private:
     static void helper(message_type type, char const *fmt, va_list ap);
 };
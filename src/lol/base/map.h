@@ -1,7 +1,7 @@
 //
 //  Lol Engine
 //
-//  Copyright © 2010—2018 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
 //            © 2013—2015 Guillaume Bittoun <guillaume.bittoun@gmail.com>
 //
 //  Lol Engine is free software. It comes without any warranty, to
@@ -42,13 +42,48 @@ static inline bool try_get(T const &m, typename T::key_type const &key,
     return true;
 }
 
+/* A view over the keys of a map. Iterating it does not allocate; it
+ * converts to an array when a copy of the keys is actually needed, for
+ * instance to modify the map while walking through them. */
 template <typename T>
-static inline array<typename T::key_type> keys(T const &m)
+class key_view
 {
-    array<typename T::key_type> ret;
-    for (auto const &it : m)
-        ret << it.first;
-    return ret;
+public:
+    class iterator
+    {
+    public:
+        inline iterator(typename T::const_iterator it) : m_it(it) {}
+
+        inline typename T::key_type const &operator *() const { return m_it->first; }
+        inline iterator &operator ++() { ++m_it; return *this; }
+        inline bool operator !=(iterator const &that) const { return m_it != that.m_it; }
+
+    private:
+        typename T::const_iterator m_it;
+    };
+
+    inline key_view(T const &m) : m_map(m) {}
+
+    inline iterator begin() const { return iterator(m_map.begin()); }
+    inline iterator end() const { return iterator(m_map.end()); }
+
+    inline operator array<typename T::key_type>() const
+    {
+        array<typename T::key_type> ret;
+        ret.reserve(m_map.size());
+        for (auto const &it : m_map)
+            ret << it.first;
+        return ret;
+    }
+
+private:
+    T const &m_map;
+};
+
+template <typename T>
+static inline key_view<T> keys(T const &m)
+{
+    return key_view<T>(m);
 }
 
 } /* namespace lol */
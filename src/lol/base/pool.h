@@ -0,0 +1,150 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// Node allocators
+// ---------------
+// Containers that allocate one node at a time (trees, lists) take their
+// allocator as a template parameter with a create()/destroy() interface.
+// node_pool carves objects out of large chunks and recycles them through
+// a free list, which keeps nodes close together in memory and avoids
+// going through the global heap for each of them. node_heap simply calls
+// new and delete, for comparison or for nodes that must outlive their
+// container.
+//
+
+#include <new>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+
+namespace lol
+{
+
+template<typename T> class node_pool
+{
+public:
+    inline node_pool() = default;
+
+    node_pool(node_pool const &) = delete;
+    node_pool &operator =(node_pool const &) = delete;
+
+    /* Memory is released, but the destructors of objects that were not
+     * destroyed are not called. */
+    inline ~node_pool()
+    {
+        while (m_chunks)
+        {
+            chunk *next = m_chunks->m_next;
+            ::operator delete(m_chunks);
+            m_chunks = next;
+        }
+    }
+
+    template<typename... ARGS> inline T *create(ARGS &&... args)
+    {
+        return new (alloc()) T(std::forward<ARGS>(args)...);
+    }
+
+    inline void destroy(T *p)
+    {
+        p->~T();
+        free(p);
+    }
+
+    inline void *alloc()
+    {
+        if (!m_free)
+            grow();
+        slot *ret = m_free;
+        m_free = ret->m_next;
+        ++m_count;
+        return ret;
+    }
+
+    inline void free(void *p)
+    {
+        slot *s = (slot *)p;
+        s->m_next = m_free;
+        m_free = s;
+        --m_count;
+    }
+
+    /* Number of live objects */
+    inline size_t count() const { return m_count; }
+
+    /* Number of objects that fit in the allocated chunks */
+    inline size_t capacity() const { return m_capacity; }
+
+private:
+    union slot
+    {
+        slot *m_next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type m_data;
+    };
+
+    struct chunk
+    {
+        chunk *m_next;
+    };
+
+    /* Chunks double in size up to a few thousand objects */
+    void grow()
+    {
+        size_t count = m_capacity ? m_capacity : 16;
+        if (count > 4096)
+            count = 4096;
+
+        size_t header = (sizeof(chunk) + alignof(slot) - 1) / alignof(slot) * alignof(slot);
+        chunk *c = (chunk *)::operator new(header + count * sizeof(slot));
+        c->m_next = m_chunks;
+        m_chunks = c;
+        m_capacity += count;
+
+        slot *slots = (slot *)((char *)c + header);
+        for (size_t i = count; i--; )
+        {
+            slots[i].m_next = m_free;
+            m_free = &slots[i];
+        }
+    }
+
+    chunk *m_chunks = nullptr;
+    slot *m_free = nullptr;
+    size_t m_count = 0, m_capacity = 0;
+};
+
+template<typename T> class node_heap
+{
+public:
+    template<typename... ARGS> inline T *create(ARGS &&... args)
+    {
+        ++m_count;
+        return new T(std::forward<ARGS>(args)...);
+    }
+
+    inline void destroy(T *p)
+    {
+        --m_count;
+        delete p;
+    }
+
+    inline size_t count() const { return m_count; }
+
+private:
+    size_t m_count = 0;
+};
+
+} /* namespace lol */
+
@@ -43,6 +43,7 @@
 #include <lol/../text.h>
 #include <lol/../textureimage.h>
 #include <lol/../tileset.h>
+#include <lol/../tileatlas.h>
 
 // UI
 #include <lol/../ui/input.h>
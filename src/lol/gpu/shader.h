@@ -319,9 +319,15 @@ class Shader
 public:
     static std::shared_ptr<Shader> Create(std::string const &name, std::string const &code);
 
+    /* Keep linked programs in “dir” so that later runs with the same
+     * driver skip compilation. Disabled when “dir” is empty, the default. */
+    static void SetBinaryCache(std::string const &dir);
+
     int GetAttribCount() const;
     ShaderAttrib GetAttribLocation(VertexUsage usage, int index) const;
 
+    /* Uniform locations are resolved at link time; this is a hash table
+     * lookup, but callers in hot paths should still keep the result. */
     ShaderUniform GetUniformLocation(std::string const& uni) const;
     ShaderUniform GetUniformLocation(char const *uni) const;
     void SetUniform(ShaderUniform const &uni, int i);
@@ -17,4 +17,6 @@
 #include <lol/image/image.h>
 #include <lol/image/resource.h>
 #include <lol/image/movie.h>
+#include <lol/image/tiled.h>
+#include <lol/image/atlas.h>
 
@@ -0,0 +1,123 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// The image_atlas class
+// ---------------------
+// Packs rectangles taken from many images into a few shared pages. Groups
+// of rectangles, such as all the tiles of a tileset, always share a page.
+// Each rectangle is surrounded by a copy of its own edge pixels, so that
+// filtering never bleeds neighbouring rectangles in. With “mip_levels”
+// set, padded rectangles are also aligned on 2^mip_levels texels and the
+// padding is at least that wide, so that the first mip_levels mipmaps of
+// a page do not bleed either; smaller mipmaps must not be used.
+//
+
+#include <lol/image/pixel.h>
+#include <lol/image/image.h>
+
+#include <string>
+
+namespace lol
+{
+
+// A MaxRects bin packer: keeps the list of maximal free rectangles and
+// places each new rectangle where it leaves the shortest side free.
+class rect_packer
+{
+public:
+    rect_packer(ivec2 size = ivec2(0));
+
+    ivec2 size() const { return m_size; }
+
+    /* Find room for a rectangle, or return false */
+    bool insert(ivec2 size, ibox2 &placed);
+
+    /* Mark an area as used, e.g. when restoring a saved layout */
+    void occupy(ibox2 area);
+
+    /* Fraction of the area given to insert() or occupy() */
+    float occupancy() const;
+
+private:
+    void prune(array<ibox2> const &split);
+
+    ivec2 m_size;
+    int64_t m_used;
+    array<ibox2> m_free;
+};
+
+class image_atlas
+{
+public:
+    /* Pages should have power of two sizes to be usable as textures */
+    image_atlas(ivec2 page_size = ivec2(1024), int padding = 2,
+                int mip_levels = 0);
+
+    /* Copy the “rects” areas of “img” into the same page, and return the
+     * new group index, or -1 if they would not fit in an empty page. */
+    int add(std::string const &name, image const &img,
+            array<ibox2> const &rects);
+
+    /* Index of the group with the given name, or -1 */
+    int find(std::string const &name) const;
+
+    int group_count() const { return m_groups.count(); }
+    int group_page(int n) const { return m_groups[n].page; }
+    array<ibox2> const &group_rects(int n) const { return m_groups[n].rects; }
+
+    /* Pages are RGBA_8 images. The version of a page changes whenever
+     * pixels are added to it, so that textures can be updated. */
+    int page_count() const { return m_pages.count(); }
+    ivec2 page_size() const { return m_page_size; }
+    int padding() const { return m_padding; }
+    int mip_levels() const { return m_mip_levels; }
+    image const &page(int n) const { return m_pages[n].img; }
+    int page_version(int n) const { return m_pages[n].version; }
+
+    /* Fraction of the page area covered by rectangles, padding excluded */
+    float efficiency() const;
+
+    /* Store the layout and pixels in a single binary file. Loading
+     * rejects files whose rectangles do not fit their page. */
+    bool save(std::string const &path) const;
+    bool load(std::string const &path);
+
+private:
+    struct group
+    {
+        std::string name;
+        int page;
+        array<ibox2> rects;
+    };
+
+    struct atlas_page
+    {
+        image img;
+        rect_packer packer;
+        int version;
+    };
+
+    bool place(rect_packer &packer, array<ibox2> const &rects,
+               array<ibox2> &placed) const;
+    ibox2 cell(ibox2 const &rect) const;
+
+    ivec2 m_page_size;
+    int m_padding, m_mip_levels;
+    array<group> m_groups;
+    array<atlas_page> m_pages;
+};
+
+} /* namespace lol */
+
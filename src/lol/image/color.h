@@ -318,6 +318,29 @@ public:
      */
     static vec3 WavelengthToCIExyY(float nm);
 
+    /*
+     * Batch versions of the above, working on count RGBA pixels at once.
+     * Alpha is left untouched and dst may be the same buffer as src.
+     * The 8-bit sRGB input variant uses a lookup table.
+     */
+    static void sRGBToLinearRGB(vec4 *dst, vec4 const *src, size_t count);
+    static void sRGBToLinearRGB(vec4 *dst, u8vec4 const *src, size_t count);
+    static void LinearRGBTosRGB(vec4 *dst, vec4 const *src, size_t count);
+    static void RGBToYUV(vec4 *dst, vec4 const *src, size_t count);
+    static void YUVToRGB(vec4 *dst, vec4 const *src, size_t count);
+    static void RGBToHSV(vec4 *dst, vec4 const *src, size_t count);
+    static void HSVToRGB(vec4 *dst, vec4 const *src, size_t count);
+    static void LinearRGBToCIEXYZ(vec4 *dst, vec4 const *src, size_t count);
+    static void CIEXYZToLinearRGB(vec4 *dst, vec4 const *src, size_t count);
+    static void CIEXYZToCIELab(vec4 *dst, vec4 const *src, size_t count);
+    static void LinearRGBToCIELab(vec4 *dst, vec4 const *src, size_t count);
+
+    /*
+     * Distances from count L*a*b* colours to a reference colour.
+     */
+    static void DistanceCIEDE2000(float *dst, vec3 const *lab, vec3 ref,
+                                  size_t count);
+
     /*
     * Convert uint color to vec4.
     */
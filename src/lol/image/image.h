@@ -43,6 +43,28 @@ enum class ResampleAlgorithm : uint8_t
 {
     Bicubic,
     Bresenham,
+    Box,
+    Bilinear,
+    Mitchell,
+    Lanczos3,
+};
+
+enum class MorphologyShape : uint8_t
+{
+    Rectangle,
+    Disc,
+};
+
+enum class QuantizeAlgorithm : uint8_t
+{
+    MedianCut,
+    KMeans,
+};
+
+enum class ColorSpace : uint8_t
+{
+    RGB,
+    CIELab,
 };
 
 enum class EdiffAlgorithm : uint8_t
@@ -132,8 +154,27 @@ public:
     image Resize(ivec2 size, ResampleAlgorithm algorithm);
     image Crop(ibox2 box) const;
 
+    /* Statistics; grey images only use the first component. Results do
+     * not depend on the number of threads. */
+    struct pixel_stats
+    {
+        int count;
+        vec4 min, max;
+        dvec4 sum, mean, variance;
+    };
+
+    pixel_stats statistics() const;
+    /* Per-channel counts of values in [0, 1] split into “bins” bins;
+     * values outside that range go to the first or last bin. */
+    array<ivec4> histogram(int bins = 256) const;
+    /* The value of rank p × (count - 1) in each channel, for p in [0, 1] */
+    vec4 percentile(float p) const;
+    /* Summed-area table: element [x][y] is the sum of pixels [0…x]×[0…y] */
+    array2d<dvec4> summed_area() const;
+
     /* Image processing */
     image AutoContrast() const;
+    image AutoThreshold() const;
     image Brightness(float val) const;
     image Contrast(float val) const;
     image Convolution(array2d<float> const &kernel);
@@ -147,15 +188,55 @@ public:
     image Threshold(vec3 val) const;
     image RGBToYUV() const;
     image YUVToRGB() const;
+    image sRGBToLinearRGB() const;
+    image LinearRGBTosRGB() const;
+
+    /* Morphology; Dilate() and Erode() without arguments use a 3×3 cross.
+     * The cost per pixel does not depend on the radii. */
+    image Dilate(ivec2 radii,
+                 MorphologyShape shape = MorphologyShape::Rectangle) const;
+    image Erode(ivec2 radii,
+                MorphologyShape shape = MorphologyShape::Rectangle) const;
+    image Open(ivec2 radii,
+               MorphologyShape shape = MorphologyShape::Rectangle) const;
+    image Close(ivec2 radii,
+                MorphologyShape shape = MorphologyShape::Rectangle) const;
+    image TopHat(ivec2 radii,
+                 MorphologyShape shape = MorphologyShape::Rectangle) const;
+
+    /* Colour quantisation */
+    array<vec4> quantize(int colors,
+                         QuantizeAlgorithm algorithm = QuantizeAlgorithm::KMeans,
+                         ColorSpace space = ColorSpace::RGB) const;
+    image remap(array<vec4> const &palette,
+                ColorSpace space = ColorSpace::RGB) const;
+    /* Return a Y_8 image of palette indices, e.g. for gpu_palette tiles */
+    image remap_indices(array<vec4> const &palette,
+                        ColorSpace space = ColorSpace::RGB) const;
 
     /* Dithering */
     image dither_random() const;
     image dither_ediff(array2d<float> const &kernel,
                        ScanMode scan = ScanMode::Raster) const;
+    image dither_ediff(array2d<float> const &kernel,
+                       array<vec4> const &palette,
+                       ScanMode scan = ScanMode::Raster) const;
     image dither_ostromoukhov(ScanMode scan = ScanMode::Raster) const;
     image dither_ordered(array2d<float> const &kernel) const;
     image dither_halftone(float radius, float angle) const;
-    image dither_dbs() const;
+
+    /* Direct binary search dithering stops after max_passes passes over
+     * the image, or when a pass changes no more than tolerance times the
+     * number of pixels. Per-pass statistics are appended to stats. */
+    struct dbs_pass
+    {
+        int changes;  /* toggles and swaps applied during the pass */
+        int cells;    /* cells that were visited */
+        float error;  /* perceived error at the end of the pass */
+    };
+
+    image dither_dbs(int max_passes = 50, float tolerance = 0.f,
+                     array<dbs_pass> *stats = nullptr) const;
 
     /* Combine images */
     static image Merge(image &src1, image &src2, float alpha);
@@ -15,10 +15,15 @@
 //
 // The movie class
 // ---------------
+// Frames are converted on the calling thread and encoded on a background
+// thread, through a bounded queue of reusable frames.
 //
 
 #include <lol/image/pixel.h>
 #include <lol/image/image.h>
+#include <lol/sys/thread.h>
+
+#include <atomic>
 
 extern "C" struct AVFormatContext;
 extern "C" struct AVCodecContext;
@@ -28,25 +33,47 @@ extern "C" struct AVFrame;
 namespace lol
 {
 
+// Frame conversion helpers used by the movie class. Source pixels are
+// 8-bit RGBA and rows are “pitch” pixels apart; a negative pitch reads the
+// rows bottom-up, which flips frames read back from OpenGL for free.
+void convert_to_rgb332(u8vec4 const *src, ptrdiff_t pitch, ivec2 size,
+                       uint8_t *dst, ptrdiff_t dst_pitch);
+void convert_to_yuv420(u8vec4 const *src, ptrdiff_t pitch, ivec2 size,
+                       uint8_t *const planes[3], int const pitches[3]);
+
 class movie
 {
 public:
     movie(ivec2 size);
+    ~movie();
 
+    /* The container is guessed from the file name, and defaults to GIF.
+     * GIF movies are encoded as 3:3:2 RGB, all others as YUV 4:2:0. */
     bool open_file(std::string const &filename);
     bool push_image(image &im);
+    bool push_frame(u8vec4 const *pixels, ptrdiff_t pitch);
     void close();
 
 private:
     bool open_codec();
+    bool encode(AVFrame *frame);
+    void encoder_thread();
 
 private:
+    /* Number of frames that may be waiting for the encoder */
+    static int const QUEUE_SIZE = 4;
+
     AVFormatContext *m_avformat;
     AVCodecContext *m_avcodec;
     AVStream *m_stream;
-    AVFrame *m_frame;
+    AVFrame *m_frames[QUEUE_SIZE];
     ivec2 m_size;
     int m_index;
+
+    queue<AVFrame *, QUEUE_SIZE> m_free, m_pending;
+    thread *m_encoder;
+    std::atomic<bool> m_failed;
+    bool m_header_written;
 };
 
 } // namespace lol
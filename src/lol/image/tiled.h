@@ -0,0 +1,73 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// The tiled_image class
+// ---------------------
+// An image too large to be held in memory. Pixels are stored in square
+// tiles in a scratch file that is deleted with the image, and only the
+// most recently used tiles stay in memory, within a given budget. Where
+// the platform allows it, tiles are memory-mapped views of the file.
+//
+
+#include <lol/image/pixel.h>
+#include <lol/image/image.h>
+
+#include <functional>
+
+namespace lol
+{
+
+class tiled_image
+{
+public:
+    /* The format is either PixelFormat::Y_F32 or PixelFormat::RGBA_F32 */
+    tiled_image(ivec2 size, PixelFormat format = PixelFormat::RGBA_F32,
+                ivec2 tile_size = ivec2(256));
+    ~tiled_image();
+
+    tiled_image(tiled_image const &) = delete;
+    tiled_image &operator =(tiled_image const &) = delete;
+
+    ivec2 size() const;
+    PixelFormat format() const;
+    ivec2 tile_size() const;
+
+    /* Memory used by resident tiles, in bytes. Tiles in use are never
+     * evicted, so the usage may briefly exceed the budget. */
+    void set_cache_budget(size_t bytes);
+    size_t cache_budget() const;
+    size_t cache_usage() const;
+
+    /* Copy pixels from an image, or into a new image */
+    void write(image const &src, ivec2 origin = ivec2(0));
+    image read(ibox2 box) const;
+
+    /* Run “filter” on every tile and store the results in dst, which
+     * must have the same size. Each tile is given to the filter with a
+     * margin of “halo” pixels taken from its neighbours, except at the
+     * image borders, so that filters reading at most “halo” pixels away
+     * give the same result as on the whole image. Filters that wrap
+     * around the image borders are not supported. */
+    void process(tiled_image &dst, ivec2 halo,
+                 std::function<image(image const &)> const &filter) const;
+
+private:
+    void copy_from(image const &src, ibox2 box, ivec2 origin);
+
+    class tiled_image_data *m_data;
+};
+
+} /* namespace lol */
+
@@ -104,12 +104,25 @@ public:
 
     inline arraynd() = default;
 
+    /* Use the given allocator instead of the heap; see allocator.h */
+    inline explicit arraynd(allocator *alloc)
+      : super(alloc)
+    {
+    }
+
     inline arraynd(vec_t<ptrdiff_t, N> sizes, element_t e = element_t())
       : m_sizes(sizes)
     {
         resize_data(e);
     }
 
+    inline arraynd(vec_t<ptrdiff_t, N> sizes, element_t e, allocator *alloc)
+      : super(alloc),
+        m_sizes(sizes)
+    {
+        resize_data(e);
+    }
+
     /* Additional constructor if ptrdiff_t != int */
     template<typename T2 = int, typename T3 = typename std::enable_if<!std::is_same<ptrdiff_t, T2>::value, int>::type>
     inline arraynd(vec_t<T2, N> sizes, element_t e = element_t())
@@ -251,6 +264,9 @@ public:
         return this->m_sizes;
     }
 
+    inline void set_allocator(allocator *alloc) { super::set_allocator(alloc); }
+    inline allocator *get_allocator() const { return super::get_allocator(); }
+
 public:
     inline element_t *data() { return super::data(); }
     inline element_t const *data() const { return super::data(); }
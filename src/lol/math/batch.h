@@ -0,0 +1,53 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// Batch vector operations
+// -----------------------
+// These apply the same operation to arrays of vectors, quaternions or
+// scalars. They give the same results as calling the scalar functions
+// in a loop, up to floating point rounding, but use SIMD instructions
+// when available. Destination arrays may alias source arrays.
+//
+
+#include <lol/math/vector.h>
+#include <lol/math/matrix.h>
+#include <lol/math/transform.h>
+
+#include <cstddef>
+
+namespace lol
+{
+
+/* dst[i] = m * src[i] */
+void transform(vec4 *dst, vec4 const *src, size_t count, mat4 const &m);
+
+/* Same as above for data stored as structure of arrays: x, y, z and w
+ * each point to count floats, and are transformed in place. */
+void transform(float *x, float *y, float *z, float *w, size_t count,
+               mat4 const &m);
+
+/* dst[i] = normalize(src[i]) */
+void normalize_all(vec3 *dst, vec3 const *src, size_t count);
+void normalize_all(vec4 *dst, vec4 const *src, size_t count);
+
+/* dst[i] = dot(a[i], b[i]) */
+void dot_all(float *dst, vec3 const *a, vec3 const *b, size_t count);
+void dot_all(float *dst, vec4 const *a, vec4 const *b, size_t count);
+
+/* dst[i] = slerp(a[i], b[i], f) */
+void slerp(quat *dst, quat const *a, quat const *b, float f, size_t count);
+
+} /* namespace lol */
+
@@ -34,11 +34,27 @@ namespace lol
  * integers are unused. The highest used bit is the sign bit.
  *
  * Digits are stored in little endian mode.
+ *
+ * Digit operations are done in an unsigned type twice as wide as T;
+ * 64-bit digits are only available if the compiler provides __int128.
  */
 
+template<typename T> struct bigint_wide;
+
+template<> struct bigint_wide<uint32_t> { typedef uint64_t type; };
+
+#if defined __SIZEOF_INT128__
+template<> struct bigint_wide<uint64_t> { typedef unsigned __int128 type; };
+#endif
+
+template<unsigned int N = 16, typename T = uint32_t> class montgomery;
+template<unsigned int N = 16, typename T = uint32_t> class barrett;
+
 template<unsigned int N = 16, typename T = uint32_t>
 class LOL_ATTR_NODISCARD bigint
 {
+    typedef typename bigint_wide<T>::type W;
+
     static int const bits_per_digit = sizeof(T) * 8 - 1;
     static T const digit_mask = ~((T)1 << bits_per_digit);
 
@@ -89,10 +105,10 @@ public:
      * pad the rest (if applicable) with zeroes or ones to extend the
      * sign bit.
      */
-    template<int M>
+    template<unsigned int M>
     explicit bigint(bigint<M,T> const &x)
     {
-        for (unsigned int i = 0; i < (N < M) ? N : M; ++i)
+        for (unsigned int i = 0; i < ((N < M) ? N : M); ++i)
             m_digits[i] = x.m_digits[i];
 
         if (N > M)
@@ -238,6 +254,78 @@ public:
         return multiply(x);
     }
 
+    /*
+     * bigint division: the quotient is truncated towards zero and the
+     * remainder has the sign of the dividend, like for native integers.
+     * Division by zero is undefined.
+     */
+    inline bigint<N,T> operator /(bigint<N,T> const &x) const
+    {
+        bigint<N,T> q, r;
+        divide(*this, x, q, r);
+        return q;
+    }
+
+    inline bigint<N,T> operator %(bigint<N,T> const &x) const
+    {
+        bigint<N,T> q, r;
+        divide(*this, x, q, r);
+        return r;
+    }
+
+    inline bigint<N,T> & operator /=(bigint<N,T> const &x)
+    {
+        return *this = *this / x;
+    }
+
+    inline bigint<N,T> & operator %=(bigint<N,T> const &x)
+    {
+        return *this = *this % x;
+    }
+
+    /*
+     * bigint shifts: left shifts discard the bits that overflow, right
+     * shifts extend the sign bit. Negative shift counts are undefined.
+     */
+    bigint<N,T> operator <<(int n) const
+    {
+        bigint<N,T> ret;
+        int const q = n / bits_per_digit, r = n % bits_per_digit;
+        for (int i = 0; i < (int)N; ++i)
+        {
+            T lo = i - q >= 0 ? m_digits[i - q] : (T)0;
+            T lo2 = i - q - 1 >= 0 ? m_digits[i - q - 1] : (T)0;
+            ret.m_digits[i] = ((lo << r) | (lo2 >> (bits_per_digit - r)))
+                            & digit_mask;
+        }
+        return ret;
+    }
+
+    bigint<N,T> operator >>(int n) const
+    {
+        bigint<N,T> ret;
+        T padding = is_negative() ? digit_mask : (T)0;
+        int const q = n / bits_per_digit, r = n % bits_per_digit;
+        for (int i = 0; i < (int)N; ++i)
+        {
+            T hi = i + q < (int)N ? m_digits[i + q] : padding;
+            T hi2 = i + q + 1 < (int)N ? m_digits[i + q + 1] : padding;
+            ret.m_digits[i] = ((hi >> r) | (hi2 << (bits_per_digit - r)))
+                            & digit_mask;
+        }
+        return ret;
+    }
+
+    inline bigint<N,T> & operator <<=(int n)
+    {
+        return *this = *this << n;
+    }
+
+    inline bigint<N,T> & operator >>=(int n)
+    {
+        return *this = *this >> n;
+    }
+
     /*
      * bigint equality operator: just use memcmp.
      * FIXME: we could easily support operands of different sizes.
@@ -254,26 +342,20 @@ public:
 
     /*
      * bigint comparison operators: take a quick decision if signs
-     * differ. Otherwise, compare all digits.
+     * differ. Otherwise, compare all digits, most significant first.
      */
     bool operator >(bigint<N,T> const &x) const
     {
         if (is_negative() ^ x.is_negative())
             return x.is_negative();
-        for (unsigned int i = 0; i < N; ++i)
-            if (m_digits[i] != x.m_digits[i])
-                return m_digits[i] > x.m_digits[i];
-        return false;
+        return compare(m_digits.data(), x.m_digits.data(), N) > 0;
     }
 
     bool operator <(bigint<N,T> const &x) const
     {
         if (is_negative() ^ x.is_negative())
             return is_negative();
-        for (unsigned int i = 0; i < N; ++i)
-            if (m_digits[i] != x.m_digits[i])
-                return m_digits[i] < x.m_digits[i];
-        return false;
+        return compare(m_digits.data(), x.m_digits.data(), N) < 0;
     }
 
     inline bool operator >=(bigint<N,T> const &x) const
@@ -317,6 +399,8 @@ public:
 private:
     /* Allow other types of bigints to access our private members */
     template<unsigned int, typename> friend class bigint;
+    template<unsigned int, typename> friend class montgomery;
+    template<unsigned int, typename> friend class barrett;
 
     inline bool is_negative() const
     {
@@ -329,23 +413,20 @@ private:
     typename std::enable_if<(N != M || (N > 1 && N < 64)), bigint<N + M, T>>
     ::type inline multiply(bigint<M,T> const &b) const
     {
-        /* FIXME: other digit sizes are not supported */
-        static_assert(sizeof(T) <= sizeof(uint32_t), "ensure T is uint32_t");
-
-        bigint<N + M> ret(0);
+        bigint<N + M, T> ret(0);
         for (unsigned int i = 0; i < N; ++i)
         {
             T carry(0);
             for (unsigned int j = 0; j < M; ++j)
             {
-                uint64_t digit = ret.m_digits[i + j]
-                               + (uint64_t)m_digits[i] * b.m_digits[j]
-                               + carry;
+                W digit = ret.m_digits[i + j]
+                        + (W)m_digits[i] * b.m_digits[j]
+                        + carry;
                 ret.m_digits[i + j] = (T)digit & digit_mask;
-                carry = (digit >> bits_per_digit) & digit_mask;
+                carry = (T)(digit >> bits_per_digit) & digit_mask;
             }
 
-            for (unsigned int j = M; i + j < M + N && carry != 0; ++i)
+            for (unsigned int j = M; i + j < M + N && carry != 0; ++j)
             {
                 T digit = ret.m_digits[i + j] + carry;
                 ret.m_digits[i + j] = (T)digit & digit_mask;
@@ -382,12 +463,239 @@ private:
     ::type inline multiply(bigint<M,T> const &b) const
     {
         bigint<2, T> ret;
-        uint64_t digit = (uint64_t)m_digits[0] * b.m_digits[0];
+        W digit = (W)m_digits[0] * b.m_digits[0];
         ret.m_digits[0] = (T)(digit) & ret.digit_mask;
         ret.m_digits[1] = (T)(digit >> ret.bits_per_digit) & ret.digit_mask;
         return ret;
     }
 
+    /*
+     * Raw digit helpers, also used by the modular arithmetic classes.
+     * They treat digit arrays as unsigned numbers.
+     */
+    static int compare(T const *a, T const *b, int n)
+    {
+        for (int i = n - 1; i >= 0; --i)
+            if (a[i] != b[i])
+                return a[i] > b[i] ? 1 : -1;
+        return 0;
+    }
+
+    /* a -= b, returning the final borrow */
+    static T subtract(T *a, T const *b, int n)
+    {
+        T borrow(0);
+        for (int i = 0; i < n; ++i)
+        {
+            T digit = a[i] - b[i] - borrow;
+            a[i] = digit & digit_mask;
+            borrow = (digit & ~digit_mask) ? T(1) : T(0);
+        }
+        return borrow;
+    }
+
+    /* dst = a × b; dst must have room for na + nb digits */
+    static void multiply(T *dst, T const *a, int na, T const *b, int nb)
+    {
+        for (int i = 0; i < na + nb; ++i)
+            dst[i] = 0;
+        for (int i = 0; i < na; ++i)
+        {
+            T carry(0);
+            for (int j = 0; j < nb; ++j)
+            {
+                W digit = dst[i + j] + (W)a[i] * b[j] + carry;
+                dst[i + j] = (T)digit & digit_mask;
+                carry = (T)(digit >> bits_per_digit);
+            }
+            dst[i + nb] = carry;
+        }
+    }
+
+    /* Number of significant digits, ignoring the sign */
+    inline int digit_count() const
+    {
+        int n = N;
+        while (n > 0 && m_digits[n - 1] == 0)
+            --n;
+        return n;
+    }
+
+    inline bool bit(int n) const
+    {
+        return (m_digits[n / bits_per_digit] >> (n % bits_per_digit)) & 1;
+    }
+
+    inline int bit_count() const
+    {
+        int n = digit_count();
+        if (n == 0)
+            return 0;
+        int bits = (n - 1) * bits_per_digit;
+        for (T digit = m_digits[n - 1]; digit; digit >>= 1)
+            ++bits;
+        return bits;
+    }
+
+    static void divide(bigint<N,T> const &a, bigint<N,T> const &b,
+                       bigint<N,T> &q, bigint<N,T> &r)
+    {
+        bool a_neg = a.is_negative(), b_neg = b.is_negative();
+        udivide(a_neg ? -a : a, b_neg ? -b : b, q, r);
+        if (a_neg ^ b_neg)
+            q = -q;
+        if (a_neg)
+            r = -r;
+    }
+
+    /*
+     * Unsigned division using Knuth’s algorithm D (TAOCP vol. 2, 4.3.1).
+     * All temporaries have a fixed size, so nothing is allocated. The
+     * magnitude of the smallest negative number is still correct here
+     * because digits are treated as unsigned.
+     */
+    static void udivide(bigint<N,T> const &u, bigint<N,T> const &v,
+                        bigint<N,T> &q, bigint<N,T> &r)
+    {
+        int const m = u.digit_count();
+        int const n = v.digit_count() ? v.digit_count() : 1;
+
+        q.m_digits.fill(0);
+        r.m_digits.fill(0);
+
+        if (m < n)
+        {
+            r = u;
+            return;
+        }
+
+        /* Short division by a single digit */
+        if (n == 1)
+        {
+            W rem = 0;
+            for (int j = m - 1; j >= 0; --j)
+            {
+                W num = (rem << bits_per_digit) | u.m_digits[j];
+                q.m_digits[j] = (T)(num / v.m_digits[0]);
+                rem = num % v.m_digits[0];
+            }
+            r.m_digits[0] = (T)rem;
+            return;
+        }
+
+        /* Normalise so that the leading digit of v has its top bit set;
+         * this guarantees that the quotient digit estimate is at most
+         * two units too large. */
+        int s = 0;
+        while (!((v.m_digits[n - 1] << s) & ((T)1 << (bits_per_digit - 1))))
+            ++s;
+
+        std::array<T, N + 1> un;
+        std::array<T, N> vn;
+        for (int i = n - 1; i >= 0; --i)
+            vn[i] = ((v.m_digits[i] << s) | (i ? v.m_digits[i - 1]
+                                 >> (bits_per_digit - s) : (T)0)) & digit_mask;
+        un[m] = u.m_digits[m - 1] >> (bits_per_digit - s);
+        for (int i = m - 1; i >= 0; --i)
+            un[i] = ((u.m_digits[i] << s) | (i ? u.m_digits[i - 1]
+                                 >> (bits_per_digit - s) : (T)0)) & digit_mask;
+
+        for (int j = m - n; j >= 0; --j)
+        {
+            /* Estimate the quotient digit from the top digits */
+            W num = ((W)un[j + n] << bits_per_digit) | un[j + n - 1];
+            W qhat = num / vn[n - 1], rhat = num % vn[n - 1];
+            while (qhat > digit_mask || qhat * vn[n - 2]
+                              > ((rhat << bits_per_digit) | un[j + n - 2]))
+            {
+                --qhat;
+                rhat += vn[n - 1];
+                if (rhat > digit_mask)
+                    break;
+            }
+
+            /* Multiply and subtract */
+            T borrow(0), carry(0);
+            for (int i = 0; i < n; ++i)
+            {
+                W p = qhat * vn[i] + carry;
+                carry = (T)(p >> bits_per_digit);
+                T digit = un[i + j] - ((T)p & digit_mask) - borrow;
+                un[i + j] = digit & digit_mask;
+                borrow = (digit & ~digit_mask) ? T(1) : T(0);
+            }
+            T digit = un[j + n] - carry - borrow;
+            un[j + n] = digit & digit_mask;
+
+            /* The estimate was one too large: add back */
+            if (digit & ~digit_mask)
+            {
+                --qhat;
+                carry = 0;
+                for (int i = 0; i < n; ++i)
+                {
+                    T sum = un[i + j] + vn[i] + carry;
+                    un[i + j] = sum & digit_mask;
+                    carry = sum >> bits_per_digit;
+                }
+                un[j + n] = (un[j + n] + carry) & digit_mask;
+            }
+
+            q.m_digits[j] = (T)qhat;
+        }
+
+        /* The remainder is what is left in un, unnormalised */
+        for (int i = 0; i < n; ++i)
+            r.m_digits[i] = ((un[i] >> s) | (un[i + 1]
+                                 << (bits_per_digit - s))) & digit_mask;
+    }
+
+    /*
+     * Left-to-right sliding window exponentiation, using the modular
+     * multiplication of ctx. All values are in the representation of
+     * ctx, and one is the representation of 1.
+     */
+    template<typename R>
+    static bigint<N,T> pow_window(R const &ctx, bigint<N,T> const &x,
+                                  bigint<N,T> ret, bigint<N,T> const &e)
+    {
+        int const bits = e.bit_count();
+        int const w = bits > 512 ? 5 : bits > 128 ? 4 : 3;
+
+        /* Precompute the odd powers x, x³, x⁵… */
+        bigint<N,T> table[1 << 4];
+        bigint<N,T> x2 = ctx.mul(x, x);
+        table[0] = x;
+        for (int i = 1; i < 1 << (w - 1); ++i)
+            table[i] = ctx.mul(table[i - 1], x2);
+
+        for (int i = bits - 1; i >= 0; )
+        {
+            if (!e.bit(i))
+            {
+                ret = ctx.mul(ret, ret);
+                --i;
+                continue;
+            }
+
+            /* Find the longest window ending with a set bit */
+            int l = i - w + 1 > 0 ? i - w + 1 : 0;
+            while (!e.bit(l))
+                ++l;
+
+            int window = 0;
+            for (int j = i; j >= l; --j)
+            {
+                window = 2 * window + e.bit(j);
+                ret = ctx.mul(ret, ret);
+            }
+            ret = ctx.mul(ret, table[window >> 1]);
+            i = l - 1;
+        }
+
+        return ret;
+    }
+
     inline uint32_t get_uint32(int offset) const
     {
         unsigned int bit = offset * 32;
@@ -407,6 +715,206 @@ private:
     std::array<T, N> m_digits;
 };
 
+/*
+ * Montgomery modular arithmetic, for odd moduli. Values are kept in
+ * Montgomery form x·R mod m, with R = B^k where B is the digit base and
+ * k the digit count of m, so that modular products only need digit
+ * multiplications and no division. The modulus must be odd and positive,
+ * and values in [0, m).
+ */
+template<unsigned int N, typename T>
+class montgomery
+{
+    typedef typename bigint_wide<T>::type W;
+
+    static int const bits_per_digit = bigint<N,T>::bits_per_digit;
+    static T const digit_mask = bigint<N,T>::digit_mask;
+
+public:
+    explicit montgomery(bigint<N,T> const &m)
+      : m_m(m),
+        m_k(m.digit_count())
+    {
+        /* Compute −1/m mod 2^bits_per_digit using Newton’s iteration;
+         * each step doubles the number of correct bits. */
+        T inv(1);
+        for (int i = 0; i < 6; ++i)
+            inv *= (T)2 - m.m_digits[0] * inv;
+        m_inv = (T)(0 - inv) & digit_mask;
+
+        /* Compute R² mod m by repeated doubling */
+        m_r2 = bigint<N,T>(1);
+        for (int i = 0; i < 2 * bits_per_digit * m_k; ++i)
+        {
+            m_r2 = m_r2 + m_r2;
+            if (bigint<N,T>::compare(m_r2.m_digits.data(),
+                                     m_m.m_digits.data(), N) >= 0)
+                bigint<N,T>::subtract(m_r2.m_digits.data(),
+                                      m_m.m_digits.data(), N);
+        }
+    }
+
+    inline bigint<N,T> to(bigint<N,T> const &x) const
+    {
+        return mul(x, m_r2);
+    }
+
+    inline bigint<N,T> from(bigint<N,T> const &x) const
+    {
+        return mul(x, bigint<N,T>(1));
+    }
+
+    /* Return a·b/R mod m, interleaving the product and the reduction
+     * (the CIOS method from Koç, Acar and Kaliski, 1996). */
+    bigint<N,T> mul(bigint<N,T> const &a, bigint<N,T> const &b) const
+    {
+        T const *m = m_m.m_digits.data();
+        int const k = m_k;
+        std::array<T, N + 2> t;
+        t.fill(0);
+
+        for (int i = 0; i < k; ++i)
+        {
+            T carry(0);
+            for (int j = 0; j < k; ++j)
+            {
+                W acc = t[j] + (W)a.m_digits[j] * b.m_digits[i] + carry;
+                t[j] = (T)acc & digit_mask;
+                carry = (T)(acc >> bits_per_digit);
+            }
+            T digit = t[k] + carry;
+            t[k] = digit & digit_mask;
+            t[k + 1] = digit >> bits_per_digit;
+
+            /* Add a multiple of m that clears the lowest digit, then
+             * shift everything by one digit */
+            T q = (T)((W)t[0] * m_inv) & digit_mask;
+            carry = (T)(((W)t[0] + (W)q * m[0]) >> bits_per_digit);
+            for (int j = 1; j < k; ++j)
+            {
+                W acc = t[j] + (W)q * m[j] + carry;
+                t[j - 1] = (T)acc & digit_mask;
+                carry = (T)(acc >> bits_per_digit);
+            }
+            digit = t[k] + carry;
+            t[k - 1] = digit & digit_mask;
+            t[k] = t[k + 1] + (digit >> bits_per_digit);
+        }
+
+        if (t[k] || bigint<N,T>::compare(t.data(), m, k) >= 0)
+            bigint<N,T>::subtract(t.data(), m, k);
+
+        bigint<N,T> ret(0);
+        for (int j = 0; j < k; ++j)
+            ret.m_digits[j] = t[j];
+        return ret;
+    }
+
+    /* Return x^e mod m, for x in [0, m) and e ≥ 0 */
+    bigint<N,T> pow(bigint<N,T> const &x, bigint<N,T> const &e) const
+    {
+        return from(bigint<N,T>::pow_window(*this, to(x),
+                                            to(bigint<N,T>(1)), e));
+    }
+
+private:
+    bigint<N,T> m_m, m_r2;
+    int m_k;
+    T m_inv;
+};
+
+/*
+ * Barrett modular arithmetic, for any positive modulus. A precomputed
+ * approximation µ of B^2k/m, where B is the digit base and k the digit
+ * count of m, turns each reduction into two truncated products.
+ */
+template<unsigned int N, typename T>
+class barrett
+{
+public:
+    explicit barrett(bigint<N,T> const &m)
+      : m_m(m),
+        m_k(m.digit_count())
+    {
+        bigint<2 * N + 1, T> b2k(0), mu;
+        b2k.m_digits[2 * m_k] = 1;
+        mu = b2k / bigint<2 * N + 1, T>(m);
+        for (unsigned int i = 0; i <= N; ++i)
+            m_mu[i] = mu.m_digits[i];
+    }
+
+    /* Return x mod m, for x in [0, m²) */
+    bigint<N,T> reduce(bigint<2 * N, T> const &x) const
+    {
+        int const k = m_k;
+
+        /* q = ⌊⌊x / B^(k−1)⌋ · µ / B^(k+1)⌋ is at most 2 below x / m */
+        std::array<T, 2 * N + 2> q2;
+        bigint<N,T>::multiply(q2.data(), x.m_digits.data() + k - 1, k + 1,
+                              m_mu.data(), k + 1);
+        T const *q = q2.data() + k + 1;
+
+        /* r = (x − q·m) mod B^(k+1) */
+        std::array<T, 2 * N + 2> qm;
+        bigint<N,T>::multiply(qm.data(), q, k + 1,
+                              m_m.m_digits.data(), k);
+        std::array<T, N + 1> r, mm;
+        for (int i = 0; i <= k; ++i)
+        {
+            r[i] = x.m_digits[i];
+            mm[i] = i < k ? m_m.m_digits[i] : (T)0;
+        }
+        bigint<N,T>::subtract(r.data(), qm.data(), k + 1);
+
+        while (bigint<N,T>::compare(r.data(), mm.data(), k + 1) >= 0)
+            bigint<N,T>::subtract(r.data(), mm.data(), k + 1);
+
+        bigint<N,T> ret(0);
+        for (int i = 0; i < k; ++i)
+            ret.m_digits[i] = r[i];
+        return ret;
+    }
+
+    /* Return a·b mod m, for a and b in [0, m) */
+    inline bigint<N,T> mul(bigint<N,T> const &a, bigint<N,T> const &b) const
+    {
+        bigint<2 * N, T> tmp(0);
+        bigint<N,T>::multiply(tmp.m_digits.data(), a.m_digits.data(), m_k,
+                              b.m_digits.data(), m_k);
+        return reduce(tmp);
+    }
+
+    /* Return x^e mod m, for x in [0, m) and e ≥ 0 */
+    bigint<N,T> pow(bigint<N,T> const &x, bigint<N,T> const &e) const
+    {
+        bigint<N,T> one(m_k > 1 || m_m.m_digits[0] > 1 ? 1 : 0);
+        return bigint<N,T>::pow_window(*this, x, one, e);
+    }
+
+private:
+    bigint<N,T> m_m;
+    int m_k;
+    std::array<T, N + 1> m_mu;
+};
+
+/*
+ * Modular exponentiation: use Montgomery arithmetic for odd moduli,
+ * and Barrett reduction otherwise. The modulus must be positive, and
+ * the exponent non-negative.
+ */
+template<unsigned int N, typename T>
+bigint<N,T> pow_mod(bigint<N,T> const &x, bigint<N,T> const &e,
+                    bigint<N,T> const &m)
+{
+    bigint<N,T> y = x % m;
+    if (y < bigint<N,T>(0))
+        y = y + m;
+
+    if ((m & bigint<N,T>(1)) != bigint<N,T>(0))
+        return montgomery<N,T>(m).pow(y, e);
+    return barrett<N,T>(m).pow(y, e);
+}
+
 /*
  * Some convenience typedefs
  */
@@ -0,0 +1,132 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// Visibility culling
+// ------------------
+// The frustum class extracts the six clipping planes of a view-projection
+// matrix and tests bounding volumes against them, one at a time or in
+// batches. The occlusion_buffer class is a coarse software depth buffer:
+// occluders are rasterised into it, and bounding boxes that lie entirely
+// behind them can be rejected before anything is sent to the GPU. The
+// culler class chains both tests and keeps per-frame statistics.
+//
+
+#include <lol/base/array.h>
+#include <lol/math/vector.h>
+#include <lol/math/matrix.h>
+#include <lol/math/geometry.h>
+
+#include <cstddef>
+
+namespace lol
+{
+
+/* Per-frame culling statistics: out of the tested volumes, how many
+ * were outside the frustum, hidden by occluders, or kept. */
+struct cull_stats
+{
+    int tested = 0;
+    int outside = 0;
+    int occluded = 0;
+    int visible = 0;
+};
+
+class frustum
+{
+public:
+    frustum() = default;
+
+    /* Planes are extracted for OpenGL-style clip space, ie. visible
+     * points satisfy -w ≤ x, y, z ≤ w. */
+    explicit frustum(mat4 const &view_proj);
+
+    /* Plane equations (a, b, c, d) with unit normals pointing inside the
+     * frustum, in order left, right, bottom, top, near, far. */
+    inline vec4 const &operator[](int i) const { return m_planes[i]; }
+
+    /* Return false if the volume is entirely outside the frustum. These
+     * tests are conservative: a few volumes near the frustum corners may
+     * be reported as visible although they are not. */
+    bool test(box3 const &box) const;
+    bool test(vec3 const &center, float radius) const;
+
+    /* Batch versions; spheres are stored as (center, radius). */
+    void test(bool *dst, box3 const *boxes, size_t count) const;
+    void test(bool *dst, vec4 const *spheres, size_t count) const;
+
+private:
+    vec4 m_planes[6];
+};
+
+class occlusion_buffer
+{
+public:
+    occlusion_buffer(ivec2 size = ivec2(64, 32));
+
+    inline ivec2 size() const { return m_size; }
+
+    /* Start a new frame with the given view-projection matrix. */
+    void clear(mat4 const &view_proj);
+
+    /* Rasterise occluders. These must be entirely covered by opaque
+     * geometry, for instance a box inside a wall, or the test below
+     * will reject objects that are actually visible. Triangles that
+     * cross the near plane are ignored. */
+    void add_occluder(vec3 const &a, vec3 const &b, vec3 const &c);
+    void add_occluder(box3 const &box);
+
+    /* Return false if the box is entirely hidden by the occluders. */
+    bool test(box3 const &box) const;
+
+    /* Depth of the nearest occluder at a given cell, in normalised
+     * device coordinates; 1 means nothing was drawn there. */
+    inline float depth(ivec2 pos) const
+    {
+        return m_depth[pos.y * m_size.x + pos.x];
+    }
+
+private:
+    ivec2 m_size;
+    mat4 m_view_proj;
+    array<float> m_depth;
+};
+
+class culler
+{
+public:
+    culler(ivec2 occlusion_size = ivec2(64, 32));
+
+    /* Start culling with a new view. If occlusion is false, occluders
+     * are ignored and only the frustum test is performed. */
+    void begin(mat4 const &view_proj, bool occlusion = false);
+    void add_occluder(box3 const &box);
+
+    /* Set dst[i] to whether boxes[i] may be visible, and update the
+     * statistics accordingly. */
+    void cull(bool *dst, box3 const *boxes, size_t count);
+
+    /* Statistics accumulate over calls to begin() until reset() */
+    inline cull_stats const &stats() const { return m_stats; }
+    void reset();
+
+private:
+    frustum m_frustum;
+    occlusion_buffer m_occlusion;
+    bool m_use_occlusion = false;
+    cull_stats m_stats;
+};
+
+} /* namespace lol */
+
@@ -149,25 +149,37 @@ public:
     template<typename U> friend Real<U> peaks(Real<U> const &x, Real<U> const &y);
 
     std::string str(int ndigits = 150) const;
+    /* Print into buf without allocating; at most size-1 characters are
+     * written, followed by a zero. Returns the length of the full string,
+     * which is never more than ndigits + 25. */
+    size_t str(char *buf, size_t size, int ndigits = 150) const;
     std::string xstr() const;
 
     /* Additional operators using base C++ types */
 #define __LOL_REAL_OP_HELPER_GENERIC(op, type) \
     inline Real<T> operator op(type x) const { return *this op (Real<T>)x; } \
     inline Real<T> const &operator op##=(type x) { return *this = (*this op x); }
-#define __LOL_REAL_OP_HELPER_FASTMULDIV(op, type) \
+#define __LOL_REAL_OP_HELPER_FASTMULDIV(op, type, small_op) \
     inline Real<T> operator op(type x) const \
     { \
         Real<T> tmp = *this; return tmp op##= x; \
     } \
     inline Real<T> const &operator op##=(type x) \
     { \
+        /* Absolute value of x, also valid for the smallest signed value */ \
+        uint64_t ux = x > (type)0 ? (uint64_t)x : (uint64_t)0 - (uint64_t)x; \
         /* If multiplying or dividing by a power of two, take a shortcut */ \
         if (!is_zero() && x && !(x & (x - 1))) \
         { \
             while (x >>= 1) \
                 m_exponent += 1 op 2 - 1; /* 1 if op is *, -1 if op is / */ \
         } \
+        /* If x fits in a bigit, a single pass over the mantissa is enough */ \
+        else if (x && ux == (bigit_t)ux) \
+        { \
+            *this = small_op((bigit_t)ux); \
+            m_sign ^= !(x > (type)0); \
+        } \
         else \
             *this = *this op (Real<T>)x; \
         return *this; \
@@ -175,8 +187,8 @@ public:
 #define __LOL_REAL_OP_HELPER_INT(type) \
     __LOL_REAL_OP_HELPER_GENERIC(+, type) \
     __LOL_REAL_OP_HELPER_GENERIC(-, type) \
-    __LOL_REAL_OP_HELPER_FASTMULDIV(*, type) \
-    __LOL_REAL_OP_HELPER_FASTMULDIV(/, type)
+    __LOL_REAL_OP_HELPER_FASTMULDIV(*, type, mul_bigit) \
+    __LOL_REAL_OP_HELPER_FASTMULDIV(/, type, div_bigit)
 #define __LOL_REAL_OP_HELPER_FLOAT(type) \
     __LOL_REAL_OP_HELPER_GENERIC(+, type) \
     __LOL_REAL_OP_HELPER_GENERIC(-, type) \
@@ -223,6 +235,10 @@ public:
     static Real<T> const& R_MAX();
 
 private:
+    /* Multiply or divide by a single bigit in linear time */
+    Real<T> mul_bigit(bigit_t x) const;
+    Real<T> div_bigit(bigit_t x) const;
+
     std::vector<T> m_mantissa;
     exponent_t m_exponent = 0;
     bool m_sign = false, m_nan = false, m_inf = false;
@@ -257,6 +273,8 @@ template<> LOL_ATTR_NODISCARD real::operator int32_t() const;
 template<> LOL_ATTR_NODISCARD real::operator uint32_t() const;
 template<> LOL_ATTR_NODISCARD real::operator int64_t() const;
 template<> LOL_ATTR_NODISCARD real::operator uint64_t() const;
+template<> real real::mul_bigit(bigit_t x) const;
+template<> real real::div_bigit(bigit_t x) const;
 template<> real real::operator +() const;
 template<> real real::operator -() const;
 template<> real real::operator +(real const &x) const;
@@ -362,6 +380,7 @@ template<> real franke(real const &x, real const &y);
 template<> real peaks(real const &x, real const &y);
 
 template<> std::string real::str(int ndigits) const;
+template<> size_t real::str(char *buf, size_t size, int ndigits) const;
 template<> std::string real::xstr() const;
 
 } /* namespace lol */
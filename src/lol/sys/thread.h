@@ -18,6 +18,8 @@
 //
 
 #include <functional>
+#include <algorithm>
+#include <vector>
 
 #include <thread>
 #include <mutex>
@@ -218,5 +220,36 @@ private:
     std::function<void(thread*)> m_function;
 };
 
+// Split [0, count[ into contiguous bands of at least “grain” items and call
+// fn(begin, end) on each of them, using one thread per CPU core. The calling
+// thread processes the first band. When threads are unavailable, this is
+// a single fn(0, count) call.
+template<typename T>
+void parallel_for(int count, T const &fn, int grain = 1)
+{
+    int bands = has_threads() ? (int)std::thread::hardware_concurrency() : 1;
+    bands = std::max(1, std::min(bands, count / std::max(grain, 1)));
+
+    if (bands <= 1)
+    {
+        if (count > 0)
+            fn(0, count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    for (int n = 1; n < bands; ++n)
+    {
+        int begin = (int)((int64_t)count * n / bands);
+        int end = (int)((int64_t)count * (n + 1) / bands);
+        workers.emplace_back([&fn, begin, end]() { fn(begin, end); });
+    }
+
+    fn(0, (int)((int64_t)count / bands));
+
+    for (auto &worker : workers)
+        worker.join();
+}
+
 } /* namespace lol */
 
@@ -0,0 +1,260 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#if defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
+/*
+ * Batch vector operations. The SSE versions work on groups of four
+ * elements at a time, which are first transposed into structure of
+ * arrays form so that each instruction handles one component of four
+ * vectors. Remaining elements go through the scalar code. Additions are
+ * done in the same order as in the scalar code, but results may still
+ * differ from it in the last bits, e.g. when the compiler contracts the
+ * scalar code into fused multiply-adds.
+ */
+
+namespace lol
+{
+
+#if defined __SSE__
+/* Load four vec3 (twelve floats) and transpose them into x, y, z */
+static inline void load_vec3x4(vec3 const *src, __m128 &x, __m128 &y,
+                               __m128 &z)
+{
+    __m128 a = _mm_loadu_ps(&src[0].x); /* x0 y0 z0 x1 */
+    __m128 b = _mm_loadu_ps(&src[1].y); /* y1 z1 x2 y2 */
+    __m128 c = _mm_loadu_ps(&src[2].z); /* z2 x3 y3 z3 */
+
+    __m128 t = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));
+    x = _mm_shuffle_ps(a, t, _MM_SHUFFLE(3, 0, 3, 0));
+    y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                       _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                       _MM_SHUFFLE(2, 0, 2, 0));
+    z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                       _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                       _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/* The reverse of load_vec3x4() */
+static inline void store_vec3x4(vec3 *dst, __m128 x, __m128 y, __m128 z)
+{
+    __m128 a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                              _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)),
+                              _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                              _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+                              _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                              _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)),
+                              _MM_SHUFFLE(2, 0, 2, 0));
+    _mm_storeu_ps(&dst[0].x, a);
+    _mm_storeu_ps(&dst[1].y, b);
+    _mm_storeu_ps(&dst[2].z, c);
+}
+
+/* Divide x by the length, or return zero if the length is zero, just
+ * like normalize() does. */
+static inline __m128 normalize_div(__m128 x, __m128 len)
+{
+    __m128 mask = _mm_cmpneq_ps(len, _mm_setzero_ps());
+    return _mm_and_ps(mask, _mm_div_ps(x, len));
+}
+#endif
+
+void transform(vec4 *dst, vec4 const *src, size_t count, mat4 const &m)
+{
+    size_t n = 0;
+
+#if defined __SSE__
+    /* Here the matrix columns are used directly, so each vector costs
+     * four broadcasts and four multiply-adds. */
+    __m128 const c0 = _mm_loadu_ps(&m[0].x), c1 = _mm_loadu_ps(&m[1].x),
+                 c2 = _mm_loadu_ps(&m[2].x), c3 = _mm_loadu_ps(&m[3].x);
+
+    for (; n < count; ++n)
+    {
+        __m128 v = _mm_loadu_ps(&src[n].x);
+        __m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, 0x00));
+        r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, 0x55)));
+        r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, 0xaa)));
+        r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, 0xff)));
+        _mm_storeu_ps(&dst[n].x, r);
+    }
+#endif
+
+    for (; n < count; ++n)
+        dst[n] = m * src[n];
+}
+
+void transform(float *x, float *y, float *z, float *w, size_t count,
+               mat4 const &m)
+{
+    size_t n = 0;
+
+#if defined __SSE__
+    __m128 k[4][4];
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            k[i][j] = _mm_set1_ps(m[i][j]);
+
+    for (; n + 4 <= count; n += 4)
+    {
+        __m128 vx = _mm_loadu_ps(x + n), vy = _mm_loadu_ps(y + n),
+               vz = _mm_loadu_ps(z + n), vw = _mm_loadu_ps(w + n);
+
+        __m128 r[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            r[j] = _mm_mul_ps(k[0][j], vx);
+            r[j] = _mm_add_ps(r[j], _mm_mul_ps(k[1][j], vy));
+            r[j] = _mm_add_ps(r[j], _mm_mul_ps(k[2][j], vz));
+            r[j] = _mm_add_ps(r[j], _mm_mul_ps(k[3][j], vw));
+        }
+
+        _mm_storeu_ps(x + n, r[0]);
+        _mm_storeu_ps(y + n, r[1]);
+        _mm_storeu_ps(z + n, r[2]);
+        _mm_storeu_ps(w + n, r[3]);
+    }
+#endif
+
+    for (; n < count; ++n)
+    {
+        vec4 v = m * vec4(x[n], y[n], z[n], w[n]);
+        x[n] = v.x;
+        y[n] = v.y;
+        z[n] = v.z;
+        w[n] = v.w;
+    }
+}
+
+void normalize_all(vec3 *dst, vec3 const *src, size_t count)
+{
+    size_t n = 0;
+
+#if defined __SSE__
+    for (; n + 4 <= count; n += 4)
+    {
+        __m128 x, y, z;
+        load_vec3x4(src + n, x, y, z);
+
+        __m128 norm = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x),
+                                            _mm_mul_ps(y, y)),
+                                 _mm_mul_ps(z, z));
+        __m128 len = _mm_sqrt_ps(norm);
+
+        store_vec3x4(dst + n, normalize_div(x, len), normalize_div(y, len),
+                     normalize_div(z, len));
+    }
+#endif
+
+    for (; n < count; ++n)
+        dst[n] = normalize(src[n]);
+}
+
+void normalize_all(vec4 *dst, vec4 const *src, size_t count)
+{
+    size_t n = 0;
+
+#if defined __SSE__
+    for (; n + 4 <= count; n += 4)
+    {
+        __m128 x = _mm_loadu_ps(&src[n].x);
+        __m128 y = _mm_loadu_ps(&src[n + 1].x);
+        __m128 z = _mm_loadu_ps(&src[n + 2].x);
+        __m128 w = _mm_loadu_ps(&src[n + 3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        __m128 norm = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x),
+                                                       _mm_mul_ps(y, y)),
+                                            _mm_mul_ps(z, z)),
+                                 _mm_mul_ps(w, w));
+        __m128 len = _mm_sqrt_ps(norm);
+        x = normalize_div(x, len);
+        y = normalize_div(y, len);
+        z = normalize_div(z, len);
+        w = normalize_div(w, len);
+
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(&dst[n].x, x);
+        _mm_storeu_ps(&dst[n + 1].x, y);
+        _mm_storeu_ps(&dst[n + 2].x, z);
+        _mm_storeu_ps(&dst[n + 3].x, w);
+    }
+#endif
+
+    for (; n < count; ++n)
+        dst[n] = normalize(src[n]);
+}
+
+void dot_all(float *dst, vec3 const *a, vec3 const *b, size_t count)
+{
+    size_t n = 0;
+
+#if defined __SSE__
+    for (; n + 4 <= count; n += 4)
+    {
+        __m128 ax, ay, az, bx, by, bz;
+        load_vec3x4(a + n, ax, ay, az);
+        load_vec3x4(b + n, bx, by, bz);
+
+        _mm_storeu_ps(dst + n,
+                      _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx),
+                                            _mm_mul_ps(ay, by)),
+                                 _mm_mul_ps(az, bz)));
+    }
+#endif
+
+    for (; n < count; ++n)
+        dst[n] = dot(a[n], b[n]);
+}
+
+void dot_all(float *dst, vec4 const *a, vec4 const *b, size_t count)
+{
+    size_t n = 0;
+
+#if defined __SSE__
+    for (; n + 4 <= count; n += 4)
+    {
+        __m128 a0 = _mm_loadu_ps(&a[n].x), a1 = _mm_loadu_ps(&a[n + 1].x),
+               a2 = _mm_loadu_ps(&a[n + 2].x), a3 = _mm_loadu_ps(&a[n + 3].x);
+        __m128 b0 = _mm_loadu_ps(&b[n].x), b1 = _mm_loadu_ps(&b[n + 1].x),
+               b2 = _mm_loadu_ps(&b[n + 2].x), b3 = _mm_loadu_ps(&b[n + 3].x);
+        _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+        _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+        _mm_storeu_ps(dst + n,
+                      _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, b0),
+                                                       _mm_mul_ps(a1, b1)),
+                                            _mm_mul_ps(a2, b2)),
+                                 _mm_mul_ps(a3, b3)));
+    }
+#endif
+
+    for (; n < count; ++n)
+        dst[n] = dot(a[n], b[n]);
+}
+
+/* There is no SIMD version of slerp() yet: the trigonometric functions
+ * would need vectorised implementations first. */
+void slerp(quat *dst, quat const *a, quat const *b, float f, size_t count)
+{
+    for (size_t n = 0; n < count; ++n)
+        dst[n] = slerp(a[n], b[n], f);
+}
+
+} /* namespace lol */
+
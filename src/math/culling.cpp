@@ -0,0 +1,386 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined __SSE__
+#   include <xmmintrin.h>
+#endif
+
+namespace lol
+{
+
+/*
+ * Frustum
+ */
+
+frustum::frustum(mat4 const &view_proj)
+{
+    /* Gribb-Hartmann extraction: each plane is the sum or difference of
+     * the fourth row of the matrix and one of the three others. */
+    vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = vec4(view_proj[0][i], view_proj[1][i],
+                       view_proj[2][i], view_proj[3][i]);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        m_planes[2 * i] = rows[3] + rows[i];
+        m_planes[2 * i + 1] = rows[3] - rows[i];
+    }
+
+    for (auto &p : m_planes)
+        p /= length(p.xyz);
+}
+
+/* Signed distance from a point to a plane. The evaluation order is fixed
+ * so that the SIMD versions below give exactly the same results. */
+static inline float plane_distance(vec4 const &p, float x, float y, float z)
+{
+    return ((p.x * x + p.y * y) + p.z * z) + p.w;
+}
+
+bool frustum::test(box3 const &box) const
+{
+    /* Only test the box corner that lies furthest along each normal */
+    for (auto const &p : m_planes)
+        if (plane_distance(p, p.x > 0.f ? box.bb.x : box.aa.x,
+                              p.y > 0.f ? box.bb.y : box.aa.y,
+                              p.z > 0.f ? box.bb.z : box.aa.z) < 0.f)
+            return false;
+    return true;
+}
+
+bool frustum::test(vec3 const &center, float radius) const
+{
+    for (auto const &p : m_planes)
+        if (plane_distance(p, center.x, center.y, center.z) + radius < 0.f)
+            return false;
+    return true;
+}
+
+void frustum::test(bool *dst, box3 const *boxes, size_t count) const
+{
+    size_t n = 0;
+
+#if defined __SSE__
+    /* Test four boxes at a time against each plane */
+    for (; n + 4 <= count; n += 4)
+    {
+        box3 const *b = boxes + n;
+        __m128 const ax = _mm_setr_ps(b[0].aa.x, b[1].aa.x, b[2].aa.x, b[3].aa.x);
+        __m128 const ay = _mm_setr_ps(b[0].aa.y, b[1].aa.y, b[2].aa.y, b[3].aa.y);
+        __m128 const az = _mm_setr_ps(b[0].aa.z, b[1].aa.z, b[2].aa.z, b[3].aa.z);
+        __m128 const bx = _mm_setr_ps(b[0].bb.x, b[1].bb.x, b[2].bb.x, b[3].bb.x);
+        __m128 const by = _mm_setr_ps(b[0].bb.y, b[1].bb.y, b[2].bb.y, b[3].bb.y);
+        __m128 const bz = _mm_setr_ps(b[0].bb.z, b[1].bb.z, b[2].bb.z, b[3].bb.z);
+
+        __m128 outside = _mm_setzero_ps();
+        for (auto const &p : m_planes)
+        {
+            __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x),
+                                             p.x > 0.f ? bx : ax),
+                                  _mm_mul_ps(_mm_set1_ps(p.y),
+                                             p.y > 0.f ? by : ay));
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(p.z),
+                                         p.z > 0.f ? bz : az));
+            d = _mm_add_ps(d, _mm_set1_ps(p.w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int i = 0; i < 4; ++i)
+            dst[n + i] = !(mask & (1 << i));
+    }
+#endif
+
+    for (; n < count; ++n)
+        dst[n] = test(boxes[n]);
+}
+
+void frustum::test(bool *dst, vec4 const *spheres, size_t count) const
+{
+    size_t n = 0;
+
+#if defined __SSE__
+    for (; n + 4 <= count; n += 4)
+    {
+        __m128 x = _mm_loadu_ps(&spheres[n].x);
+        __m128 y = _mm_loadu_ps(&spheres[n + 1].x);
+        __m128 z = _mm_loadu_ps(&spheres[n + 2].x);
+        __m128 r = _mm_loadu_ps(&spheres[n + 3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, r);
+
+        __m128 outside = _mm_setzero_ps();
+        for (auto const &p : m_planes)
+        {
+            __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), x),
+                                  _mm_mul_ps(_mm_set1_ps(p.y), y));
+            d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(p.z), z));
+            d = _mm_add_ps(_mm_add_ps(d, _mm_set1_ps(p.w)), r);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int i = 0; i < 4; ++i)
+            dst[n + i] = !(mask & (1 << i));
+    }
+#endif
+
+    for (; n < count; ++n)
+        dst[n] = test(spheres[n].xyz, spheres[n].w);
+}
+
+/*
+ * Occlusion buffer
+ */
+
+occlusion_buffer::occlusion_buffer(ivec2 size)
+  : m_size(size)
+{
+    clear(mat4(1.f));
+}
+
+void occlusion_buffer::clear(mat4 const &view_proj)
+{
+    m_view_proj = view_proj;
+    m_depth.resize(m_size.x * m_size.y);
+    for (auto &z : m_depth)
+        z = 1.f;
+}
+
+/* Project a point to buffer coordinates; x and y are in cells, z is the
+ * normalised device depth. Return false if the point is not in front of
+ * the near plane. */
+static inline bool project(vec3 &dst, mat4 const &view_proj, ivec2 size,
+                           vec3 const &src)
+{
+    vec4 p = view_proj * vec4(src, 1.f);
+    if (p.w <= 1e-6f || p.z < -p.w)
+        return false;
+    dst = vec3((p.x / p.w * 0.5f + 0.5f) * size.x,
+               (p.y / p.w * 0.5f + 0.5f) * size.y, p.z / p.w);
+    return true;
+}
+
+/* Range of cells touched by the rectangle [lo, hi] */
+static inline ibox2 cell_range(vec2 const &lo, vec2 const &hi, ivec2 size)
+{
+    return ibox2(max(ivec2(0), ivec2((int)floor(lo.x), (int)floor(lo.y))),
+                 min(size, ivec2((int)ceil(hi.x), (int)ceil(hi.y))));
+}
+
+/* Write depth into all the cells entirely covered by a convex polygon
+ * given in counter-clockwise order. Depth across the polygon is given by
+ * the plane z = zplane.x + zplane.y * x + zplane.z * y, and we store its
+ * furthest value over each cell so that the buffer never claims more
+ * occlusion than there really is. */
+static void fill(array<float> &depth, ivec2 size,
+                 vec2 const *poly, int n, vec3 zplane)
+{
+    vec2 lo = poly[0], hi = poly[0];
+    for (int i = 1; i < n; ++i)
+    {
+        lo = min(lo, poly[i]);
+        hi = max(hi, poly[i]);
+    }
+
+    ibox2 cells = cell_range(lo, hi, size);
+
+    auto inside = [&](float x, float y)
+    {
+        for (int i = 0, j = n - 1; i < n; j = i++)
+            if ((poly[i].x - poly[j].x) * (y - poly[j].y)
+                 - (poly[i].y - poly[j].y) * (x - poly[j].x) < 0.f)
+                return false;
+        return true;
+    };
+
+    for (int y = cells.aa.y; y < cells.bb.y; ++y)
+        for (int x = cells.aa.x; x < cells.bb.x; ++x)
+        {
+            float fx = (float)x, fy = (float)y;
+            if (!inside(fx, fy) || !inside(fx + 1.f, fy)
+                 || !inside(fx, fy + 1.f) || !inside(fx + 1.f, fy + 1.f))
+                continue;
+
+            float z = zplane.x + zplane.y * (fx + (zplane.y > 0.f))
+                               + zplane.z * (fy + (zplane.z > 0.f));
+            float &dst = depth[y * size.x + x];
+            dst = lol::min(dst, z);
+        }
+}
+
+void occlusion_buffer::add_occluder(vec3 const &a, vec3 const &b,
+                                    vec3 const &c)
+{
+    vec3 p[3];
+    if (!project(p[0], m_view_proj, m_size, a)
+         || !project(p[1], m_view_proj, m_size, b)
+         || !project(p[2], m_view_proj, m_size, c))
+        return;
+
+    vec3 e1 = p[1] - p[0], e2 = p[2] - p[0];
+    float area = e1.x * e2.y - e2.x * e1.y;
+    if (abs(area) < 1e-6f)
+        return;
+
+    /* Make the triangle counter-clockwise */
+    if (area < 0.f)
+    {
+        std::swap(p[1], p[2]);
+        std::swap(e1, e2);
+        area = -area;
+    }
+
+    float dzdx = (e1.z * e2.y - e2.z * e1.y) / area;
+    float dzdy = (e1.x * e2.z - e2.x * e1.z) / area;
+    vec3 zplane(p[0].z - dzdx * p[0].x - dzdy * p[0].y, dzdx, dzdy);
+
+    vec2 poly[3] = { p[0].xy, p[1].xy, p[2].xy };
+    fill(m_depth, m_size, poly, 3, zplane);
+}
+
+void occlusion_buffer::add_occluder(box3 const &box)
+{
+    /* Rasterise the silhouette of the box at the depth of its furthest
+     * corner: every point inside the silhouette is hidden by the box
+     * at least that deep. */
+    vec2 pts[8];
+    float zmax = -1.f;
+    for (int i = 0; i < 8; ++i)
+    {
+        vec3 p;
+        if (!project(p, m_view_proj, m_size,
+                     vec3(i & 1 ? box.bb.x : box.aa.x,
+                          i & 2 ? box.bb.y : box.aa.y,
+                          i & 4 ? box.bb.z : box.aa.z)))
+            return;
+        pts[i] = p.xy;
+        zmax = lol::max(zmax, p.z);
+    }
+
+    /* Andrew’s monotone chain gives the convex hull in
+     * counter-clockwise order. */
+    std::sort(pts, pts + 8, [](vec2 const &u, vec2 const &v)
+    {
+        return u.x < v.x || (u.x == v.x && u.y < v.y);
+    });
+
+    auto cross = [](vec2 const &o, vec2 const &u, vec2 const &v)
+    {
+        return (u.x - o.x) * (v.y - o.y) - (u.y - o.y) * (v.x - o.x);
+    };
+
+    vec2 hull[16];
+    int n = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        while (n >= 2 && cross(hull[n - 2], hull[n - 1], pts[i]) <= 0.f)
+            --n;
+        hull[n++] = pts[i];
+    }
+    for (int i = 6, lower = n + 1; i >= 0; --i)
+    {
+        while (n >= lower && cross(hull[n - 2], hull[n - 1], pts[i]) <= 0.f)
+            --n;
+        hull[n++] = pts[i];
+    }
+
+    /* The last point is the same as the first one */
+    if (n - 1 >= 3)
+        fill(m_depth, m_size, hull, n - 1, vec3(zmax, 0.f, 0.f));
+}
+
+bool occlusion_buffer::test(box3 const &box) const
+{
+    vec2 lo(FLT_MAX), hi(-FLT_MAX);
+    float zmin = 1.f;
+    for (int i = 0; i < 8; ++i)
+    {
+        /* Boxes crossing the near plane are always visible */
+        vec3 p;
+        if (!project(p, m_view_proj, m_size,
+                     vec3(i & 1 ? box.bb.x : box.aa.x,
+                          i & 2 ? box.bb.y : box.aa.y,
+                          i & 4 ? box.bb.z : box.aa.z)))
+            return true;
+        lo = min(lo, p.xy);
+        hi = max(hi, p.xy);
+        zmin = lol::min(zmin, p.z);
+    }
+
+    ibox2 cells = cell_range(lo, hi, m_size);
+    if (cells.aa.x >= cells.bb.x || cells.aa.y >= cells.bb.y)
+        return true;
+
+    for (int y = cells.aa.y; y < cells.bb.y; ++y)
+        for (int x = cells.aa.x; x < cells.bb.x; ++x)
+            if (m_depth[y * m_size.x + x] >= zmin)
+                return true;
+
+    return false;
+}
+
+/*
+ * Culler
+ */
+
+culler::culler(ivec2 occlusion_size)
+  : m_occlusion(occlusion_size)
+{
+}
+
+void culler::begin(mat4 const &view_proj, bool occlusion)
+{
+    m_frustum = frustum(view_proj);
+    m_use_occlusion = occlusion;
+    if (occlusion)
+        m_occlusion.clear(view_proj);
+}
+
+void culler::add_occluder(box3 const &box)
+{
+    if (m_use_occlusion)
+        m_occlusion.add_occluder(box);
+}
+
+void culler::cull(bool *dst, box3 const *boxes, size_t count)
+{
+    m_frustum.test(dst, boxes, count);
+
+    for (size_t n = 0; n < count; ++n)
+    {
+        if (!dst[n])
+            ++m_stats.outside;
+        else if (m_use_occlusion && !m_occlusion.test(boxes[n]))
+        {
+            dst[n] = false;
+            ++m_stats.occluded;
+        }
+        else
+            ++m_stats.visible;
+    }
+
+    m_stats.tested += (int)count;
+}
+
+void culler::reset()
+{
+    m_stats = cull_stats();
+}
+
+} /* namespace lol */
+
@@ -12,10 +12,14 @@
 
 #include <lol/engine-internal.h>
 
+#include <algorithm>
+#include <map>
 #include <new>
 #include <string>
 #include <sstream>
 #include <iomanip>
+#include <vector>
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
 
@@ -32,9 +36,10 @@ template<> int real::DEFAULT_BIGIT_COUNT = 16;
  * Initialisation order is not important because everything is
  * done on demand, but here is the dependency list anyway:
  *  - fast_log() requires R_1
- *  - log() requires R_LN2
+ *  - log() requires R_LN2, R_SQRT2
  *  - inverse() require R_2
- *  - exp() requires R_0, R_1, R_LN2
+ *  - exp() requires R_0, R_1, R_LN2, R_LOG2E
+ *  - sin() and cos() require R_PI_2, R_2_PI
  *  - sqrt() requires R_3
  */
 
@@ -43,6 +48,7 @@ static real fast_log(real const &x);
 static real load_min();
 static real load_max();
 static real load_pi();
+static real load_ln2();
 
 /* These getters do not need caching, their return values are small */
 template<> real const real::R_0() { return real(); }
@@ -52,16 +58,13 @@ template<> real const real::R_NAN() { real ret; ret.m_nan = true; return ret; }
 #define LOL_CONSTANT_GETTER(name, value) \
     template<> real const& real::name() \
     { \
-        static real ret; \
-        static int prev_bigit_count = -1; \
-        /* If the default bigit count has changed, we must recompute
-         * the value with the desired precision. */ \
-        if (prev_bigit_count != DEFAULT_BIGIT_COUNT) \
-        { \
-            ret = (value); \
-            prev_bigit_count = DEFAULT_BIGIT_COUNT; \
-        } \
-        return ret; \
+        /* Keep one value per precision, so that code switching back \
+         * and forth between precisions does not recompute it. */ \
+        static std::map<int, real> cache; \
+        auto it = cache.find(DEFAULT_BIGIT_COUNT); \
+        if (it == cache.end()) \
+            it = cache.emplace(DEFAULT_BIGIT_COUNT, (value)).first; \
+        return it->second; \
     }
 
 LOL_CONSTANT_GETTER(R_1,        real(1.0));
@@ -72,7 +75,7 @@ LOL_CONSTANT_GETTER(R_10,       real(10.0));
 LOL_CONSTANT_GETTER(R_MIN,      load_min());
 LOL_CONSTANT_GETTER(R_MAX,      load_max());
 
-LOL_CONSTANT_GETTER(R_LN2,      fast_log(R_2()));
+LOL_CONSTANT_GETTER(R_LN2,      load_ln2());
 LOL_CONSTANT_GETTER(R_LN10,     log(R_10()));
 LOL_CONSTANT_GETTER(R_LOG2E,    inverse(R_LN2()));
 LOL_CONSTANT_GETTER(R_LOG10E,   inverse(R_LN10()));
@@ -232,6 +235,30 @@ template<> real::operator long double() const
     return (long double)(hi) + (long double)(lo);
 }
 
+/*
+ * Integer powers of ten. The powers 10^(2^k) are kept for each precision
+ * so that decimal conversions only need a few multiplications, and
+ * negative powers a single inversion.
+ */
+static real pow10(real::exponent_t n)
+{
+    static std::map<int, std::vector<real>> cache;
+
+    auto &powers = cache[real::DEFAULT_BIGIT_COUNT];
+    uint64_t un = n < 0 ? (uint64_t)0 - (uint64_t)n : (uint64_t)n;
+
+    real ret = real::R_1();
+    for (int k = 0; un; ++k, un >>= 1)
+    {
+        if ((int)powers.size() <= k)
+            powers.push_back(k ? powers[k - 1] * powers[k - 1] : real::R_10());
+        if (un & 1)
+            ret *= powers[k];
+    }
+
+    return n < 0 ? inverse(ret) : ret;
+}
+
 /*
  * Create a real number from an ASCII representation
  */
@@ -241,6 +268,13 @@ template<> real::Real(char const *str)
     exponent_t exponent = 0;
     bool hex = false, comma = false, nonzero = false, negative = false, finished = false;
 
+    /* Decimal digits are accumulated in groups of up to 9, so that each
+     * group costs a single multiplication by a bigit. Hexadecimal digits
+     * are directly stored as mantissa bits. */
+    uint32_t chunk = 0, chunk_scale = 1;
+    std::vector<bigit_t> hexbits;
+    int nibbles = 0;
+
     for (char const *p = str; *p && !finished; p++)
     {
         switch (*p)
@@ -258,10 +292,12 @@ template<> real::Real(char const *str)
             break;
         case 'x':
         case 'X':
-            /* This character is only valid for 0x... and 0X... numbers */
-            if (p != str + 1 || str[0] != '0')
+            /* This character is only valid for 0x... and 0X... numbers,
+             * optionally preceded by a sign */
+            if (p - str != (negative || str[0] == '+' ? 2 : 1) || p[-1] != '0')
                 finished = true;
-            hex = true;
+            else
+                hex = true;
             break;
         case 'p':
         case 'P':
@@ -282,22 +318,29 @@ template<> real::Real(char const *str)
         case 'A': case 'B': case 'C': case 'D': case 'F':
         case '0': case '1': case '2': case '3': case '4':
         case '5': case '6': case '7': case '8': case '9':
+            nonzero |= *p != '0';
             if (nonzero)
             {
-                /* Multiply ret by 10 or 16 depending the base. */
-                if (!hex)
+                bigit_t digit = (*p >= 'a' && *p <= 'f') ? (bigit_t)(*p - 'a' + 10)
+                              : (*p >= 'A' && *p <= 'F') ? (bigit_t)(*p - 'A' + 10)
+                              : (bigit_t)(*p - '0');
+                if (hex)
                 {
-                    real x = ret + ret;
-                    ret = x + x + ret;
+                    if (nibbles % 8 == 0)
+                        hexbits.push_back(0);
+                    hexbits.back() |= digit << (28 - 4 * (nibbles++ % 8));
+                }
+                else
+                {
+                    chunk = chunk * 10 + digit;
+                    chunk_scale *= 10;
+                    if (chunk_scale == 1000000000)
+                    {
+                        ret = ret * chunk_scale + real(chunk);
+                        chunk = 0;
+                        chunk_scale = 1;
+                    }
                 }
-                ret.m_exponent += hex ? 4 : 1;
-            }
-            if (*p != '0')
-            {
-                ret += (*p >= 'a' && *p <= 'f') ? (int)(*p - 'a' + 10)
-                     : (*p >= 'A' && *p <= 'F') ? (int)(*p - 'A' + 10)
-                     : (int)(*p - '0');
-                nonzero = true;
             }
             if (comma)
                 exponent -= hex ? 4 : 1;
@@ -308,10 +351,30 @@ template<> real::Real(char const *str)
         }
     }
 
-    if (hex)
-        ret.m_exponent += exponent;
-    else if (exponent)
-        ret *= pow(R_10(), (real)exponent);
+    if (hex && nibbles)
+    {
+        /* Drop the leading 1 of the first digit and copy the bits that
+         * follow it into the mantissa. */
+        int shift = 1;
+        while (!(hexbits[0] >> (bigit_bits() - shift)))
+            ++shift;
+
+        ret.m_mantissa.resize(DEFAULT_BIGIT_COUNT);
+        ret.m_exponent = exponent + 4 * nibbles - shift;
+        for (int i = 0; i < ret.bigit_count(); ++i)
+        {
+            uint64_t hi = i < (int)hexbits.size() ? hexbits[i] : 0;
+            uint64_t lo = i + 1 < (int)hexbits.size() ? hexbits[i + 1] : 0;
+            ret.m_mantissa[i] = (bigit_t)((hi << shift) | (lo >> (bigit_bits() - shift)));
+        }
+    }
+    else if (!hex)
+    {
+        if (chunk_scale > 1)
+            ret = ret * chunk_scale + real(chunk);
+        if (exponent)
+            ret *= pow10(exponent);
+    }
 
     if (negative)
         ret = -ret;
@@ -579,6 +642,75 @@ template<> real real::operator *(real const &x) const
     return ret;
 }
 
+template<> real real::mul_bigit(bigit_t x) const
+{
+    /* Only works with 32-bit bigits for now */
+    static_assert(sizeof(bigit_t) == 4, "bigit_t must be 32-bit");
+
+    if (is_zero())
+        return *this;
+
+    /* Multiply the mantissa, including its implicit leading 1, by x.
+     * The result has an extra high bigit of up to 33 bits. */
+    std::vector<uint64_t> tmp(bigit_count() + 1);
+    uint64_t carry = 0;
+    for (int i = bigit_count(); i--; )
+    {
+        carry += (uint64_t)m_mantissa[i] * x;
+        tmp[i + 1] = carry & ~(bigit_t)0;
+        carry >>= bigit_bits();
+    }
+    tmp[0] = carry + x;
+
+    /* Shift right so that the leading 1 becomes implicit again */
+    int shift = 0;
+    while (tmp[0] >> (shift + 1))
+        ++shift;
+
+    real ret = *this;
+    for (int i = 0; i < bigit_count(); ++i)
+        ret.m_mantissa[i] = (bigit_t)((tmp[i] << (bigit_bits() - shift))
+                                       | (tmp[i + 1] >> shift));
+    ret.m_exponent += shift;
+    return ret;
+}
+
+template<> real real::div_bigit(bigit_t x) const
+{
+    static_assert(sizeof(bigit_t) == 4, "bigit_t must be 32-bit");
+
+    if (is_zero())
+        return *this;
+
+    /* Schoolbook division of the mantissa, including its implicit
+     * leading 1, by x. The first quotient bigit is always zero unless
+     * x is 1, and the second one is never zero, so compute one more
+     * bigit than needed in order to renormalise. */
+    std::vector<uint64_t> tmp(bigit_count() + 2);
+    uint64_t rem = 1;
+    tmp[0] = rem / x;
+    rem %= x;
+    for (int i = 0; i <= bigit_count(); ++i)
+    {
+        rem = (rem << bigit_bits()) | (i < bigit_count() ? m_mantissa[i] : 0);
+        tmp[i + 1] = rem / x;
+        rem %= x;
+    }
+
+    /* Shift left so that the leading 1 becomes implicit again */
+    int first = tmp[0] ? 0 : 1;
+    int shift = 0;
+    while (tmp[first] >> (shift + 1))
+        ++shift;
+
+    real ret = *this;
+    for (int i = 0; i < bigit_count(); ++i)
+        ret.m_mantissa[i] = (bigit_t)((tmp[first + i] << (bigit_bits() - shift))
+                                       | (tmp[first + i + 1] >> shift));
+    ret.m_exponent += shift - bigit_bits() * first;
+    return ret;
+}
+
 template<> real real::operator /(real const &x) const
 {
     return *this * inverse(x);
@@ -954,63 +1086,106 @@ template<> real fract(real const &x)
 
 template<> real degrees(real const &x)
 {
-    /* FIXME: need to recompute this for different mantissa sizes */
-    static real mul = real(180) * real::R_1_PI();
-
-    return x * mul;
+    return x * real::R_1_PI() * 180;
 }
 
 template<> real radians(real const &x)
 {
-    /* FIXME: need to recompute this for different mantissa sizes */
-    static real mul = real::R_PI() / real(180);
+    return x * real::R_PI() / 180;
+}
+
+/* Evaluate the power series sum(c_n w^n) where c_0 = 1 and each ratio
+ * c_n / c_(n-1) is num(n) / den(n), both small integers. This covers the
+ * Taylor series of exp, sin, cos, atan, atanh and asin.
+ *
+ * The series is cut once its terms fall below the precision of w, then
+ * evaluated with the baby-step giant-step method of Paterson-Stockmeyer:
+ * with m ≈ √N, the powers w, w^2 … w^m are computed once and the series
+ * is summed in blocks of m terms. Inside a block, coefficients are only
+ * multiplied or divided by small integers, which is linear in the size of
+ * the mantissa, so about 2√N full multiplications are needed instead of
+ * N multiplications and N divisions. */
+template<typename N, typename D>
+static real power_series(real const &w, N num, D den)
+{
+    if (!w)
+        return real::R_1();
+
+    /* Count the terms by following their magnitude in log2 space */
+    real::exponent_t e;
+    double log2_w = std::log2(std::fabs((double)frexp(w, &e))) + (double)e;
+    int count = 1;
+    for (double log2_term = 0.0; log2_term > -2.0 - w.total_bits(); ++count)
+        log2_term += log2_w + std::log2((double)num(count) / (double)den(count));
+
+    int m = 1;
+    while (m * m < count)
+        ++m;
+
+    std::vector<real> powers(m + 1);
+    powers[1] = w;
+    for (int i = 2; i <= m; ++i)
+        powers[i] = powers[i - 1] * w;
+
+    real ret;
+    for (int j = (count - 1) / m; j >= 0; --j)
+    {
+        /* Giant step: move the blocks summed so far m terms up */
+        if (j < (count - 1) / m)
+        {
+            ret *= powers[m];
+            for (int n = j * m + 1; n <= j * m + m; ++n)
+                ret = ret * num(n) / den(n);
+        }
+
+        /* Baby steps: sum the block using Horner’s scheme on the ratios */
+        real block;
+        for (int i = std::min(m, count - j * m); --i > 0; )
+            block = (block + powers[i]) * num(j * m + i) / den(j * m + i);
 
-    return x * mul;
+        ret += block + real::R_1();
+    }
+
+    return ret;
 }
 
+/* Coefficient ratios for the series of atan and atanh, 1/(2n+1) */
+static uint64_t odd_num(int n) { return (uint64_t)(2 * n - 1); }
+static uint64_t odd_den(int n) { return (uint64_t)(2 * n + 1); }
+
 static real fast_log(real const &x)
 {
-    /* This fast log method is tuned to work on the [1..2] range and
-     * no effort whatsoever was made to improve convergence outside this
-     * domain of validity. It can converge pretty fast, provided we use
-     * the following variable substitutions:
-     *    y = sqrt(x)
-     *    z = (y - 1) / (y + 1)
+    /* This fast log method is tuned to work on the [√2/2..√2] range.
+     * It uses the following variable substitution:
+     *    z = (x - 1) / (x + 1)
      *
-     * And the following identities:
-     *    ln(x) = 2 ln(y)
-     *          = 2 ln((1 + z) / (1 - z))
-     *          = 4 z (1 + z^2 / 3 + z^4 / 5 + z^6 / 7...)
+     * And the following identity:
+     *    ln(x) = 2 atanh(z)
+     *          = 2 z (1 + z^2 / 3 + z^4 / 5 + z^6 / 7...)
      *
-     * Any additional sqrt() call would halve the convergence time, but
-     * would also impact the final precision. For now we stick with one
-     * sqrt() call. */
-    real y = sqrt(x);
-    real z = (y - real::R_1()) / (y + real::R_1()), z2 = z * z, zn = z2;
-    real sum = real::R_1();
-
-    for (int i = 3; ; i += 2)
-    {
-        real newsum = sum + zn / (real)i;
-        if (newsum == sum)
-            break;
-        sum = newsum;
-        zn *= z2;
-    }
-
-    return z * sum * 4;
+     * In the valid domain |z| < 0.172, so each term brings more than
+     * five bits of precision. */
+    real z = (x - real::R_1()) / (x + real::R_1());
+    return z * power_series(z * z, odd_num, odd_den) * 2;
 }
 
 template<> real log(real const &x)
 {
     /* Strategy for log(x): if x = 2^E*M then log(x) = E log(2) + log(M),
-     * with the property that M is in [1..2[, so fast_log() applies here. */
+     * with the property that M is in [√2/2..√2[, so fast_log() applies
+     * here. */
     if (x.is_negative() || x.is_zero())
         return real::R_NAN();
 
     real tmp(x);
+    real::exponent_t e = x.m_exponent;
     tmp.m_exponent = 0;
-    return real(x.m_exponent) * real::R_LN2() + fast_log(tmp);
+    if (tmp > real::R_SQRT2())
+    {
+        tmp.m_exponent = -1;
+        ++e;
+    }
+    return real::R_LN2() * e + fast_log(tmp);
 }
 
 template<> real log2(real const &x)
@@ -1020,8 +1195,14 @@ template<> real log2(real const &x)
         return real::R_NAN();
 
     real tmp(x);
+    real::exponent_t e = x.m_exponent;
     tmp.m_exponent = 0;
-    return real(x.m_exponent) + fast_log(tmp) * real::R_LOG2E();
+    if (tmp > real::R_SQRT2())
+    {
+        tmp.m_exponent = -1;
+        ++e;
+    }
+    return real(e) + fast_log(tmp) * real::R_LOG2E();
 }
 
 template<> real log10(real const &x)
@@ -1029,25 +1210,27 @@ template<> real log10(real const &x)
     return log(x) * real::R_LOG10E();
 }
 
-static real fast_exp_sub(real const &x, real const &y)
+static real fast_expm1(real const &x)
 {
-    /* This fast exp method is tuned to work on the [-1..1] range and
-     * no effort whatsoever was made to improve convergence outside this
-     * domain of validity. The argument y is used for cases where we
-     * don’t want the leading 1 in the Taylor series. */
-    real ret = real::R_1() - y, xn = x;
-    int i = 1;
-
-    for (;;)
-    {
-        real newret = ret + xn;
-        if (newret == ret)
-            break;
-        ret = newret * ++i;
-        xn *= x;
-    }
+    /* This fast exp(x)-1 method is tuned to work on the [-1..1] range.
+     * The argument is first halved k times so that the Taylor series
+     * converges faster, then the result is doubled back k times with
+     *    exp(2y) - 1 = (exp(y) - 1) (exp(y) - 1 + 2)
+     *
+     * Unlike squaring exp(y), this loses no precision near zero. Each
+     * halving costs one multiplication and saves a few series terms,
+     * so k grows slowly with the precision. */
+    int k = 2;
+    while (k * k * 8 < x.total_bits())
+        ++k;
+
+    real y = ldexp(x, -k);
+    real ret = y * power_series(y, [](int) { return (uint64_t)1; },
+                                   [](int n) { return (uint64_t)(n + 1); });
+    for (int i = 0; i < k; ++i)
+        ret *= ret + real::R_2();
 
-    return ret / fast_fact(i);
+    return ret;
 }
 
 template<> real exp(real const &x)
@@ -1059,18 +1242,19 @@ template<> real exp(real const &x)
      * try to predict a value for E, which is approximately:
      *  E ≈ log2(exp(x)) = x / log(2)
      *
-     * Let E0 be an integer close to x / log(2). We need to find a value x0
-     * such that exp(x) = 2^E0 * exp(x0). We get x0 = x - E0 log(2).
+     * Let E0 be the integer closest to x / log(2). We need to find a value
+     * x0 such that exp(x) = 2^E0 * exp(x0). We get x0 = x - E0 log(2),
+     * with |x0| ≤ log(2)/2.
      *
      * Thus the final algorithm:
-     *  int E0 = x / log(2)
+     *  int E0 = round(x / log(2))
      *  real x0 = x - E0 log(2)
      *  real x1 = exp(x0)
      *  return x1 * 2^E0
      */
-    real::exponent_t e0 = x / real::R_LN2();
-    real x0 = x - (real)e0 * real::R_LN2();
-    real x1 = fast_exp_sub(x0, real::R_0());
+    real::exponent_t e0 = round(x * real::R_LOG2E());
+    real x0 = x - real::R_LN2() * e0;
+    real x1 = fast_expm1(x0) + real::R_1();
     x1.m_exponent += e0;
     return x1;
 }
@@ -1078,9 +1262,9 @@ template<> real exp(real const &x)
 template<> real exp2(real const &x)
 {
     /* Strategy for exp2(x): see strategy in exp(). */
-    real::exponent_t e0 = x;
-    real x0 = x - (real)e0;
-    real x1 = fast_exp_sub(x0 * real::R_LN2(), real::R_0());
+    real::exponent_t e0 = round(x);
+    real x0 = x - real(e0);
+    real x1 = fast_expm1(x0 * real::R_LN2()) + real::R_1();
     x1.m_exponent += e0;
     return x1;
 }
@@ -1093,7 +1277,7 @@ template<> real erf(real const &x)
      *  - if x≥7, erf(x) = 1+exp(-x²)/(x·sqrt(π))·sum((-1)^n·(2n-1)!!/(2x²)^n
      *
      * FIXME: do not compute factorials at each iteration, accumulate
-     * them instead (see fast_exp_sub).
+     * them instead (see power_series).
      * FIXME: For a potentially faster implementation, see “Expanding the
      * Error Function erf(z)” at:
      *  http://www.mathematica-journal.com/2014/11/on-burmanns-theorem-and-its-application-to-problems-of-linear-and-nonlinear-heat-transfer-and-diffusion/#more-39602/
@@ -1142,8 +1326,8 @@ template<> real sinh(real const &x)
      * accuracy near zero. We only use this identity for |x|>0.5. If
      * |x|<=0.5, we compute exp(x)-1 and exp(-x)-1 instead. */
     bool near_zero = (fabs(x) < real::R_1() / 2);
-    real x1 = near_zero ? fast_exp_sub(x, real::R_1()) : exp(x);
-    real x2 = near_zero ? fast_exp_sub(-x, real::R_1()) : exp(-x);
+    real x1 = near_zero ? fast_expm1(x) : exp(x);
+    real x2 = near_zero ? fast_expm1(-x) : exp(-x);
     return (x1 - x2) / 2;
 }
 
@@ -1151,8 +1335,8 @@ template<> real tanh(real const &x)
 {
     /* See sinh() for the strategy here */
     bool near_zero = (fabs(x) < real::R_1() / 2);
-    real x1 = near_zero ? fast_exp_sub(x, real::R_1()) : exp(x);
-    real x2 = near_zero ? fast_exp_sub(-x, real::R_1()) : exp(-x);
+    real x1 = near_zero ? fast_expm1(x) : exp(x);
+    real x2 = near_zero ? fast_expm1(-x) : exp(-x);
     real x3 = near_zero ? x1 + x2 + real::R_2() : x1 + x2;
     return (x1 - x2) / x3;
 }
@@ -1284,41 +1468,40 @@ template<> real fmod(real const &x, real const &y)
     return x - tmp * y;
 }
 
-template<> real sin(real const &x)
+static real fast_sincos(real const &x, int quadrant)
 {
-    bool switch_sign = x.is_negative();
-
-    real absx = fmod(fabs(x), real::R_PI() * 2);
-    if (absx > real::R_PI())
-    {
-        absx -= real::R_PI();
-        switch_sign = !switch_sign;
-    }
+    /* Strategy for sin(x) and cos(x): find the integer q closest to
+     * x / (π/2) and evaluate the Taylor series of sin or cos at
+     * r = x - q π/2, which is in [-π/4..π/4]:
+     *  sin(r) = r (1 - r^2 / (2·3) (1 - r^2 / (4·5) (1 - ...)))
+     *  cos(r) = 1 - r^2 / (1·2) (1 - r^2 / (3·4) (1 - ...))
+     *
+     * The quadrant argument adds to q: cos(x) = sin(x + π/2). */
+    real q = round(x * real::R_2_PI());
+    real r = x - q * real::R_PI_2();
+    quadrant = (quadrant + (int)(q - floor(ldexp(q, -2)) * 4)) & 3;
 
-    if (absx > real::R_PI_2())
-        absx = real::R_PI() - absx;
+    real ret;
+    if (quadrant & 1)
+        ret = power_series(-r * r,
+                           [](int) { return (uint64_t)1; },
+                           [](int n) { return (uint64_t)(2 * n - 1) * (2 * n); });
+    else
+        ret = r * power_series(-r * r,
+                               [](int) { return (uint64_t)1; },
+                               [](int n) { return (uint64_t)(2 * n) * (2 * n + 1); });
 
-    real ret = real::R_0(), fact = real::R_1(), xn = absx, mx2 = -absx * absx;
-    int i = 1;
-    for (;;)
-    {
-        real newret = ret + xn;
-        if (newret == ret)
-            break;
-        ret = newret * ((i + 1) * (i + 2));
-        xn *= mx2;
-        i += 2;
-    }
-    ret /= fast_fact(i);
+    return quadrant & 2 ? -ret : ret;
+}
 
-    /* Propagate sign */
-    ret.m_sign ^= switch_sign;
-    return ret;
+template<> real sin(real const &x)
+{
+    return fast_sincos(x, 0);
 }
 
 template<> real cos(real const &x)
 {
-    return sin(real::R_PI_2() - x);
+    return fast_sincos(x, 1);
 }
 
 template<> real tan(real const &x)
@@ -1358,18 +1541,11 @@ static inline real asinacos(real const &x, int is_asin)
     if (!around_zero)
         absx = sqrt((real::R_1() - absx) / 2);
 
-    real ret = absx, xn = absx, x2 = absx * absx, fact1 = 2, fact2 = 1;
-    for (int i = 1; ; ++i)
-    {
-        xn *= x2;
-        real mul = (real)(2 * i + 1);
-        real newret = ret + ldexp(fact1 * xn / (mul * fact2), -2 * i);
-        if (newret == ret)
-            break;
-        ret = newret;
-        fact1 *= (real)((2 * i + 1) * (2 * i + 2));
-        fact2 *= (real)((i + 1) * (i + 1));
-    }
+    /* asin(x) = x (1 + x^2 / 6 + 3 x^4 / 40 + 5 x^6 / 112 + ...) where
+     * each coefficient is the previous one times (2n-1)^2 / (2n (2n+1)) */
+    real ret = absx * power_series(absx * absx,
+        [](int n) { return (uint64_t)(2 * n - 1) * (2 * n - 1); },
+        [](int n) { return (uint64_t)(2 * n) * (2 * n + 1); });
 
     if (x.is_negative())
         ret = -ret;
@@ -1400,101 +1576,32 @@ template<> real acos(real const &x)
 
 template<> real atan(real const &x)
 {
-    /* Computing atan(x): we choose a different Taylor series depending on
-     * the value of x to help with convergence.
-     *
-     * If |x| < 0.5 we evaluate atan(y) near 0:
+    /* Computing atan(x): we reduce the argument until its absolute value
+     * is below tan(π/8) = √2-1, then evaluate the Taylor series near 0:
      *  atan(y) = y - y^3/3 + y^5/5 - y^7/7 + y^9/9 ...
      *
-     * If 0.5 <= |x| < 1.5 we evaluate atan(1+y) near 0:
-     *  atan(1+y) = π/4 + y/(1*2^1) - y^2/(2*2^1) + y^3/(3*2^2)
-     *                  - y^5/(5*2^3) + y^6/(6*2^3) - y^7/(7*2^4)
-     *                  + y^9/(9*2^5) - y^10/(10*2^5) + y^11/(11*2^6) ...
+     * If |x| > 1 we use atan(x) = π/2 - atan(1/x)
      *
-     * If 1.5 <= |x| < 2 we evaluate atan(sqrt(3)+2y) near 0:
-     *  atan(sqrt(3)+2y) = π/3 + 1/2 y - sqrt(3)/2 y^2/2
-     *                         + y^3/3 - sqrt(3)/2 y^4/4 + 1/2 y^5/5
-     *                         - 1/2 y^7/7 + sqrt(3)/2 y^8/8
-     *                         - y^9/9 + sqrt(3)/2 y^10/10 - 1/2 y^11/11
-     *                         + 1/2 y^13/13 - sqrt(3)/2 y^14/14
-     *                         + y^15/15 - sqrt(3)/2 y^16/16 + 1/2 y^17/17 ...
+     * If |y| > tan(π/8) we use atan(y) = π/4 + atan((y-1)/(y+1)), and
+     * the new argument is in [1-√2..0].
      *
-     * If |x| >= 2 we evaluate atan(y) near +∞:
-     *  atan(y) = π/2 - y^-1 + y^-3/3 - y^-5/5 + y^-7/7 - y^-9/9 ...
-     */
-    real absx = fabs(x);
+     * Each term of the series then brings at least 2.5 bits. */
+    real y = fabs(x), ret = real::R_0();
 
-    if (absx < (real::R_1() / 2))
+    bool invert = y > real::R_1();
+    if (invert)
+        y = inverse(y);
+
+    if (y > real::R_SQRT2() - real::R_1())
     {
-        real ret = x, xn = x, mx2 = -x * x;
-        for (int i = 3; ; i += 2)
-        {
-            xn *= mx2;
-            real newret = ret + xn / (real)i;
-            if (newret == ret)
-                break;
-            ret = newret;
-        }
-        return ret;
+        ret = real::R_PI_4();
+        y = (y - real::R_1()) / (y + real::R_1());
     }
 
-    real ret = 0;
+    ret += y * power_series(-y * y, odd_num, odd_den);
 
-    if (absx < (real::R_3() / 2))
-    {
-        real y = real::R_1() - absx;
-        real yn = y, my2 = -y * y;
-        for (int i = 0; ; i += 2)
-        {
-            real newret = ret + ldexp(yn / (real)(2 * i + 1), -i - 1);
-            yn *= y;
-            newret += ldexp(yn / (real)(2 * i + 2), -i - 1);
-            yn *= y;
-            newret += ldexp(yn / (real)(2 * i + 3), -i - 2);
-            if (newret == ret)
-                break;
-            ret = newret;
-            yn *= my2;
-        }
-        ret = real::R_PI_4() - ret;
-    }
-    else if (absx < real::R_2())
-    {
-        real y = (absx - real::R_SQRT3()) / 2;
-        real yn = y, my2 = -y * y;
-        for (int i = 1; ; i += 6)
-        {
-            real newret = ret + ((yn / (real)i) / 2);
-            yn *= y;
-            newret -= (real::R_SQRT3() / 2) * yn / (real)(i + 1);
-            yn *= y;
-            newret += yn / (real)(i + 2);
-            yn *= y;
-            newret -= (real::R_SQRT3() / 2) * yn / (real)(i + 3);
-            yn *= y;
-            newret += (yn / (real)(i + 4)) / 2;
-            if (newret == ret)
-                break;
-            ret = newret;
-            yn *= my2;
-        }
-        ret = real::R_PI_3() + ret;
-    }
-    else
-    {
-        real y = inverse(absx);
-        real yn = y, my2 = -y * y;
-        ret = y;
-        for (int i = 3; ; i += 2)
-        {
-            yn *= my2;
-            real newret = ret + yn / (real)i;
-            if (newret == ret)
-                break;
-            ret = newret;
-        }
+    if (invert)
         ret = real::R_PI_2() - ret;
-    }
 
     /* Propagate sign */
     ret.m_sign = x.m_sign;
@@ -1566,68 +1673,135 @@ template<>
 std::ostream& operator <<(std::ostream &s, real const &x)
 {
     bool hex = (s.flags() & std::ios_base::basefield) == std::ios_base::hex;
-    s << (hex ? x.xstr() : x.str((int)s.precision()));
-    return s;
+    if (hex)
+        return s << x.xstr();
+
+    int ndigits = std::max((int)s.precision(), 1);
+    std::vector<char> buf(ndigits + 32);
+    x.str(buf.data(), buf.size(), ndigits);
+    return s << buf.data();
 }
 
 template<> std::string real::str(int ndigits) const
 {
-    std::stringstream ss;
+    std::string ret(std::max(ndigits, 1) + 32, '\0');
+    ret.resize(str(&ret[0], ret.size(), ndigits));
+    return ret;
+}
+
+template<> size_t real::str(char *buf, size_t size, int ndigits) const
+{
+    /* Characters are only stored while they fit, but the full length is
+     * always returned, like snprintf() does. */
+    size_t len = 0;
+    auto put = [&](char ch)
+    {
+        if (len + 1 < size)
+            buf[len] = ch;
+        ++len;
+    };
+
     real x = *this;
 
     if (x.is_negative())
     {
-        ss << '-';
+        put('-');
         x = -x;
     }
 
     if (!x)
     {
-        ss << '0';
-        return ss.str();
+        put('0');
+        if (size)
+            buf[std::min(len, size - 1)] = '\0';
+        return len;
     }
 
-    // Normalise x so that mantissa is in [1..9.999]
-    // FIXME: better use int64_t when the cast is implemented
-    // FIXME: does not work with R_MAX and probably R_MIN
-    int exponent = ceil(log10(x));
-    x *= pow(R_10(), -(real)exponent);
-
     if (ndigits < 1)
         ndigits = 1;
 
-    // Add a bias to simulate some naive rounding
-    x += real(4.99f) * pow(R_10(), -(real)(ndigits + 1));
+    // Normalise x so that mantissa is in [1..9.999], starting with an
+    // estimate of the decimal exponent.
+    // FIXME: does not work with R_MAX and probably R_MIN
+    double log2_x = (double)x.m_exponent + std::log2(1.0 + x.m_mantissa[0] / 4294967296.0);
+    exponent_t exponent = (exponent_t)std::floor(log2_x * 0.30102999566398120);
+    x *= pow10(-exponent);
+    while (x >= R_10())
+    {
+        x /= 10;
+        ++exponent;
+    }
+    while (x < R_1())
+    {
+        x *= 10;
+        --exponent;
+    }
+
+    // Add a bias to simulate some naive rounding; it only needs a few
+    // bits of precision, so 4.99·10^-ndigits is built from a double.
+    double log2_bias = std::log2(4.99) - ndigits * 3.3219280948873623;
+    double int_bias = std::floor(log2_bias);
+    x += ldexp(real(std::exp2(log2_bias - int_bias)), (exponent_t)int_bias);
+    if (x >= R_10())
+    {
+        x /= 10;
+        ++exponent;
+    }
 
-    if (x < R_1())
+    // Split x into its integer part, which is the first digit, and its
+    // fractional part as a fixed-point number
+    int shift = (int)x.m_exponent;
+    std::vector<bigit_t> frac(x.bigit_count());
+    for (int i = 0; i < x.bigit_count(); ++i)
     {
-        x *= R_10();
-        exponent--;
+        uint64_t hi = x.m_mantissa[i];
+        uint64_t lo = i + 1 < x.bigit_count() ? x.m_mantissa[i + 1] : 0;
+        frac[i] = (bigit_t)((hi << shift) | (lo >> (bigit_bits() - shift)));
     }
 
-    // Print digits
-    for (int i = 0; i < ndigits; ++i)
+    put((char)('0' + ((1 << shift) | ((uint64_t)x.m_mantissa[0] >> (bigit_bits() - shift)))));
+    put('.');
+
+    // Print digits nine at a time: each group is the carry out of the
+    // fractional part multiplied by 10^9
+    size_t end = len;
+    for (int i = 1; i < ndigits; i += 9)
     {
-        int digit = (int)floor(x);
-        ss << (char)('0' + digit);
-        if (i == 0)
-            ss << '.';
-        x -= real(digit);
-        x *= R_10();
+        uint64_t carry = 0;
+        for (int j = (int)frac.size(); j--; )
+        {
+            carry += (uint64_t)frac[j] * 1000000000u;
+            frac[j] = (bigit_t)carry;
+            carry >>= bigit_bits();
+        }
+
+        char group[9];
+        for (int j = 9; j--; carry /= 10)
+            group[j] = (char)('0' + carry % 10);
+        for (int j = 0; j < 9 && i + j < ndigits; ++j)
+        {
+            put(group[j]);
+            if (group[j] != '0')
+                end = len;
+        }
     }
 
     // Remove trailing zeroes
-    std::string ret = ss.str();
-    ss.str("");
-    size_t end = ret.find_last_not_of('0');
-    if (end != std::string::npos)
-        ss << ret.substr(0, end + 1);
+    len = end;
 
     // Print exponent information
     if (exponent)
-        ss << 'e' << (exponent >= 0 ? '+' : '-') << lol::abs(exponent);
+    {
+        char tmp[24];
+        std::sprintf(tmp, "e%c%llu", exponent >= 0 ? '+' : '-',
+                     (unsigned long long)(exponent >= 0 ? exponent : -exponent));
+        for (char const *p = tmp; *p; ++p)
+            put(*p);
+    }
 
-    return ss.str();
+    if (size)
+        buf[std::min(len, size - 1)] = '\0';
+    return len;
 }
 
 template<> std::string real::xstr() const
@@ -1677,22 +1851,40 @@ static real load_max()
 
 static real load_pi()
 {
-    /* Approximate π using Machin’s formula: 16*atan(1/5)-4*atan(1/239) */
-    real ret = 0, x0 = 5, x1 = 239;
-    real const m0 = -x0 * x0, m1 = -x1 * x1, r16 = 16, r4 = 4;
+    /* Approximate π using Machin’s formula: 16*atan(1/5)-4*atan(1/239).
+     * The terms only need divisions by small integers, which are linear
+     * in the size of the mantissa. */
+    real ret = 0, x0 = real::R_1() / 5, x1 = real::R_1() / 239;
 
     for (int i = 1; ; i += 2)
     {
-        real newret = ret + r16 / (x0 * (real)i) - r4 / (x1 * (real)i);
+        real newret = ret + x0 * 16 / i - x1 * 4 / i;
         if (newret == ret)
             break;
         ret = newret;
-        x0 *= m0;
-        x1 *= m1;
+        x0 /= -25;
+        x1 /= -57121;
     }
 
     return ret;
 }
 
+static real load_ln2()
+{
+    /* Approximate log(2) using 2*atanh(1/3), the same way as π above. */
+    real ret = 0, x = real::R_1() / 3;
+
+    for (int i = 1; ; i += 2)
+    {
+        real newret = ret + x / i;
+        if (newret == ret)
+            break;
+        ret = newret;
+        x /= 9;
+    }
+
+    return ret * 2;
+}
+
 } /* namespace lol */
 
@@ -16,6 +16,9 @@
 #include <string>
 #include <cstring>
 #include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <time.h>
 
 namespace lol
@@ -36,23 +39,185 @@ extern "C"
  */
 MessageService *g_messageservice = nullptr;
 
+static int64_t get_ticks()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//-----------------------------------------------------------------------------
+// Message storage
+//----
+struct MessageService::message_node
+{
+    static size_t const INLINE_SIZE = 96;
+
+    inline char const *data() const { return m_heap ? m_heap : m_data; }
+
+    std::atomic<message_node *> m_next;
+    /* Index + 1 of the next node in the free list, or 0 */
+    std::atomic<uint32_t> m_free_next;
+    uint32_t m_index;
+    int64_t m_ticks;
+    size_t m_size;
+    /* Only used for messages longer than INLINE_SIZE */
+    char *m_heap;
+    char m_data[INLINE_SIZE];
+};
+
+/* Nodes are allocated in chunks and recycled through a lock-free free
+ * list. The list head packs the index of the first node with a counter
+ * that changes on every update, so that a node taken and given back by
+ * other threads between our read and our compare-and-swap is detected. */
+class MessageService::message_pool
+{
+public:
+    message_pool()
+    {
+        for (auto &chunk : m_chunks)
+            chunk = nullptr;
+    }
+
+    ~message_pool()
+    {
+        for (uint32_t n = 0; n < m_chunk_count; ++n)
+        {
+            message_node *chunk = m_chunks[n];
+            for (uint32_t i = 0; i < CHUNK_SIZE; ++i)
+                delete[] chunk[i].m_heap;
+            delete[] chunk;
+        }
+    }
+
+    message_node *alloc()
+    {
+        uint64_t head = m_free.load(std::memory_order_acquire);
+        for (;;)
+        {
+            uint32_t index = (uint32_t)head;
+            if (!index)
+            {
+                if (!grow())
+                    return nullptr;
+                head = m_free.load(std::memory_order_acquire);
+                continue;
+            }
+
+            message_node *node = get(index - 1);
+            uint64_t next = tag(head) | node->m_free_next.load(std::memory_order_relaxed);
+            if (m_free.compare_exchange_weak(head, next, std::memory_order_acquire,
+                                             std::memory_order_acquire))
+                return node;
+        }
+    }
+
+    void free(message_node *node)
+    {
+        delete[] node->m_heap;
+        node->m_heap = nullptr;
+        push(node, node);
+    }
+
+private:
+    static uint32_t const CHUNK_SIZE = 256;
+    static uint32_t const MAX_CHUNKS = 4096;
+
+    static inline uint64_t tag(uint64_t head)
+    {
+        return ((head >> 32) + 1) << 32;
+    }
+
+    inline message_node *get(uint32_t index) const
+    {
+        return &m_chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE];
+    }
+
+    /* Push the list of nodes from first to last, already linked together */
+    void push(message_node *first, message_node *last)
+    {
+        uint64_t head = m_free.load(std::memory_order_relaxed);
+        do
+            last->m_free_next.store((uint32_t)head, std::memory_order_relaxed);
+        while (!m_free.compare_exchange_weak(head, tag(head) | (first->m_index + 1),
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+    }
+
+    bool grow()
+    {
+        std::lock_guard<std::mutex> lock(m_grow_mutex);
+
+        /* Another thread may have grown the pool in the meantime */
+        if ((uint32_t)m_free.load(std::memory_order_acquire))
+            return true;
+
+        if (m_chunk_count == MAX_CHUNKS)
+            return false;
+
+        uint32_t base = m_chunk_count * CHUNK_SIZE;
+        message_node *chunk = new message_node[CHUNK_SIZE];
+        for (uint32_t i = 0; i < CHUNK_SIZE; ++i)
+        {
+            chunk[i].m_index = base + i;
+            chunk[i].m_free_next = base + i + 2;
+            chunk[i].m_heap = nullptr;
+        }
+
+        m_chunks[m_chunk_count++].store(chunk, std::memory_order_release);
+        push(&chunk[0], &chunk[CHUNK_SIZE - 1]);
+        return true;
+    }
+
+    std::atomic<uint64_t> m_free { 0 };
+    std::atomic<message_node *> m_chunks[MAX_CHUNKS];
+    uint32_t m_chunk_count = 0;
+    std::mutex m_grow_mutex;
+};
+
+/* A multiple-producer, single-consumer queue. The head is a dummy node
+ * whose message was already fetched; producers only touch the tail. */
+struct MessageService::message_queue
+{
+    void push(message_node *node)
+    {
+        node->m_next.store(nullptr, std::memory_order_relaxed);
+        message_node *prev = m_tail.exchange(node, std::memory_order_acq_rel);
+        prev->m_next.store(node, std::memory_order_release);
+    }
+
+    std::atomic<message_node *> m_tail;
+    message_node *m_head;
+};
+
 //-----------------------------------------------------------------------------
 // Ctor/Dtor
 //----
 MessageService::MessageService()
+  : m_pool(new message_pool()),
+    m_queues(new message_queue[MessageBucket::MAX]),
+    m_start_time(time(nullptr)),
+    m_start_ticks(get_ticks())
 {
+    for (int i = 0; i < MessageBucket::MAX; ++i)
+    {
+        message_node *dummy = m_pool->alloc();
+        dummy->m_next = nullptr;
+        m_queues[i].m_head = dummy;
+        m_queues[i].m_tail = dummy;
+    }
 }
 
 MessageService::~MessageService()
 {
-    m_bucket.clear();
+    /* The pool releases all nodes, including those still queued */
+    delete[] m_queues;
+    delete m_pool;
 }
 
 //Setup/Destroy
 void MessageService::Setup()
 {
     g_messageservice = new MessageService();
-    g_messageservice->m_bucket.resize(MessageBucket::MAX);
 }
 
 void MessageService::Destroy()
@@ -63,42 +228,74 @@ void MessageService::Destroy()
 
 //-----------------------------------------------------------------------------
 bool MessageService::Send(MessageBucket id, const std::string& message)
+{
+    return Send(id, message.c_str(), message.length());
+}
+
+bool MessageService::Send(MessageBucket id, char const *message)
+{
+    return Send(id, message, strlen(message));
+}
+
+bool MessageService::Send(MessageBucket id, char const *message, size_t len)
 {
     if (g_messageservice)
     {
+        ASSERT(0 <= id.ToScalar() && id.ToScalar() < MessageBucket::MAX);
         MessageService& g = *g_messageservice;
-        array<MessageList>& bucket = g.m_bucket[id.ToScalar()];
-        bucket << MessageList(time(nullptr), message);
+
+        message_node *node = g.m_pool->alloc();
+        if (!node)
+            return false;
+
+        node->m_ticks = get_ticks();
+        node->m_size = len;
+        if (len > message_node::INLINE_SIZE)
+            node->m_heap = new char[len];
+        memcpy(node->m_heap ? node->m_heap : node->m_data, message, len);
+
+        g.m_queues[id.ToScalar()].push(node);
         return true;
     }
     return false;
 }
 
+//----
+// Return the node holding the next message, which becomes the new dummy
+// head of the queue, or nullptr if the queue is empty.
+MessageService::message_node *MessageService::Pop(MessageBucket id)
+{
+    ASSERT(0 <= id.ToScalar() && id.ToScalar() < MessageBucket::MAX);
+    message_queue &queue = m_queues[id.ToScalar()];
+
+    message_node *head = queue.m_head;
+    message_node *next = head->m_next.load(std::memory_order_acquire);
+    if (!next)
+        return nullptr;
+
+    queue.m_head = next;
+    m_pool->free(head);
+    return next;
+}
+
 //----
 bool MessageService::FetchFirst(MessageBucket id, std::string& message)
 {
-    if (g_messageservice)
-    {
-        ASSERT(0 <= id.ToScalar() && id.ToScalar() < g_messageservice->m_bucket.count());
-        time_t timestamp;
-        return g_messageservice->FetchFirst(id, message, timestamp);
-    }
-    return false;
+    time_t timestamp;
+    return FetchFirst(id, message, timestamp);
 }
 
 bool MessageService::FetchFirst(MessageBucket id, std::string& message, time_t& timestamp)
 {
     if (g_messageservice)
     {
-        ASSERT(0 <= id.ToScalar() && id.ToScalar() < g_messageservice->m_bucket.count());
         MessageService& g = *g_messageservice;
-        array<MessageList>& bucket = g.m_bucket[id.ToScalar()];
+        message_node *node = g.Pop(id);
 
-        if (bucket.count())
+        if (node)
         {
-            message = bucket[0].m_message;
-            timestamp = bucket[0].m_timestamp;
-            bucket.remove(0);
+            message.assign(node->data(), node->m_size);
+            timestamp = g.m_start_time + (time_t)((node->m_ticks - g.m_start_ticks) / 1000000000);
             return true;
         }
     }
@@ -108,35 +305,42 @@ bool MessageService::FetchFirst(MessageBucket id, std::string& message, time_t&
 //----
 bool MessageService::FetchAll(MessageBucket id, std::string& message)
 {
-    if (g_messageservice)
-    {
-        ASSERT(0 <= id.ToScalar() && id.ToScalar() < g_messageservice->m_bucket.count());
-        time_t timestamp;
-        return g_messageservice->FetchAll(id, message, timestamp);
-    }
-    return false;
+    time_t timestamp;
+    return FetchAll(id, message, timestamp);
 }
 
 bool MessageService::FetchAll(MessageBucket id, std::string& message, time_t& first_timestamp)
 {
     if (g_messageservice)
     {
-        ASSERT(0 <= id.ToScalar() && id.ToScalar() < g_messageservice->m_bucket.count());
         MessageService& g = *g_messageservice;
-        array<MessageList>& bucket = g.m_bucket[id.ToScalar()];
         message = "";
 
-        if (bucket.count())
+        message_node *node = g.Pop(id);
+        if (node)
         {
-            first_timestamp = bucket[0].m_timestamp;
-            for (int i = 0; i < bucket.count(); ++i)
-                message += bucket[i].m_message;
-            bucket.clear();
+            first_timestamp = g.m_start_time + (time_t)((node->m_ticks - g.m_start_ticks) / 1000000000);
+            for (; node; node = g.Pop(id))
+                message.append(node->data(), node->m_size);
             return true;
         }
     }
     return false;
 }
 
+//----
+int MessageService::FetchBatch(MessageBucket id, std::string *messages, int count)
+{
+    int ret = 0;
+    if (g_messageservice)
+    {
+        MessageService& g = *g_messageservice;
+        message_node *node;
+        while (ret < count && (node = g.Pop(id)))
+            messages[ret++].assign(node->data(), node->m_size);
+    }
+    return ret;
+}
+
 } /* namespace lol */
 
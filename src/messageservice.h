@@ -2,7 +2,7 @@
 //  Lol Engine
 //
 //  Copyright © 2013—2015 Benjamin “Touky” Huet <huet.benjamin@gmail.com>
-//            © 2017—2018 Sam Hocevar <sam@hocevar.net>
+//            © 2017—2019 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -15,10 +15,16 @@
 
 #include <string>
 #include <map>
+#include <cstddef>
+#include <ctime>
 
 //
 // The Message Service class
 // -------------------------
+// Any thread may send messages to a bucket without locking; each bucket
+// must only be read from one thread at a time. Message storage is pooled,
+// so that sending and fetching short messages does not allocate memory
+// once the pool has grown to its working size.
 //
 
 namespace lol
@@ -66,22 +72,6 @@ protected:
 };
 typedef SafeEnum<MessageBucketBase> MessageBucket;
 
-//Message list container with time in it
-struct MessageList
-{
-    MessageList(time_t timestamp, const std::string& message)
-      : m_timestamp(timestamp),
-        m_message(message)
-    {
-    }
-
-    time_t m_timestamp;
-    std::string m_message;
-};
-
-/*
-    A template class perhaps ?
-*/
 class MessageService
 {
 public:
@@ -97,13 +87,28 @@ public:
 
     //Common interactions
     static bool Send(MessageBucket id, const std::string& message);
+    static bool Send(MessageBucket id, char const *message);
+    static bool Send(MessageBucket id, char const *message, size_t len);
     static bool FetchFirst(MessageBucket id, std::string& message);
     static bool FetchFirst(MessageBucket id, std::string& message, time_t &timestamp);
     static bool FetchAll(MessageBucket id, std::string& message);
     static bool FetchAll(MessageBucket id, std::string& message, time_t &first_timestamp);
 
+    // Fetch up to “count” messages into the caller’s strings, whose memory
+    // is reused; return the number of messages fetched.
+    static int FetchBatch(MessageBucket id, std::string *messages, int count);
+
 private:
-    array<array<MessageList> >  m_bucket;
+    struct message_node;
+    struct message_queue;
+    class message_pool;
+
+    message_node *Pop(MessageBucket id);
+
+    message_pool *m_pool;
+    message_queue *m_queues;
+    time_t m_start_time;
+    int64_t m_start_ticks;
 };
 
 extern MessageService *g_messageservice;
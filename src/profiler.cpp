@@ -48,6 +48,16 @@ private:
 }
 data[Profiler::STAT_COUNT];
 
+/* Allocation counters at the end of the previous frame, and their
+ * increase during that frame. */
+static int64_t g_last_allocs = 0, g_last_bytes = 0;
+static int64_t g_frame_allocs = 0, g_frame_bytes = 0;
+
+/* Same for the event counters */
+std::atomic<int64_t> Profiler::m_counters[Profiler::COUNTER_COUNT];
+static int64_t g_last_counts[Profiler::COUNTER_COUNT] = { 0 };
+static int64_t g_frame_counts[Profiler::COUNTER_COUNT] = { 0 };
+
 /*
  * Profiler public class
  */
@@ -60,6 +70,24 @@ void Profiler::Start(int id)
 void Profiler::Stop(int id)
 {
     data[id].update();
+
+    if (id == STAT_TICK_FRAME)
+    {
+        alloc_counters const &c = get_alloc_counters();
+        int64_t allocs = c.allocs.load(std::memory_order_relaxed);
+        int64_t bytes = c.bytes.load(std::memory_order_relaxed);
+        g_frame_allocs = allocs - g_last_allocs;
+        g_frame_bytes = bytes - g_last_bytes;
+        g_last_allocs = allocs;
+        g_last_bytes = bytes;
+
+        for (int i = 0; i < COUNTER_COUNT; ++i)
+        {
+            int64_t count = GetTotal(i);
+            g_frame_counts[i] = count - g_last_counts[i];
+            g_last_counts[i] = count;
+        }
+    }
 }
 
 float Profiler::GetAvg(int id)
@@ -72,5 +100,25 @@ float Profiler::GetMax(int id)
     return data[id].max;
 }
 
+int64_t Profiler::GetFrameAllocs()
+{
+    return g_frame_allocs;
+}
+
+int64_t Profiler::GetFrameAllocBytes()
+{
+    return g_frame_bytes;
+}
+
+int64_t Profiler::GetTotal(int id)
+{
+    return m_counters[id].load(std::memory_order_relaxed);
+}
+
+int64_t Profiler::GetFrameCount(int id)
+{
+    return g_frame_counts[id];
+}
+
 } /* namespace lol */
 
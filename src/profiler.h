@@ -14,9 +14,12 @@
 // The Profiler class
 // -------------------
 // The Profiler is a static class that collects statistic counters.
+// It also tracks the heap allocations made by the engine containers
+// from one frame to the next; see lol/base/allocator.h.
 //
 
 #include <stdint.h>
+#include <atomic>
 
 namespace lol
 {
@@ -43,13 +46,37 @@ public:
         STAT_COUNT
     };
 
+    /* Event counters, safe to increment from any thread */
+    enum
+    {
+        COUNTER_SHADER_COMPILE = 0,
+        COUNTER_SHADER_CACHE_HIT,
+        COUNTER_SHADER_BINARY_HIT,
+        COUNTER_UNIFORM_LOOKUP,
+        COUNTER_COUNT
+    };
+
     static void Start(int id);
     static void Stop(int id);
     static float GetAvg(int id);
     static float GetMax(int id);
 
+    /* Heap allocations and allocated bytes during the last frame */
+    static int64_t GetFrameAllocs();
+    static int64_t GetFrameAllocBytes();
+
+    /* Event counts since startup, and during the last frame */
+    static inline void Count(int id, int64_t n = 1)
+    {
+        m_counters[id].fetch_add(n, std::memory_order_relaxed);
+    }
+    static int64_t GetTotal(int id);
+    static int64_t GetFrameCount(int id);
+
 private:
     Profiler() {}
+
+    static std::atomic<int64_t> m_counters[COUNTER_COUNT];
 };
 
 } /* namespace lol */
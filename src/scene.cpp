@@ -96,6 +96,18 @@ void SceneDisplay::Disable()
 
 void PrimitiveSource::Render(Scene& scene) { UNUSED(scene); }
 
+bool PrimitiveSource::GetBounds(box3 &bounds) const
+{
+    UNUSED(bounds);
+    return false;
+}
+
+bool PrimitiveSource::GetOccluder(box3 &occluder) const
+{
+    UNUSED(occluder);
+    return false;
+}
+
 void PrimitiveRenderer::Render(Scene& scene, std::shared_ptr<PrimitiveSource> primitive)
 {
     UNUSED(scene);
@@ -108,7 +120,7 @@ void PrimitiveRenderer::Render(Scene& scene, std::shared_ptr<PrimitiveSource> pr
 
 uint64_t Scene::g_used_id = 1;
 mutex Scene::g_prim_mutex;
-std::map<uintptr_t, array<std::shared_ptr<PrimitiveSource>>> Scene::g_prim_sources;
+hash_map<uintptr_t, array<std::shared_ptr<PrimitiveSource>>> Scene::g_prim_sources;
 
 /*
  * Public Scene class
@@ -164,6 +176,12 @@ void Scene::resize(ivec2 size)
     m_wanted_size = size;
 }
 
+void Scene::SetCulling(bool frustum, bool occlusion)
+{
+    m_frustum_culling = frustum;
+    m_occlusion_culling = frustum && occlusion;
+}
+
 Scene::~Scene()
 {
     PopCamera(m_default_cam);
@@ -258,11 +276,11 @@ void Scene::SetTileCam(int cam_idx)
 void Scene::Reset()
 {
     /* New scenegraph: Release fire&forget primitives */
-    for (uintptr_t key : keys(m_prim_renderers))
+    for (auto &kv : m_prim_renderers)
     {
-        for (int idx = 0; idx < m_prim_renderers[key].count(); ++idx)
-            if (m_prim_renderers[key][idx]->m_fire_and_forget)
-                ReleasePrimitiveRenderer(idx--, key);
+        for (int idx = 0; idx < kv.second.count(); ++idx)
+            if (kv.second[idx]->m_fire_and_forget)
+                kv.second.remove(idx--);
     }
 
     m_tile_api.m_bufs.clear();
@@ -489,11 +507,16 @@ void Scene::render(float seconds)
 {
     gpu_marker("### render scene");
 
+    m_frame_arena.reset();
+    m_culler.reset();
+
     // FIXME: get rid of the delta time argument
     gpu_marker("# primitives");
     render_primitives();
     gpu_marker("# tiles");
     render_tiles();
+
+    m_cull_stats = m_culler.stats();
     gpu_marker("# lines");
     render_lines(seconds);
 }
@@ -566,23 +589,107 @@ void Scene::render_primitives()
     rc.depth_func(DepthFunc::LessOrEqual);
 
     /* new scenegraph */
-    for (uintptr_t key : keys(m_prim_renderers))
+    array<std::shared_ptr<PrimitiveRenderer>,
+          std::shared_ptr<PrimitiveSource>> todo(&m_frame_arena);
+    array<box3> bounds(&m_frame_arena);
+    array<int> bounded(&m_frame_arena);
+
+    for (auto const &kv : m_prim_renderers)
     {
-        for (int idx = 0; idx < m_prim_renderers[key].count(); ++idx)
+        /* TODO: Not sure if thread compliant */
+        auto sources = g_prim_sources.find(kv.first);
+
+        for (int idx = 0; idx < kv.second.count(); ++idx)
         {
-            /* TODO: Not sure if thread compliant */
             std::shared_ptr<PrimitiveSource> source;
-            if (idx < g_prim_sources[key].count())
-                source = g_prim_sources[key][idx];
-            m_prim_renderers[key][idx]->Render(*this, source);
+            if (sources != g_prim_sources.end() && idx < sources->second.count())
+                source = sources->second[idx];
+
+            box3 box;
+            if (m_frustum_culling && source && source->GetBounds(box))
+            {
+                bounds.push(box);
+                bounded.push(todo.count());
+            }
+            todo.push(kv.second[idx], source);
         }
     }
+
+    /* Cull all bounded primitives in one batch, then render whatever
+     * may be visible in the original order. */
+    array<bool> visible(&m_frame_arena);
+    visible.resize(todo.count(), true);
+
+    if (bounds.count())
+    {
+        Camera *cam = GetCamera();
+        m_culler.begin(cam->GetProjection() * cam->GetView(),
+                       m_occlusion_culling);
+
+        if (m_occlusion_culling)
+        {
+            box3 box;
+            for (auto const &t : todo)
+                if (t.m2 && t.m2->GetOccluder(box))
+                    m_culler.add_occluder(box);
+        }
+
+        array<bool> result(&m_frame_arena);
+        result.resize(bounds.count());
+        m_culler.cull(result.data(), bounds.data(), bounds.count());
+        for (int i = 0; i < bounded.count(); ++i)
+            visible[bounded[i]] = result[i];
+    }
+
+    for (int i = 0; i < todo.count(); ++i)
+        if (visible[i])
+            todo[i].m1->Render(*this, todo[i].m2);
+}
+
+/* Remove the tiles that lie outside the view */
+void Scene::cull_tiles(array<Tile> &tiles)
+{
+    if (!m_frustum_culling || !tiles.count())
+        return;
+
+    array<box3> bounds(&m_frame_arena);
+    bounds.reserve(tiles.count());
+    for (auto const &t : tiles)
+    {
+        /* Same quad as TileSet::BlitTile() */
+        vec2 size = 0.5f * (vec2)t.m_tileset->GetTileSize(t.m_id);
+        box3 box;
+        for (int i = 0; i < 4; ++i)
+        {
+            vec3 p = (t.m_model * vec4(i & 1 ? size.x : -size.x,
+                                       i & 2 ? size.y : -size.y,
+                                       0.f, 1.f)).xyz;
+            box = i ? box3(min(box.aa, p), max(box.bb, p)) : box3(p, p);
+        }
+        bounds.push(box);
+    }
+
+    Camera *cam = GetCamera(m_tile_api.m_cam);
+    m_culler.begin(cam->GetProjection() * cam->GetView());
+
+    array<bool> visible(&m_frame_arena);
+    visible.resize(tiles.count());
+    m_culler.cull(visible.data(), bounds.data(), bounds.count());
+
+    int n = 0;
+    for (int i = 0; i < tiles.count(); ++i)
+        if (visible[i])
+            tiles[n++] = tiles[i];
+    tiles.resize(n);
 }
 
 void Scene::render_tiles() // XXX: rename to Blit()
 {
     render_context rc(m_renderer);
 
+    cull_tiles(m_tile_api.m_tiles);
+    cull_tiles(m_tile_api.m_palettes);
+
     /* Early test if nothing needs to be rendered */
     if (!m_tile_api.m_tiles.count() && !m_tile_api.m_palettes.count())
         return;
@@ -629,10 +736,17 @@ void Scene::render_tiles() // XXX: rename to Blit()
 
         for (int buf = 0, i = 0, n; i < tiles.count(); i = n, buf += 2)
         {
-            /* Count how many quads will be needed */
+            /* Count how many quads will be needed; tilesets sharing an
+             * atlas page and a palette go in the same batch. */
+            TileSet *tileset = tiles[i].m_tileset;
             for (n = i + 1; n < tiles.count(); n++)
-                if (tiles[i].m_tileset != tiles[n].m_tileset)
+            {
+                TileSet *other = tiles[n].m_tileset;
+                if (other != tileset && (!tileset->GetTexture()
+                        || other->GetTexture() != tileset->GetTexture()
+                        || other->GetPalette() != tileset->GetPalette()))
                     break;
+            }
 
             /* Create a vertex array object */
             auto vb1 = std::make_shared<VertexBuffer>(6 * (n - i) * sizeof(vec3));
@@ -645,7 +759,7 @@ void Scene::render_tiles() // XXX: rename to Blit()
 
             for (int j = i; j < n; j++)
             {
-                tiles[i].m_tileset->BlitTile(tiles[j].m_id, tiles[j].m_model,
+                tiles[j].m_tileset->BlitTile(tiles[j].m_id, tiles[j].m_model,
                                 vertex + 6 * (j - i), texture + 6 * (j - i));
             }
 
@@ -709,7 +823,7 @@ void Scene::render_lines(float seconds)
     if (!m_line_api.m_shader)
         m_line_api.m_shader = Shader::Create(LOLFX_RESOURCE_NAME(gpu_line));
 
-    array<vec4, vec4, vec4, vec4> buff;
+    array<vec4, vec4, vec4, vec4> buff(&m_frame_arena);
     buff.resize(linecount);
     int real_linecount = 0;
     mat4 const inv_view_proj = inverse(GetCamera()->GetProjection() * GetCamera()->GetView());
@@ -42,6 +42,14 @@ public:
     virtual ~PrimitiveSource() { }
     virtual void Render(Scene& scene);
 
+    /* World space bounding box, used for culling. Sources that
+     * return false are never culled. */
+    virtual bool GetBounds(box3 &bounds) const;
+
+    /* A box entirely covered by the opaque parts of the primitive, used
+     * to hide other primitives during occlusion culling. */
+    virtual bool GetOccluder(box3 &occluder) const;
+
 private:
 };
 
@@ -255,6 +263,17 @@ public:
 
     void resize(ivec2 size);
 
+    /* Culling of primitives and tiles: frustum culling is enabled by
+     * default, occlusion culling is only useful for scenes with large
+     * occluders. Statistics are those of the last rendered frame. */
+    void SetCulling(bool frustum, bool occlusion = false);
+    cull_stats const &GetCullStats() const { return m_cull_stats; }
+
+    /* Scratch memory for the current frame, reset at the beginning of
+     * render(). Only use it from the render thread, and never keep the
+     * memory beyond the frame. */
+    arena &GetFrameArena() { return m_frame_arena; }
+
     void pre_render(float seconds);
     void render(float seconds);
     void post_render(float seconds);
@@ -262,12 +281,20 @@ public:
 private:
     void render_primitives();
     void render_tiles();
+    void cull_tiles(array<Tile> &tiles);
     void render_lines(float seconds);
 
     ivec2 m_size, m_wanted_size;
 
     std::shared_ptr<Renderer> m_renderer;
 
+    /* Visibility culling */
+    bool m_frustum_culling = true, m_occlusion_culling = false;
+    culler m_culler;
+    cull_stats m_cull_stats;
+
+    arena m_frame_arena;
+
     //
     // The old SceneData stuff
     //
@@ -301,8 +328,8 @@ private:
      * - Updated by entity
      * - Marked Fire&Forget
      * - Scene is destroyed */
-    std::map<uintptr_t, array<std::shared_ptr<PrimitiveRenderer>>> m_prim_renderers;
-    static std::map<uintptr_t, array<std::shared_ptr<PrimitiveSource>>> g_prim_sources;
+    hash_map<uintptr_t, array<std::shared_ptr<PrimitiveRenderer>>> m_prim_renderers;
+    static hash_map<uintptr_t, array<std::shared_ptr<PrimitiveSource>>> g_prim_sources;
     static mutex g_prim_mutex;
 
     Camera *m_default_cam;
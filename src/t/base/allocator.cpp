@@ -0,0 +1,167 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <string>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+/* Count copies so that we can check that arrays move their elements */
+struct copy_counter
+{
+    copy_counter(int val = 0) : m_val(val) {}
+    copy_counter(copy_counter const &that) : m_val(that.m_val) { ++copies; }
+    copy_counter(copy_counter &&that) : m_val(that.m_val) { that.m_val = -1; }
+    copy_counter &operator =(copy_counter const &that) { m_val = that.m_val; ++copies; return *this; }
+    copy_counter &operator =(copy_counter &&that) { m_val = that.m_val; that.m_val = -1; return *this; }
+
+    int m_val;
+    static int copies;
+};
+
+int copy_counter::copies = 0;
+
+lolunit_declare_fixture(allocator_test)
+{
+    lolunit_declare_test(arena_reuse)
+    {
+        arena a(1024);
+
+        /* The first round needs several chunks */
+        for (int i = 0; i < 10; ++i)
+        {
+            void *p = a.alloc(300, 16);
+            lolunit_assert_equal((uintptr_t)p % 16, (uintptr_t)0);
+            memset(p, i, 300);
+        }
+        lolunit_assert(a.capacity() >= 3000);
+        a.reset();
+        lolunit_assert_equal(a.used(), (size_t)0);
+
+        /* The following rounds do not touch the heap */
+        int64_t allocs = get_alloc_counters().allocs;
+        for (int round = 0; round < 5; ++round)
+        {
+            for (int i = 0; i < 10; ++i)
+                a.alloc(300, 16);
+            a.reset();
+        }
+        lolunit_assert_equal(get_alloc_counters().allocs - allocs, (int64_t)0);
+    }
+
+    lolunit_declare_test(stack_allocator_rewind)
+    {
+        stack_allocator s(256);
+
+        void *p1 = s.alloc(96, 8);
+        auto m = s.get_marker();
+        size_t used = s.used();
+        for (int i = 0; i < 20; ++i)
+            s.alloc(96, 8);
+        s.rewind(m);
+        lolunit_assert_equal(s.used(), used);
+
+        /* Memory after the marker is handed out again */
+        void *p2 = s.alloc(96, 8);
+        lolunit_assert((uint8_t *)p2 > (uint8_t *)p1);
+        lolunit_assert((uint8_t *)p2 < (uint8_t *)p1 + 256);
+
+        /* Freeing in reverse order releases memory */
+        s.free(p2, 96);
+        lolunit_assert_equal(s.used(), used);
+    }
+
+    lolunit_declare_test(pool_allocator_recycle)
+    {
+        pool_allocator pool(24, 16);
+        lolunit_assert(pool.block_size() >= 24);
+
+        void *blocks[40];
+        for (auto &p : blocks)
+            p = pool.alloc(24, 8);
+        lolunit_assert_equal(pool.count(), (size_t)40);
+
+        void *first = blocks[0];
+        pool.free(first, 24);
+        lolunit_assert(pool.alloc(20, 8) == first);
+
+        /* Large requests fall back to the heap */
+        void *big = pool.alloc(1000, 8);
+        lolunit_assert_equal(pool.count(), (size_t)40);
+        pool.free(big, 1000);
+    }
+
+    lolunit_declare_test(array_with_allocator)
+    {
+        arena a;
+        int64_t allocs = 0;
+
+        /* After the first round, the arena has grown large enough */
+        for (int round = 0; round < 4; ++round)
+        {
+            {
+                array<int, std::string> tmp(&a);
+                for (int i = 0; i < 1000; ++i)
+                    tmp.push(i, std::to_string(i));
+                lolunit_assert_equal(tmp.count(), 1000);
+                lolunit_assert(tmp[999].m2 == "999");
+            }
+            a.reset();
+            if (round == 0)
+                allocs = get_alloc_counters().allocs;
+        }
+        lolunit_assert_equal(get_alloc_counters().allocs - allocs, (int64_t)0);
+
+        /* Moving an array to the heap */
+        array<int> data(&a);
+        data << 1 << 2 << 3;
+        data.set_allocator(nullptr);
+        a.reset();
+        lolunit_assert(data.get_allocator() == nullptr);
+        lolunit_assert_equal(data.count(), 3);
+        lolunit_assert_equal(data[2], 3);
+
+        array2d<float> grid(&a);
+        grid.resize(ivec2(16, 16), 1.f);
+        lolunit_assert(grid.get_allocator() == &a);
+        lolunit_assert_equal(grid[15][15], 1.f);
+    }
+
+    lolunit_declare_test(array_moves_elements)
+    {
+        array<copy_counter> a;
+        copy_counter::copies = 0;
+
+        for (int i = 0; i < 1000; ++i)
+            a.push(copy_counter(i));
+        a.insert(copy_counter(-2), 0);
+        a.remove(0);
+        a.remove_swap(0);
+        lolunit_assert_equal(copy_counter::copies, 0);
+        lolunit_assert_equal(a[0].m_val, 999);
+
+        array<copy_counter> b = std::move(a);
+        lolunit_assert_equal(copy_counter::copies, 0);
+        lolunit_assert_equal(b.count(), 999);
+        lolunit_assert_equal(a.count(), 0);
+
+        array<copy_counter> c(b);
+        lolunit_assert_equal(copy_counter::copies, 999);
+    }
+};
+
+} /* namespace lol */
+
@@ -277,6 +277,34 @@ lolunit_declare_fixture(avl_tree_test)
         lolunit_assert_equal(test1.count(), 10);
         lolunit_assert_equal(test2.count(), 10);
     }
+
+    lolunit_declare_test(avl_tree_allocators)
+    {
+        /* Trees work with any node allocator */
+        avl_tree<int, int, node_heap> tree1;
+        avl_tree<int, int, node_pool> tree2;
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            tree1.insert(i * 7 % 1000, i);
+            tree2.insert(i * 7 % 1000, i);
+        }
+        for (int i = 0; i < 1000; i += 3)
+        {
+            lolunit_assert(tree1.erase(i));
+            lolunit_assert(tree2.erase(i));
+        }
+
+        auto it = tree2.begin();
+        for (auto kv : tree1)
+        {
+            lolunit_assert_equal(kv.key, (*it).key);
+            lolunit_assert_equal(kv.value, (*it).value);
+            ++it;
+        }
+        lolunit_assert(!(it != tree2.end()));
+        lolunit_assert_equal(tree1.count(), tree2.count());
+    }
 };
 
 }
@@ -0,0 +1,172 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <map>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+lolunit_declare_fixture(btree_test)
+{
+    /* Check that iterating the tree gives the same sequence as the map */
+    template<typename T>
+    void check_same(T const &tree, std::map<int, int> const &ref)
+    {
+        lolunit_assert_equal(tree.count(), (int)ref.size());
+
+        auto it = ref.begin();
+        for (auto kv : tree)
+        {
+            lolunit_assert(it != ref.end());
+            lolunit_assert_equal(kv.key, it->first);
+            lolunit_assert_equal(kv.value, it->second);
+            ++it;
+        }
+        lolunit_assert(it == ref.end());
+    }
+
+    lolunit_declare_test(btree_insert)
+    {
+        btree<int, int> tree;
+
+        lolunit_assert_equal(tree.insert(1, 1), true);
+        lolunit_assert_equal(tree.insert(2, 3), true);
+        lolunit_assert_equal(tree.insert(2, 0), false);
+        lolunit_assert_equal(tree.count(), 2);
+
+        int *value_ptr = nullptr;
+        lolunit_assert(tree.try_get(2, value_ptr));
+        lolunit_assert_equal(*value_ptr, 0);
+        lolunit_assert(!tree.exists(3));
+    }
+
+    lolunit_declare_test(btree_against_std_map)
+    {
+        /* Enough random inserts and erases to split and merge nodes
+         * on several levels */
+        btree<int, int> tree;
+        std::map<int, int> ref;
+
+        for (int n = 0; n < 50000; ++n)
+        {
+            int key = rand(5000);
+            if (rand(5) < 3)
+            {
+                lolunit_assert_equal(tree.insert(key, n), ref.count(key) == 0);
+                ref[key] = n;
+            }
+            else
+            {
+                lolunit_assert_equal(tree.erase(key), ref.erase(key) > 0);
+            }
+        }
+        check_same(tree, ref);
+
+        /* Erase everything */
+        for (auto const &kv : ref)
+            lolunit_assert(tree.erase(kv.first));
+        lolunit_assert_equal(tree.count(), 0);
+        lolunit_assert(!(tree.begin() != tree.end()));
+    }
+
+    lolunit_declare_test(btree_bulk_load)
+    {
+        for (int count : { 0, 1, 7, 100, 10000 })
+        {
+            array<int> keys, values;
+            std::map<int, int> ref;
+            for (int n = 0; n < count; ++n)
+            {
+                keys << 3 * n;
+                values << n;
+                ref[3 * n] = n;
+            }
+
+            btree<int, int> tree;
+            tree.bulk_load(keys.data(), values.data(), keys.count());
+            check_same(tree, ref);
+
+            /* The tree can be modified after a bulk load */
+            for (int n = 0; n < count; n += 2)
+            {
+                lolunit_assert(tree.erase(3 * n));
+                ref.erase(3 * n);
+                lolunit_assert(tree.insert(3 * n + 1, -n));
+                ref[3 * n + 1] = -n;
+            }
+            check_same(tree, ref);
+        }
+    }
+
+    lolunit_declare_test(btree_range)
+    {
+        btree<int, int> tree;
+        for (int n = 0; n < 1000; ++n)
+            tree.insert(2 * n, n);
+
+        int expected = 50;
+        for (auto kv : tree.range(100, 201))
+            lolunit_assert_equal(kv.value, expected++);
+        lolunit_assert_equal(expected, 101);
+
+        /* Bounds that fall between keys, or outside of the tree */
+        lolunit_assert_equal((*tree.lower_bound(99)).key, 100);
+        lolunit_assert(!(tree.lower_bound(2000) != tree.end()));
+
+        int count = 0;
+        for (auto kv : tree.range(-10, 3))
+            count += kv.value + 1;
+        lolunit_assert_equal(count, 3);
+
+        /* Iterating backwards */
+        auto it = tree.lower_bound(10);
+        it--;
+        lolunit_assert_equal((*it).key, 8);
+    }
+
+    lolunit_declare_test(btree_pool)
+    {
+        /* Nodes are recycled by the pool */
+        btree<int, int> tree;
+        for (int n = 0; n < 10000; ++n)
+            tree.insert(n, n);
+        size_t const capacity = tree.node_capacity();
+        lolunit_assert(capacity > 0);
+
+        tree.clear();
+        for (int n = 0; n < 10000; ++n)
+            tree.insert(n, n);
+        lolunit_assert_equal(tree.node_capacity(), capacity);
+
+        for (int n = 0; n < 10000; ++n)
+            tree.erase(n);
+        lolunit_assert_equal(tree.count(), 0);
+        for (int n = 0; n < 10000; ++n)
+            tree.insert(n, n);
+        lolunit_assert_equal(tree.node_capacity(), capacity);
+
+        check_same(tree, [] { std::map<int, int> m; for (int n = 0; n < 10000; ++n) m[n] = n; return m; }());
+
+        btree<int, int, node_heap> heap_tree;
+        for (auto kv : tree)
+            heap_tree.insert(kv.key, kv.value);
+        btree<int, int, node_heap> copy(heap_tree);
+        lolunit_assert_equal(copy.count(), 10000);
+    }
+};
+
+} /* namespace lol */
+
@@ -0,0 +1,174 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <map>
+#include <string>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+/* Count live instances to check that nothing is leaked or destroyed twice */
+struct tracked
+{
+    tracked(int val = 0) : m_val(val) { ++instances; }
+    tracked(tracked const &that) : m_val(that.m_val) { ++instances; }
+    ~tracked() { --instances; }
+
+    int m_val;
+    static int instances;
+};
+
+int tracked::instances = 0;
+
+lolunit_declare_fixture(hash_map_test)
+{
+    lolunit_declare_test(hash_map_basic)
+    {
+        hash_map<int, int> m;
+
+        lolunit_assert(m.empty());
+        lolunit_assert(m.find(0) == m.end());
+        lolunit_assert(m.begin() == m.end());
+
+        m[1] = 10;
+        m[2] = 20;
+        lolunit_assert_equal(m.size(), 2u);
+        lolunit_assert(has_key(m, 1));
+        lolunit_assert(!has_key(m, 3));
+
+        int val = 0;
+        lolunit_assert(try_get(m, 2, val));
+        lolunit_assert_equal(val, 20);
+
+        auto ret = m.emplace(2, 30);
+        lolunit_assert(!ret.second);
+        lolunit_assert_equal(ret.first->second, 20);
+
+        lolunit_assert_equal(m.erase(1), 1u);
+        lolunit_assert_equal(m.erase(1), 0u);
+        lolunit_assert_equal(m.size(), 1u);
+        lolunit_assert(m.begin()->first == 2);
+    }
+
+    lolunit_declare_test(hash_map_against_std_map)
+    {
+        /* Random inserts and erases with many tombstones */
+        hash_map<int, int> m;
+        std::map<int, int> ref;
+
+        for (int n = 0; n < 20000; ++n)
+        {
+            int key = rand(2000);
+            if (rand(3))
+            {
+                m[key] = n;
+                ref[key] = n;
+            }
+            else
+            {
+                lolunit_assert_equal(m.erase(key), ref.erase(key));
+            }
+        }
+
+        lolunit_assert_equal(m.size(), ref.size());
+        for (auto const &kv : ref)
+        {
+            auto it = m.find(kv.first);
+            lolunit_assert(it != m.end());
+            lolunit_assert_equal(it->second, kv.second);
+        }
+
+        size_t count = 0;
+        for (auto const &kv : m)
+        {
+            lolunit_assert_equal(ref[kv.first], kv.second);
+            ++count;
+        }
+        lolunit_assert_equal(count, ref.size());
+
+        /* Erase while iterating */
+        for (auto it = m.begin(); it != m.end(); )
+            it = it->first & 1 ? m.erase(it) : ++it;
+        for (auto const &kv : m)
+            lolunit_assert_equal(kv.first & 1, 0);
+    }
+
+    lolunit_declare_test(hash_map_strings)
+    {
+        hash_map<std::string, int> m;
+        m["foo"] = 1;
+        m[std::string("bar")] = 2;
+
+        /* Heterogeneous lookups do not need a std::string */
+        lolunit_assert(m.find("foo") != m.end());
+        lolunit_assert_equal(m.find("bar")->second, 2);
+        lolunit_assert(m.find("baz") == m.end());
+#if __cpp_lib_string_view
+        lolunit_assert_equal(m.find(std::string_view("foobar", 3))->second, 1);
+#endif
+    }
+
+    lolunit_declare_test(hash_map_lifetime)
+    {
+        {
+            hash_map<int, tracked> m;
+            for (int n = 0; n < 1000; ++n)
+                m.emplace(n, n);
+            lolunit_assert_equal(tracked::instances, 1000);
+
+            hash_map<int, tracked> m2(m);
+            lolunit_assert_equal(tracked::instances, 2000);
+
+            for (int n = 0; n < 500; ++n)
+                m.erase(n);
+            lolunit_assert_equal(tracked::instances, 1500);
+
+            m2 = std::move(m);
+            lolunit_assert_equal(m2.size(), 500u);
+
+            m2.clear();
+            lolunit_assert(m2.empty());
+        }
+        lolunit_assert_equal(tracked::instances, 0);
+    }
+
+    lolunit_declare_test(flat_map_basic)
+    {
+        flat_map<std::string, int> m;
+        m["zz"] = 3;
+        m["aa"] = 1;
+        m["mm"] = 2;
+
+        lolunit_assert_equal(m.size(), 3u);
+        lolunit_assert(!m.emplace("mm", 5).second);
+
+        /* Iteration is in key order */
+        int expected = 1;
+        for (auto const &kv : m)
+            lolunit_assert_equal(kv.second, expected++);
+
+        lolunit_assert(m.find("aa") != m.end());
+        lolunit_assert(m.find("bb") == m.end());
+        lolunit_assert(m.lower_bound("bb")->first == "mm");
+
+        lolunit_assert_equal(m.erase("aa"), 1u);
+        lolunit_assert_equal(m.erase("aa"), 0u);
+        lolunit_assert(m.begin()->first == "mm");
+    }
+};
+
+} /* namespace lol */
+
@@ -0,0 +1,217 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+static char const *LOG_FILE = "test-base-log.txt";
+
+lolunit_declare_fixture(log_test)
+{
+    void setup()
+    {
+        msg::flush();
+        msg::set_console(false);
+    }
+
+    void teardown()
+    {
+        msg::set_log_file("");
+        msg::set_console(true);
+        remove(LOG_FILE);
+        remove((std::string(LOG_FILE) + ".1").c_str());
+    }
+
+    /* Each test starts with an empty log file */
+    static void start_log(size_t max_size = 0, int max_files = 1)
+    {
+        msg::set_log_file("");
+        remove(LOG_FILE);
+        remove((std::string(LOG_FILE) + ".1").c_str());
+        msg::set_log_file(LOG_FILE, max_size, max_files);
+    }
+
+    static array<std::string> read_log(std::string const &name)
+    {
+        msg::flush();
+
+        std::string data;
+        FILE *f = fopen(name.c_str(), "rb");
+        if (f)
+        {
+            char buf[4096];
+            for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0; )
+                data.append(buf, n);
+            fclose(f);
+        }
+
+        array<std::string> ret = split(data);
+        if (ret.count() && ret.last() == "")
+            ret.pop();
+        return ret;
+    }
+
+    lolunit_declare_test(log_file)
+    {
+        start_log();
+        msg::info("hello %d\n", 42);
+        msg::warn("world\n");
+
+        auto lines = read_log(LOG_FILE);
+        lolunit_assert_equal(lines.count(), 2);
+        lolunit_assert(lines[0] == "INFO: hello 42");
+        lolunit_assert(lines[1] == "WARN: world");
+    }
+
+    lolunit_declare_test(log_order)
+    {
+        start_log();
+        /* Synchronous errors must come after the queued messages */
+        for (int n = 0; n < 100; ++n)
+            msg::info("%d\n", n);
+        msg::error("done\n");
+
+        auto lines = read_log(LOG_FILE);
+        lolunit_assert_equal(lines.count(), 101);
+        for (int n = 0; n < 100; ++n)
+            lolunit_assert(lines[n] == format("INFO: %d", n));
+        lolunit_assert(lines[100] == "ERROR: done");
+    }
+
+    lolunit_declare_test(log_threads)
+    {
+        start_log();
+        int const THREADS = 4, COUNT = 5000;
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < THREADS; ++t)
+            workers.emplace_back([t]()
+            {
+                for (int n = 0; n < COUNT; ++n)
+                    msg::warn("%d %d\n", t, n);
+            });
+        for (auto &worker : workers)
+            worker.join();
+
+        /* Messages from each thread are in order and none were lost */
+        auto lines = read_log(LOG_FILE);
+        lolunit_assert_equal(lines.count(), THREADS * COUNT);
+
+        int next[THREADS] = { 0 };
+        for (auto const &line : lines)
+        {
+            int t = -1, n = -1;
+            sscanf(line.c_str(), "WARN: %d %d", &t, &n);
+            lolunit_assert(t >= 0 && t < THREADS);
+            lolunit_assert_equal(n, next[t]);
+            ++next[t];
+        }
+    }
+
+    lolunit_declare_test(log_short_threads)
+    {
+        start_log();
+        int const ROUNDS = 20, COUNT = 50;
+
+        /* Rings of exited threads are reused by later ones */
+        for (int r = 0; r < ROUNDS; ++r)
+        {
+            std::thread worker([r]()
+            {
+                for (int n = 0; n < COUNT; ++n)
+                    msg::info("%d %d\n", r, n);
+            });
+            worker.join();
+        }
+
+        auto lines = read_log(LOG_FILE);
+        lolunit_assert_equal(lines.count(), ROUNDS * COUNT);
+        for (int i = 0; i < ROUNDS * COUNT; ++i)
+            lolunit_assert(lines[i] == format("INFO: %d %d", i / COUNT,
+                                                             i % COUNT));
+    }
+
+    lolunit_declare_test(log_long_message)
+    {
+        start_log();
+        std::string big(100000, 'x');
+        msg::info("short\n");
+        msg::info("%s\n", big.c_str());
+
+        auto lines = read_log(LOG_FILE);
+        lolunit_assert_equal(lines.count(), 2);
+        lolunit_assert(lines[1] == "INFO: " + big);
+    }
+
+    lolunit_declare_test(log_fields)
+    {
+        start_log();
+        {
+            msg::field f1("level", "e1m1");
+            msg::info("a\n");
+            {
+                msg::field f2("entity", "door");
+                msg::info("b\n");
+            }
+        }
+        msg::info("c\n");
+
+        auto lines = read_log(LOG_FILE);
+        lolunit_assert_equal(lines.count(), 3);
+        lolunit_assert(lines[0] == "INFO: [level=e1m1] a");
+        lolunit_assert(lines[1] == "INFO: [level=e1m1 entity=door] b");
+        lolunit_assert(lines[2] == "INFO: c");
+    }
+
+    lolunit_declare_test(log_rate_limit)
+    {
+        start_log();
+        msg::set_rate_limit(10);
+        for (int n = 0; n < 1000; ++n)
+            msg::info("%d\n", n);
+        msg::warn("not limited\n");
+        msg::set_rate_limit(0);
+
+        /* The first ten messages, then the warning */
+        auto lines = read_log(LOG_FILE);
+        lolunit_assert(lines.count() >= 11);
+        lolunit_assert(lines.count() < 20);
+        lolunit_assert(lines[0] == "INFO: 0");
+        lolunit_assert(lines.last() == "WARN: not limited");
+    }
+
+    lolunit_declare_test(log_rotation)
+    {
+        start_log(1000, 1);
+        for (int n = 0; n < 200; ++n)
+            msg::warn("message %d\n", n);
+
+        auto lines = read_log(LOG_FILE);
+        auto old_lines = read_log(std::string(LOG_FILE) + ".1");
+        lolunit_assert(lines.count() > 0);
+        lolunit_assert(old_lines.count() > 0);
+        lolunit_assert(lines.count() + old_lines.count() < 200);
+        lolunit_assert(lines.last() == "WARN: message 199");
+    }
+};
+
+} /* namespace lol */
+
@@ -1,7 +1,7 @@
 //
 //  Lol Engine — Unit tests
 //
-//  Copyright © 2010—2018 Sam Hocevar <sam@hocevar.net>
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
 //
 //  Lol Engine is free software. It comes without any warranty, to
 //  the extent permitted by applicable law. You can redistribute it
@@ -32,6 +32,24 @@ lolunit_declare_fixture(map_test)
         lolunit_assert(!has_key(m, 1));
         lolunit_assert(has_key(m, 2));
     }
+
+    lolunit_declare_test(map_keys)
+    {
+        std::map<int, int> m;
+
+        m[3] = 0;
+        m[1] = 0;
+        m[2] = 0;
+
+        int expected = 1;
+        for (int key : keys(m))
+            lolunit_assert_equal(key, expected++);
+
+        array<int> all_keys = keys(m);
+        lolunit_assert_equal(all_keys.count(), 3);
+        lolunit_assert_equal(all_keys[0], 1);
+        lolunit_assert_equal(all_keys[2], 3);
+    }
 };
 
 } /* namespace lol */
@@ -0,0 +1,222 @@
+//
+//  Lol Engine — Unit tests for EasyMesh command programs
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+lolunit_declare_fixture(easymesh_test)
+{
+    // Two smoothed boxes and a cylinder, each in their own brace group,
+    // followed by “tail” which may differ between programs.
+    static void build(EasyMesh &em, float tail)
+    {
+        em.OpenBrace();
+        em.SetCurColorA(vec4(1.f, 0.f, 0.f, 1.f));
+        em.AppendBox(vec3(1.f, 2.f, 3.f));
+        em.SmoothMesh(2, 1, 1);
+        em.CloseBrace();
+        em.OpenBrace();
+        em.AppendCylinder(12, 1.f, 2.f, 1.f);
+        em.Translate(vec3(3.f, 0.f, 0.f));
+        em.CloseBrace();
+        em.OpenBrace();
+        em.AppendBox(vec3(0.5f));
+        em.SplitTriangles(2);
+        em.Rotate(30.f, vec3(0.f, 1.f, 0.f));
+        em.CloseBrace();
+        em.Scale(vec3(tail));
+    }
+
+    static void record(EasyMesh &em, float tail)
+    {
+        em.BD()->Enable(MeshBuildOperation::CommandRecording);
+        build(em, tail);
+        em.BD()->Disable(MeshBuildOperation::CommandRecording);
+    }
+
+    void check_equal(EasyMesh &a, EasyMesh &b)
+    {
+        lolunit_assert_equal(a.m_vert.count(), b.m_vert.count());
+        lolunit_assert_equal(a.m_indices.count(), b.m_indices.count());
+        for (int i = 0; i < a.m_vert.count(); ++i)
+        {
+            lolunit_assert(a.m_vert[i].m_coord == b.m_vert[i].m_coord);
+            lolunit_assert(a.m_vert[i].m_normal == b.m_vert[i].m_normal);
+            lolunit_assert(a.m_vert[i].m_color == b.m_vert[i].m_color);
+        }
+        for (int i = 0; i < a.m_indices.count(); ++i)
+            lolunit_assert_equal(a.m_indices[i], b.m_indices[i]);
+    }
+
+    lolunit_declare_test(program_same_as_immediate)
+    {
+        EasyMeshCache::Clear();
+
+        // Without command recording, operations are applied immediately
+        EasyMesh immediate;
+        build(immediate, 2.f);
+
+        EasyMesh program;
+        record(program, 2.f);
+        program.ExecuteCmdStack();
+
+        lolunit_assert(program.m_vert.count() > 0);
+        check_equal(immediate, program);
+        lolunit_assert(program.BD()->ColorA() == vec4(1.f, 0.f, 0.f, 1.f));
+    }
+
+    lolunit_declare_test(program_cache)
+    {
+        EasyMeshCache::Clear();
+
+        EasyMesh first;
+        record(first, 2.f);
+        first.ExecuteCmdStack();
+        int64_t hits = EasyMeshCache::GetHitCount();
+
+        EasyMesh second;
+        record(second, 2.f);
+        second.ExecuteCmdStack();
+        lolunit_assert_equal(EasyMeshCache::GetHitCount(), hits + 1);
+        check_equal(first, second);
+        lolunit_assert(second.BD()->ColorA() == vec4(1.f, 0.f, 0.f, 1.f));
+
+        // A different starting state is a different program
+        EasyMesh third;
+        third.SetCurColorB(vec4(0.f, 1.f, 0.f, 1.f));
+        record(third, 2.f);
+        third.ExecuteCmdStack();
+        lolunit_assert_equal(EasyMeshCache::GetHitCount(), hits + 1);
+    }
+
+    lolunit_declare_test(program_prefix)
+    {
+        EasyMeshCache::Clear();
+
+        EasyMesh first;
+        record(first, 2.f);
+        first.ExecuteCmdStack();
+
+        // Only the final scale differs, so the state after the last
+        // expensive command is reused.
+        EasyMesh second;
+        record(second, 3.f);
+        second.ExecuteCmdStack();
+
+        EasyMeshCache::Clear();
+        EasyMesh reference;
+        record(reference, 3.f);
+        reference.ExecuteCmdStack();
+
+        check_equal(second, reference);
+    }
+
+    lolunit_declare_test(program_cache_limit)
+    {
+        EasyMeshCache::Clear();
+        EasyMeshCache::SetMemoryLimit(0);
+
+        EasyMesh first, second;
+        record(first, 2.f);
+        first.ExecuteCmdStack();
+        record(second, 2.f);
+        second.ExecuteCmdStack();
+        lolunit_assert_equal(EasyMeshCache::GetHitCount(), 0);
+
+        EasyMeshCache::SetMemoryLimit(64 << 20);
+    }
+
+    // Every edge of a closed, consistently wound mesh has an opposite
+    void check_closed(EasyMesh &em)
+    {
+        MeshTopology topo;
+        topo.Weld(em.m_vert, 0);
+        topo.Build(em.m_indices, 0, em.m_indices.count());
+        for (int c = 0; c < topo.GetCornerCount(); ++c)
+        {
+            int o = topo.GetOpposite(c);
+            lolunit_assert(o >= 0);
+            lolunit_assert_equal(topo.GetOpposite(o), c);
+            lolunit_assert_equal(topo.GetVertex(MeshTopology::Next(c)),
+                                 topo.GetVertex(MeshTopology::Prev(o)));
+        }
+    }
+
+    lolunit_declare_test(topology)
+    {
+        EasyMesh em;
+        em.AppendBox(vec3(1.f));
+        lolunit_assert_equal(em.m_vert.count(), 24);
+
+        MeshTopology topo;
+        topo.Weld(em.m_vert, 0);
+        topo.Build(em.m_indices, 0, em.m_indices.count());
+        topo.BuildNeighbours();
+
+        int masters = 0;
+        for (int v = 0; v < topo.GetVertexCount(); ++v)
+        {
+            int m = topo.GetMaster(v);
+            lolunit_assert(em.m_vert[m].m_coord == em.m_vert[v].m_coord);
+            if (m != v)
+                continue;
+            ++masters;
+            // Box corners are linked to their 3 edges, plus face diagonals
+            lolunit_assert(topo.GetNeighbourCount(v) >= 3);
+            for (int n = 0; n < topo.GetNeighbourCount(v); ++n)
+                lolunit_assert(topo.GetMaster(topo.GetNeighbour(v, n)) == topo.GetNeighbour(v, n));
+        }
+        lolunit_assert_equal(masters, 8);
+        check_closed(em);
+    }
+
+    lolunit_declare_test(split_shares_midpoints)
+    {
+        EasyMesh em;
+        em.AppendBox(vec3(1.f));
+        em.SplitTriangles(1);
+
+        // Each face has 5 edges and gets 5 new vertices
+        lolunit_assert_equal(em.m_vert.count(), 24 + 6 * 5);
+        lolunit_assert_equal(em.m_indices.count(), 12 * 4 * 3);
+        check_closed(em);
+
+        em.SmoothMesh(2, 1, 1);
+        lolunit_assert_equal(em.m_indices.count(), 12 * 64 * 3);
+        check_closed(em);
+    }
+
+    lolunit_declare_test(chamfer)
+    {
+        EasyMesh em;
+        em.AppendBox(vec3(1.f));
+        em.Chamfer(.1f);
+
+        // 6 faces, 12 edge quads and 8 corner triangles
+        lolunit_assert_equal(em.m_indices.count(), (6 * 2 + 12 * 2 + 8) * 3);
+        check_closed(em);
+
+        for (int i = 0; i < em.m_vert.count(); ++i)
+        {
+            vec3 p = abs(em.m_vert[i].m_coord);
+            lolunit_assert_doubles_equal(max(p.x, max(p.y, p.z)), .5f, 1e-5f);
+            lolunit_assert_doubles_equal(min(p.x, min(p.y, p.z)), .5f - .1f / sqrt(2.f), 1e-5f);
+        }
+    }
+};
+
+} /* namespace lol */
+
@@ -129,6 +129,55 @@ lolunit_declare_fixture(color_test)
             lolunit_unset_context(&rgb[0]);
         }
     }
+
+    lolunit_declare_test(batch_conversions)
+    {
+        size_t const count = 103; /* Not a multiple of the SIMD width */
+        array<vec4> src, dst;
+        array<u8vec4> src8;
+        for (size_t n = 0; n < count; ++n)
+        {
+            src8.push(u8vec4(rand<uint8_t>(), rand<uint8_t>(),
+                             rand<uint8_t>(), rand<uint8_t>()));
+            src.push(vec4(src8.last()) / 255.f);
+        }
+        dst.resize(count);
+
+        Color::sRGBToLinearRGB(dst.data(), src.data(), count);
+        for (size_t n = 0; n < count; ++n)
+            lolunit_assert_doubles_equal(0.f, distance(dst[n],
+                                    Color::sRGBToLinearRGB(src[n])), 1e-5f);
+
+        Color::sRGBToLinearRGB(dst.data(), src8.data(), count);
+        for (size_t n = 0; n < count; ++n)
+            lolunit_assert_doubles_equal(0.f, distance(dst[n],
+                                    Color::sRGBToLinearRGB(src[n])), 1e-5f);
+
+        Color::LinearRGBTosRGB(dst.data(), src.data(), count);
+        for (size_t n = 0; n < count; ++n)
+            lolunit_assert_doubles_equal(0.f, distance(dst[n],
+                                    Color::LinearRGBTosRGB(src[n])), 1e-5f);
+
+        Color::RGBToYUV(dst.data(), src.data(), count);
+        for (size_t n = 0; n < count; ++n)
+            lolunit_assert_doubles_equal(0.f, distance(dst[n],
+                                    Color::RGBToYUV(src[n])), 1e-5f);
+
+        Color::YUVToRGB(dst.data(), src.data(), count);
+        for (size_t n = 0; n < count; ++n)
+            lolunit_assert_doubles_equal(0.f, distance(dst[n],
+                                    Color::YUVToRGB(src[n])), 1e-5f);
+
+        Color::LinearRGBToCIELab(dst.data(), src.data(), count);
+        for (size_t n = 0; n < count; ++n)
+        {
+            vec3 lab = Color::CIEXYZToCIELab(
+                            Color::LinearRGBToCIEXYZ(src[n].rgb));
+            lolunit_assert_doubles_equal(0.f, distance(dst[n].rgb, lab),
+                                         1e-3f);
+            lolunit_assert_equal(dst[n].a, src[n].a);
+        }
+    }
 };
 
 } /* namespace lol */
@@ -0,0 +1,287 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+/* Reference serial implementations, pushing each pixel’s error to its
+ * neighbours as soon as it is quantised. */
+static array<float> ref_ediff(array<float> p, ivec2 size,
+                              array2d<float> const &ker, ScanMode scan)
+{
+    ivec2 ksize = ker.size();
+
+    int kx;
+    for (kx = 0; kx < ksize.x; kx++)
+        if (ker[kx][0] > 0.f)
+            break;
+
+    for (int y = 0; y < size.y; y++)
+    {
+        bool reverse = (y & 1) && (scan == ScanMode::Serpentine);
+
+        for (int x = 0; x < size.x; x++)
+        {
+            int x2 = reverse ? size.x - 1 - x : x;
+            int s = reverse ? -1 : 1;
+
+            float v = p[y * size.x + x2];
+            float q = v < 0.5f ? 0.f : 1.f;
+            p[y * size.x + x2] = q;
+
+            for (int j = 0; j < ksize.y && y < size.y - j; j++)
+                for (int i = 0; i < ksize.x; i++)
+                {
+                    if ((j == 0 && i <= kx)
+                         || x + i - kx < 0 || x + i - kx >= size.x)
+                        continue;
+                    p[(y + j) * size.x + x2 + (i - kx) * s]
+                        += (v - q) * ker[i][j];
+                }
+        }
+    }
+
+    return p;
+}
+
+/* Ostromoukhov’s diffusion coefficients, copied from the library */
+static vec3 ref_diffusion(float v)
+{
+    static vec3 const table[] =
+    {
+        vec3(0.0000f, 0.2777f, 0.0000f),
+        vec3(0.0039f, 0.2777f, 0.0000f),
+        vec3(0.0117f, 0.3636f, 0.0000f),
+        vec3(0.0157f, 0.3846f, 0.0000f),
+        vec3(0.0392f, 0.2308f, 0.2308f),
+        vec3(0.0863f, 0.1667f, 0.3333f),
+        vec3(0.1255f, 0.3878f, 0.2041f),
+        vec3(0.2510f, 0.0000f, 0.4762f),
+        vec3(0.2824f, 0.0769f, 0.5385f),
+        vec3(0.3020f, 0.1667f, 0.1667f),
+        vec3(0.3333f, 0.1667f, 0.1667f),
+        vec3(0.3725f, 0.2000f, 0.3000f),
+        vec3(0.4196f, 0.2000f, 0.3000f),
+        vec3(0.4980f, 0.1667f, 0.1667f),
+        vec3(1.0000f, 0.1667f, 0.1667f),
+    };
+
+    vec3 ret(0.1667f);
+
+    if (v > 0.5f)
+       v = 1.f - v;
+    if (v < 0.f)
+       v = 0.f;
+
+    for (unsigned int i = 1; i < sizeof(table) / sizeof(table[0]); ++i)
+    {
+        if (v <= table[i][0])
+        {
+            ret[1] = lol::mix(table[i - 1][1], table[i][1],
+                         (table[i][0] - v) / (table[i][0] - table[i - 1][0]));
+            ret[2] = lol::mix(table[i - 1][2], table[i][2],
+                         (table[i][0] - v) / (table[i][0] - table[i - 1][0]));
+            break;
+        }
+    }
+
+    ret[0] = 1.f - ret[1] - ret[2];
+    return ret;
+}
+
+static array<float> ref_ostromoukhov(array<float> p, ivec2 size,
+                                     ScanMode scan)
+{
+    int w = size.x, h = size.y;
+
+    for (int y = 0; y < h; y++)
+    {
+        bool reverse = (y & 1) && (scan == ScanMode::Serpentine);
+
+        for (int x = 0; x < w; x++)
+        {
+            int x2 = reverse ? w - 1 - x : x;
+            int s = reverse ? -1 : 1;
+
+            float v = p[y * w + x2];
+            float q = v < 0.5f ? 0.f : 1.f;
+            p[y * w + x2] = q;
+
+            vec3 e = (v - q) * ref_diffusion(v);
+
+            if (x < w - 1)
+                p[y * w + x2 + s] += e[0];
+            if (y < h - 1)
+            {
+                if (x > 0)
+                    p[(y + 1) * w + x2 - s] += e[1];
+                p[(y + 1) * w + x2] += e[2];
+            }
+        }
+    }
+
+    return p;
+}
+
+static image make_gradient(ivec2 size)
+{
+    image img(size);
+    float *data = img.lock<PixelFormat::Y_F32>();
+    for (int y = 0; y < size.y; ++y)
+        for (int x = 0; x < size.x; ++x)
+            data[y * size.x + x] = (float)(x + y) / (size.x + size.y)
+                                 + rand(-0.05f, 0.05f);
+    img.unlock(data);
+    return img;
+}
+
+lolunit_declare_fixture(dither_test)
+{
+    lolunit_declare_test(ediff_matches_serial)
+    {
+        ivec2 const size(113, 47);
+        image img = make_gradient(size);
+
+        array<float> src;
+        float const *data = img.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < size.x * size.y; ++n)
+            src.push(data[n]);
+        img.unlock(data);
+
+        for (int a = 0; a < (int)EdiffAlgorithm::Lite + 1; ++a)
+        for (auto scan : { ScanMode::Raster, ScanMode::Serpentine })
+        {
+            array2d<float> ker = image::kernel::ediff((EdiffAlgorithm)a);
+            array<float> ref = ref_ediff(src, size, ker, scan);
+
+            image dst = img.dither_ediff(ker, scan);
+            float const *p = dst.lock<PixelFormat::Y_F32>();
+            lolunit_set_context(a);
+            for (int n = 0; n < size.x * size.y; ++n)
+                lolunit_assert_equal(p[n], ref[n]);
+            lolunit_unset_context(a);
+            dst.unlock(p);
+        }
+    }
+
+    lolunit_declare_test(ostromoukhov_matches_serial)
+    {
+        ivec2 const size(131, 53);
+        image img(size);
+        float *data = img.lock<PixelFormat::Y_F32>();
+        array<float> src;
+        for (int n = 0; n < size.x * size.y; ++n)
+            src.push(data[n] = rand(1.f));
+        img.unlock(data);
+
+        for (auto scan : { ScanMode::Raster, ScanMode::Serpentine })
+        {
+            array<float> ref = ref_ostromoukhov(src, size, scan);
+
+            image dst = img.dither_ostromoukhov(scan);
+            float const *p = dst.lock<PixelFormat::Y_F32>();
+            for (int n = 0; n < size.x * size.y; ++n)
+                lolunit_assert_equal(p[n], ref[n]);
+            dst.unlock(p);
+        }
+    }
+
+    lolunit_declare_test(ostromoukhov_output)
+    {
+        /* The result must be binary, and preserve the mean intensity */
+        ivec2 const size(97, 61);
+        image img = make_gradient(size);
+
+        for (auto scan : { ScanMode::Raster, ScanMode::Serpentine })
+        {
+            image dst = img.dither_ostromoukhov(scan);
+            float const *src = img.lock<PixelFormat::Y_F32>();
+            float const *p = dst.lock<PixelFormat::Y_F32>();
+
+            float sum1 = 0.f, sum2 = 0.f;
+            for (int n = 0; n < size.x * size.y; ++n)
+            {
+                lolunit_assert(p[n] == 0.f || p[n] == 1.f);
+                sum1 += src[n];
+                sum2 += p[n];
+            }
+            lolunit_assert_doubles_equal(sum1 / (size.x * size.y),
+                                         sum2 / (size.x * size.y), 0.01f);
+
+            dst.unlock(p);
+            img.unlock(src);
+        }
+    }
+
+    lolunit_declare_test(dbs_convergence)
+    {
+        ivec2 const size(53, 41);
+        image img = make_gradient(size);
+
+        array<image::dbs_pass> stats;
+        image dst = img.dither_dbs(50, 0.f, &stats);
+
+        /* Every pass must lower the perceived error, and we must have
+         * converged before the pass budget was exhausted. */
+        lolunit_assert(stats.count() > 1);
+        lolunit_assert(stats.count() < 50);
+        lolunit_assert_equal(stats.last().changes, 0);
+        for (int n = 1; n < stats.count(); ++n)
+            lolunit_assert(stats[n].error <= stats[n - 1].error);
+
+        /* Check the incrementally updated error against the perceived
+         * error computed from scratch with the HVS filter. */
+        float const *src = img.lock<PixelFormat::Y_F32>();
+        float const *p = dst.lock<PixelFormat::Y_F32>();
+
+        float ker[15][15], t = 0.f;
+        for (int j = 0; j < 15; ++j)
+            for (int i = 0; i < 15; ++i)
+            {
+                vec2 v((float)(i - 7), (float)(j - 7));
+                ker[j][i] = exp(-sqlength(v / 1.6f) / 2.f)
+                          + exp(-sqlength(v / 0.6f) / 2.f);
+                t += ker[j][i];
+            }
+
+        double error = 0.0;
+        for (int y = -7; y < size.y + 7; ++y)
+            for (int x = -7; x < size.x + 7; ++x)
+            {
+                double sum = 0.0;
+                for (int j = -7; j <= 7; ++j)
+                    for (int i = -7; i <= 7; ++i)
+                    {
+                        ivec2 pos(x + i, y + j);
+                        if (pos >= ivec2(0) && pos < size)
+                        {
+                            int n = pos.y * size.x + pos.x;
+                            lolunit_assert(p[n] == 0.f || p[n] == 1.f);
+                            sum += ker[j + 7][i + 7] / t * (p[n] - src[n]);
+                        }
+                    }
+                error += sum * sum;
+            }
+
+        lolunit_assert_doubles_equal(stats.last().error, error, error * 1e-3);
+
+        dst.unlock(p);
+        img.unlock(src);
+    }
+};
+
+} /* namespace lol */
+
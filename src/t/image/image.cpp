@@ -12,13 +12,42 @@
 
 #include <lol/engine-internal.h>
 
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
 
 #include <lolunit.h>
 
 namespace lol
 {
 
+/* Brute force morphology on a grey image, for reference */
+static array<float> morph_reference(float const *src, ivec2 size, ivec2 r,
+                                    bool disc, bool dilate)
+{
+    int64_t const rx2 = (int64_t)r.x * r.x, ry2 = (int64_t)r.y * r.y;
+    array<float> ret;
+
+    for (int y = 0; y < size.y; ++y)
+    for (int x = 0; x < size.x; ++x)
+    {
+        float t = dilate ? -1e30f : 1e30f;
+        for (int dy = -r.y; dy <= r.y; ++dy)
+        for (int dx = -r.x; dx <= r.x; ++dx)
+        {
+            if (disc && r.x && r.y && dx * dx * ry2 + dy * dy * rx2 > rx2 * ry2)
+                continue;
+            if (x + dx < 0 || x + dx >= size.x || y + dy < 0 || y + dy >= size.y)
+                continue;
+            float v = src[(y + dy) * size.x + x + dx];
+            t = dilate ? lol::max(t, v) : lol::min(t, v);
+        }
+        ret << t;
+    }
+
+    return ret;
+}
+
 lolunit_declare_fixture(image_test)
 {
     lolunit_declare_test(open_image)
@@ -42,7 +71,702 @@ lolunit_declare_fixture(image_test)
 
         img.unlock(data);
     }
+
+    lolunit_declare_test(resize_constant)
+    {
+        ResampleAlgorithm const algorithms[] =
+        {
+            ResampleAlgorithm::Bicubic, ResampleAlgorithm::Box,
+            ResampleAlgorithm::Bilinear, ResampleAlgorithm::Mitchell,
+            ResampleAlgorithm::Lanczos3,
+        };
+
+        image img(ivec2(37, 23));
+        vec4 *data = img.lock<PixelFormat::RGBA_F32>();
+        for (int n = 0; n < 37 * 23; ++n)
+            data[n] = vec4(0.25f, 0.5f, 0.75f, 1.f);
+        img.unlock(data);
+
+        for (auto algorithm : algorithms)
+        for (ivec2 size : { ivec2(10, 5), ivec2(37, 23), ivec2(80, 61) })
+        {
+            image dst = img.Resize(size, algorithm);
+            lolunit_assert_equal(dst.size().x, size.x);
+            lolunit_assert_equal(dst.size().y, size.y);
+
+            vec4 const *p = dst.lock<PixelFormat::RGBA_F32>();
+            for (int n = 0; n < size.x * size.y; ++n)
+            {
+                lolunit_assert_doubles_equal(p[n].r, 0.25f, 1e-5f);
+                lolunit_assert_doubles_equal(p[n].g, 0.5f, 1e-5f);
+                lolunit_assert_doubles_equal(p[n].b, 0.75f, 1e-5f);
+                lolunit_assert_doubles_equal(p[n].a, 1.f, 1e-5f);
+            }
+            dst.unlock(p);
+        }
+    }
+
+    lolunit_declare_test(resize_box_average)
+    {
+        image img(ivec2(4, 2));
+        u8vec4 *data = img.lock<PixelFormat::RGBA_8>();
+        for (int n = 0; n < 8; ++n)
+            data[n] = u8vec4(n * 20, 255 - n * 20, (n & 1) * 200, 255);
+        img.unlock(data);
+
+        image dst = img.Resize(ivec2(2, 1), ResampleAlgorithm::Box);
+        u8vec4 const *p = dst.lock<PixelFormat::RGBA_8>();
+
+        /* Each destination pixel is the mean of a 2×2 block */
+        lolunit_assert_equal((int)p[0].r, 50);
+        lolunit_assert_equal((int)p[0].g, 205);
+        lolunit_assert_equal((int)p[0].b, 100);
+        lolunit_assert_equal((int)p[1].r, 90);
+        lolunit_assert_equal((int)p[1].g, 165);
+        lolunit_assert_equal((int)p[1].b, 100);
+        lolunit_assert_equal((int)p[1].a, 255);
+
+        dst.unlock(p);
+    }
+
+    lolunit_declare_test(quantize_exact)
+    {
+        /* An image with only four distinct colours must be quantised
+         * back to exactly these colours. */
+        vec4 const colors[] =
+        {
+            vec4(1.f, 0.f, 0.f, 1.f), vec4(0.f, 0.5f, 0.f, 1.f),
+            vec4(0.f, 0.f, 1.f, 1.f), vec4(0.9f, 0.9f, 0.2f, 1.f),
+        };
+
+        image img(ivec2(64, 64));
+        vec4 *data = img.lock<PixelFormat::RGBA_F32>();
+        for (int n = 0; n < 64 * 64; ++n)
+            data[n] = colors[(n * 7 / 13) % 4];
+        img.unlock(data);
+
+        for (auto space : { ColorSpace::RGB, ColorSpace::CIELab })
+        {
+            array<vec4> palette = img.quantize(4, QuantizeAlgorithm::KMeans,
+                                               space);
+            lolunit_assert_equal(palette.count(), 4);
+
+            for (auto const &c : colors)
+            {
+                float best = 1.f;
+                for (auto const &p : palette)
+                    best = lol::min(best, distance(c, p));
+                lolunit_assert_doubles_equal(best, 0.f, 1e-5f);
+            }
+
+            image dst = img.remap(palette, space);
+            vec4 const *p = dst.lock<PixelFormat::RGBA_F32>();
+            for (int n = 0; n < 64 * 64; ++n)
+                lolunit_assert_doubles_equal(distance(p[n],
+                                    colors[(n * 7 / 13) % 4]), 0.f, 1e-5f);
+            dst.unlock(p);
+        }
+    }
+
+    lolunit_declare_test(remap_nearest)
+    {
+        /* Check the k-d tree lookup against a linear search */
+        array<vec4> palette;
+        for (int n = 0; n < 37; ++n)
+            palette.push(vec4(rand(1.f), rand(1.f), rand(1.f), 1.f));
+
+        image img(ivec2(50, 20));
+        vec4 *data = img.lock<PixelFormat::RGBA_F32>();
+        for (int n = 0; n < 50 * 20; ++n)
+            data[n] = vec4(rand(1.f), rand(1.f), rand(1.f), 1.f);
+        img.unlock(data);
+
+        image dst = img.remap_indices(palette);
+        data = img.lock<PixelFormat::RGBA_F32>();
+        uint8_t const *p = dst.lock<PixelFormat::Y_8>();
+        for (int n = 0; n < 50 * 20; ++n)
+        {
+            int best = 0;
+            for (int i = 1; i < palette.count(); ++i)
+                if (sqlength(data[n].rgb - palette[i].rgb)
+                     < sqlength(data[n].rgb - palette[best].rgb))
+                    best = i;
+            lolunit_assert_equal((int)p[n], best);
+        }
+        dst.unlock(p);
+        img.unlock(data);
+    }
+
+    lolunit_declare_test(morphology_grey)
+    {
+        image img(ivec2(41, 27));
+        float *data = img.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < 41 * 27; ++n)
+            data[n] = rand(1.f);
+        img.unlock(data);
+
+        for (ivec2 r : { ivec2(1, 1), ivec2(0, 3), ivec2(4, 0), ivec2(2, 5),
+                         ivec2(7, 6), ivec2(30, 2) })
+        for (auto shape : { MorphologyShape::Rectangle, MorphologyShape::Disc })
+        for (bool dilate : { true, false })
+        {
+            image dst = dilate ? img.Dilate(r, shape) : img.Erode(r, shape);
+            data = img.lock<PixelFormat::Y_F32>();
+            array<float> ref = morph_reference(data, img.size(), r,
+                                    shape == MorphologyShape::Disc, dilate);
+            img.unlock(data);
+
+            float const *p = dst.lock<PixelFormat::Y_F32>();
+            for (int n = 0; n < 41 * 27; ++n)
+                lolunit_assert_equal(p[n], ref[n]);
+            dst.unlock(p);
+        }
+    }
+
+    lolunit_declare_test(morphology_cross)
+    {
+        /* The 3×3 operators use a cross */
+        image img(ivec2(5, 5));
+        float *data = img.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < 25; ++n)
+            data[n] = n == 12 ? 1.f : 0.f;
+        img.unlock(data);
+
+        image dst = img.Dilate();
+        float const *p = dst.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < 25; ++n)
+        {
+            bool in = n == 7 || n == 11 || n == 12 || n == 13 || n == 17;
+            lolunit_assert_equal(p[n], in ? 1.f : 0.f);
+        }
+        dst.unlock(p);
+
+        dst = dst.Erode();
+        p = dst.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < 25; ++n)
+            lolunit_assert_equal(p[n], n == 12 ? 1.f : 0.f);
+        dst.unlock(p);
+    }
+
+    lolunit_declare_test(morphology_distance)
+    {
+        /* Large discs on binary images go through a distance transform */
+        image img(ivec2(96, 80));
+        float *data = img.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < 96 * 80; ++n)
+            data[n] = rand(100) < 2 ? 1.f : 0.f;
+        img.unlock(data);
+
+        for (ivec2 r : { ivec2(20, 20), ivec2(25, 13) })
+        for (bool dilate : { true, false })
+        {
+            image dst = dilate ? img.Dilate(r, MorphologyShape::Disc)
+                               : img.Erode(r, MorphologyShape::Disc);
+            data = img.lock<PixelFormat::Y_F32>();
+            array<float> ref = morph_reference(data, img.size(), r, true, dilate);
+            img.unlock(data);
+
+            float const *p = dst.lock<PixelFormat::Y_F32>();
+            for (int n = 0; n < 96 * 80; ++n)
+                lolunit_assert_equal(p[n], ref[n]);
+            dst.unlock(p);
+        }
+    }
+
+    lolunit_declare_test(morphology_rgba)
+    {
+        image img(ivec2(23, 19));
+        vec4 *data = img.lock<PixelFormat::RGBA_F32>();
+        for (int n = 0; n < 23 * 19; ++n)
+            data[n] = vec4(rand(1.f), rand(1.f), rand(1.f), rand(1.f));
+        img.unlock(data);
+
+        image open = img.Open(ivec2(2, 3));
+        image close = img.Close(ivec2(2, 3));
+        image tophat = img.TopHat(ivec2(2, 3));
+
+        data = img.lock<PixelFormat::RGBA_F32>();
+        vec4 const *o = open.lock<PixelFormat::RGBA_F32>();
+        vec4 const *c = close.lock<PixelFormat::RGBA_F32>();
+        vec4 const *t = tophat.lock<PixelFormat::RGBA_F32>();
+        for (int n = 0; n < 23 * 19; ++n)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                lolunit_assert_lequal(o[n][i], data[n][i]);
+                lolunit_assert_gequal(c[n][i], data[n][i]);
+                lolunit_assert_doubles_equal(t[n][i], data[n][i] - o[n][i], 1e-6f);
+            }
+
+            /* Alpha is left untouched */
+            lolunit_assert_equal(o[n].a, data[n].a);
+            lolunit_assert_equal(c[n].a, data[n].a);
+        }
+        img.unlock(data);
+        open.unlock(o);
+        close.unlock(c);
+        tophat.unlock(t);
+    }
+
+    lolunit_declare_test(statistics)
+    {
+        image img(ivec2(67, 45));
+        vec4 *data = img.lock<PixelFormat::RGBA_F32>();
+        for (int n = 0; n < 67 * 45; ++n)
+            data[n] = vec4(rand(1.f), 0.5f + 1e-3f * rand(1.f),
+                           (float)(n % 7) / 6.f, 1.f);
+
+        dvec4 sum(0.0), sum2(0.0);
+        vec4 mn(data[0]), mx(data[0]);
+        for (int n = 0; n < 67 * 45; ++n)
+        {
+            sum += dvec4(data[n]);
+            mn = lol::min(mn, data[n]);
+            mx = lol::max(mx, data[n]);
+        }
+        dvec4 mean = sum / (double)(67 * 45);
+        for (int n = 0; n < 67 * 45; ++n)
+            sum2 += (dvec4(data[n]) - mean) * (dvec4(data[n]) - mean);
+        img.unlock(data);
+
+        image::pixel_stats st = img.statistics();
+        lolunit_assert_equal(st.count, 67 * 45);
+        for (int i = 0; i < 4; ++i)
+        {
+            lolunit_assert_equal(st.min[i], mn[i]);
+            lolunit_assert_equal(st.max[i], mx[i]);
+            lolunit_assert_doubles_equal(st.sum[i], sum[i], 1e-6 * sum[i]);
+            lolunit_assert_doubles_equal(st.mean[i], mean[i], 1e-7);
+            double variance = sum2[i] / (67 * 45);
+            lolunit_assert_doubles_equal(st.variance[i], variance,
+                                         1e-6 * variance + 1e-12);
+        }
+    }
+
+    lolunit_declare_test(histogram_percentile)
+    {
+        image img(ivec2(131, 17));
+        float *data = img.lock<PixelFormat::Y_F32>();
+        array<float> sorted;
+        for (int n = 0; n < 131 * 17; ++n)
+            sorted << (data[n] = lol::pow(rand(1.f), 3.f));
+        img.unlock(data);
+        std::sort(&sorted[0], &sorted[0] + sorted.count());
+
+        array<ivec4> hist = img.histogram(10);
+        int total = 0;
+        for (int i = 0; i < 10; ++i)
+        {
+            int expected = 0;
+            for (float v : sorted)
+                expected += lol::min((int)(v * 10), 9) == i;
+            lolunit_assert_equal(hist[i].x, expected);
+            lolunit_assert_equal(hist[i].y, 0);
+            total += hist[i].x;
+        }
+        lolunit_assert_equal(total, 131 * 17);
+
+        for (float p : { 0.f, 0.1f, 0.5f, 0.99f, 1.f })
+        {
+            int rank = (int)lol::round(p * (sorted.count() - 1));
+            lolunit_assert_equal(img.percentile(p).x, sorted[rank]);
+        }
+    }
+
+    lolunit_declare_test(summed_area)
+    {
+        image img(ivec2(29, 31));
+        vec4 *data = img.lock<PixelFormat::RGBA_F32>();
+        for (int n = 0; n < 29 * 31; ++n)
+            data[n] = vec4(rand(1.f), rand(1.f), rand(1.f), 1.f);
+
+        array2d<dvec4> sat = img.summed_area();
+        for (int y = 0; y < 31; y += 5)
+        for (int x = 0; x < 29; x += 3)
+        {
+            dvec4 sum(0.0);
+            for (int j = 0; j <= y; ++j)
+                for (int i = 0; i <= x; ++i)
+                    sum += dvec4(data[j * 29 + i]);
+            for (int c = 0; c < 4; ++c)
+                lolunit_assert_doubles_equal(sat[x][y][c], sum[c], 1e-9);
+        }
+        img.unlock(data);
+    }
+
+    lolunit_declare_test(auto_threshold)
+    {
+        /* Two well separated populations */
+        image img(ivec2(64, 64));
+        float *data = img.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < 64 * 64; ++n)
+            data[n] = (n & 1 ? 0.7f : 0.2f) + rand(-0.05f, 0.05f);
+        img.unlock(data);
+
+        image dst = img.AutoThreshold();
+        float const *p = dst.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < 64 * 64; ++n)
+            lolunit_assert_equal(p[n], n & 1 ? 1.f : 0.f);
+        dst.unlock(p);
+    }
+
+    lolunit_declare_test(tiled_image_io)
+    {
+        image img(ivec2(100, 70));
+        vec4 *data = img.lock<PixelFormat::RGBA_F32>();
+        for (int n = 0; n < 100 * 70; ++n)
+            data[n] = vec4(rand(1.f), rand(1.f), rand(1.f), 1.f);
+        img.unlock(data);
+
+        /* A budget of two tiles forces evictions */
+        tiled_image tiled(ivec2(100, 70), PixelFormat::RGBA_F32, ivec2(16));
+        tiled.set_cache_budget(2 * 16 * 16 * sizeof(vec4));
+        tiled.write(img, ivec2(0));
+        lolunit_assert(tiled.cache_usage() <= tiled.cache_budget());
+
+        image part = tiled.read(ibox2(ivec2(-5, 60), ivec2(30, 80)));
+        lolunit_assert_equal(part.size().x, 35);
+        lolunit_assert_equal(part.size().y, 20);
+
+        vec4 const *p = part.lock<PixelFormat::RGBA_F32>();
+        data = img.lock<PixelFormat::RGBA_F32>();
+        for (int y = 0; y < 20; ++y)
+        for (int x = 0; x < 35; ++x)
+        {
+            ivec2 const src(x - 5, y + 60);
+            vec4 const expected = src.x >= 0 && src.y < 70
+                                ? data[src.y * 100 + src.x] : vec4(0.f);
+            lolunit_assert(p[y * 35 + x] == expected);
+        }
+        img.unlock(data);
+        part.unlock(p);
+    }
+
+    lolunit_declare_test(tiled_image_process)
+    {
+        ivec2 const size(100, 70), radii(3, 2);
+
+        image img(size);
+        float *data = img.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < size.x * size.y; ++n)
+            data[n] = rand(1.f);
+        img.unlock(data);
+
+        tiled_image src(size, PixelFormat::Y_F32, ivec2(32, 16));
+        tiled_image dst(size, PixelFormat::Y_F32, ivec2(32, 16));
+        src.set_cache_budget(0);
+        dst.set_cache_budget(0);
+        src.write(img);
+
+        src.process(dst, radii, [&](image const &tile)
+        {
+            return tile.Dilate(radii, MorphologyShape::Disc);
+        });
+
+        image expected = img.Dilate(radii, MorphologyShape::Disc);
+        image result = dst.read(ibox2(ivec2(0), size));
+        float const *a = expected.lock<PixelFormat::Y_F32>();
+        float const *b = result.lock<PixelFormat::Y_F32>();
+        for (int n = 0; n < size.x * size.y; ++n)
+            lolunit_assert_equal(a[n], b[n]);
+        expected.unlock(a);
+        result.unlock(b);
+
+        /* Nothing stays resident once the tiles are released */
+        lolunit_assert_equal(src.cache_usage(), (size_t)0);
+        lolunit_assert_equal(dst.cache_usage(), (size_t)0);
+    }
+
+    lolunit_declare_test(convert_rgb332)
+    {
+        ivec2 const size(37, 5);
+        array<u8vec4> src;
+        for (int n = 0; n < size.x * size.y; ++n)
+            src << u8vec4(rand(256), rand(256), rand(256), 255);
+
+        /* Read the rows bottom-up, as with OpenGL readbacks */
+        array<uint8_t> dst;
+        dst.resize(size.x * size.y);
+        convert_to_rgb332(&src[(size.y - 1) * size.x], -size.x, size,
+                          &dst[0], size.x);
+
+        for (int y = 0; y < size.y; ++y)
+        for (int x = 0; x < size.x; ++x)
+        {
+            u8vec4 p = src[(size.y - 1 - y) * size.x + x];
+            lolunit_assert_equal((int)dst[y * size.x + x],
+                                 (p.r & 0xe0) | ((p.g & 0xe0) >> 3) | (p.b >> 6));
+        }
+    }
+
+    lolunit_declare_test(convert_yuv420)
+    {
+        /* Odd sizes exercise the border handling */
+        ivec2 const size(23, 7), half((size + ivec2(1)) / 2);
+        array<u8vec4> src;
+        for (int n = 0; n < size.x * size.y; ++n)
+            src << u8vec4(rand(256), rand(256), rand(256), 255);
+
+        array<uint8_t> luma, u, v;
+        luma.resize(size.x * size.y);
+        u.resize(half.x * half.y);
+        v.resize(half.x * half.y);
+        uint8_t *const planes[3] = { &luma[0], &u[0], &v[0] };
+        int const pitches[3] = { size.x, half.x, half.x };
+        convert_to_yuv420(&src[0], size.x, size, planes, pitches);
+
+        for (int y = 0; y < size.y; ++y)
+        for (int x = 0; x < size.x; ++x)
+        {
+            u8vec4 p = src[y * size.x + x];
+            lolunit_assert_equal((int)luma[y * size.x + x],
+                ((66 * p.r + 129 * p.g + 25 * p.b + 128) >> 8) + 16);
+        }
+
+        for (int y = 0; y < half.y; ++y)
+        for (int x = 0; x < half.x; ++x)
+        {
+            ivec3 sum(0);
+            for (int j = 0; j < 2; ++j)
+            for (int i = 0; i < 2; ++i)
+            {
+                int sx = min(2 * x + i, size.x - 1);
+                int sy = min(2 * y + j, size.y - 1);
+                sum += ivec3(src[sy * size.x + sx].rgb);
+            }
+
+            lolunit_assert_equal((int)u[y * half.x + x],
+                ((-38 * sum.r - 74 * sum.g + 112 * sum.b + 512) >> 10) + 128);
+            lolunit_assert_equal((int)v[y * half.x + x],
+                ((112 * sum.r - 94 * sum.g - 18 * sum.b + 512) >> 10) + 128);
+        }
+    }
+
+    lolunit_declare_test(rect_packer_overlap)
+    {
+        rect_packer packer(ivec2(256));
+        array<ibox2> boxes;
+
+        for (int n = 0; n < 200; ++n)
+        {
+            ibox2 box;
+            if (!packer.insert(ivec2(rand(4, 40), rand(4, 40)), box))
+                break;
+            lolunit_assert(box.aa.x >= 0 && box.aa.y >= 0);
+            lolunit_assert(box.bb.x <= 256 && box.bb.y <= 256);
+            boxes << box;
+        }
+
+        lolunit_assert(boxes.count() > 20);
+        for (int i = 0; i < boxes.count(); ++i)
+        for (int j = i + 1; j < boxes.count(); ++j)
+        {
+            ibox2 const &a = boxes[i], &b = boxes[j];
+            lolunit_assert(a.bb.x <= b.aa.x || b.bb.x <= a.aa.x
+                            || a.bb.y <= b.aa.y || b.bb.y <= a.aa.y);
+        }
+    }
+
+    lolunit_declare_test(image_atlas_extrude)
+    {
+        image img(ivec2(8, 4));
+        u8vec4 *data = img.lock<PixelFormat::RGBA_8>();
+        for (int n = 0; n < 8 * 4; ++n)
+            data[n] = u8vec4(n, 255 - n, 0, 255);
+        img.unlock(data);
+
+        array<ibox2> rects;
+        rects << ibox2(0, 0, 4, 4) << ibox2(4, 0, 8, 4);
+
+        image_atlas atlas(ivec2(64), 2);
+        int group = atlas.add("tiles", img, rects);
+        lolunit_assert_equal(group, 0);
+        lolunit_assert_equal(atlas.page_count(), 1);
+        lolunit_assert_equal(atlas.group_rects(group).count(), 2);
+
+        image page = atlas.page(0);
+        u8vec4 const *p = page.lock<PixelFormat::RGBA_8>();
+        data = img.lock<PixelFormat::RGBA_8>();
+        for (int i = 0; i < 2; ++i)
+        {
+            ibox2 const r = atlas.group_rects(group)[i];
+            lolunit_assert_equal(r.extent().x, 4);
+            lolunit_assert_equal(r.extent().y, 4);
+
+            /* The padding repeats the nearest edge pixel */
+            for (int y = -2; y < 6; ++y)
+            for (int x = -2; x < 6; ++x)
+            {
+                ivec2 const src = rects[i].aa + ivec2(lol::clamp(x, 0, 3),
+                                                      lol::clamp(y, 0, 3));
+                ivec2 const dst = r.aa + ivec2(x, y);
+                lolunit_assert(p[dst.y * 64 + dst.x] == data[src.y * 8 + src.x]);
+            }
+        }
+        img.unlock(data);
+        page.unlock(p);
+    }
+
+    lolunit_declare_test(image_atlas_mipmap)
+    {
+        image img(ivec2(16, 8));
+        u8vec4 *data = img.lock<PixelFormat::RGBA_8>();
+        for (int n = 0; n < 16 * 8; ++n)
+            data[n] = u8vec4(n, 255 - n, 0, 255);
+        img.unlock(data);
+
+        array<ibox2> rects;
+        rects << ibox2(0, 0, 3, 5) << ibox2(3, 0, 10, 2)
+              << ibox2(10, 1, 11, 8) << ibox2(4, 3, 9, 8);
+
+        /* Two mip levels need 4-texel aligned cells and padding */
+        image_atlas atlas(ivec2(64), 1, 2);
+        lolunit_assert_equal(atlas.padding(), 4);
+        int group = atlas.add("tiles", img, rects);
+        lolunit_assert(group >= 0);
+
+        array<ibox2> cells;
+        for (auto const &r : atlas.group_rects(group))
+        {
+            ivec2 const aa = r.aa - ivec2(4);
+            ivec2 const bb = (r.bb + ivec2(4 + 3)) / 4 * 4;
+            lolunit_assert_equal(aa.x % 4, 0);
+            lolunit_assert_equal(aa.y % 4, 0);
+            cells << ibox2(aa, bb);
+        }
+
+        image page = atlas.page(0);
+        u8vec4 const *p = page.lock<PixelFormat::RGBA_8>();
+        data = img.lock<PixelFormat::RGBA_8>();
+        for (int i = 0; i < cells.count(); ++i)
+        {
+            /* Cells never share a 4×4 block of texels */
+            for (int j = 0; j < i; ++j)
+                lolunit_assert(cells[i].bb.x <= cells[j].aa.x
+                                || cells[j].bb.x <= cells[i].aa.x
+                                || cells[i].bb.y <= cells[j].aa.y
+                                || cells[j].bb.y <= cells[i].aa.y);
+
+            /* The whole cell repeats the nearest edge pixel */
+            ibox2 const r = atlas.group_rects(group)[i];
+            ivec2 const size = rects[i].extent();
+            for (int y = cells[i].aa.y; y < cells[i].bb.y; ++y)
+            for (int x = cells[i].aa.x; x < cells[i].bb.x; ++x)
+            {
+                ivec2 const src = rects[i].aa
+                    + ivec2(lol::clamp(x - r.aa.x, 0, size.x - 1),
+                            lol::clamp(y - r.aa.y, 0, size.y - 1));
+                lolunit_assert(p[y * 64 + x] == data[src.y * 16 + src.x]);
+            }
+        }
+        img.unlock(data);
+        page.unlock(p);
+    }
+
+    lolunit_declare_test(image_atlas_incremental)
+    {
+        image a(ivec2(32)), b(ivec2(16));
+        u8vec4 *data = a.lock<PixelFormat::RGBA_8>();
+        std::fill(data, data + 32 * 32, u8vec4(255, 0, 0, 255));
+        a.unlock(data);
+        data = b.lock<PixelFormat::RGBA_8>();
+        std::fill(data, data + 16 * 16, u8vec4(0, 0, 255, 255));
+        b.unlock(data);
+
+        image_atlas atlas(ivec2(64), 1);
+        int ga = atlas.add("a", a, array<ibox2>{ ibox2(0, 0, 32, 32) });
+        int version = atlas.page_version(0);
+        array<ibox2> before = atlas.group_rects(ga);
+
+        int gb = atlas.add("b", b, array<ibox2>{ ibox2(0, 0, 16, 16) });
+        lolunit_assert_equal(atlas.group_page(gb), 0);
+        lolunit_assert(atlas.page_version(0) != version);
+        lolunit_assert(atlas.group_rects(ga)[0] == before[0]);
+        lolunit_assert_equal(atlas.find("b"), gb);
+        lolunit_assert_equal(atlas.find("c"), -1);
+
+        /* Earlier pixels are left untouched */
+        image page = atlas.page(0);
+        u8vec4 const *p = page.lock<PixelFormat::RGBA_8>();
+        ivec2 const c = before[0].aa + ivec2(16);
+        lolunit_assert(p[c.y * 64 + c.x] == u8vec4(255, 0, 0, 255));
+        page.unlock(p);
+
+        /* Groups that cannot fit in an empty page are rejected */
+        image big(ivec2(80));
+        lolunit_assert_equal(atlas.add("big", big,
+                                       array<ibox2>{ ibox2(0, 0, 80, 80) }), -1);
+    }
+
+    lolunit_declare_test(image_atlas_save_load)
+    {
+        image img(ivec2(20, 10));
+        u8vec4 *data = img.lock<PixelFormat::RGBA_8>();
+        for (int n = 0; n < 20 * 10; ++n)
+            data[n] = u8vec4(rand(256), rand(256), rand(256), 255);
+        img.unlock(data);
+
+        image_atlas atlas(ivec2(32), 1);
+        atlas.add("one", img, array<ibox2>{ ibox2(0, 0, 10, 10) });
+        atlas.add("two", img, array<ibox2>{ ibox2(10, 0, 20, 10),
+                                            ibox2(5, 5, 8, 8) });
+
+        char const *path = "test-atlas.tmp";
+        lolunit_assert(atlas.save(path));
+
+        image_atlas loaded;
+        bool ok = loaded.load(path);
+        std::remove(path);
+        lolunit_assert(ok);
+
+        lolunit_assert(loaded.page_size() == atlas.page_size());
+        lolunit_assert_equal(loaded.page_count(), atlas.page_count());
+        lolunit_assert_equal(loaded.group_count(), 2);
+        lolunit_assert_equal(loaded.find("two"), 1);
+        for (int g = 0; g < 2; ++g)
+        {
+            lolunit_assert_equal(loaded.group_page(g), atlas.group_page(g));
+            for (int i = 0; i < atlas.group_rects(g).count(); ++i)
+                lolunit_assert(loaded.group_rects(g)[i]
+                                == atlas.group_rects(g)[i]);
+        }
+
+        for (int n = 0; n < atlas.page_count(); ++n)
+        {
+            image p1 = atlas.page(n), p2 = loaded.page(n);
+            u8vec4 const *a = p1.lock<PixelFormat::RGBA_8>();
+            u8vec4 const *b = p2.lock<PixelFormat::RGBA_8>();
+            lolunit_assert(std::equal(a, a + 32 * 32, b));
+            p2.unlock(b);
+            p1.unlock(a);
+        }
+
+        /* Rectangles outside their page are rejected. The first one
+         * starts after the header, name length, name, page and count. */
+        lolunit_assert(atlas.save(path));
+        FILE *f = fopen(path, "r+b");
+        lolunit_assert(f);
+        int32_t const bad = 1000;
+        fseek(f, 32 + 4 + 3 + 8 + 8, SEEK_SET);
+        fwrite(&bad, sizeof(bad), 1, f);
+        fclose(f);
+
+        image_atlas corrupt;
+        ok = corrupt.load(path);
+        std::remove(path);
+        lolunit_assert(!ok);
+        lolunit_assert_equal(corrupt.page_count(), 0);
+
+        /* New rectangles avoid the restored ones and their padding */
+        int g = loaded.add("three", img, array<ibox2>{ ibox2(0, 0, 6, 6) });
+        lolunit_assert(g >= 0);
+        ibox2 const r = loaded.group_rects(g)[0];
+        for (int i = 0; loaded.group_page(g) == 0 && i < 2; ++i)
+        for (auto const &s : loaded.group_rects(i))
+            lolunit_assert(r.bb.x + 1 <= s.aa.x - 1 || s.bb.x + 1 <= r.aa.x - 1
+                            || r.bb.y + 1 <= s.aa.y - 1
+                            || s.bb.y + 1 <= r.aa.y - 1);
+    }
 };
 
 } /* namespace lol */
-
@@ -0,0 +1,186 @@
+//
+//  Lol Engine — Unit tests for batch vector operations
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <lolunit.h>
+
+#include <cfloat>
+
+namespace lol
+{
+
+/* Not a multiple of the SIMD width, to exercise the scalar tails */
+static size_t const COUNT = 103;
+
+/* Batch and scalar code may round differently, for instance because of
+ * fused multiply-adds or -ffast-math, so results are compared within a
+ * few ulps of the magnitude of the terms that were summed. */
+static float tolerance(float magnitude)
+{
+    return 4.f * FLT_EPSILON * lol::max(magnitude, FLT_MIN);
+}
+
+/* Sum of the magnitudes of the terms of m * v */
+static vec4 abs_product(mat4 const &m, vec4 const &v)
+{
+    return lol::abs(m[0]) * lol::abs(v.x) + lol::abs(m[1]) * lol::abs(v.y)
+         + lol::abs(m[2]) * lol::abs(v.z) + lol::abs(m[3]) * lol::abs(v.w);
+}
+
+lolunit_declare_fixture(batch_test)
+{
+    void setup()
+    {
+        for (size_t n = 0; n < COUNT; ++n)
+        {
+            m_v3.push(vec3(rand(-5.f, 5.f), rand(-5.f, 5.f),
+                           rand(-5.f, 5.f)));
+            m_v4.push(vec4(rand(-5.f, 5.f), rand(-5.f, 5.f),
+                           rand(-5.f, 5.f), rand(-5.f, 5.f)));
+        }
+
+        /* Zero vectors must normalise to zero */
+        m_v3[7] = vec3(0.f);
+        m_v4[9] = vec4(0.f);
+
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                m_mat[i][j] = rand(-2.f, 2.f);
+    }
+
+    void teardown()
+    {
+        m_v3.clear();
+        m_v4.clear();
+    }
+
+    lolunit_declare_test(transform_aos)
+    {
+        array<vec4> dst;
+        dst.resize(COUNT);
+        transform(dst.data(), m_v4.data(), COUNT, m_mat);
+
+        for (size_t n = 0; n < COUNT; ++n)
+        {
+            vec4 ref = m_mat * m_v4[n];
+            vec4 mag = abs_product(m_mat, m_v4[n]);
+            for (int i = 0; i < 4; ++i)
+                lolunit_assert_doubles_equal(dst[n][i], ref[i],
+                                             tolerance(mag[i]));
+        }
+
+        /* In-place transformation */
+        transform(m_v4.data(), m_v4.data(), COUNT, m_mat);
+        for (size_t n = 0; n < COUNT; ++n)
+            lolunit_assert(m_v4[n] == dst[n]);
+    }
+
+    lolunit_declare_test(transform_soa)
+    {
+        array<float> x, y, z, w;
+        for (size_t n = 0; n < COUNT; ++n)
+        {
+            x.push(m_v4[n].x);
+            y.push(m_v4[n].y);
+            z.push(m_v4[n].z);
+            w.push(m_v4[n].w);
+        }
+
+        transform(x.data(), y.data(), z.data(), w.data(), COUNT, m_mat);
+
+        for (size_t n = 0; n < COUNT; ++n)
+        {
+            vec4 ref = m_mat * m_v4[n];
+            vec4 mag = abs_product(m_mat, m_v4[n]);
+            lolunit_assert_doubles_equal(x[n], ref.x, tolerance(mag.x));
+            lolunit_assert_doubles_equal(y[n], ref.y, tolerance(mag.y));
+            lolunit_assert_doubles_equal(z[n], ref.z, tolerance(mag.z));
+            lolunit_assert_doubles_equal(w[n], ref.w, tolerance(mag.w));
+        }
+    }
+
+    lolunit_declare_test(normalize)
+    {
+        array<vec3> dst3;
+        array<vec4> dst4;
+        dst3.resize(COUNT);
+        dst4.resize(COUNT);
+
+        normalize_all(dst3.data(), m_v3.data(), COUNT);
+        normalize_all(dst4.data(), m_v4.data(), COUNT);
+
+        for (size_t n = 0; n < COUNT; ++n)
+        {
+            vec3 ref3 = lol::normalize(m_v3[n]);
+            vec4 ref4 = lol::normalize(m_v4[n]);
+            for (int i = 0; i < 3; ++i)
+                lolunit_assert_doubles_equal(dst3[n][i], ref3[i],
+                                             tolerance(1.f));
+            for (int i = 0; i < 4; ++i)
+                lolunit_assert_doubles_equal(dst4[n][i], ref4[i],
+                                             tolerance(1.f));
+        }
+
+        /* Zero vectors stay exactly zero */
+        lolunit_assert(dst3[7] == vec3(0.f));
+        lolunit_assert(dst4[9] == vec4(0.f));
+    }
+
+    lolunit_declare_test(dot)
+    {
+        array<float> dst3, dst4;
+        dst3.resize(COUNT);
+        dst4.resize(COUNT);
+
+        dot_all(dst3.data(), m_v3.data(), m_v3.data() + 1, COUNT - 1);
+        dot_all(dst4.data(), m_v4.data(), m_v4.data() + 1, COUNT - 1);
+
+        for (size_t n = 0; n + 1 < COUNT; ++n)
+        {
+            float mag3 = lol::dot(lol::abs(m_v3[n]), lol::abs(m_v3[n + 1]));
+            float mag4 = lol::dot(lol::abs(m_v4[n]), lol::abs(m_v4[n + 1]));
+            lolunit_assert_doubles_equal(dst3[n],
+                    lol::dot(m_v3[n], m_v3[n + 1]), tolerance(mag3));
+            lolunit_assert_doubles_equal(dst4[n],
+                    lol::dot(m_v4[n], m_v4[n + 1]), tolerance(mag4));
+        }
+    }
+
+    lolunit_declare_test(slerp)
+    {
+        array<quat> a, b, dst;
+        for (size_t n = 0; n < COUNT; ++n)
+        {
+            a.push(quat::rotate(rand(-3.f, 3.f), m_v3[(n + 1) % COUNT]));
+            b.push(quat::rotate(rand(-3.f, 3.f), m_v3[(n + 2) % COUNT]));
+        }
+        dst.resize(COUNT);
+
+        lol::slerp(dst.data(), a.data(), b.data(), 0.3f, COUNT);
+        for (size_t n = 0; n < COUNT; ++n)
+        {
+            /* The trigonometric terms amplify rounding differences */
+            quat ref = lol::slerp(a[n], b[n], 0.3f);
+            for (int i = 0; i < 4; ++i)
+                lolunit_assert_doubles_equal(dst[n][i], ref[i], 1e-5f);
+        }
+    }
+
+private:
+    array<vec3> m_v3;
+    array<vec4> m_v4;
+    mat4 m_mat;
+};
+
+} /* namespace lol */
+
@@ -19,6 +19,16 @@
 namespace lol
 {
 
+/* A random non-negative number with at most the given number of bits */
+template<unsigned int N, typename T>
+static bigint<N,T> random_bigint(int bits)
+{
+    bigint<N,T> ret(0);
+    for (int n = 0; n < bits; n += 16)
+        ret = (ret << 16) | bigint<N,T>((int32_t)rand(0x10000));
+    return ret >> ((bits + 15) / 16 * 16 - bits);
+}
+
 lolunit_declare_fixture(bigint_test)
 {
     lolunit_declare_test(declaration)
@@ -236,6 +246,128 @@ lolunit_declare_fixture(bigint_test)
         lolunit_assert_equal((int32_t)(c * b), 0);
         lolunit_assert_equal((int32_t)(c * c), 100);
     }
+
+    lolunit_declare_test(shift)
+    {
+        bigint<4> a(1), b(-3);
+
+        lolunit_assert((a << 100) >> 100 == a);
+        lolunit_assert((a << 122) > bigint<4>(0));
+        lolunit_assert((a << 123) >> 123 == bigint<4>(-1));
+        lolunit_assert((a << 124) == bigint<4>(0));
+        lolunit_assert((b << 40) >> 40 == b);
+        lolunit_assert(b >> 1 == bigint<4>(-2));
+        lolunit_assert(b >> 200 == bigint<4>(-1));
+        lolunit_assert_equal((int32_t)(bigint<4>(0x1234567) << 4), 0x12345670);
+        lolunit_assert_equal((int32_t)(bigint<4>(0x1234567) >> 4), 0x123456);
+    }
+
+    lolunit_declare_test(divide_small)
+    {
+        for (int32_t a = -50; a <= 50; a += 7)
+        for (int32_t b = -13; b <= 13; ++b)
+        {
+            if (b == 0)
+                continue;
+            lolunit_assert_equal((int32_t)(bigint<3>(a) / bigint<3>(b)), a / b);
+            lolunit_assert_equal((int32_t)(bigint<3>(a) % bigint<3>(b)), a % b);
+        }
+    }
+
+    template<unsigned int N, typename T>
+    void check_divide()
+    {
+        int const bits = (int)N * (sizeof(T) * 8 - 1) - 1;
+        for (int n = 0; n < 200; ++n)
+        {
+            bigint<N,T> a = random_bigint<N,T>(rand(1, bits));
+            bigint<N,T> b = random_bigint<N,T>(rand(1, bits));
+            if (b == bigint<N,T>(0))
+                continue;
+            if (rand(2))
+                a = -a;
+            if (rand(2))
+                b = -b;
+
+            bigint<N,T> q = a / b, r = a % b;
+            lolunit_assert((bigint<N,T>(q * b) + r == a));
+
+            bigint<N,T> zero(0);
+            lolunit_assert(r == zero || (r < zero) == (a < zero));
+            lolunit_assert((r < zero ? -r : r) < (b < zero ? -b : b));
+        }
+    }
+
+    lolunit_declare_test(divide)
+    {
+        check_divide<2, uint32_t>();
+        check_divide<8, uint32_t>();
+        check_divide<33, uint32_t>();
+#if defined __SIZEOF_INT128__
+        check_divide<4, uint64_t>();
+        check_divide<17, uint64_t>();
+#endif
+    }
+
+    /* Compare pow_mod() against square-and-multiply with division */
+    template<unsigned int N, typename T>
+    void check_pow_mod(bigint<N,T> const &m)
+    {
+        for (int n = 0; n < 10; ++n)
+        {
+            bigint<N,T> x = random_bigint<N,T>(rand(1, 30 * (int)N)) % m;
+            bigint<N,T> e = random_bigint<N,T>(rand(1, 64));
+            bigint<2 * N, T> y(1), x2(x), m2(m);
+
+            for (int i = 64; i-- > 0; )
+            {
+                y = bigint<2 * N, T>(y * y) % m2;
+                if (e >> i & bigint<N,T>(1))
+                    y = bigint<2 * N, T>(y * x2) % m2;
+            }
+
+            lolunit_assert((pow_mod(x, e, m) == bigint<N,T>(y)));
+        }
+    }
+
+    lolunit_declare_test(modular_pow)
+    {
+        /* Odd moduli use Montgomery, even ones use Barrett. Even moduli
+         * are built so that they can never be zero. */
+        for (int n = 0; n < 10; ++n)
+        {
+            check_pow_mod(random_bigint<8, uint32_t>(rand(2, 240)) | bigint<8>(1));
+            check_pow_mod((random_bigint<8, uint32_t>(rand(2, 240)) << 1)
+                           + bigint<8>(2));
+#if defined __SIZEOF_INT128__
+            check_pow_mod(random_bigint<4, uint64_t>(rand(2, 240))
+                           | bigint<4, uint64_t>(1));
+            check_pow_mod((random_bigint<4, uint64_t>(rand(2, 240)) << 1)
+                           + bigint<4, uint64_t>(2));
+#endif
+        }
+
+        lolunit_assert(pow_mod(bigint<4>(7), bigint<4>(0), bigint<4>(1))
+                        == bigint<4>(0));
+        lolunit_assert(pow_mod(bigint<4>(-2), bigint<4>(3), bigint<4>(5))
+                        == bigint<4>(2));
+    }
+
+    lolunit_declare_test(fermat)
+    {
+        /* 2^521 − 1 is a Mersenne prime, so a^(p−1) = 1 mod p */
+        bigint<32> p = (bigint<32>(1) << 521) - bigint<32>(1);
+        lolunit_assert(pow_mod(bigint<32>(3), p - bigint<32>(1), p)
+                        == bigint<32>(1));
+        lolunit_assert(pow_mod(bigint<32>(3), p, p) == bigint<32>(3));
+
+#if defined __SIZEOF_INT128__
+        typedef bigint<16, uint64_t> int1008_t;
+        int1008_t p2 = (int1008_t(1) << 521) - int1008_t(1);
+        lolunit_assert(pow_mod(int1008_t(5), p2 - int1008_t(1), p2)
+                        == int1008_t(1));
+#endif
+    }
 };
 
 } /* namespace lol */
@@ -0,0 +1,195 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+/* A camera at the origin looking down the negative z axis */
+static mat4 make_view_proj()
+{
+    return mat4::perspective(radians(60.f), 4.f, 3.f, 0.1f, 100.f)
+         * mat4::lookat(vec3(0.f), vec3(0.f, 0.f, -1.f), vec3::axis_y);
+}
+
+static box3 random_box(float range, float size)
+{
+    vec3 a(rand(-range, range), rand(-range, range), rand(-range, range));
+    return box3(a, a + vec3(rand(size), rand(size), rand(size)));
+}
+
+/* Sample the box and check whether any of the samples is visible */
+static bool sample_box(mat4 const &view_proj, box3 const &box)
+{
+    for (int i = 0; i <= 4; ++i)
+    for (int j = 0; j <= 4; ++j)
+    for (int k = 0; k <= 4; ++k)
+    {
+        vec3 p = box.aa + box.extent() * vec3((float)i, (float)j, (float)k) / 4.f;
+        vec4 q = view_proj * vec4(p, 1.f);
+        if (abs(q.x) <= q.w && abs(q.y) <= q.w && abs(q.z) <= q.w)
+            return true;
+    }
+    return false;
+}
+
+lolunit_declare_fixture(culling_test)
+{
+    lolunit_declare_test(frustum_planes)
+    {
+        frustum f(make_view_proj());
+
+        /* All planes are normalised and point inside the frustum */
+        for (int i = 0; i < 6; ++i)
+        {
+            lolunit_assert_doubles_equal(length(f[i].xyz), 1.f, 1e-5f);
+            lolunit_assert(dot(f[i].xyz, vec3(0.f, 0.f, -10.f)) + f[i].w > 0.f);
+        }
+
+        lolunit_assert(f.test(vec3(0.f, 0.f, -10.f), 0.5f));
+        lolunit_assert(!f.test(vec3(0.f, 0.f, 10.f), 0.5f));
+        lolunit_assert(!f.test(vec3(0.f, 0.f, -200.f), 0.5f));
+        lolunit_assert(f.test(vec3(0.f, 0.f, -100.2f), 0.5f));
+        lolunit_assert(!f.test(vec3(50.f, 0.f, -10.f), 0.5f));
+
+        lolunit_assert(f.test(box3(vec3(-1.f, -1.f, -11.f), vec3(1.f, 1.f, -9.f))));
+        lolunit_assert(f.test(box3(vec3(-100.f), vec3(100.f))));
+        lolunit_assert(!f.test(box3(vec3(-1.f, -1.f, 1.f), vec3(1.f, 1.f, 3.f))));
+        lolunit_assert(!f.test(box3(vec3(20.f, -1.f, -11.f), vec3(22.f, 1.f, -9.f))));
+    }
+
+    lolunit_declare_test(frustum_conservative)
+    {
+        /* Culled boxes must never have visible parts */
+        mat4 view_proj = make_view_proj();
+        frustum f(view_proj);
+
+        for (int n = 0; n < 1000; ++n)
+        {
+            box3 box = random_box(40.f, 10.f);
+            if (sample_box(view_proj, box))
+                lolunit_assert(f.test(box));
+        }
+    }
+
+    lolunit_declare_test(frustum_batch)
+    {
+        /* Batch tests must match the scalar ones exactly */
+        frustum f(make_view_proj());
+
+        array<box3> boxes;
+        array<vec4> spheres;
+        for (int n = 0; n < 103; ++n)
+        {
+            boxes.push(random_box(40.f, 10.f));
+            spheres.push(vec4(rand(-40.f, 40.f), rand(-40.f, 40.f),
+                              rand(-40.f, 40.f), rand(5.f)));
+        }
+
+        array<bool> result;
+        result.resize(boxes.count());
+
+        f.test(result.data(), boxes.data(), boxes.count());
+        for (int n = 0; n < boxes.count(); ++n)
+            lolunit_assert_equal(result[n], f.test(boxes[n]));
+
+        f.test(result.data(), spheres.data(), spheres.count());
+        for (int n = 0; n < spheres.count(); ++n)
+            lolunit_assert_equal(result[n],
+                                 f.test(spheres[n].xyz, spheres[n].w));
+    }
+
+    lolunit_declare_test(occlusion)
+    {
+        occlusion_buffer buf(ivec2(64, 48));
+        buf.clear(make_view_proj());
+
+        /* A wall in front of the camera */
+        buf.add_occluder(box3(vec3(-4.f, -3.f, -11.f), vec3(4.f, 3.f, -10.f)));
+
+        /* Behind the wall, beside it, in front of it, and partly behind */
+        lolunit_assert(!buf.test(box3(vec3(-1.f, -1.f, -30.f), vec3(1.f, 1.f, -20.f))));
+        lolunit_assert(buf.test(box3(vec3(9.f, -1.f, -30.f), vec3(11.f, 1.f, -20.f))));
+        lolunit_assert(buf.test(box3(vec3(-1.f, -1.f, -6.f), vec3(1.f, 1.f, -5.f))));
+        lolunit_assert(buf.test(box3(vec3(3.f, -1.f, -30.f), vec3(8.f, 1.f, -20.f))));
+
+        /* Boxes crossing the near plane are always visible */
+        lolunit_assert(buf.test(box3(vec3(-1.f, -1.f, -30.f), vec3(1.f, 1.f, 1.f))));
+
+        /* A triangle occluder facing the camera */
+        buf.clear(make_view_proj());
+        buf.add_occluder(vec3(-20.f, -20.f, -10.f), vec3(20.f, -20.f, -10.f),
+                         vec3(0.f, 20.f, -10.f));
+        lolunit_assert(!buf.test(box3(vec3(-1.f, -1.f, -30.f), vec3(1.f, 1.f, -20.f))));
+        lolunit_assert(buf.test(box3(vec3(-1.f, -1.f, -9.f), vec3(1.f, 1.f, -8.f))));
+    }
+
+    lolunit_declare_test(culler_synthetic_scene)
+    {
+        /* A grid of boxes on the ground, partly hidden by a wall */
+        mat4 view_proj = make_view_proj();
+        box3 wall(vec3(-5.f, -2.f, -16.f), vec3(5.f, 3.f, -15.f));
+
+        array<box3> boxes;
+        for (int z = 0; z < 40; ++z)
+            for (int x = -20; x < 20; ++x)
+                boxes.push(box3(vec3(x * 2.f, -2.f, -z * 2.f - 2.f),
+                                vec3(x * 2.f + 1.f, -1.f, -z * 2.f - 1.f)));
+
+        array<bool> visible;
+        visible.resize(boxes.count());
+
+        culler c;
+        c.begin(view_proj);
+        c.cull(visible.data(), boxes.data(), boxes.count());
+        cull_stats s1 = c.stats();
+
+        lolunit_assert_equal(s1.tested, boxes.count());
+        lolunit_assert_equal(s1.occluded, 0);
+        lolunit_assert(s1.outside > 0);
+        lolunit_assert_equal(s1.tested, s1.outside + s1.visible);
+        for (int n = 0; n < boxes.count(); ++n)
+            if (sample_box(view_proj, boxes[n]))
+                lolunit_assert(visible[n]);
+
+        c.reset();
+        c.begin(view_proj, true);
+        c.add_occluder(wall);
+        c.cull(visible.data(), boxes.data(), boxes.count());
+        cull_stats s2 = c.stats();
+
+        lolunit_assert_equal(s2.outside, s1.outside);
+        lolunit_assert(s2.occluded > 0);
+        lolunit_assert_equal(s2.tested, s2.outside + s2.occluded + s2.visible);
+
+        /* Occluded boxes must be entirely behind the wall: the line of
+         * sight to each of their corners crosses its front face. */
+        for (int n = 0; n < boxes.count(); ++n)
+            if (!visible[n] && sample_box(view_proj, boxes[n]))
+                for (int i = 0; i < 8; ++i)
+                {
+                    vec3 p(i & 1 ? boxes[n].bb.x : boxes[n].aa.x,
+                           i & 2 ? boxes[n].bb.y : boxes[n].aa.y,
+                           i & 4 ? boxes[n].bb.z : boxes[n].aa.z);
+                    lolunit_assert(p.z < wall.bb.z);
+                    vec3 q = p * (wall.bb.z / p.z);
+                    lolunit_assert(q.x >= wall.aa.x && q.x <= wall.bb.x);
+                    lolunit_assert(q.y >= wall.aa.y && q.y <= wall.bb.y);
+                }
+    }
+};
+
+} /* namespace lol */
+
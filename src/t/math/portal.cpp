@@ -0,0 +1,261 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+/* A maze of square rooms of side 4 and height 3 on the xz plane. Room
+ * (i, j) spans x ∈ [4i, 4i+4] and z ∈ [-4j-4, -4j]. Doors are 2×2 and
+ * centred on the walls; about one in three walls has no door. */
+struct maze
+{
+    maze(int w, int h) : m_w(w), m_h(h)
+    {
+        for (int n = 0; n < w * h; ++n)
+            m_set << new PortalRoom<void>();
+
+        for (int j = 0; j < h; ++j)
+            for (int i = 0; i < w; ++i)
+            {
+                if (i + 1 < w && rand(3) != 0)
+                {
+                    auto door = new PortalDoor<void>(vec3(4.f * i + 4.f, 0.f, -4.f * j - 2.f),
+                                                     vec3::axis_x, vec3::axis_y, vec2(2.f));
+                    door->ConnectRooms(room(i + 1, j), room(i, j));
+                    m_xdoors[j * w + i] = door;
+                }
+                if (j + 1 < h && rand(3) != 0)
+                {
+                    auto door = new PortalDoor<void>(vec3(4.f * i + 2.f, 0.f, -4.f * j - 4.f),
+                                                     -vec3::axis_z, vec3::axis_y, vec2(2.f));
+                    door->ConnectRooms(room(i, j + 1), room(i, j));
+                    m_zdoors[j * w + i] = door;
+                }
+            }
+    }
+
+    PortalRoom<void> *room(int i, int j) { return m_set.GetRoom(j * m_w + i); }
+
+    /* Follow a ray from a point inside room (i, j) and mark all the
+     * rooms it goes through before hitting a wall. */
+    void cast(vec3 p, vec3 dir, ivec2 pos, PortalBitset &visible)
+    {
+        for (;;)
+        {
+            visible.set(pos.y * m_w + pos.x);
+
+            /* Find where the ray leaves the room */
+            float tx = dir.x > 0.f ? (4.f * pos.x + 4.f - p.x) / dir.x
+                     : dir.x < 0.f ? (4.f * pos.x - p.x) / dir.x : FLT_MAX;
+            float tz = dir.z < 0.f ? (-4.f * pos.y - 4.f - p.z) / dir.z
+                     : dir.z > 0.f ? (-4.f * pos.y - p.z) / dir.z : FLT_MAX;
+            float ty = dir.y > 0.f ? (3.f - p.y) / dir.y
+                     : dir.y < 0.f ? -p.y / dir.y : FLT_MAX;
+            float t = lol::min(tx, tz);
+            if (ty < t)
+                return;
+            p += t * dir;
+
+            /* Check whether we are going through a door */
+            ivec2 next = pos, key = pos;
+            float offset;
+            std::map<int, PortalDoor<void> *> *doors;
+            if (tx < tz)
+            {
+                next.x += dir.x > 0.f ? 1 : -1;
+                key.x = lol::min(pos.x, next.x);
+                offset = p.z + 4.f * key.y + 2.f;
+                doors = &m_xdoors;
+            }
+            else
+            {
+                next.y += dir.z < 0.f ? 1 : -1;
+                key.y = lol::min(pos.y, next.y);
+                offset = p.x - 4.f * key.x - 2.f;
+                doors = &m_zdoors;
+            }
+
+            if (next.x < 0 || next.y < 0 || next.x >= m_w || next.y >= m_h
+                 || doors->find(key.y * m_w + key.x) == doors->end()
+                 || abs(offset) > 1.f || p.y > 2.f)
+                return;
+            pos = next;
+        }
+    }
+
+    int m_w, m_h;
+    PortalSet<void> m_set;
+    std::map<int, PortalDoor<void> *> m_xdoors, m_zdoors;
+};
+
+static mat4 make_camera(vec3 eye, float angle)
+{
+    vec3 target = eye + vec3(cos(angle), 0.f, -sin(angle));
+    return mat4::perspective(radians(70.f), 4.f, 3.f, 0.1f, 100.f)
+         * mat4::lookat(eye, target, vec3::axis_y);
+}
+
+lolunit_declare_fixture(portal_test)
+{
+    lolunit_declare_test(corridor)
+    {
+        /* Five rooms in a row along the z axis */
+        PortalSet<void> set;
+        PortalRoom<void> *rooms[5];
+        for (auto &room : rooms)
+            set << (room = new PortalRoom<void>());
+        for (int n = 0; n < 4; ++n)
+            (new PortalDoor<void>(vec3(2.f, 0.f, -4.f * n - 4.f), -vec3::axis_z,
+                                  vec3::axis_y, vec2(2.f)))->ConnectRooms(rooms[n + 1], rooms[n]);
+
+        lolunit_assert_equal(set.GetDoorCount(), 4);
+        for (int n = 0; n < 5; ++n)
+            lolunit_assert_equal(rooms[n]->GetID(), n);
+
+        /* Looking down the corridor, everything is visible */
+        PortalBitset visible;
+        set.GetVisibleRooms(make_camera(vec3(2.f, 1.f, -1.f), F_PI_2), rooms[0], visible);
+        lolunit_assert_equal(visible.count(), 5);
+
+        /* Looking back, only the current room is visible */
+        set.GetVisibleRooms(make_camera(vec3(2.f, 1.f, -1.f), -F_PI_2), rooms[0], visible);
+        lolunit_assert_equal(visible.count(), 1);
+        lolunit_assert(visible.get(0));
+
+        /* Looking sideways from the middle of a room, the door is out
+         * of view */
+        set.GetVisibleRooms(make_camera(vec3(2.f, 1.f, -2.f), 0.f), rooms[0], visible);
+        lolunit_assert_equal(visible.count(), 1);
+
+        /* Removing a room renumbers the others */
+        set >> rooms[2];
+        lolunit_assert_equal(set.GetRoomCount(), 4);
+        lolunit_assert_equal(rooms[2]->GetID(), -1);
+        lolunit_assert_equal(rooms[3]->GetID(), 2);
+        set.GetVisibleRooms(make_camera(vec3(2.f, 1.f, -1.f), F_PI_2), rooms[0], visible);
+        lolunit_assert_equal(visible.count(), 2);
+        delete rooms[2];
+    }
+
+    lolunit_declare_test(pvs_backwards)
+    {
+        /* A door that lies behind the door leading into a room cannot
+         * be seen through it. */
+        PortalSet<void> set;
+        PortalRoom<void> *a = new PortalRoom<void>(), *b = new PortalRoom<void>(),
+                         *c = new PortalRoom<void>();
+        set << a << b << c;
+        (new PortalDoor<void>(vec3(0.f, 0.f, 0.f), -vec3::axis_z,
+                              vec3::axis_y, vec2(2.f)))->ConnectRooms(b, a);
+        (new PortalDoor<void>(vec3(4.f, 0.f, 0.5f), vec3::axis_z,
+                              vec3::axis_y, vec2(2.f)))->ConnectRooms(c, b);
+
+        set.ComputePVS();
+        lolunit_assert(set.HasPVS());
+        lolunit_assert(set.GetPVS(a).get(b->GetID()));
+        lolunit_assert(!set.GetPVS(a).get(c->GetID()));
+        lolunit_assert(set.GetPVS(b).get(a->GetID()));
+        lolunit_assert(set.GetPVS(b).get(c->GetID()));
+        lolunit_assert(set.GetPVS(c).get(b->GetID()));
+        lolunit_assert(!set.GetPVS(c).get(a->GetID()));
+    }
+
+    lolunit_declare_test(maze_conservative)
+    {
+        /* Rays cast from the camera must never reach a room that the
+         * queries do not report, with or without the PVS. */
+        maze m(12, 12);
+        PortalBitset const empty = [&]() { PortalBitset b; b.resize(144); return b; }();
+
+        array<mat4> cameras;
+        array<PortalRoom<void> *> start_rooms;
+        array<PortalBitset> expected;
+
+        for (int n = 0; n < 40; ++n)
+        {
+            ivec2 pos(rand(12), rand(12));
+            vec3 eye(4.f * pos.x + rand(0.5f, 3.5f), rand(0.5f, 2.5f),
+                     -4.f * pos.y - rand(0.5f, 3.5f));
+            mat4 view_proj = make_camera(eye, rand(2.f * F_PI));
+            mat4 inv = inverse(view_proj);
+
+            PortalBitset rays = empty;
+            for (int k = 0; k < 200; ++k)
+            {
+                vec4 q = inv * vec4(rand(-1.f, 1.f), rand(-1.f, 1.f), 1.f, 1.f);
+                m.cast(eye, normalize(q.xyz / q.w - eye), pos, rays);
+            }
+
+            cameras.push(view_proj);
+            start_rooms.push(m.room(pos.x, pos.y));
+            expected.push(rays);
+        }
+
+        array<PortalBitset> results[2];
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            if (pass)
+                m.m_set.ComputePVS();
+
+            m.m_set.GetVisibleRooms(cameras, start_rooms, results[pass]);
+            lolunit_assert_equal(results[pass].count(), cameras.count());
+
+            for (int n = 0; n < cameras.count(); ++n)
+            {
+                /* Batch and single queries must agree */
+                PortalBitset visible;
+                m.m_set.GetVisibleRooms(cameras[n], start_rooms[n], visible);
+                lolunit_assert(visible == results[pass][n]);
+
+                for (int r = 0; r < 144; ++r)
+                    if (expected[n].get(r))
+                        lolunit_assert(visible.get(r));
+            }
+        }
+
+        /* The PVS can only remove rooms */
+        for (int n = 0; n < cameras.count(); ++n)
+            for (int r = 0; r < 144; ++r)
+                if (results[1][n].get(r))
+                    lolunit_assert(results[0][n].get(r));
+    }
+
+    lolunit_declare_test(pvs_serialisation)
+    {
+        maze m(6, 5);
+        m.m_set.ComputePVS();
+        array<uint8_t> data = m.m_set.SavePVS();
+
+        array<PortalBitset> pvs;
+        for (int r = 0; r < m.m_set.GetRoomCount(); ++r)
+            pvs.push(m.m_set.GetPVS(m.m_set.GetRoom(r)));
+
+        m.m_set.ClearPVS();
+        lolunit_assert(!m.m_set.HasPVS());
+        lolunit_assert(m.m_set.LoadPVS(data));
+        for (int r = 0; r < m.m_set.GetRoomCount(); ++r)
+            lolunit_assert(pvs[r] == m.m_set.GetPVS(m.m_set.GetRoom(r)));
+
+        /* Data for another set is rejected */
+        maze other(5, 5);
+        lolunit_assert(!other.m_set.LoadPVS(data));
+        data.pop();
+        lolunit_assert(!m.m_set.LoadPVS(data));
+    }
+};
+
+} /* namespace lol */
+
@@ -13,6 +13,7 @@
 #include <lol/engine-internal.h>
 
 #include <cmath>
+#include <string>
 
 #include <lolunit.h>
 
@@ -316,6 +317,117 @@ lolunit_declare_fixture(real_test)
         lolunit_assert_lequal((double)fabs(b), 1.0);
     }
 
+    lolunit_declare_test(small_integer_division)
+    {
+        /* Multiplying and dividing by an integer that fits in a bigit
+         * must agree with the generic operators, up to the last bit. */
+        int tests[] = { 3, -3, 7, 10, -255, 65537, 2147483647 };
+
+        for (int n : tests)
+        {
+            real a = real::R_PI() / n;
+            real b = real::R_PI() / real(n);
+            real c = real::R_PI() * n;
+            real d = real::R_PI() * real(n);
+
+            lolunit_set_context(n);
+            lolunit_assert_lequal((double)fabs(ldexp(a / b - real::R_1(), a.total_bits() - 2)), 1.0);
+            lolunit_assert_lequal((double)fabs(ldexp(c / d - real::R_1(), c.total_bits() - 2)), 1.0);
+        }
+
+        lolunit_assert_equal((double)(real(1.5) * 3), 4.5);
+        lolunit_assert_equal((double)(real(-4.5) / 3), -1.5);
+        lolunit_assert((real(0) * 3).is_zero());
+    }
+
+    lolunit_declare_test(high_precision_functions)
+    {
+        /* Check some identities with 2048-bit reals; the results must
+         * agree to within a few bits of the precision. */
+        int old_bigit_count = real::DEFAULT_BIGIT_COUNT;
+        real::DEFAULT_BIGIT_COUNT = 64;
+
+        double tests[] = { -5.5, -1.0, -0.3, 0.001, 0.4, 1.0, 2.5, 9.0 };
+
+        for (double test : tests)
+        {
+            real x = test;
+            real one = sin(x) * sin(x) + cos(x) * cos(x);
+            real y = log(exp(x));
+            real z = tan(atan(x));
+
+            lolunit_set_context(test);
+            lolunit_assert_lequal((double)fabs(ldexp(one - real::R_1(), 2040)), 1.0);
+            lolunit_assert_lequal((double)fabs(ldexp(y - x, 2036)), 1.0);
+            lolunit_assert_lequal((double)fabs(ldexp(z - x, 2036)), 1.0);
+            lolunit_assert_equal(x.total_bits(), 2048);
+        }
+
+        /* Constants are kept for each precision */
+        real pi = real::R_PI();
+        real::DEFAULT_BIGIT_COUNT = old_bigit_count;
+        lolunit_assert_equal((double)pi, (double)real::R_PI());
+        lolunit_assert_equal(real::R_PI().total_bits(), old_bigit_count * 32);
+
+        real::DEFAULT_BIGIT_COUNT = 64;
+        lolunit_assert(real::R_PI() == pi);
+        real::DEFAULT_BIGIT_COUNT = old_bigit_count;
+    }
+
+    lolunit_declare_test(string_round_trip)
+    {
+        int old_bigit_count = real::DEFAULT_BIGIT_COUNT;
+
+        for (int bigits : { 4, 16, 64 })
+        {
+            real::DEFAULT_BIGIT_COUNT = bigits;
+            int ndigits = (int)(bigits * 32 * 0.30103) + 3;
+
+            for (int n = 0; n < 20; ++n)
+            {
+                /* Build a random value from its hexadecimal representation */
+                std::string hex = rand(2) ? "-0x1." : "0x1.";
+                for (int i = 0; i < bigits * 8; ++i)
+                    hex += "0123456789abcdef"[rand(16)];
+                hex += "p" + std::to_string(rand(-300, 300));
+
+                real x(hex.c_str());
+                real y(x.xstr().c_str());
+                real z(x.str(ndigits).c_str());
+
+                /* The value must be the one that was built, with its sign,
+                 * or the comparisons below would hold trivially */
+                bool negative = hex[0] == '-';
+                real magnitude = negative ? -x : x;
+                int exponent = std::stoi(hex.substr(hex.find('p') + 1));
+
+                lolunit_set_context(hex);
+                lolunit_assert(negative ? x < real::R_0() : x > real::R_0());
+                lolunit_assert(magnitude >= ldexp(real::R_1(), exponent));
+                lolunit_assert(magnitude < ldexp(real::R_1(), exponent + 1));
+                lolunit_assert(x == y);
+                lolunit_assert_lequal((double)fabs(ldexp(z / x - real::R_1(), x.total_bits() - 8)), 1.0);
+                lolunit_unset_context(hex);
+            }
+        }
+
+        real::DEFAULT_BIGIT_COUNT = old_bigit_count;
+
+        /* Signs are accepted before hexadecimal numbers */
+        lolunit_assert_equal((double)real("-0x1.8p1"), -3.0);
+        lolunit_assert_equal((double)real("+0x1p-1"), 0.5);
+        lolunit_assert_equal((double)real("-0X10"), -16.0);
+        lolunit_assert_equal((double)real("1x2"), 1.0);
+
+        /* Printing into a buffer truncates but reports the full length */
+        char buf[8];
+        lolunit_assert_equal(real::R_PI().str(buf, sizeof(buf), 20), (size_t)21);
+        lolunit_assert_equal(std::string(buf), std::string("3.14159"));
+        lolunit_assert_equal(real(-0.375).str(buf, sizeof(buf), 20), (size_t)8);
+        lolunit_assert_equal(std::string(buf), std::string("-3.75e-"));
+        lolunit_assert_equal(real(1234).str(), std::string("1.234e+3"));
+    }
+
     lolunit_declare_test(real_sqrt)
     {
         double sqrt0 = sqrt(real(0));
@@ -0,0 +1,139 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+lolunit_declare_fixture(messageservice_test)
+{
+    void setup()
+    {
+        MessageService::Setup();
+    }
+
+    void teardown()
+    {
+        MessageService::Destroy();
+    }
+
+    lolunit_declare_test(message_order)
+    {
+        std::string long_message(1000, 'x');
+
+        MessageService::Send(MessageBucket::Bckt0, "first");
+        MessageService::Send(MessageBucket::Bckt1, "other");
+        MessageService::Send(MessageBucket::Bckt0, long_message);
+        MessageService::Send(MessageBucket::Bckt0, std::string("third"));
+
+        std::string message;
+        time_t timestamp = 0;
+        lolunit_assert(MessageService::FetchFirst(MessageBucket::Bckt0, message, timestamp));
+        lolunit_assert(message == "first");
+        lolunit_assert(timestamp <= time(nullptr));
+        lolunit_assert(timestamp >= time(nullptr) - 5);
+
+        lolunit_assert(MessageService::FetchFirst(MessageBucket::Bckt0, message));
+        lolunit_assert(message == long_message);
+        lolunit_assert(MessageService::FetchFirst(MessageBucket::Bckt0, message));
+        lolunit_assert(message == "third");
+        lolunit_assert(!MessageService::FetchFirst(MessageBucket::Bckt0, message));
+
+        lolunit_assert(MessageService::FetchAll(MessageBucket::Bckt1, message));
+        lolunit_assert(message == "other");
+        lolunit_assert(!MessageService::FetchAll(MessageBucket::Bckt1, message));
+        lolunit_assert(message == "");
+    }
+
+    lolunit_declare_test(message_fetch_all)
+    {
+        for (int i = 0; i < 1000; ++i)
+            MessageService::Send(MessageBucket::Bckt2, format("%d,", i));
+
+        std::string expected;
+        for (int i = 0; i < 1000; ++i)
+            expected += format("%d,", i);
+
+        std::string message;
+        lolunit_assert(MessageService::FetchAll(MessageBucket::Bckt2, message));
+        lolunit_assert(message == expected);
+    }
+
+    lolunit_declare_test(message_fetch_batch)
+    {
+        for (int i = 0; i < 10; ++i)
+            MessageService::Send(MessageBucket::Bckt3, format("%d", i));
+
+        std::string messages[4];
+        lolunit_assert_equal(MessageService::FetchBatch(MessageBucket::Bckt3, messages, 4), 4);
+        lolunit_assert(messages[3] == "3");
+        lolunit_assert_equal(MessageService::FetchBatch(MessageBucket::Bckt3, messages, 4), 4);
+        lolunit_assert(messages[0] == "4");
+        lolunit_assert_equal(MessageService::FetchBatch(MessageBucket::Bckt3, messages, 4), 2);
+        lolunit_assert(messages[1] == "9");
+        lolunit_assert_equal(MessageService::FetchBatch(MessageBucket::Bckt3, messages, 4), 0);
+    }
+
+    lolunit_declare_test(message_threads)
+    {
+        int const THREADS = 4, COUNT = 10000;
+
+        std::vector<std::thread> producers;
+        for (int t = 0; t < THREADS; ++t)
+            producers.emplace_back([t]()
+            {
+                char buf[32];
+                for (int n = 0; n < COUNT; ++n)
+                {
+                    sprintf(buf, "%d %d", t, n);
+                    MessageService::Send(MessageBucket::Bckt4, buf);
+                }
+            });
+
+        /* Fetch while the producers are running; messages from each
+         * thread arrive in order and none are lost. */
+        int next[THREADS] = { 0 }, total = 0;
+        std::string messages[16];
+        while (total < THREADS * COUNT)
+        {
+            int count = MessageService::FetchBatch(MessageBucket::Bckt4, messages, 16);
+            for (int i = 0; i < count; ++i)
+            {
+                int t = -1, n = -1;
+                sscanf(messages[i].c_str(), "%d %d", &t, &n);
+                lolunit_assert(t >= 0 && t < THREADS);
+                lolunit_assert_equal(n, next[t]);
+                ++next[t];
+            }
+            total += count;
+            if (!count)
+                std::this_thread::yield();
+        }
+
+        for (auto &producer : producers)
+            producer.join();
+
+        std::string message;
+        lolunit_assert(!MessageService::FetchFirst(MessageBucket::Bckt4, message));
+    }
+};
+
+} /* namespace lol */
+
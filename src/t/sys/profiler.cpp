@@ -0,0 +1,49 @@
+//
+//  Lol Engine — Unit tests
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+#include <lolunit.h>
+
+namespace lol
+{
+
+lolunit_declare_fixture(profiler_test)
+{
+    lolunit_declare_test(counters)
+    {
+        int const id = Profiler::COUNTER_UNIFORM_LOOKUP;
+
+        /* Close a frame so that earlier counts are not ours */
+        Profiler::Start(Profiler::STAT_TICK_FRAME);
+        Profiler::Stop(Profiler::STAT_TICK_FRAME);
+        int64_t total = Profiler::GetTotal(id);
+
+        Profiler::Count(id);
+        Profiler::Count(id, 4);
+        lolunit_assert_equal(Profiler::GetTotal(id), total + 5);
+
+        Profiler::Start(Profiler::STAT_TICK_FRAME);
+        Profiler::Stop(Profiler::STAT_TICK_FRAME);
+        lolunit_assert_equal(Profiler::GetFrameCount(id), 5);
+        lolunit_assert_equal(Profiler::GetTotal(id), total + 5);
+
+        /* A frame without events counts nothing */
+        Profiler::Start(Profiler::STAT_TICK_FRAME);
+        Profiler::Stop(Profiler::STAT_TICK_FRAME);
+        lolunit_assert_equal(Profiler::GetFrameCount(id), 0);
+        lolunit_assert_equal(Profiler::GetTotal(id), total + 5);
+    }
+};
+
+} /* namespace lol */
+
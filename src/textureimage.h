@@ -57,13 +57,13 @@ public:
     virtual std::string GetName() const;
 
     void UpdateTexture(image* img);
-    Texture * GetTexture();
-    Texture const * GetTexture() const;
+    virtual Texture * GetTexture();
+    virtual Texture const * GetTexture() const;
     image * GetImage();
     image const * GetImage() const;
     ivec2 GetImageSize() const;
-    ivec2 GetTextureSize() const;
-    void Bind();
+    virtual ivec2 GetTextureSize() const;
+    virtual void Bind();
     void Unbind();
 
 protected:
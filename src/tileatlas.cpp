@@ -0,0 +1,143 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#include <lol/engine-internal.h>
+
+namespace lol
+{
+
+/*
+ * TileAtlas implementation class
+ */
+
+class TileAtlasData
+{
+    friend class TileAtlas;
+
+private:
+    image_atlas m_atlas;
+
+    /* One texture per page, and the page version it was made from */
+    array<Texture *, int> m_textures;
+};
+
+/*
+ * Public TileAtlas class
+ */
+
+TileAtlas::TileAtlas(ivec2 page_size, int padding)
+  : m_data(new TileAtlasData())
+{
+    m_data->m_atlas = image_atlas(page_size, padding);
+
+    m_drawgroup = tickable::group::draw::texture;
+}
+
+TileAtlas::~TileAtlas()
+{
+    delete m_data;
+}
+
+bool TileAtlas::add(TileSet *tileset)
+{
+    if (tileset->GetPalette())
+        return false;
+
+    std::string const name = tileset->GetName();
+    int const count = tileset->GetTileCount();
+
+    /* Tilesets from a loaded atlas only need their coordinates */
+    int group = m_data->m_atlas.find(name);
+    if (group >= 0 && m_data->m_atlas.group_rects(group).count() != count)
+        group = -1;
+
+    if (group < 0)
+    {
+        if (!tileset->GetImage())
+            return false;
+
+        array<ibox2> rects;
+        for (int i = 0; i < count; ++i)
+            rects << tileset->GetTilePixel(i);
+
+        group = m_data->m_atlas.add(name, *tileset->GetImage(), rects);
+        if (group < 0)
+            return false;
+    }
+
+    tileset->use_atlas(this, m_data->m_atlas.group_page(group),
+                       m_data->m_atlas.group_rects(group));
+    return true;
+}
+
+Texture *TileAtlas::GetTexture(int page)
+{
+    return page < m_data->m_textures.count() ? m_data->m_textures[page].m1
+                                             : nullptr;
+}
+
+image_atlas const &TileAtlas::GetAtlas() const
+{
+    return m_data->m_atlas;
+}
+
+bool TileAtlas::save(std::string const &path) const
+{
+    return m_data->m_atlas.save(path);
+}
+
+bool TileAtlas::load(std::string const &path)
+{
+    return m_data->m_atlas.load(path);
+}
+
+std::string TileAtlas::GetName() const
+{
+    return "<tileatlas>";
+}
+
+void TileAtlas::tick_draw(float seconds, Scene &scene)
+{
+    entity::tick_draw(seconds, scene);
+
+    if (has_flags(entity::flags::destroying))
+    {
+        for (auto &t : m_data->m_textures)
+            delete t.m1;
+        m_data->m_textures.clear();
+        return;
+    }
+
+    /* Upload new pages, and pages that received new tiles */
+    image_atlas const &atlas = m_data->m_atlas;
+    for (int n = 0; n < atlas.page_count(); ++n)
+    {
+        if (n == m_data->m_textures.count())
+            m_data->m_textures.push(nullptr, -1);
+
+        auto &t = m_data->m_textures[n];
+        if (t.m1 && t.m2 == atlas.page_version(n))
+            continue;
+
+        image tmp = atlas.page(n);
+        u8vec4 *pixels = tmp.lock<PixelFormat::RGBA_8>();
+        if (!t.m1)
+            t.m1 = new Texture(atlas.page_size(), PixelFormat::RGBA_8);
+        t.m1->SetData(pixels);
+        tmp.unlock(pixels);
+
+        t.m2 = atlas.page_version(n);
+    }
+}
+
+} /* namespace lol */
+
@@ -0,0 +1,68 @@
+//
+//  Lol Engine
+//
+//  Copyright © 2010—2019 Sam Hocevar <sam@hocevar.net>
+//
+//  Lol Engine is free software. It comes without any warranty, to
+//  the extent permitted by applicable law. You can redistribute it
+//  and/or modify it under the terms of the Do What the Fuck You Want
+//  to Public License, Version 2, as published by the WTFPL Task Force.
+//  See http://www.wtfpl.net/ for more details.
+//
+
+#pragma once
+
+//
+// The TileAtlas class
+// -------------------
+// A TileAtlas gathers the tiles of many tilesets into a few shared
+// textures, so that the scene can draw them in fewer batches. Tilesets
+// keep their tile indices; only their texture coordinates change. Pages
+// are uploaded in the render tick method, again whenever tiles are added.
+// Page textures are never mipmapped: the tile padding only protects them
+// from bilinear filtering.
+//
+
+#include <lol/image/atlas.h>
+#include <lol/gpu/texture.h>
+
+#include "engine/entity.h"
+
+namespace lol
+{
+
+class TileSet;
+class TileAtlasData;
+
+class TileAtlas : public entity
+{
+public:
+    TileAtlas(ivec2 page_size = ivec2(1024), int padding = 2);
+    virtual ~TileAtlas();
+
+    /* Move the tiles of a tileset into the atlas. This must happen before
+     * the tileset texture is uploaded, unless the tileset is already part
+     * of a loaded atlas. Tilesets with a palette are not supported.
+     * Each tileset keeps a reference on the atlas until it dies. */
+    bool add(TileSet *tileset);
+
+    Texture *GetTexture(int page);
+    image_atlas const &GetAtlas() const;
+
+    /* Packed atlases can be saved and loaded back before adding tilesets,
+     * which then skips packing and copying their pixels. */
+    bool save(std::string const &path) const;
+    bool load(std::string const &path);
+
+    /* Inherited from entity */
+    virtual std::string GetName() const;
+
+protected:
+    virtual void tick_draw(float seconds, Scene &scene);
+
+private:
+    TileAtlasData *m_data;
+};
+
+} /* namespace lol */
+
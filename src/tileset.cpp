@@ -43,6 +43,10 @@ protected:
     /* Pixels, then texture coordinates */
     array<ibox2, box2> m_tiles;
     ivec2 m_tile_size;
+
+    /* The atlas page holding our tiles, if any */
+    TileAtlas *m_atlas = nullptr;
+    int m_atlas_page = 0;
 };
 
 /*
@@ -154,6 +158,8 @@ TileSet::TileSet(std::string const &path, image *img)
 
 TileSet::~TileSet()
 {
+    if (m_tileset_data->m_atlas)
+        Ticker::Unref(m_tileset_data->m_atlas);
     delete m_tileset_data;
 }
 
@@ -192,6 +198,8 @@ void TileSet::clear_all()
 
 int TileSet::define_tile(ibox2 rect)
 {
+    ASSERT(!m_tileset_data->m_atlas, "cannot define tiles after packing");
+
     m_tileset_data->m_tiles.push(rect,
              box2((vec2)rect.aa / (vec2)m_data->m_texture_size,
                   (vec2)rect.bb / (vec2)m_data->m_texture_size));
@@ -258,6 +266,64 @@ TileSet const* TileSet::GetPalette() const
     return m_palette;
 }
 
+//Atlas -----------------------------------------------------------------------
+void TileSet::use_atlas(TileAtlas *atlas, int page, array<ibox2> const &rects)
+{
+    ASSERT(rects.count() == m_tileset_data->m_tiles.count());
+
+    /* Keep the atlas, and its page textures, alive as long as we are */
+    if (atlas != m_tileset_data->m_atlas)
+    {
+        Ticker::Ref(atlas);
+        if (m_tileset_data->m_atlas)
+            Ticker::Unref(m_tileset_data->m_atlas);
+    }
+
+    m_tileset_data->m_atlas = atlas;
+    m_tileset_data->m_atlas_page = page;
+
+    vec2 size = (vec2)atlas->GetAtlas().page_size();
+    for (int i = 0; i < rects.count(); ++i)
+        m_tileset_data->m_tiles[i].m2 = box2((vec2)rects[i].aa / size,
+                                             (vec2)rects[i].bb / size);
+
+    /* Our own pixels are no longer needed */
+    delete m_data->m_image;
+    m_data->m_image = nullptr;
+}
+
+Texture *TileSet::GetTexture()
+{
+    if (m_tileset_data->m_atlas)
+        return m_tileset_data->m_atlas->GetTexture(m_tileset_data->m_atlas_page);
+    return super::GetTexture();
+}
+
+Texture const *TileSet::GetTexture() const
+{
+    if (m_tileset_data->m_atlas)
+        return m_tileset_data->m_atlas->GetTexture(m_tileset_data->m_atlas_page);
+    return super::GetTexture();
+}
+
+ivec2 TileSet::GetTextureSize() const
+{
+    if (m_tileset_data->m_atlas)
+        return m_tileset_data->m_atlas->GetAtlas().page_size();
+    return super::GetTextureSize();
+}
+
+void TileSet::Bind()
+{
+    if (m_tileset_data->m_atlas)
+    {
+        if (GetTexture())
+            GetTexture()->Bind();
+    }
+    else
+        super::Bind();
+}
+
 void TileSet::BlitTile(uint32_t id, mat4 model, vec3 *vertex, vec2 *texture)
 {
     ibox2 pixels = m_tileset_data->m_tiles[id].m1;
@@ -271,7 +337,7 @@ void TileSet::BlitTile(uint32_t id, mat4 model, vec3 *vertex, vec2 *texture)
     vec3 extent_x = 0.5f * pixels.extent().x * (model * vec4::axis_x).xyz;
     vec3 extent_y = 0.5f * pixels.extent().y * (model * vec4::axis_y).xyz;
 
-    if (!m_data->m_image && m_data->m_texture)
+    if (!m_data->m_image && GetTexture())
     {
         *vertex++ = pos + extent_x + extent_y;
         *vertex++ = pos - extent_x + extent_y;
@@ -35,6 +35,7 @@ namespace lol
 
 class TextureImageData;
 class TileSetData;
+class TileAtlas;
 
 class TileSet : public TextureImage
 {
@@ -81,6 +82,15 @@ public:
     TileSet const * GetPalette() const;
     void BlitTile(uint32_t id, mat4 model, vec3 *vertex, vec2 *texture);
 
+    /* Draw tiles from a shared atlas page; see TileAtlas::add() */
+    void use_atlas(TileAtlas *atlas, int page, array<ibox2> const &rects);
+
+    /* Inherited from TextureImage, redirected to the atlas if any */
+    virtual Texture * GetTexture();
+    virtual Texture const * GetTexture() const;
+    virtual ivec2 GetTextureSize() const;
+    virtual void Bind();
+
 protected:
     TileSetData *m_tileset_data;
     TileSet *m_palette;
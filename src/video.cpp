@@ -22,6 +22,13 @@
 
 #include "lolgl.h"
 
+#include <algorithm>
+
+#if (defined LOL_USE_GLEW || defined HAVE_GL_2X) \
+        && defined GL_PIXEL_PACK_BUFFER && defined GL_MAP_READ_BIT
+#   define LOL_CAPTURE_PBO 1
+#endif
+
 namespace lol
 {
 
@@ -108,15 +115,169 @@ void Video::Capture(uint32_t *buffer)
     glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
 #   endif
 
+    /* Flip the rows, since OpenGL returns them bottom-up */
     for (int j = 0; j < height / 2; j++)
-        for (int i = 0; i < width; i++)
+        std::swap_ranges(buffer + j * width, buffer + (j + 1) * width,
+                         buffer + (height - j - 1) * width);
+#else
+    UNUSED(buffer);
+#endif
+}
+
+/*
+ * FrameCapture implementation class
+ */
+
+class FrameCaptureData
+{
+    friend class FrameCapture;
+
+private:
+    /* Read the viewport in RGBA into “dst”, which may be an offset in the
+     * currently bound pixel pack buffer. */
+    static void ReadViewport(ivec2 size, void *dst)
+    {
+#if defined LOL_USE_GLEW || defined HAVE_GL_2X || defined HAVE_GLES_2X
+#   if defined HAVE_GL_2X
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+#   endif
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, dst);
+#else
+        UNUSED(size, dst);
+#endif
+    }
+
+    static ivec2 ViewportSize()
+    {
+#if defined LOL_USE_GLEW || defined HAVE_GL_2X || defined HAVE_GLES_2X
+        GLint v[4];
+        glGetIntegerv(GL_VIEWPORT, v);
+        return ivec2(v[2], v[3]);
+#else
+        return ivec2(0);
+#endif
+    }
+
+#if LOL_CAPTURE_PBO
+    struct slot
+    {
+        GLuint pbo = 0;
+        ivec2 size = ivec2(0);
+        size_t bytes = 0;
+        bool pending = false;
+    };
+
+    /* Map a finished readback and give it to the callback */
+    static void Deliver(slot &s, FrameCapture::callback const &fn)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+        void *p = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, s.bytes,
+                                   GL_MAP_READ_BIT);
+        if (p)
+        {
+            u8vec4 const *pixels = (u8vec4 const *)p;
+            fn(pixels + (s.size.y - 1) * s.size.x, -s.size.x, s.size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        s.pending = false;
+    }
+
+    array<slot> m_slots;
+    int m_next = 0;
+#endif
+
+    bool m_use_pbo = false;
+
+    /* Reused across frames when reading synchronously */
+    array<u8vec4> m_buffer;
+};
+
+/*
+ * Public FrameCapture class
+ */
+
+FrameCapture::FrameCapture(int depth)
+  : m_data(new FrameCaptureData())
+{
+#if LOL_CAPTURE_PBO
+    /* GL functions are loaded by GLEW, so check they exist */
+#   if defined LOL_USE_GLEW && !defined __APPLE__
+    m_data->m_use_pbo = depth > 1
+                     && (GLEW_VERSION_3_0 || GLEW_ARB_map_buffer_range);
+#   else
+    m_data->m_use_pbo = depth > 1;
+#   endif
+    if (m_data->m_use_pbo)
+        m_data->m_slots.resize(depth);
+#else
+    UNUSED(depth);
+#endif
+}
+
+FrameCapture::~FrameCapture()
+{
+#if LOL_CAPTURE_PBO
+    for (auto const &s : m_data->m_slots)
+        if (s.pbo)
+            glDeleteBuffers(1, &s.pbo);
+#endif
+
+    delete m_data;
+}
+
+void FrameCapture::Capture(callback const &fn)
+{
+    ivec2 size = FrameCaptureData::ViewportSize();
+    if (size.x <= 0 || size.y <= 0)
+        return;
+
+#if LOL_CAPTURE_PBO
+    if (m_data->m_use_pbo)
+    {
+        /* The next slot holds the oldest frame; free it first */
+        FrameCaptureData::slot &s = m_data->m_slots[m_data->m_next];
+        if (s.pending)
+            FrameCaptureData::Deliver(s, fn);
+
+        if (!s.pbo)
+            glGenBuffers(1, &s.pbo);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+        size_t bytes = (size_t)size.x * size.y * sizeof(u8vec4);
+        if (bytes != s.bytes)
         {
-            uint32_t tmp = buffer[j * width + i];
-            buffer[j * width + i] = buffer[(height - j - 1) * width + i];
-            buffer[(height - j - 1) * width + i] = tmp;
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            s.bytes = bytes;
         }
+        FrameCaptureData::ReadViewport(size, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        s.size = size;
+        s.pending = true;
+        m_data->m_next = (m_data->m_next + 1) % m_data->m_slots.count();
+        return;
+    }
+#endif
+
+    m_data->m_buffer.resize(size.x * size.y);
+    FrameCaptureData::ReadViewport(size, &m_data->m_buffer[0]);
+    fn(&m_data->m_buffer[(size.y - 1) * size.x], -size.x, size);
+}
+
+void FrameCapture::Flush(callback const &fn)
+{
+#if LOL_CAPTURE_PBO
+    int count = (int)m_data->m_slots.count();
+    for (int i = 0; i < count; ++i)
+    {
+        FrameCaptureData::slot &s = m_data->m_slots[(m_data->m_next + i) % count];
+        if (s.pending)
+            FrameCaptureData::Deliver(s, fn);
+    }
 #else
-    UNUSED(buffer);
+    UNUSED(fn);
 #endif
 }
 
@@ -19,6 +19,7 @@
 //
 
 #include <stdint.h>
+#include <functional>
 
 namespace lol
 {
@@ -59,5 +60,29 @@ public:
     static void Capture(uint32_t *buffer);
 };
 
+// Asynchronous frame capture. Each Capture() call starts reading the
+// viewport into one of a ring of pixel buffer objects, and hands the frame
+// started “depth - 1” calls earlier to the callback, so that the GPU never
+// needs to be waited for. Pixels are RGBA; since OpenGL returns rows
+// bottom-up, the callback gets a pointer to the top row and a negative
+// pitch. Without pixel buffer objects, frames are read synchronously.
+class FrameCapture
+{
+public:
+    typedef std::function<void(u8vec4 const *pixels, ptrdiff_t pitch,
+                               ivec2 size)> callback;
+
+    FrameCapture(int depth = 3);
+    ~FrameCapture();
+
+    void Capture(callback const &fn);
+
+    /* Hand all frames still in flight to the callback */
+    void Flush(callback const &fn);
+
+private:
+    class FrameCaptureData *m_data;
+};
+
 } /* namespace lol */
 